@@ -54,4 +54,7 @@ TESEO_AGPS_ENABLED := false
 TESEO_SUPL_ENABLED := false
 endif
 
+# Firmware update over the UART, the bootloader framing is not validated on a receiver yet
+TESEO_FIRMWARE_UPDATE_ENABLED := false
+
 include $(call all-subdir-makefiles)
@@ -39,10 +39,14 @@ LOCAL_SHARED_LIBRARIES := \
 	libteseo.utils        \
 	libteseo.vendor
 
-LOCAL_SRC_FILES := src/config.cpp
+LOCAL_SRC_FILES := \
+	src/cache.cpp  \
+	src/config.cpp
 
 LOCAL_COPY_HEADERS_TO:= teseo/config/
-LOCAL_COPY_HEADERS := include/teseo/config/config.h
+LOCAL_COPY_HEADERS :=         \
+	include/teseo/config/cache.h  \
+	include/teseo/config/config.h
 
 LOCAL_PRELINK_MODULE := false
 
@@ -0,0 +1,94 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Binary cache of the parsed configuration
+ * @file cache.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_CONFIG_CACHE_H
+#define TESEO_HAL_CONFIG_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <teseo/config/config.h>
+
+namespace stm {
+namespace config {
+namespace cache {
+
+/**
+ * Identity of a configuration file
+ *
+ * @details The cache is only used when all the fields match the current configuration file.
+ */
+struct SourceKey {
+    uint64_t size;      ///< File size, in bytes
+    int64_t mtimeSec;   ///< Modification time, seconds part
+    int64_t mtimeNsec;  ///< Modification time, nanoseconds part
+    uint64_t hash;      ///< FNV-1a hash of the file content
+
+    bool operator==(const SourceKey & other) const;
+    bool operator!=(const SourceKey & other) const;
+};
+
+/**
+ * 64 bits FNV-1a hash
+ */
+uint64_t hash(const void * data, std::size_t length);
+
+/**
+ * Read a configuration file and compute its key
+ * @param path Configuration file path
+ * @param content Receives the file content
+ * @param key Receives the file key
+ * @return true on success, false if the file cannot be read
+ */
+bool readSource(const std::string & path, std::string & content, SourceKey & key);
+
+/**
+ * Load the configuration from a cache file
+ * @param cachePath Cache file path
+ * @param key Key of the current configuration file
+ * @param config Receives the configuration, left unchanged on failure
+ * @return true if the cache exists, is valid and matches the key
+ */
+bool load(const std::string & cachePath, const SourceKey & key, Configuration & config);
+
+/**
+ * Write a configuration to a cache file
+ * @details The file is written to a temporary file first and then renamed, so a reader never
+ * sees a partially written cache.
+ * @param cachePath Cache file path
+ * @param key Key of the configuration file the configuration was parsed from
+ * @param config Configuration to store
+ * @return true on success
+ */
+bool store(const std::string & cachePath, const SourceKey & key, const Configuration & config);
+
+} // namespace cache
+} // namespace config
+} // namespace stm
+
+#endif // TESEO_HAL_CONFIG_CACHE_H
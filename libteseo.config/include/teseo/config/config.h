@@ -47,8 +47,41 @@ struct Configuration {
     struct Device {
         std::string tty; ///< TTY connected to Teseo
         unsigned int speed; ///< Serial port baudrate
+        std::string pps; ///< PPS device fed by the Teseo 1PPS line, empty to disable
     } device;
 
+    /**
+     * Hot-standby receiver, used when the primary device fails
+     */
+    struct Standby {
+        std::string tty;     ///< TTY connected to the standby Teseo, empty to disable
+        unsigned int speed;  ///< Serial port baudrate
+        int epoch_period;    ///< Receivers fix period, in milliseconds
+        int cadence_timeout; ///< A receiver whose epoch is this late is stalled, below epoch_period, in milliseconds
+        int fix_timeout;     ///< A receiver without valid fix for this long is unhealthy, in milliseconds
+        int demote_after;    ///< Primary healthy time before the standby is demoted, in milliseconds
+    } standby;
+
+    /**
+     * Receiver datalog, fixes are logged by the receiver while the host is not navigating
+     */
+    struct Datalog {
+        bool enable;        ///< Log fixes in the receiver between navigation sessions
+        bool circular;      ///< Overwrite the oldest entries when the log is full
+        int min_interval;   ///< Minimum time between two entries, in seconds
+        int min_speed;      ///< Minimum speed for an entry to be logged, in km/h
+        int min_distance;   ///< Minimum distance between two entries, in meters
+        int answer_timeout; ///< A command without answer for this long failed, in milliseconds
+    } datalog;
+
+    /**
+     * Compressed capture of the receiver stream
+     */
+    struct Capture {
+        std::string path; ///< Capture file, empty to disable
+        int chunk_size;   ///< Raw bytes covered by an independently decodable chunk
+    } capture;
+
     /**
      * Constellations supports
      */
@@ -57,14 +90,42 @@ struct Configuration {
         bool glonass;
         bool beidou;
         bool galileo;
+        bool adaptive; ///< Disable the extra constellations under open sky
     } constellations;
 
+    /**
+     * Almanac based sky visibility prediction
+     */
+    struct SkyPrediction {
+        bool enable;        ///< Inject the predicted satellites as aiding at start
+        std::string store;  ///< File keeping the almanacs and the last position
+        int elevation_mask; ///< Minimum elevation of a predicted satellite, in degrees
+        int refresh;        ///< Almanac age requiring a dump from the receiver, in seconds
+    } sky_prediction;
+
     /**
      * Assistance
      */
     struct Agnss
     {
         bool enable; ///< Flag used to enable or disable assistance including ST-AGPS
+
+        /**
+         * Predictive assistance file refresh
+         */
+        struct Refresh {
+            bool enable;                ///< Enable or disable the refresh
+            std::string ephemeris_uri;  ///< Ephemeris file URI, empty to not refresh the ephemeris
+            int ephemeris_validity;     ///< Validity of downloaded ephemeris, in seconds
+            std::string almanac_uri;    ///< Almanac file URI, empty to not refresh the almanacs
+            int almanac_validity;       ///< Validity of downloaded almanacs, in seconds
+            std::string path;           ///< Directory where the downloaded files are stored
+            int prefetch_lead;          ///< Refresh an item this long before it expires, in seconds
+            int coalesce_window;        ///< Refresh early when woken up less than this before, in seconds
+            int backoff_base;           ///< First retry delay, in seconds
+            int backoff_max;            ///< Maximum retry delay, in seconds
+            int daily_budget;           ///< Maximum bytes downloaded per 24 hours, 0 for unlimited
+        } refresh;
     } agnss;
     /**
      * ST-AGPS Configuration
@@ -101,7 +162,18 @@ struct Configuration {
 
 };
 
-const Configuration & read(const std::string & path = std::string("/etc/gps.conf"));
+/**
+ * Read the configuration
+ *
+ * @details The parsed configuration is kept in a binary cache, keyed by the size, modification
+ * time and content hash of the configuration file. The TOML parser only runs when the cache is
+ * missing, corrupted or out of date, in which case the cache is rebuilt.
+ * @param path Configuration file path
+ * @param cachePath Cache file path, empty to disable the cache
+ */
+const Configuration & read(
+    const std::string & path = std::string("/etc/gps.conf"),
+    const std::string & cachePath = std::string("/data/gps/gps.conf.cache"));
 
 const Configuration & get();
 
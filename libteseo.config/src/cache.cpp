@@ -0,0 +1,479 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Binary cache of the parsed configuration
+ * @file cache.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/config/cache.h>
+
+#define LOG_TAG "teseo_hal_config_cache"
+#include <cutils/log.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fields.h"
+
+using namespace std;
+
+namespace stm {
+namespace config {
+namespace cache {
+
+namespace {
+
+constexpr uint32_t magic = 0x46435354; // "TSCF"
+constexpr uint32_t version = 1;
+
+/**
+ * Cache file header, stored in host byte order
+ *
+ * @details The cache is never shared between devices, there is no need for a portable layout.
+ */
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t schema;         ///< Hash of the fields and defaults, invalidates caches of other HAL versions
+    uint64_t sourceSize;
+    int64_t sourceMtimeSec;
+    int64_t sourceMtimeNsec;
+    uint64_t sourceHash;
+    uint32_t payloadSize;
+    uint32_t reserved;
+    uint64_t payloadHash;
+};
+
+static_assert(sizeof(Header) == 64, "Unexpected cache header size");
+
+enum class Tag : uint8_t {
+    Bool     = 'b',
+    Int      = 'i',
+    Unsigned = 'u',
+    String   = 's'
+};
+
+/**
+ * Each field is stored as a type tag followed by its value, strings are length prefixed
+ */
+class Writer {
+private:
+    vector<uint8_t> & buffer;
+
+    void raw(const void * data, size_t length)
+    {
+        auto bytes = static_cast<const uint8_t *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + length);
+    }
+
+    void tag(Tag t)
+    {
+        buffer.push_back(static_cast<uint8_t>(t));
+    }
+
+public:
+    Writer(vector<uint8_t> & buffer) : buffer(buffer) { }
+
+    void put(bool value)
+    {
+        tag(Tag::Bool);
+        buffer.push_back(value ? 1 : 0);
+    }
+
+    void put(int value)
+    {
+        tag(Tag::Int);
+        int32_t v = value;
+        raw(&v, sizeof(v));
+    }
+
+    void put(unsigned int value)
+    {
+        tag(Tag::Unsigned);
+        uint32_t v = value;
+        raw(&v, sizeof(v));
+    }
+
+    void put(const string & value)
+    {
+        tag(Tag::String);
+        uint32_t length = value.size();
+        raw(&length, sizeof(length));
+        raw(value.data(), value.size());
+    }
+};
+
+/**
+ * Hash of the name, type and default value of every field
+ *
+ * @details The cache stores the resolved configuration, defaults included: a cache built with
+ * other defaults or field types must be dropped as well.
+ */
+uint64_t computeSchema()
+{
+    vector<uint8_t> buffer;
+    Writer writer(buffer);
+    Configuration config;
+
+#define SCHEMA_FIELD(key, def) \
+    writer.put(string(#key)); \
+    writer.put(static_cast<decltype(config.key)>(def));
+
+    CONFIG_FIELDS(SCHEMA_FIELD)
+
+#undef SCHEMA_FIELD
+
+    return hash(buffer.data(), buffer.size());
+}
+
+uint64_t schema()
+{
+    static const uint64_t value = computeSchema();
+    return value;
+}
+
+class Reader {
+private:
+    const uint8_t * cursor;
+    const uint8_t * end;
+
+    bool raw(void * data, size_t length)
+    {
+        if(static_cast<size_t>(end - cursor) < length)
+            return false;
+
+        memcpy(data, cursor, length);
+        cursor += length;
+        return true;
+    }
+
+    bool tag(Tag t)
+    {
+        if(cursor == end || *cursor != static_cast<uint8_t>(t))
+            return false;
+
+        cursor++;
+        return true;
+    }
+
+public:
+    Reader(const uint8_t * data, size_t length) : cursor(data), end(data + length) { }
+
+    bool get(bool & value)
+    {
+        uint8_t v;
+        if(!tag(Tag::Bool) || !raw(&v, sizeof(v)) || v > 1)
+            return false;
+
+        value = (v == 1);
+        return true;
+    }
+
+    bool get(int & value)
+    {
+        int32_t v;
+        if(!tag(Tag::Int) || !raw(&v, sizeof(v)))
+            return false;
+
+        value = v;
+        return true;
+    }
+
+    bool get(unsigned int & value)
+    {
+        uint32_t v;
+        if(!tag(Tag::Unsigned) || !raw(&v, sizeof(v)))
+            return false;
+
+        value = v;
+        return true;
+    }
+
+    bool get(string & value)
+    {
+        uint32_t length;
+        if(!tag(Tag::String) || !raw(&length, sizeof(length)))
+            return false;
+
+        if(static_cast<size_t>(end - cursor) < length)
+            return false;
+
+        value.assign(reinterpret_cast<const char *>(cursor), length);
+        cursor += length;
+        return true;
+    }
+
+    bool atEnd() const
+    {
+        return cursor == end;
+    }
+};
+
+bool deserialize(const uint8_t * data, size_t length, const SourceKey & key, Configuration & config)
+{
+    Header header;
+
+    if(length < sizeof(header))
+    {
+        ALOGW("Configuration cache truncated (%zu bytes)", length);
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if(header.magic != magic || header.version != version || header.schema != schema())
+    {
+        ALOGI("Configuration cache built by another HAL version");
+        return false;
+    }
+
+    SourceKey cachedKey = {
+        header.sourceSize,
+        header.sourceMtimeSec,
+        header.sourceMtimeNsec,
+        header.sourceHash
+    };
+
+    if(cachedKey != key)
+    {
+        ALOGI("Configuration file changed since the cache was built");
+        return false;
+    }
+
+    const uint8_t * payload = data + sizeof(header);
+
+    if(header.payloadSize != length - sizeof(header) ||
+       header.payloadHash != hash(payload, header.payloadSize))
+    {
+        ALOGW("Configuration cache is corrupted");
+        return false;
+    }
+
+    Configuration cfg;
+    Reader reader(payload, header.payloadSize);
+
+#define LOAD_FIELD(key, def) \
+    if(!reader.get(cfg.key)) { ALOGW("Malformed cache field: %s", #key); return false; }
+
+    CONFIG_FIELDS(LOAD_FIELD)
+
+#undef LOAD_FIELD
+
+    if(!reader.atEnd())
+    {
+        ALOGW("Trailing bytes in configuration cache");
+        return false;
+    }
+
+    config = cfg;
+    return true;
+}
+
+bool writeAll(int fd, const uint8_t * data, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t n = ::write(fd, data, length);
+
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return false;
+        }
+
+        data += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+bool SourceKey::operator==(const SourceKey & other) const
+{
+    return size == other.size &&
+           mtimeSec == other.mtimeSec &&
+           mtimeNsec == other.mtimeNsec &&
+           hash == other.hash;
+}
+
+bool SourceKey::operator!=(const SourceKey & other) const
+{
+    return !(*this == other);
+}
+
+uint64_t hash(const void * data, size_t length)
+{
+    auto bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+bool readSource(const string & path, string & content, SourceKey & key)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    content.resize(st.st_size);
+
+    size_t done = 0;
+    while(done < content.size())
+    {
+        ssize_t n = ::read(fd, &content[done], content.size() - done);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n <= 0)
+            break;
+
+        done += n;
+    }
+
+    close(fd);
+
+    // File modified while being read, the next load will rebuild the cache
+    content.resize(done);
+
+    key.size = st.st_size;
+    key.mtimeSec = st.st_mtim.tv_sec;
+    key.mtimeNsec = st.st_mtim.tv_nsec;
+    key.hash = hash(content.data(), content.size());
+
+    return true;
+}
+
+bool load(const string & cachePath, const SourceKey & key, Configuration & config)
+{
+    int fd = open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0)
+    {
+        if(errno != ENOENT)
+            ALOGW("Unable to open configuration cache %s: %s", cachePath.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void * map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED)
+    {
+        ALOGW("Unable to map configuration cache %s: %s", cachePath.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool result = deserialize(static_cast<const uint8_t *>(map), st.st_size, key, config);
+
+    munmap(map, st.st_size);
+
+    return result;
+}
+
+bool store(const string & cachePath, const SourceKey & key, const Configuration & config)
+{
+    vector<uint8_t> buffer(sizeof(Header));
+    Writer writer(buffer);
+
+#define WRITE_FIELD(key, def) writer.put(config.key);
+
+    CONFIG_FIELDS(WRITE_FIELD)
+
+#undef WRITE_FIELD
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = magic;
+    header.version = version;
+    header.schema = schema();
+    header.sourceSize = key.size;
+    header.sourceMtimeSec = key.mtimeSec;
+    header.sourceMtimeNsec = key.mtimeNsec;
+    header.sourceHash = key.hash;
+    header.payloadSize = buffer.size() - sizeof(header);
+    header.payloadHash = hash(buffer.data() + sizeof(header), header.payloadSize);
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    string tmpPath = cachePath + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if(fd < 0)
+    {
+        ALOGW("Unable to create configuration cache %s: %s", tmpPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = writeAll(fd, buffer.data(), buffer.size()) && fsync(fd) == 0;
+
+    if(close(fd) != 0)
+        ok = false;
+
+    if(ok && rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        ok = false;
+
+    if(!ok)
+    {
+        ALOGW("Unable to write configuration cache %s: %s", cachePath.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+    }
+
+    return ok;
+}
+
+} // namespace cache
+} // namespace config
+} // namespace stm
@@ -30,11 +30,13 @@
 #define LOG_TAG "teseo_hal_config"
 #include <cutils/log.h>
 #include <memory>
+#include <sstream>
 #include <string>
 
 #include <teseo/vendor/cpptoml.h>
+#include <teseo/config/cache.h>
 
-#include "defaultconfig.h"
+#include "fields.h"
 
 using namespace std;
 
@@ -57,42 +59,41 @@ T get_or_default(cpptoml::option<T> opt, const T & defaultValue)
 #define READ_VAL(key, def) \
     config.key = get_or_default(cfg.get_qualified_as<decltype(def)>(#key), def)
 
-const Configuration & read(const string & path)
+#define READ_FIELD(key, def) READ_VAL(key, def);
+
+const Configuration & read(const string & path, const string & cachePath)
 {
+    string content;
+    cache::SourceKey key;
+    bool haveSource = cache::readSource(path, content, key);
+
+    if(haveSource && !cachePath.empty() && cache::load(cachePath, key, config))
+    {
+        ALOGI("Configuration loaded from cache: %s", cachePath.c_str());
+        return config;
+    }
+
     ALOGI("Parse configuration file: %s", path.c_str());
-    rawConfig = cpptoml::parse_file(path);
+    if(haveSource)
+    {
+        istringstream stream(content);
+        cpptoml::parser parser(stream);
+        rawConfig = parser.parse();
+    }
+    else
+    {
+        // Throws with the reason why the file cannot be opened
+        rawConfig = cpptoml::parse_file(path);
+    }
 
     ALOGI("Dereference configuration object");
     const auto & cfg = *rawConfig;
 
     ALOGI("Read configuration");
-    READ_VAL(device.tty, CFG_DEF_DEVICE_TTY);
-    READ_VAL(device.speed, CFG_DEF_DEVICE_SPEED);
-
-    READ_VAL(constellations.gps,     CFG_DEF_CONSTELLATIONS_GPS);
-    READ_VAL(constellations.glonass, CFG_DEF_CONSTELLATIONS_GLONASS);
-    READ_VAL(constellations.beidou,  CFG_DEF_CONSTELLATIONS_BEIDOU);
-    READ_VAL(constellations.galileo, CFG_DEF_CONSTELLATIONS_GALILEO);
-
-    READ_VAL(agnss.enable,CFG_DEF_DATA_ASSISTANCE_ENABLED);
-    READ_VAL(stagps.enable, CFG_DEF_STAGPS_ENABLE);
-
-    READ_VAL(stagps.predictive.enable,    CFG_DEF_STAGPS_PREDICTIVE_ENABLE);
-    READ_VAL(stagps.predictive.host,      CFG_DEF_STAGPS_PREDICTIVE_HOST);
-    READ_VAL(stagps.predictive.port,      CFG_DEF_STAGPS_PREDICTIVE_PORT);
-    READ_VAL(stagps.predictive.vendor_id, CFG_DEF_STAGPS_PREDICTIVE_VENDOR_ID);
-    READ_VAL(stagps.predictive.model_id,  CFG_DEF_STAGPS_PREDICTIVE_MODEL_ID);
-    READ_VAL(stagps.predictive.device_id, CFG_DEF_STAGPS_PREDICTIVE_DEVICE_ID);
-    READ_VAL(stagps.predictive.seed_type, CFG_DEF_STAGPS_PREDICTIVE_SEED_TYPE);
-    READ_VAL(stagps.predictive.base_path, CFG_DEF_STAGPS_PREDICTIVE_BASE_PATH);
-
-    READ_VAL(stagps.realtime.enable,    CFG_DEF_STAGPS_REALTIME_ENABLE);
-    READ_VAL(stagps.realtime.host,      CFG_DEF_STAGPS_REALTIME_HOST);
-    READ_VAL(stagps.realtime.port,      CFG_DEF_STAGPS_REALTIME_PORT);
-    READ_VAL(stagps.realtime.vendor_id, CFG_DEF_STAGPS_REALTIME_VENDOR_ID);
-    READ_VAL(stagps.realtime.model_id,  CFG_DEF_STAGPS_REALTIME_MODEL_ID);
-    READ_VAL(stagps.realtime.device_id, CFG_DEF_STAGPS_REALTIME_DEVICE_ID);
-    READ_VAL(stagps.realtime.base_path, CFG_DEF_STAGPS_REALTIME_BASE_PATH);
+    CONFIG_FIELDS(READ_FIELD)
+
+    if(haveSource && !cachePath.empty() && cache::store(cachePath, key, config))
+        ALOGI("Configuration cache written: %s", cachePath.c_str());
 
     ALOGI("Done");
 
@@ -30,15 +30,51 @@
 
 #define CFG_DEF_DEVICE_TTY std::string("/dev/ttyAMA2")
 #define CFG_DEF_DEVICE_SPEED 115200
+#define CFG_DEF_DEVICE_PPS std::string("")
+
+#define CFG_DEF_STANDBY_TTY             std::string("")
+#define CFG_DEF_STANDBY_SPEED           115200
+#define CFG_DEF_STANDBY_EPOCH_PERIOD    1000
+#define CFG_DEF_STANDBY_CADENCE_TIMEOUT 200
+#define CFG_DEF_STANDBY_FIX_TIMEOUT     2500
+#define CFG_DEF_STANDBY_DEMOTE_AFTER    10000
+
+#define CFG_DEF_DATALOG_ENABLE         false
+#define CFG_DEF_DATALOG_CIRCULAR       true
+#define CFG_DEF_DATALOG_MIN_INTERVAL   1
+#define CFG_DEF_DATALOG_MIN_SPEED      0
+#define CFG_DEF_DATALOG_MIN_DISTANCE   0
+#define CFG_DEF_DATALOG_ANSWER_TIMEOUT 5000
+
+#define CFG_DEF_CAPTURE_PATH       std::string("")
+#define CFG_DEF_CAPTURE_CHUNK_SIZE 65536
 
 
 #define CFG_DEF_DATA_ASSISTANCE_ENABLED false
 #define CFG_DEF_STAGPS_ENABLE false
 
+#define CFG_DEF_AGNSS_REFRESH_ENABLE             false
+#define CFG_DEF_AGNSS_REFRESH_EPHEMERIS_URI      std::string("")
+#define CFG_DEF_AGNSS_REFRESH_EPHEMERIS_VALIDITY 14400
+#define CFG_DEF_AGNSS_REFRESH_ALMANAC_URI        std::string("")
+#define CFG_DEF_AGNSS_REFRESH_ALMANAC_VALIDITY   604800
+#define CFG_DEF_AGNSS_REFRESH_PATH               std::string("/data/gps/assistance")
+#define CFG_DEF_AGNSS_REFRESH_PREFETCH_LEAD      7200
+#define CFG_DEF_AGNSS_REFRESH_COALESCE_WINDOW    3600
+#define CFG_DEF_AGNSS_REFRESH_BACKOFF_BASE       30
+#define CFG_DEF_AGNSS_REFRESH_BACKOFF_MAX        3600
+#define CFG_DEF_AGNSS_REFRESH_DAILY_BUDGET       0
+
 #define CFG_DEF_CONSTELLATIONS_GPS     true
 #define CFG_DEF_CONSTELLATIONS_GLONASS true
 #define CFG_DEF_CONSTELLATIONS_BEIDOU  true
 #define CFG_DEF_CONSTELLATIONS_GALILEO true
+#define CFG_DEF_CONSTELLATIONS_ADAPTIVE false
+
+#define CFG_DEF_SKY_PREDICTION_ENABLE         false
+#define CFG_DEF_SKY_PREDICTION_STORE          std::string("/data/gps/almanac.bin")
+#define CFG_DEF_SKY_PREDICTION_ELEVATION_MASK 5
+#define CFG_DEF_SKY_PREDICTION_REFRESH        86400
 
 #define CFG_DEF_STAGPS_PREDICTIVE_ENABLE    false
 #define CFG_DEF_STAGPS_PREDICTIVE_HOST      std::string("")
@@ -0,0 +1,104 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief List of the configuration fields
+ * @file fields.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_CONFIG_FIELDS_H
+#define TESEO_HAL_CONFIG_FIELDS_H
+
+#include "defaultconfig.h"
+
+/**
+ * Every configuration field with its default value
+ *
+ * @details X(key, default) is expanded once per field. The same list is used to read the TOML
+ * file and to (de)serialize the binary cache, so a field added here is handled by both.
+ */
+#define CONFIG_FIELDS(X) \
+    X(device.tty,   CFG_DEF_DEVICE_TTY) \
+    X(device.speed, CFG_DEF_DEVICE_SPEED) \
+    X(device.pps,   CFG_DEF_DEVICE_PPS) \
+    \
+    X(standby.tty,             CFG_DEF_STANDBY_TTY) \
+    X(standby.speed,           CFG_DEF_STANDBY_SPEED) \
+    X(standby.epoch_period,    CFG_DEF_STANDBY_EPOCH_PERIOD) \
+    X(standby.cadence_timeout, CFG_DEF_STANDBY_CADENCE_TIMEOUT) \
+    X(standby.fix_timeout,     CFG_DEF_STANDBY_FIX_TIMEOUT) \
+    X(standby.demote_after,    CFG_DEF_STANDBY_DEMOTE_AFTER) \
+    \
+    X(datalog.enable,         CFG_DEF_DATALOG_ENABLE) \
+    X(datalog.circular,       CFG_DEF_DATALOG_CIRCULAR) \
+    X(datalog.min_interval,   CFG_DEF_DATALOG_MIN_INTERVAL) \
+    X(datalog.min_speed,      CFG_DEF_DATALOG_MIN_SPEED) \
+    X(datalog.min_distance,   CFG_DEF_DATALOG_MIN_DISTANCE) \
+    X(datalog.answer_timeout, CFG_DEF_DATALOG_ANSWER_TIMEOUT) \
+    \
+    X(capture.path,       CFG_DEF_CAPTURE_PATH) \
+    X(capture.chunk_size, CFG_DEF_CAPTURE_CHUNK_SIZE) \
+    \
+    X(constellations.gps,      CFG_DEF_CONSTELLATIONS_GPS) \
+    X(constellations.glonass,  CFG_DEF_CONSTELLATIONS_GLONASS) \
+    X(constellations.beidou,   CFG_DEF_CONSTELLATIONS_BEIDOU) \
+    X(constellations.galileo,  CFG_DEF_CONSTELLATIONS_GALILEO) \
+    X(constellations.adaptive, CFG_DEF_CONSTELLATIONS_ADAPTIVE) \
+    \
+    X(sky_prediction.enable,         CFG_DEF_SKY_PREDICTION_ENABLE) \
+    X(sky_prediction.store,          CFG_DEF_SKY_PREDICTION_STORE) \
+    X(sky_prediction.elevation_mask, CFG_DEF_SKY_PREDICTION_ELEVATION_MASK) \
+    X(sky_prediction.refresh,        CFG_DEF_SKY_PREDICTION_REFRESH) \
+    \
+    X(agnss.enable,  CFG_DEF_DATA_ASSISTANCE_ENABLED) \
+    X(stagps.enable, CFG_DEF_STAGPS_ENABLE) \
+    \
+    X(agnss.refresh.enable,             CFG_DEF_AGNSS_REFRESH_ENABLE) \
+    X(agnss.refresh.ephemeris_uri,      CFG_DEF_AGNSS_REFRESH_EPHEMERIS_URI) \
+    X(agnss.refresh.ephemeris_validity, CFG_DEF_AGNSS_REFRESH_EPHEMERIS_VALIDITY) \
+    X(agnss.refresh.almanac_uri,        CFG_DEF_AGNSS_REFRESH_ALMANAC_URI) \
+    X(agnss.refresh.almanac_validity,   CFG_DEF_AGNSS_REFRESH_ALMANAC_VALIDITY) \
+    X(agnss.refresh.path,               CFG_DEF_AGNSS_REFRESH_PATH) \
+    X(agnss.refresh.prefetch_lead,      CFG_DEF_AGNSS_REFRESH_PREFETCH_LEAD) \
+    X(agnss.refresh.coalesce_window,    CFG_DEF_AGNSS_REFRESH_COALESCE_WINDOW) \
+    X(agnss.refresh.backoff_base,       CFG_DEF_AGNSS_REFRESH_BACKOFF_BASE) \
+    X(agnss.refresh.backoff_max,        CFG_DEF_AGNSS_REFRESH_BACKOFF_MAX) \
+    X(agnss.refresh.daily_budget,       CFG_DEF_AGNSS_REFRESH_DAILY_BUDGET) \
+    \
+    X(stagps.predictive.enable,    CFG_DEF_STAGPS_PREDICTIVE_ENABLE) \
+    X(stagps.predictive.host,      CFG_DEF_STAGPS_PREDICTIVE_HOST) \
+    X(stagps.predictive.port,      CFG_DEF_STAGPS_PREDICTIVE_PORT) \
+    X(stagps.predictive.vendor_id, CFG_DEF_STAGPS_PREDICTIVE_VENDOR_ID) \
+    X(stagps.predictive.model_id,  CFG_DEF_STAGPS_PREDICTIVE_MODEL_ID) \
+    X(stagps.predictive.device_id, CFG_DEF_STAGPS_PREDICTIVE_DEVICE_ID) \
+    X(stagps.predictive.seed_type, CFG_DEF_STAGPS_PREDICTIVE_SEED_TYPE) \
+    X(stagps.predictive.base_path, CFG_DEF_STAGPS_PREDICTIVE_BASE_PATH) \
+    \
+    X(stagps.realtime.enable,    CFG_DEF_STAGPS_REALTIME_ENABLE) \
+    X(stagps.realtime.host,      CFG_DEF_STAGPS_REALTIME_HOST) \
+    X(stagps.realtime.port,      CFG_DEF_STAGPS_REALTIME_PORT) \
+    X(stagps.realtime.vendor_id, CFG_DEF_STAGPS_REALTIME_VENDOR_ID) \
+    X(stagps.realtime.model_id,  CFG_DEF_STAGPS_REALTIME_MODEL_ID) \
+    X(stagps.realtime.device_id, CFG_DEF_STAGPS_REALTIME_DEVICE_ID) \
+    X(stagps.realtime.base_path, CFG_DEF_STAGPS_REALTIME_BASE_PATH)
+
+#endif // TESEO_HAL_CONFIG_FIELDS_H
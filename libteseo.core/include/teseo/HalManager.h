@@ -33,6 +33,8 @@
 #include <hardware/gps.h>
 #include <stdlib.h>
 
+#include <atomic>
+
 #include <teseo/utils/optional.h>
 #include <teseo/utils/Signal.h>
 
@@ -40,6 +42,12 @@ namespace stm {
 
 namespace device {
 class AbstractDevice;
+class AssistanceInjector;
+class ConstellationPolicy;
+class ReceiverFailover;
+class DatalogManager;
+class DatalogTimer;
+class SkyPredictor;
 } // namespace device
 
 namespace decoder {
@@ -55,12 +63,27 @@ class IStream;
 class IByteStream;
 } // namespace stream
 
+namespace capture {
+class NmeaCaptureWriter;
+} // namespace capture
+
+namespace pps {
+class IPpsSource;
+class PpsEpochTimer;
+} // namespace pps
+
+namespace assistance {
+class HttpAssistanceFetcher;
+class AssistanceRefresher;
+} // namespace assistance
+
 namespace stagps {
 class StagpsEngine;
 } // namespace stagps
 
 namespace geofencing {
 class GeofencingManager;
+class GeofenceTimer;
 } // namespace geofencing
 
 namespace straw {
@@ -94,6 +117,10 @@ private:
 
 	device::AbstractDevice * device;
 
+	device::ConstellationPolicy * constellationPolicy;
+
+	device::SkyPredictor * skyPredictor;
+
 	decoder::AbstractDecoder * decoder;
 
 	protocol::IEncoder * encoder;
@@ -102,10 +129,46 @@ private:
 
 	stream::IByteStream * byteStream;
 
+	device::AbstractDevice * standbyDevice;
+
+	decoder::AbstractDecoder * standbyDecoder;
+
+	protocol::IEncoder * standbyEncoder;
+
+	stream::IStream * standbyStream;
+
+	stream::IByteStream * standbyByteStream;
+
+	device::ReceiverFailover * failover;
+
+	device::DatalogManager * datalogManager;
+
+	device::DatalogTimer * datalogTimer;
+
+	capture::NmeaCaptureWriter * captureWriter;
+
+	std::atomic<bool> navigating; ///< Framework navigation is running, the link must stay up
+
+	std::atomic<bool> datalogLink; ///< A datalog command is in progress, the link must stay up
+
+	std::atomic<bool> datalogStopPending; ///< Navigation started, logging stops after the last read
+
+	pps::IPpsSource * ppsSource;
+
+	pps::PpsEpochTimer * ppsTimer;
+
+	assistance::HttpAssistanceFetcher * assistanceFetcher;
+
+	assistance::AssistanceRefresher * assistanceRefresher;
+
+	device::AssistanceInjector * assistanceInjector;
+
 	stagps::StagpsEngine * stagpsEngine;
 
 	geofencing::GeofencingManager * geofencingManager;
 
+	geofencing::GeofenceTimer * geofenceTimer;
+
 	straw::StrawEngine *rawMeasurement;
 	stm::ril::Ril_If * rilIf;
 
@@ -117,10 +180,29 @@ private:
 
 	void initDevice();
 
+	void initFailover();
+
+	void initDatalog();
+
+	void initPps();
+
+	void initConstellationPolicy();
+
+	void initSkyPrediction();
+
 	void initStagps();
 
+	void initAssistanceRefresh();
+
 	void initGeofencing();
 
+	/**
+	 * @brief      Start or stop the link to the primary receiver
+	 *
+	 * @details    Out of navigation the link is only stopped when no component needs it anymore.
+	 */
+	void updateLink();
+
 	void initRawMeasurement();
 	void initAGpsIf();
 
@@ -31,22 +31,39 @@
 #define LOG_TAG "teseo_hal_HalManager"
 #include <cutils/log.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sys/stat.h>
+
 #include <teseo/config/config.h>
 #include <teseo/utils/Time.h>
 #include <teseo/utils/Wakelock.h>
 #include <teseo/utils/http.h>
+#include <teseo/utils/Pps.h>
+#include <teseo/utils/AssistanceScheduler.h>
+#include <teseo/utils/NmeaCapture.h>
 
 #include <teseo/utils/IByteStream.h>
 #include <teseo/utils/IStream.h>
 #include <teseo/device/AbstractDevice.h>
+#include <teseo/device/AssistanceInjector.h>
 #include <teseo/protocol/AbstractDecoder.h>
 
 #include <teseo/utils/UartByteStream.h>
 #include <teseo/utils/NmeaStream.h>
 #include <teseo/protocol/NmeaDecoder.h>
 #include <teseo/device/NmeaDevice.h>
+#include <teseo/device/ConstellationPolicy.h>
+#include <teseo/device/ReceiverFailover.h>
+#include <teseo/device/DatalogManager.h>
+#include <teseo/device/SkyPredictor.h>
 #include <teseo/protocol/NmeaEncoder.h>
 #include <teseo/geofencing/manager.h>
+#include <teseo/geofencing/schedule.h>
 
 #include <teseo/LocServiceProxy.h>
 
@@ -70,12 +87,66 @@ using namespace stm::device;
 
 HalManager HalManager::instance;
 
+namespace {
+
+/**
+ * Connect the read and write paths of one receiver
+ */
+void connectReceiver(
+	AbstractDevice & device,
+	decoder::AbstractDecoder & decoder,
+	protocol::IEncoder & encoder,
+	stream::IStream & stream,
+	stream::IByteStream & byteStream)
+{
+	// Bytes read stream
+	// teseo -> byte stream -> nmea stream -> decoder -> device
+	byteStream.newBytes.connect(SlotFactory::create(stream, &stream::IStream::onNewBytes));
+	stream.newSentence.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::onNewBytes));
+
+	// Bytes write stream
+	// device -> encoder -> nmea stream -> byte stream -> teseo
+	device.sendMessage.connect(SlotFactory::create(encoder, &protocol::IEncoder::encode));
+	encoder.encodedBytes.connect(SlotFactory::create(stream, &stream::IStream::write));
+	stream.newBytesToWrite.connect(SlotFactory::create(byteStream, &stream::IByteStream::write));
+
+	// Start navigation signal
+	device.startNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::start));
+	device.startNavigation.connect(SlotFactory::create(byteStream, &stream::IByteStream::start));
+
+	// Stop navigation signal
+	device.stopNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::stop));
+	device.stopNavigation.connect(SlotFactory::create(byteStream, &stream::IByteStream::stop));
+}
+
+} // namespace
+
 HalManager::HalManager() :
 	setCapabilites("HalManager::setCapabilites")
 {
 	ALOGI("Create HAL manager");
 
 	device = nullptr;
+	standbyDevice = nullptr;
+	standbyDecoder = nullptr;
+	standbyEncoder = nullptr;
+	standbyStream = nullptr;
+	standbyByteStream = nullptr;
+	failover = nullptr;
+	datalogManager = nullptr;
+	datalogTimer = nullptr;
+	captureWriter = nullptr;
+	navigating = false;
+	datalogLink = false;
+	datalogStopPending = false;
+	constellationPolicy = nullptr;
+	skyPredictor = nullptr;
+	ppsSource = nullptr;
+	ppsTimer = nullptr;
+	assistanceFetcher = nullptr;
+	assistanceRefresher = nullptr;
+	assistanceInjector = nullptr;
+	geofenceTimer = nullptr;
 
 	setCapabilites.connect(SlotFactory::create(&(LocServiceProxy::gps::sendCapabilities)));
 
@@ -104,7 +175,13 @@ int HalManager::init(GpsCallbacks * cb)
 
 	initUtils();
 	initDevice();
+	initFailover();
+	initDatalog();
+	initPps();
+	initConstellationPolicy();
+	initSkyPrediction();
 	initStagps();
+	initAssistanceRefresh();
 	initGeofencing();
 	initRawMeasurement();
 	initAGpsIf();
@@ -159,6 +236,13 @@ void HalManager::cleanup(void)
     ALOGD("AGPS is not compiled, do not cleanup");
 #endif
 
+	if(geofenceTimer)
+	{
+		geofenceTimer->stop();
+		geofenceTimer->join();
+	}
+
+	delete geofenceTimer;
 	delete geofencingManager;
 
 #ifdef STRAW_ENABLED
@@ -166,15 +250,74 @@ void HalManager::cleanup(void)
 	rawMeasurement = nullptr;
 #endif
 
+	if(ppsTimer)
+		ppsTimer->stop();
+
+	if(captureWriter)
+	{
+		captureWriter->stop();
+		captureWriter->join();
+	}
+
+	if(assistanceRefresher)
+	{
+		assistanceRefresher->stop();
+		assistanceRefresher->join();
+	}
+
+	// Already saved when navigation stopped
+	if(skyPredictor && navigating)
+		skyPredictor->onStop();
+
+	delete assistanceRefresher;
+	delete assistanceFetcher;
+	delete assistanceInjector;
+	delete ppsTimer;
+	delete ppsSource;
 	delete stream;
 	delete byteStream;
+	delete captureWriter;
 	delete decoder;
+
+	if(datalogTimer)
+	{
+		datalogTimer->stop();
+		datalogTimer->join();
+	}
+
+	delete datalogTimer;
+	delete datalogManager;
+	delete failover;
+	delete standbyStream;
+	delete standbyByteStream;
+	delete standbyDecoder;
+	delete standbyEncoder;
+	delete standbyDevice;
+	delete constellationPolicy;
+	delete skyPredictor;
 	delete device;
 
+	geofenceTimer = nullptr;
 	geofencingManager = nullptr;
+	assistanceRefresher = nullptr;
+	assistanceFetcher = nullptr;
+	assistanceInjector = nullptr;
+	ppsTimer = nullptr;
+	ppsSource = nullptr;
 	stream = nullptr;
 	byteStream = nullptr;
+	captureWriter = nullptr;
 	decoder = nullptr;
+	datalogTimer = nullptr;
+	datalogManager = nullptr;
+	failover = nullptr;
+	standbyStream = nullptr;
+	standbyByteStream = nullptr;
+	standbyDecoder = nullptr;
+	standbyEncoder = nullptr;
+	standbyDevice = nullptr;
+	constellationPolicy = nullptr;
+	skyPredictor = nullptr;
 	device = nullptr;
 
 	utils::http_cleanup();
@@ -198,40 +341,463 @@ void HalManager::initDevice()
 	byteStream = new stream::UartByteStream(config::get().device.tty, config::get().device.speed);
 	stream = new stream::NmeaStream();
 
-	// Bytes read stream
-	// teseo -> byte stream -> nmea stream -> decoder -> device
-	byteStream->newBytes.connect(SlotFactory::create(*stream, &stream::IStream::onNewBytes));
-	stream->newSentence.connect(SlotFactory::create(*decoder, &decoder::AbstractDecoder::onNewBytes));
-
-	// Bytes write stream
-	// device -> encoder -> nmea stream -> byte stream -> teseo
-	device->sendMessage.connect(SlotFactory::create(*encoder, &protocol::IEncoder::encode));
-	encoder->encodedBytes.connect(SlotFactory::create(*stream, &stream::IStream::write));
-	stream->newBytesToWrite.connect(SlotFactory::create(*byteStream, &stream::IByteStream::write));
-
-	// Start navigation signal
-	device->startNavigation.connect(SlotFactory::create(*decoder, &decoder::AbstractDecoder::start));
-	device->startNavigation.connect(SlotFactory::create(*byteStream, &stream::IByteStream::start));
+	connectReceiver(*device, *decoder, *encoder, *stream, *byteStream);
 
-	// Stop navigation signal
-	device->stopNavigation.connect(SlotFactory::create(*decoder, &decoder::AbstractDecoder::stop));
-	device->stopNavigation.connect(SlotFactory::create(*byteStream, &stream::IByteStream::stop));
+	// Compressed capture of the raw stream, encoded and written out of the reader thread
+	if(!config::get().capture.path.empty())
+	{
+		ALOGI("Capture the receiver stream to %s", config::get().capture.path.c_str());
+		captureWriter = new capture::NmeaCaptureWriter(
+			config::get().capture.path,
+			static_cast<std::size_t>(std::max(config::get().capture.chunk_size, 1024)));
+		byteStream->newBytes.connect(
+			SlotFactory::create(*captureWriter, &capture::NmeaCaptureWriter::onNewBytes));
+		captureWriter->start();
+	}
 
 	// Data model updates
 	auto & gpsSignals = LocServiceProxy::gps::getSignals();
 	gpsSignals.start.connect(SlotFactory::create(*device, &AbstractDevice::start));
 	gpsSignals.stop.connect(SlotFactory::create(*device, &AbstractDevice::stop));
 
-	device->onNmea.connect(SlotFactory::create(LocServiceProxy::gps::sendNmea));
-	device->locationUpdate.connect(SlotFactory::create(LocServiceProxy::gps::sendLocationUpdate));
-	device->satelliteListUpdate.connect(SlotFactory::create(LocServiceProxy::gps::sendSatelliteListUpdate));
+	// Out of navigation the link may stay up for the datalog or the geofencing, the framework
+	// only gets the receiver output during a session
+	device->onNmea.connect(SlotFactory::create(
+		std::function<void(GpsUtcTime, const NmeaMessage &)>([this] (GpsUtcTime timestamp, const NmeaMessage & nmea) {
+			if(navigating)
+				LocServiceProxy::gps::sendNmea(timestamp, nmea);
+		})
+	));
+
+	// With a standby receiver the updates are published by the failover
+	if(config::get().standby.tty.empty())
+	{
+		device->locationUpdate.connect(SlotFactory::create(
+			std::function<void(const Location &)>([this] (const Location & loc) {
+				if(navigating)
+					LocServiceProxy::gps::sendLocationUpdate(loc);
+			})
+		));
+		device->satelliteListUpdate.connect(SlotFactory::create(
+			std::function<void(const std::map<SatIdentifier, SatInfo> &)>([this] (const std::map<SatIdentifier, SatInfo> & satellites) {
+				if(navigating)
+					LocServiceProxy::gps::sendSatelliteListUpdate(satellites);
+			})
+		));
+	}
+
 	device->statusUpdate.connect(SlotFactory::create(LocServiceProxy::gps::sendStatusUpdate));
 
 	device->requestUtcTime.connect(SlotFactory::create(LocServiceProxy::gps::requestUtcTime));
 
+	// The link is stopped with navigation, other components may still need it
+	device->startNavigation.connect(SlotFactory::create(
+		std::function<int()>([this] () {
+			navigating = true;
+			return 0;
+		})
+	));
+	device->stopNavigation.connect(SlotFactory::create(
+		std::function<int()>([this] () {
+			navigating = false;
+			if(datalogLink)
+				updateLink();
+			return 0;
+		})
+	));
+
 	device->init();
 }
 
+void HalManager::updateLink()
+{
+	if(navigating || datalogLink)
+	{
+		decoder->start();
+		byteStream->start();
+	}
+	else
+	{
+		decoder->stop();
+		byteStream->stop();
+	}
+}
+
+void HalManager::initFailover()
+{
+	using namespace std::chrono;
+
+	const auto & cfg = config::get().standby;
+
+	if(cfg.tty.empty())
+	{
+		ALOGI("No standby receiver in configuration");
+		return;
+	}
+
+	ALOGI("Init standby receiver on %s", cfg.tty.c_str());
+	standbyDevice = new NmeaDevice();
+	standbyDecoder = new decoder::NmeaDecoder(*standbyDevice);
+	standbyEncoder = new protocol::NmeaEncoder();
+	standbyByteStream = new stream::UartByteStream(cfg.tty, cfg.speed);
+	standbyStream = new stream::NmeaStream();
+
+	connectReceiver(*standbyDevice, *standbyDecoder, *standbyEncoder, *standbyStream, *standbyByteStream);
+
+	// The standby navigates with the primary to stay warm, it is never reported to the framework
+	auto & gpsSignals = LocServiceProxy::gps::getSignals();
+	gpsSignals.start.connect(SlotFactory::create(*standbyDevice, &AbstractDevice::start));
+	gpsSignals.stop.connect(SlotFactory::create(*standbyDevice, &AbstractDevice::stop));
+
+	FailoverSettings settings;
+	settings.epochPeriod = milliseconds(cfg.epoch_period);
+	settings.cadenceTimeout = milliseconds(cfg.cadence_timeout);
+	settings.fixTimeout = milliseconds(cfg.fix_timeout);
+	settings.demoteAfter = milliseconds(cfg.demote_after);
+
+	if(settings.cadenceTimeout >= settings.epochPeriod)
+		ALOGW("Standby cadence timeout is not below one epoch, a stalled primary loses epochs");
+
+	failover = new ReceiverFailover(settings);
+
+	device->onNmea.connect(SlotFactory::create(*failover, &ReceiverFailover::onPrimaryNmea));
+	device->locationUpdate.connect(SlotFactory::create(*failover, &ReceiverFailover::onPrimaryLocation));
+	device->satelliteListUpdate.connect(SlotFactory::create(*failover, &ReceiverFailover::onPrimarySatelliteList));
+	device->startNavigation.connect(SlotFactory::create(*failover, &ReceiverFailover::onStart));
+
+	standbyDevice->onNmea.connect(SlotFactory::create(*failover, &ReceiverFailover::onStandbyNmea));
+	standbyDevice->locationUpdate.connect(SlotFactory::create(*failover, &ReceiverFailover::onStandbyLocation));
+	standbyDevice->satelliteListUpdate.connect(SlotFactory::create(*failover, &ReceiverFailover::onStandbySatelliteList));
+
+	// Like the primary receiver output, the updates only reach the framework during a session
+	failover->locationUpdate.connect(SlotFactory::create(
+		std::function<void(const Location &)>([this] (const Location & loc) {
+			if(navigating)
+				LocServiceProxy::gps::sendLocationUpdate(loc);
+		})
+	));
+	failover->satelliteListUpdate.connect(SlotFactory::create(
+		std::function<void(const ReceiverFailover::SatelliteList &)>([this] (const ReceiverFailover::SatelliteList & satellites) {
+			if(navigating)
+				LocServiceProxy::gps::sendSatelliteListUpdate(satellites);
+		})
+	));
+
+	standbyDevice->init();
+}
+
+void HalManager::initDatalog()
+{
+	const auto & cfg = config::get().datalog;
+
+	if(!cfg.enable)
+	{
+		ALOGI("Receiver datalog disabled in configuration");
+		return;
+	}
+
+	ALOGI("Init receiver datalog");
+
+	DatalogCriteria criteria;
+	criteria.circular = cfg.circular;
+	criteria.minInterval = cfg.min_interval;
+	criteria.minSpeed = cfg.min_speed;
+	criteria.minDistance = cfg.min_distance;
+
+	datalogManager = new DatalogManager(criteria, std::chrono::milliseconds(std::max(cfg.answer_timeout, 0)));
+
+	datalogManager->sendMessageRequest.connect(
+		SlotFactory::create(*device, &AbstractDevice::sendMessageRequest));
+	device->onDatalogAnswer.connect(
+		SlotFactory::create(*datalogManager, &DatalogManager::onDatalogAnswer));
+	device->onDatalogEntry.connect(
+		SlotFactory::create(*datalogManager, &DatalogManager::onDatalogEntry));
+
+	// Out of navigation the link is only up while a datalog command is in progress, the host
+	// can sleep while the receiver logs
+	datalogManager->linkRequest.connect(SlotFactory::create(
+		std::function<void(bool)>([this] (bool up) {
+			datalogLink = up;
+			updateLink();
+		})
+	));
+
+	// A command the receiver doesn't answer releases the link, the host can sleep again
+	datalogTimer = new DatalogTimer(*datalogManager);
+	datalogManager->deadlineChanged.connect(
+		SlotFactory::create(*datalogTimer, &DatalogTimer::onDeadlineChanged));
+	datalogManager->commandFailed.connect(SlotFactory::create(
+		std::function<void(DatalogState)>([this] (DatalogState state) {
+			ALOGW("Receiver datalog command failed while %s", toString(state));
+			datalogStopPending = false;
+		})
+	));
+	datalogTimer->start();
+
+	// Log between navigation sessions. The fixes logged since the last read are read back when
+	// navigation restarts, before logging stops and the datalog is erased.
+	auto & gpsSignals = LocServiceProxy::gps::getSignals();
+	gpsSignals.stop.connect(SlotFactory::create(
+		std::function<int()>([this] () {
+			datalogStopPending = false;
+
+			if(datalogManager->getState() == DatalogState::Idle)
+				datalogManager->startLogging();
+
+			return 0;
+		})
+	));
+	gpsSignals.start.connect(SlotFactory::create(
+		std::function<int()>([this] () {
+			datalogStopPending = true;
+
+			if(datalogManager->getState() == DatalogState::Logging)
+				datalogManager->readBatch();
+
+			return 0;
+		})
+	));
+
+	// Logged fixes are reported oldest first with their logging time, the framework tells them
+	// from the current location by their timestamp. They bypass the device signals, so nothing
+	// else takes them for live fixes.
+	datalogManager->batchReady.connect(SlotFactory::create(
+		std::function<void(const std::vector<Location> &)>([this] (const std::vector<Location> & batch) {
+			ALOGI("Read back %zu fixes from the receiver datalog", batch.size());
+
+			std::vector<Location> history(batch);
+			std::stable_sort(history.begin(), history.end(), [] (const Location & a, const Location & b) {
+				return a.timestamp() < b.timestamp();
+			});
+
+			for(const auto & loc : history)
+				LocServiceProxy::gps::sendLocationUpdate(loc);
+
+			if(datalogStopPending.exchange(false))
+				datalogManager->stopLogging();
+		})
+	));
+}
+
+void HalManager::initPps()
+{
+	const std::string & ppsDevice = config::get().device.pps;
+
+	if(ppsDevice.empty())
+	{
+		ALOGI("PPS disabled in configuration, epochs are timed from the NMEA stream");
+		return;
+	}
+
+	ALOGI("Init PPS epoch timer on %s", ppsDevice.c_str());
+	ppsSource = new pps::KernelPpsSource(ppsDevice);
+	ppsTimer = new pps::PpsEpochTimer(*ppsSource);
+
+	// Sentences arrival times are used to learn when the epoch is complete,
+	// GGA timestamps anchor the GNSS time on the pulses
+	auto timer = ppsTimer;
+	auto ggaId = utils::createFromString("GGA");
+	device->onNmea.connect(SlotFactory::create(
+		std::function<void(GpsUtcTime, const NmeaMessage &)>(
+			[timer, ggaId] (GpsUtcTime timestamp, const NmeaMessage & nmea) {
+				timer->onSentence();
+
+				if(nmea.sentenceId == ggaId)
+					timer->onGnssTime(timestamp);
+			})
+		)
+	);
+
+	ppsTimer->epochDue.connect(SlotFactory::create(*device, &AbstractDevice::onEpochDue));
+
+	device->startNavigation.connect(SlotFactory::create(*ppsTimer, &pps::PpsEpochTimer::start));
+	device->stopNavigation.connect(SlotFactory::create(*ppsTimer, &pps::PpsEpochTimer::stop));
+}
+
+void HalManager::initConstellationPolicy()
+{
+	const auto & cfg = config::get().constellations;
+
+	if(!cfg.adaptive)
+	{
+		ALOGI("Adaptive constellation selection disabled in configuration");
+		return;
+	}
+
+	std::set<Constellation> configured;
+	if(cfg.gps)     configured.insert(Constellation::Gps);
+	if(cfg.glonass) configured.insert(Constellation::Glonass);
+	if(cfg.beidou)  configured.insert(Constellation::Beidou);
+	if(cfg.galileo) configured.insert(Constellation::Galileo);
+
+	ALOGI("Init adaptive constellation selection");
+	constellationPolicy = new ConstellationPolicy(configured);
+
+	device->locationUpdate.connect(
+		SlotFactory::create(*constellationPolicy, &ConstellationPolicy::onLocation));
+	device->satelliteListUpdate.connect(
+		SlotFactory::create(*constellationPolicy, &ConstellationPolicy::onSatelliteList));
+	device->startNavigation.connect(
+		SlotFactory::create(*constellationPolicy, &ConstellationPolicy::onStart));
+
+	constellationPolicy->sendMessageRequest.connect(
+		SlotFactory::create(*device, &AbstractDevice::sendMessageRequest));
+}
+
+void HalManager::initSkyPrediction()
+{
+	const auto & cfg = config::get().sky_prediction;
+
+	if(!cfg.enable)
+	{
+		ALOGI("Sky prediction disabled in configuration");
+		return;
+	}
+
+	ALOGI("Init sky prediction");
+	skyPredictor = new SkyPredictor(
+		cfg.store,
+		static_cast<float>(cfg.elevation_mask),
+		static_cast<GpsUtcTime>(std::max(cfg.refresh, 0)) * 1000);
+	skyPredictor->load();
+
+	device->onAlmanac.connect(
+		SlotFactory::create(*skyPredictor, &SkyPredictor::onAlmanac));
+	device->locationUpdate.connect(
+		SlotFactory::create(*skyPredictor, &SkyPredictor::onLocation));
+	device->startNavigation.connect(
+		SlotFactory::create(*skyPredictor, &SkyPredictor::onStart));
+	device->stopNavigation.connect(
+		SlotFactory::create(*skyPredictor, &SkyPredictor::onStop));
+	LocServiceProxy::gps::getSignals().injectLocation.connect(
+		SlotFactory::create(*skyPredictor, &SkyPredictor::onInjectLocation));
+
+	skyPredictor->sendMessageRequest.connect(
+		SlotFactory::create(*device, &AbstractDevice::sendMessageRequest));
+	skyPredictor->expectedSatellites.connect(
+		SlotFactory::create(*device, &AbstractDevice::setExpectedSatellites));
+}
+
+void HalManager::initAssistanceRefresh()
+{
+	using namespace std::chrono;
+
+	const auto & cfg = config::get().agnss.refresh;
+
+	if(!cfg.enable || (cfg.ephemeris_uri.empty() && cfg.almanac_uri.empty()))
+	{
+		ALOGI("Assistance refresh disabled in configuration");
+		return;
+	}
+
+	ALOGI("Init assistance refresh in %s", cfg.path.c_str());
+
+	if(mkdir(cfg.path.c_str(), 0770) != 0 && errno != EEXIST)
+		ALOGW("Unable to create the assistance directory %s, files won't be kept", cfg.path.c_str());
+
+	assistance::SchedulerPolicy policy;
+	policy.prefetchLead = seconds(cfg.prefetch_lead);
+	policy.coalesceWindow = seconds(cfg.coalesce_window);
+	policy.backoffBase = seconds(cfg.backoff_base);
+	policy.backoffMax = seconds(cfg.backoff_max);
+	policy.dailyBudget = static_cast<std::size_t>(std::max(cfg.daily_budget, 0));
+
+	// Each kind of data is refreshed on its own, before its own validity ends
+	struct Item {
+		std::string id;
+		AssistanceKind kind;
+		std::string uri;
+		seconds validity;
+		std::string path;
+	};
+
+	std::vector<Item> items;
+
+	if(!cfg.ephemeris_uri.empty())
+		items.push_back(Item{"ephemeris", AssistanceKind::Ephemeris, cfg.ephemeris_uri,
+			seconds(cfg.ephemeris_validity), cfg.path + "/ephemeris.nmea"});
+
+	if(!cfg.almanac_uri.empty())
+		items.push_back(Item{"almanac", AssistanceKind::Almanac, cfg.almanac_uri,
+			seconds(cfg.almanac_validity), cfg.path + "/almanac.nmea"});
+
+	assistanceInjector = new AssistanceInjector();
+	assistanceInjector->sendMessageRequest.connect(
+		SlotFactory::create(*device, &AbstractDevice::sendMessageRequest));
+	device->startNavigation.connect(
+		SlotFactory::create(*assistanceInjector, &AssistanceInjector::onStart));
+	device->stopNavigation.connect(
+		SlotFactory::create(*assistanceInjector, &AssistanceInjector::onStop));
+
+	assistanceFetcher = new assistance::HttpAssistanceFetcher();
+
+	for(const auto & item : items)
+		assistanceFetcher->setUri(item.id, item.uri);
+
+	// The data is valid from download time once the receiver got it or will get it at the next
+	// navigation start. The file is stored atomically to inject it again after a restart.
+	auto injector = assistanceInjector;
+	assistanceFetcher->downloaded.connect(SlotFactory::create(
+		std::function<GpsUtcTime(const std::string &, const std::vector<char> &)>(
+			[injector, items] (const std::string & id, const std::vector<char> & payload) -> GpsUtcTime {
+				auto item = std::find_if(items.begin(), items.end(), [&id] (const Item & i) { return i.id == id; });
+
+				if(item == items.end() || injector->inject(item->kind, payload) == 0)
+					return 0;
+
+				std::string tmpPath = item->path + ".tmp";
+				std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+
+				file.write(payload.data(), payload.size());
+				file.close();
+
+				if(!file || std::rename(tmpPath.c_str(), item->path.c_str()) != 0)
+					ALOGW("Unable to store assistance file %s", item->path.c_str());
+
+				return duration_cast<milliseconds>(
+					(assistance::Clock::now() + item->validity).time_since_epoch()).count();
+			})
+		)
+	);
+
+	assistanceRefresher = new assistance::AssistanceRefresher(policy, *assistanceFetcher);
+
+	// A stored file is valid from its last modification, the receiver may have lost its data
+	// since: the file is injected again at the next navigation start while still valid
+	for(const auto & item : items)
+	{
+		struct stat st;
+
+		if(stat(item.path.c_str(), &st) != 0)
+		{
+			// Size unknown until the first download, learned by the scheduler
+			assistanceRefresher->track(item.id, assistance::Clock::now(), 0);
+			continue;
+		}
+
+		assistance::time_point validUntil = assistance::Clock::from_time_t(st.st_mtime) + item.validity;
+		assistanceRefresher->track(item.id, validUntil, st.st_size);
+
+		if(validUntil > assistance::Clock::now())
+		{
+			std::ifstream file(item.path, std::ios::binary);
+			std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			assistanceInjector->inject(item.kind, content);
+		}
+	}
+
+	// Navigation start wakes the system up, refreshes due soon are performed with it
+	auto refresher = assistanceRefresher;
+	device->startNavigation.connect(SlotFactory::create(
+		std::function<int()>([refresher] () {
+			refresher->onWakeup();
+			return 0;
+		})
+	));
+
+	assistanceRefresher->start();
+}
+
 #ifdef STAGPS_ENABLED
 void HalManager::initStagps()
 {
@@ -301,8 +867,29 @@ void HalManager::initGeofencing()
 	geofencingSignals.pauseGeofence.connect(SlotFactory::create(*geofencingManager, &GeofencingManager::pause));
 	geofencingSignals.resumeGeofence.connect(SlotFactory::create(*geofencingManager, &GeofencingManager::resume));
 
-	device->locationUpdate.connect(SlotFactory::create(*geofencingManager, &GeofencingManager::onLocationUpdate));
+	// Fences are evaluated against the published location
+	auto & locationUpdate = failover ? failover->locationUpdate : device->locationUpdate;
+	locationUpdate.connect(SlotFactory::create(*geofencingManager, &GeofencingManager::onLocationUpdate));
 	device->statusUpdate.connect(SlotFactory::create(*geofencingManager, &GeofencingManager::onDeviceStatusUpdate));
+
+	// Scheduled geofences are activated and expired on time, even without location updates. The
+	// timer thread is only started with the first scheduled geofence.
+	geofenceTimer = new GeofenceTimer(*geofencingManager);
+	geofencingManager->scheduleChanged.connect(SlotFactory::create(
+		std::function<void()>([this] () {
+			if(geofenceTimer->isRunning())
+				geofenceTimer->onScheduleChanged();
+			else
+				geofenceTimer->start();
+		})
+	));
+
+	// The framework has no expiry notification, an expired geofence is reported as removed
+	geofencingManager->geofenceExpired.connect(SlotFactory::create(
+		std::function<void(geofencing::model::GeofenceId)>([] (geofencing::model::GeofenceId id) {
+			LocServiceProxy::geofencing::answerGeofenceRemoveRequest(id, geofencing::model::OperationStatus::Success);
+		})
+	));
 }
 
 #ifdef STRAW_ENABLED
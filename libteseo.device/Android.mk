@@ -40,14 +40,24 @@ LOCAL_SHARED_LIBRARIES := \
 	libteseo.config       \
 	libteseo.model
 
-LOCAL_SRC_FILES :=         \
-	src/AbstractDevice.cpp \
-	src/NmeaDevice.cpp
+LOCAL_SRC_FILES :=              \
+	src/AbstractDevice.cpp      \
+	src/AssistanceInjector.cpp  \
+	src/ConstellationPolicy.cpp \
+	src/DatalogManager.cpp      \
+	src/NmeaDevice.cpp          \
+	src/ReceiverFailover.cpp    \
+	src/SkyPredictor.cpp
 
 LOCAL_COPY_HEADERS_TO:= teseo/device/
-LOCAL_COPY_HEADERS :=                     \
-	include/teseo/device/AbstractDevice.h \
-	include/teseo/device/NmeaDevice.h
+LOCAL_COPY_HEADERS :=                          \
+	include/teseo/device/AbstractDevice.h      \
+	include/teseo/device/AssistanceInjector.h  \
+	include/teseo/device/ConstellationPolicy.h \
+	include/teseo/device/DatalogManager.h      \
+	include/teseo/device/NmeaDevice.h          \
+	include/teseo/device/ReceiverFailover.h    \
+	include/teseo/device/SkyPredictor.h
 
 LOCAL_PRELINK_MODULE := false
 
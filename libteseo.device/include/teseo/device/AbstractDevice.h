@@ -37,12 +37,14 @@
 #include <teseo/utils/any.h>
 #include <teseo/utils/result.h>
 #include <teseo/utils/Signal.h>
+#include <teseo/model/Almanac.h>
 #include <teseo/model/Message.h>
 #include <teseo/model/NmeaMessage.h>
 #include <teseo/model/Location.h>
 #include <teseo/model/SatInfo.h>
 #include <teseo/model/Version.h>
 #include <teseo/model/Stagps.h>
+#include <teseo/model/Datalog.h>
 #include <teseo/utils/Thread.h>
 #include <teseo/model/ValueContainer.h>
 
@@ -76,8 +78,23 @@ private:
 
 	ValueContainer<std::map<SatIdentifier, SatInfo>> satellites;
 
+	/**
+	 * Satellites published while the receiver doesn't report any, cleared by the first report
+	 */
+	std::map<SatIdentifier, SatInfo> expectedSatellites;
+
 	ValueContainer<std::unordered_map<std::string, model::Version>> versions;
 
+	/**
+	 * Set when the current epoch was already published by the epoch timer
+	 */
+	bool epochPublished;
+
+	/**
+	 * Set when a sentence was received since the last epoch timer publication
+	 */
+	bool epochReceiving;
+
 protected:
 
 	// Allow NmeaDecoder to use emitNmea
@@ -86,6 +103,11 @@ protected:
 	// Allow decoding functions to update device data model
 	friend struct stm::decoder::nmea::decoders;
 
+	/**
+	 * Data model mutex, held by the decoder while a sentence is decoded
+	 */
+	std::mutex dataMutex;
+
 	/**
 	 * @brief      Abstract device constructor
 	 * @details    The constructor is protected so it must be inherited to be instanciated.
@@ -202,6 +224,23 @@ public:
 
 	void init();
 
+	/**
+	 * @brief      Epoch due slot
+	 *
+	 * @details    Called by the epoch timer when all the sentences of the current epoch should have
+	 * been received. The epoch is published immediately instead of waiting for the start sentence
+	 * of the next epoch.
+	 */
+	void onEpochDue();
+
+	/**
+	 * @brief      Set the satellites expected before the receiver reports its own
+	 *
+	 * @details    The expected list is published in place of an empty satellite list, until the
+	 * first non empty one or the end of the navigation.
+	 */
+	void setExpectedSatellites(const std::map<SatIdentifier, SatInfo> & satellites);
+
 	/**
 	 * Signal sent when navigation starts
 	 */
@@ -239,6 +278,21 @@ public:
 
 	Signal<void, model::StagpsAnswer, const std::vector<ByteVector> &> onStagpsAnswer;
 
+	/**
+	 * Answer of the receiver to a datalog command
+	 */
+	Signal<void, model::DatalogAnswer> onDatalogAnswer;
+
+	/**
+	 * Location read back from the receiver datalog, with its entry index
+	 */
+	Signal<void, unsigned int, const Location &> onDatalogEntry;
+
+	/**
+	 * Almanac dumped by the receiver
+	 */
+	Signal<void, const model::GpsAlmanac &> onAlmanac;
+
 };
 
 } // namespace device
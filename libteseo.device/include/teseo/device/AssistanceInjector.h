@@ -0,0 +1,107 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Assistance data injection
+ * @file AssistanceInjector.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_DEVICE_ASSISTANCE_INJECTOR_H
+#define TESEO_HAL_DEVICE_ASSISTANCE_INJECTOR_H
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <teseo/utils/Signal.h>
+#include <teseo/model/Message.h>
+
+namespace stm {
+namespace device {
+
+enum class AssistanceKind {
+	Ephemeris, ///< PSTMEPHEM sentences
+	Almanac    ///< PSTMALMANAC sentences
+};
+
+const char * toString(AssistanceKind kind);
+
+/**
+ * @brief      Assistance data injector
+ *
+ * @details    An assistance file holds the sentences the receiver dumps its ephemeris or almanacs
+ * with, one satellite per sentence. The same sentences inject them back. Sentences of another
+ * kind, with a bad checksum or whose data doesn't match its size are skipped.
+ *
+ * Out of navigation the link to the receiver is down: the data is kept and injected when
+ * navigation starts. Data of a kind replaces the data of the same kind not injected yet.
+ */
+class AssistanceInjector :
+	public Trackable
+{
+private:
+	std::mutex mutex;
+
+	bool navigating;
+
+	std::map<AssistanceKind, std::vector<model::Message>> pending;
+
+public:
+	AssistanceInjector();
+
+	/**
+	 * @brief      Build the injection messages of an assistance file
+	 *
+	 * @param[in]  kind     Kind of data the file holds
+	 * @param[in]  content  File content
+	 *
+	 * @return     One message per satellite
+	 */
+	static std::vector<model::Message> parse(AssistanceKind kind, const std::vector<char> & content);
+
+	/**
+	 * @brief      Inject an assistance file, now during navigation or at the next start
+	 *
+	 * @return     The number of satellites injected or kept for injection
+	 */
+	std::size_t inject(AssistanceKind kind, const std::vector<char> & content);
+
+	/**
+	 * @brief      Navigation start slot, injects the data kept
+	 */
+	int onStart();
+
+	/**
+	 * @brief      Navigation stop slot
+	 */
+	int onStop();
+
+	/**
+	 * Signal emitted to send the injections to the device
+	 */
+	Signal<void, const model::Message &> sendMessageRequest;
+};
+
+} // namespace device
+} // namespace stm
+
+#endif // TESEO_HAL_DEVICE_ASSISTANCE_INJECTOR_H
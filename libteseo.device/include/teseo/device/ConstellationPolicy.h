@@ -0,0 +1,181 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Adaptive constellation selection
+ * @file ConstellationPolicy.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_DEVICE_CONSTELLATION_POLICY_H
+#define TESEO_HAL_DEVICE_CONSTELLATION_POLICY_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include <teseo/utils/optional.h>
+#include <teseo/utils/Signal.h>
+#include <teseo/model/Constellations.h>
+#include <teseo/model/Location.h>
+#include <teseo/model/Message.h>
+#include <teseo/model/SatInfo.h>
+
+namespace stm {
+namespace device {
+
+/**
+ * @brief      Constellation policy thresholds
+ *
+ * @details    Reduction and restoration thresholds are distinct so that the selection doesn't
+ * flap when the geometry is close to a threshold.
+ */
+struct ConstellationThresholds {
+	unsigned int reduceMinUsed;  ///< Primary satellites used in fix required to reduce
+	float reduceMaxPdop;         ///< Maximum PDOP allowed to reduce
+	unsigned int restoreMinUsed; ///< Restore when less primary satellites are used in fix
+	float restoreMaxPdop;        ///< Restore when PDOP is above this value
+	unsigned int reduceAfter;    ///< Consecutive good epochs required to reduce
+	unsigned int restoreAfter;   ///< Consecutive degraded epochs required to restore
+	unsigned int holdoff;        ///< Epochs after a restoration before reducing again
+
+	ConstellationThresholds();
+};
+
+/**
+ * @brief      Per epoch summary of the navigation solution
+ */
+struct EpochSummary {
+	bool fix;                                      ///< A valid fix is available
+	float pdop;                                    ///< Fix PDOP, 0 if unknown
+	std::map<Constellation, unsigned int> used;    ///< Satellites used in fix per constellation
+	std::map<Constellation, unsigned int> tracked; ///< Satellites tracked per constellation
+
+	/**
+	 * @brief      Build an epoch summary from the device data model
+	 *
+	 * @param[in]  loc         Epoch location, empty if there is no fix
+	 * @param[in]  satellites  Epoch satellite list
+	 */
+	static EpochSummary from(
+		const std::optional<Location> & loc,
+		const std::map<SatIdentifier, SatInfo> & satellites);
+};
+
+/**
+ * @brief      Adaptive constellation selection policy
+ *
+ * @details    When the primary constellation alone provides enough satellites with a good geometry
+ * the other constellations are disabled to save receiver power and NMEA traffic. They are
+ * re-enabled as soon as the geometry degrades.
+ */
+class ConstellationPolicy :
+	public Trackable
+{
+private:
+	std::set<Constellation> configured;
+
+	Constellation primary;
+
+	ConstellationThresholds thresholds;
+
+	mutable std::mutex mutex;
+
+	bool reduced;
+
+	unsigned int goodEpochs;
+
+	unsigned int degradedEpochs;
+
+	unsigned int sinceRestore;
+
+	std::optional<Location> epochLocation;
+
+	void requestSelection();
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  configured  Constellations enabled in configuration
+	 * @param[in]  primary     Constellation kept enabled in reduced mode
+	 * @param[in]  thresholds  Policy thresholds
+	 */
+	ConstellationPolicy(
+		const std::set<Constellation> & configured,
+		Constellation primary = Constellation::Gps,
+		const ConstellationThresholds & thresholds = ConstellationThresholds());
+
+	/**
+	 * @brief      Evaluate one epoch
+	 *
+	 * @return     True if the selection changed
+	 */
+	bool evaluate(const EpochSummary & epoch);
+
+	/**
+	 * @brief      Reset the policy to the configured constellations
+	 *
+	 * @return     True if the selection changed
+	 */
+	bool reset();
+
+	/**
+	 * @brief      Get the selected constellations
+	 */
+	std::set<Constellation> selection() const;
+
+	/**
+	 * @brief      Get the Teseo constellation mask of the selected constellations
+	 */
+	uint32_t mask() const;
+
+	/**
+	 * @brief      Get the Teseo constellation mask of a set of constellations
+	 */
+	static uint32_t toMask(const std::set<Constellation> & constellations);
+
+	/**
+	 * @brief      Location update slot
+	 */
+	void onLocation(const Location & loc);
+
+	/**
+	 * @brief      Satellite list update slot, evaluates the epoch
+	 */
+	void onSatelliteList(const std::map<SatIdentifier, SatInfo> & satellites);
+
+	/**
+	 * @brief      Navigation start slot, restores the configured constellations
+	 */
+	int onStart();
+
+	/**
+	 * Signal emitted to send the constellation mask to the device
+	 */
+	Signal<void, const model::Message &> sendMessageRequest;
+};
+
+} // namespace device
+} // namespace stm
+
+#endif // TESEO_HAL_DEVICE_CONSTELLATION_POLICY_H
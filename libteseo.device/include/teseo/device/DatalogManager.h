@@ -0,0 +1,261 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Receiver datalog manager
+ * @file DatalogManager.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_DEVICE_DATALOG_MANAGER_H
+#define TESEO_HAL_DEVICE_DATALOG_MANAGER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <teseo/utils/optional.h>
+#include <teseo/utils/Signal.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/model/Datalog.h>
+#include <teseo/model/Location.h>
+#include <teseo/model/Message.h>
+
+namespace stm {
+namespace device {
+
+/**
+ * @brief      Datalog criteria, a fix is logged when all criteria are met
+ */
+struct DatalogCriteria {
+	bool circular;            ///< Overwrite the oldest entries when the log is full
+	unsigned int minInterval; ///< Minimum time between two entries, in seconds
+	unsigned int minSpeed;    ///< Minimum speed, in km/h
+	unsigned int minDistance; ///< Minimum distance between two entries, in meters
+
+	DatalogCriteria();
+};
+
+enum class DatalogState {
+	Idle,        ///< Receiver is not logging
+	Configuring, ///< Datalog is being created and started
+	Logging,     ///< Receiver is logging, the host link is not needed
+	Reading,     ///< Datalog is being read back
+	Stopping     ///< Logging is being stopped and the datalog erased
+};
+
+const char * toString(DatalogState state);
+
+/**
+ * @brief      Receiver datalog manager
+ *
+ * @details    While the receiver logs fixes in its internal memory the host doesn't have to receive
+ * every sentence. The link (byte stream and decoder, holding the wakelock) is only requested
+ * while a command is in progress: to configure the log, to read back a batch and to stop.
+ *
+ * Each batch is read from the entry following the last one read, so fixes logged while a batch
+ * is read back are part of the next one. The datalog is erased when logging stops.
+ *
+ * A command the receiver doesn't answer within the answer timeout failed: the manager goes back
+ * to idle and releases the link. Each answer or entry read back restarts the delay.
+ */
+class DatalogManager :
+	public Trackable
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using time_point = Clock::time_point;
+
+private:
+	/**
+	 * Actions to perform once the mutex is released
+	 */
+	struct Actions {
+		bool linkUp = false;
+		bool linkDown = false;
+		std::vector<model::Message> messages;
+		bool batch = false;
+		std::vector<Location> entries;
+		bool deadlineChanged = false;
+		bool failed = false;
+		DatalogState failedState = DatalogState::Idle;
+	};
+
+	DatalogCriteria criteria;
+
+	std::chrono::milliseconds answerTimeout;
+
+	std::function<time_point()> clock;
+
+	time_point deadline; ///< A command in progress not answered by then failed
+
+	mutable std::mutex mutex;
+
+	DatalogState state;
+
+	std::vector<Location> entries;
+
+	unsigned int nextEntry; ///< Index of the first entry not read back yet
+
+	unsigned int queryFirst; ///< First entry requested by the query in progress
+
+	model::Message command(model::MessageId id) const;
+
+	bool begin(DatalogState expected, DatalogState next, model::MessageId id);
+
+	void perform(Actions & actions);
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  criteria       Logging criteria
+	 * @param[in]  answerTimeout  Delay for the receiver to answer a command
+	 */
+	DatalogManager(
+		const DatalogCriteria & criteria = DatalogCriteria(),
+		std::chrono::milliseconds answerTimeout = std::chrono::milliseconds(5000));
+
+	/**
+	 * @brief      Create the datalog and start logging
+	 *
+	 * @return     False if the manager is not idle
+	 */
+	bool startLogging();
+
+	/**
+	 * @brief      Read back the fixes logged since the previous batch, batchReady is sent when done
+	 *
+	 * @return     False if the receiver is not logging
+	 */
+	bool readBatch();
+
+	/**
+	 * @brief      Stop logging and erase the datalog
+	 *
+	 * @return     False if the receiver is not logging
+	 */
+	bool stopLogging();
+
+	DatalogState getState() const;
+
+	/**
+	 * @brief      Time the command in progress fails without answer, empty without command
+	 */
+	std::optional<time_point> answerDeadline() const;
+
+	/**
+	 * @brief      Fail the command in progress if its answer is late
+	 */
+	void check();
+
+	/**
+	 * @brief      Current time of the manager clock
+	 */
+	time_point now() const;
+
+	/**
+	 * @brief      Set the clock answers are timed with, the steady clock by default
+	 */
+	void setClock(std::function<time_point()> clock);
+
+	/**
+	 * @brief      Receiver answer slot
+	 */
+	void onDatalogAnswer(model::DatalogAnswer answer);
+
+	/**
+	 * @brief      Datalog entry slot
+	 */
+	void onDatalogEntry(unsigned int index, const Location & loc);
+
+	/**
+	 * Request to send a message to the receiver
+	 */
+	Signal<void, const model::Message &> sendMessageRequest;
+
+	/**
+	 * Request the link to the receiver to be up (true) or allow it to go down (false)
+	 */
+	Signal<void, bool> linkRequest;
+
+	/**
+	 * Fixes read back from the datalog, oldest first
+	 */
+	Signal<void, const std::vector<Location> &> batchReady;
+
+	/**
+	 * The receiver didn't answer the command of the given state, the manager is idle again
+	 */
+	Signal<void, DatalogState> commandFailed;
+
+	/**
+	 * The answer deadline may have changed
+	 */
+	Signal<void> deadlineChanged;
+};
+
+/**
+ * @brief      Thread failing the datalog commands the receiver doesn't answer in time
+ */
+class DatalogTimer :
+	public Trackable,
+	public Thread
+{
+private:
+	DatalogManager & manager;
+
+	std::mutex mutex;
+
+	std::condition_variable cond;
+
+	bool runTimer;
+
+	bool changed;
+
+protected:
+	virtual void run();
+
+public:
+	DatalogTimer(DatalogManager & manager);
+
+	/**
+	 * @brief      Start the timer thread
+	 */
+	int start();
+
+	/**
+	 * @brief      Request the timer thread to stop, join it to wait for its end
+	 */
+	virtual int stop();
+
+	/**
+	 * @brief      Deadline change slot, the wakeup time is computed again
+	 */
+	void onDeadlineChanged();
+};
+
+} // namespace device
+} // namespace stm
+
+#endif // TESEO_HAL_DEVICE_DATALOG_MANAGER_H
@@ -0,0 +1,236 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Hot-standby receiver failover
+ * @file ReceiverFailover.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_DEVICE_RECEIVER_FAILOVER_H
+#define TESEO_HAL_DEVICE_RECEIVER_FAILOVER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include <hardware/gps.h>
+
+#include <teseo/utils/optional.h>
+#include <teseo/utils/Signal.h>
+#include <teseo/model/Location.h>
+#include <teseo/model/NmeaMessage.h>
+#include <teseo/model/SatInfo.h>
+
+namespace stm {
+namespace device {
+
+enum class Receiver {
+	Primary = 0,
+	Standby = 1
+};
+
+const char * toString(Receiver receiver);
+
+/**
+ * @brief      Failover settings
+ */
+struct FailoverSettings {
+	std::chrono::milliseconds epochPeriod;    ///< Receivers fix period
+	std::chrono::milliseconds cadenceTimeout; ///< Receiver stalled when an epoch is this late, below one epoch
+	std::chrono::milliseconds fixTimeout;     ///< Receiver unhealthy without valid fix for this long
+	std::chrono::milliseconds demoteAfter;    ///< Primary healthy time before the standby is demoted
+
+	FailoverSettings();
+};
+
+/**
+ * @brief      Receiver health monitor
+ *
+ * @details    A receiver is healthy when its sentences keep coming at the expected cadence and it
+ * provided a valid fix recently. The receiver outputs a burst of sentences every epoch, it stalled
+ * once its next epoch is more than cadenceTimeout late.
+ */
+class ReceiverHealth {
+public:
+	using Clock = std::chrono::steady_clock;
+	using time_point = Clock::time_point;
+
+private:
+	std::optional<time_point> lastSentence;
+	std::optional<time_point> epochStart;
+	std::optional<time_point> lastValidFix;
+
+public:
+	void onSentence(time_point now, const FailoverSettings & settings);
+
+	void onValidFix(time_point now);
+
+	void reset();
+
+	bool stalled(time_point now, const FailoverSettings & settings) const;
+
+	bool healthy(time_point now, const FailoverSettings & settings) const;
+};
+
+/**
+ * @brief      Hot-standby receiver failover
+ *
+ * @details    Both receivers are decoded all the time, only the active one is published. The
+ * primary is active while it is healthy. When it stalls or loses its fix and the standby is
+ * healthy the standby becomes active, its last fix is published right away if it belongs to
+ * the current epoch. The standby is demoted once the primary stayed healthy for demoteAfter.
+ *
+ * Health is evaluated on every event of both receivers, a silent primary is detected by the
+ * standby sentences.
+ */
+class ReceiverFailover :
+	public Trackable
+{
+public:
+	using Clock = ReceiverHealth::Clock;
+	using time_point = ReceiverHealth::time_point;
+	using SatelliteList = std::map<SatIdentifier, SatInfo>;
+
+private:
+	struct State {
+		ReceiverHealth health;
+		std::optional<Location> location;
+		time_point locationTime;
+		std::optional<SatelliteList> satellites;
+		time_point satellitesTime;
+	};
+
+	/**
+	 * Data to publish once the state mutex is released, under the publication mutex
+	 */
+	struct Publication {
+		std::optional<Location> location;
+		std::optional<SatelliteList> satellites;
+		bool activeChanged = false;
+		Receiver active = Receiver::Primary;
+	};
+
+	FailoverSettings settings;
+
+	mutable std::mutex mutex;
+
+	/**
+	 * Held from the evaluation to the end of the publication, both decoder threads publish in
+	 * the order of their evaluation and never concurrently
+	 */
+	std::mutex publishMutex;
+
+	State states[2];
+
+	Receiver active;
+
+	std::optional<time_point> primaryHealthySince;
+
+	unsigned int switches;
+
+	State & state(Receiver receiver) { return states[static_cast<int>(receiver)]; }
+
+	void evaluate(time_point now, Publication & pub);
+
+	void switchTo(Receiver receiver, time_point now, Publication & pub);
+
+	void publish(const Publication & pub);
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  settings  Failover settings
+	 */
+	ReceiverFailover(const FailoverSettings & settings = FailoverSettings());
+
+	/**
+	 * @brief      A sentence was received from a receiver
+	 */
+	void sentence(Receiver receiver, time_point now);
+
+	/**
+	 * @brief      A valid location was decoded from a receiver
+	 */
+	void location(Receiver receiver, const Location & loc, time_point now);
+
+	/**
+	 * @brief      A satellite list was decoded from a receiver
+	 */
+	void satelliteList(Receiver receiver, const SatelliteList & satellites, time_point now);
+
+	/**
+	 * @brief      Evaluate the receivers health without new event
+	 */
+	void check(time_point now);
+
+	/**
+	 * @brief      Forget the receivers history and make the primary active
+	 */
+	void reset();
+
+	Receiver getActive() const;
+
+	/**
+	 * @brief      Number of source switches since creation
+	 */
+	unsigned int getSwitchCount() const;
+
+	void onPrimaryNmea(GpsUtcTime timestamp, const NmeaMessage & nmea);
+
+	void onStandbyNmea(GpsUtcTime timestamp, const NmeaMessage & nmea);
+
+	void onPrimaryLocation(const Location & loc);
+
+	void onStandbyLocation(const Location & loc);
+
+	void onPrimarySatelliteList(const SatelliteList & satellites);
+
+	void onStandbySatelliteList(const SatelliteList & satellites);
+
+	/**
+	 * @brief      Navigation start slot, the primary receiver is active again
+	 *
+	 * @return     0
+	 */
+	int onStart();
+
+	/**
+	 * Location update of the active receiver
+	 */
+	Signal<void, const Location &> locationUpdate;
+
+	/**
+	 * Satellite list update of the active receiver
+	 */
+	Signal<void, const SatelliteList &> satelliteListUpdate;
+
+	/**
+	 * Sent when the active receiver changes
+	 */
+	Signal<void, Receiver> activeChanged;
+};
+
+} // namespace device
+} // namespace stm
+
+#endif // TESEO_HAL_DEVICE_RECEIVER_FAILOVER_H
@@ -0,0 +1,258 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Almanac based sky visibility prediction
+ * @file SkyPredictor.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_DEVICE_SKY_PREDICTOR_H
+#define TESEO_HAL_DEVICE_SKY_PREDICTOR_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <hardware/gps.h>
+
+#include <teseo/utils/optional.h>
+#include <teseo/utils/Signal.h>
+#include <teseo/model/Almanac.h>
+#include <teseo/model/Location.h>
+#include <teseo/model/Message.h>
+#include <teseo/model/SatInfo.h>
+
+namespace stm {
+namespace device {
+
+/**
+ * @brief      Earth centered, earth fixed coordinates, in meters
+ */
+struct Ecef {
+	double x;
+	double y;
+	double z;
+
+	/**
+	 * @brief      Convert a WGS84 position
+	 *
+	 * @param[in]  latitude   Latitude, in decimal degrees
+	 * @param[in]  longitude  Longitude, in decimal degrees
+	 * @param[in]  altitude   Height above the ellipsoid, in meters
+	 */
+	static Ecef fromWgs84(double latitude, double longitude, double altitude);
+};
+
+/**
+ * @brief      GPS almanac orbit, with the physical values of the almanac fields
+ */
+struct AlmanacOrbit {
+	uint8_t prn;
+	unsigned int week;          ///< Almanac week, possibly modulo 1024
+	double toa;                 ///< Reference time of week, in seconds
+	double eccentricity;
+	double inclination;         ///< Radians
+	double rightAscensionRate;  ///< Radians per second
+	double sqrtA;               ///< Square root of the semi-major axis, in sqrt(m)
+	double rightAscension;      ///< Longitude of ascending node at the weekly epoch, in radians
+	double perigee;             ///< Argument of perigee, in radians
+	double meanAnomaly;         ///< Mean anomaly at reference time, in radians
+
+	/**
+	 * @brief      Decode an almanac, IS-GPS-200 scale factors
+	 *
+	 * @return     The orbit, empty if the almanac isn't available or the satellite is unhealthy
+	 */
+	static std::optional<AlmanacOrbit> from(const model::GpsAlmanac & almanac);
+
+	/**
+	 * @brief      Satellite position
+	 *
+	 * @param[in]  gpsTime  Seconds since the GPS time origin
+	 */
+	Ecef position(double gpsTime) const;
+};
+
+/**
+ * @brief      Satellite predicted above the elevation mask
+ */
+struct PredictedSatellite {
+	uint8_t prn;
+	float elevation;  ///< Degrees
+	float azimuth;    ///< Degrees, from the north, clockwise
+	float doppler;    ///< L1 Doppler seen by a static receiver, in Hz
+};
+
+/**
+ * @brief      Almanac based sky visibility prediction
+ *
+ * @details    The almanacs dumped by the receiver are kept on the host, with the last known
+ * position. When navigation starts, the almanacs are propagated to the current time to predict
+ * the visible satellites and their Doppler.
+ *
+ * The predicted list is published as the expected satellite list until the receiver reports its
+ * own, and the receiver almanacs are dumped. The stored almanacs of the predicted satellites the
+ * receiver reports unavailable, after a backup power loss for instance, are injected as search
+ * aiding.
+ *
+ * Without prediction at start, the almanacs are refreshed from the receiver once per session
+ * after the first fix, when they are older than the refresh period.
+ */
+class SkyPredictor :
+	public Trackable
+{
+private:
+	std::string storePath;
+
+	float elevationMask;
+
+	GpsUtcTime refreshPeriod;
+
+	mutable std::mutex mutex;
+
+	std::map<uint8_t, model::GpsAlmanac> almanacs;
+
+	std::optional<Location> lastPosition;
+
+	GpsUtcTime refreshedAt;
+
+	bool dirty;
+
+	bool dumpRequested;
+
+	// Almanacs reported unavailable by the receiver are injected
+	bool seeding;
+
+	std::vector<PredictedSatellite> prediction;
+
+	std::function<GpsUtcTime()> clock;
+
+	void save();
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  storePath      File keeping the almanacs and the last position, empty to keep
+	 *                            them in memory only
+	 * @param[in]  elevationMask  Minimum elevation of a visible satellite, in degrees
+	 * @param[in]  refreshPeriod  Age of the almanacs requiring a dump from the receiver, in ms
+	 */
+	SkyPredictor(
+		const std::string & storePath,
+		float elevationMask = 5.f,
+		GpsUtcTime refreshPeriod = 24 * 3600 * 1000);
+
+	/**
+	 * @brief      Load the almanacs and the last position from the store
+	 *
+	 * @return     False if the store can't be read
+	 */
+	bool load();
+
+	/**
+	 * @brief      Predict the visible satellites
+	 *
+	 * @param[in]  almanacs       Almanacs, by PRN
+	 * @param[in]  position       Observer position
+	 * @param[in]  utc            Prediction time
+	 * @param[in]  elevationMask  Minimum elevation, in degrees
+	 *
+	 * @return     The visible satellites, highest elevation first
+	 */
+	static std::vector<PredictedSatellite> predict(
+		const std::map<uint8_t, model::GpsAlmanac> & almanacs,
+		const Location & position,
+		GpsUtcTime utc,
+		float elevationMask);
+
+	/**
+	 * @brief      Predict the visible satellites from the stored almanacs and position
+	 *
+	 * @return     The visible satellites, empty without position or almanac
+	 */
+	std::vector<PredictedSatellite> predictNow() const;
+
+	/**
+	 * @brief      Build the expected satellite list from a prediction
+	 */
+	static std::map<SatIdentifier, SatInfo> toSatelliteList(const std::vector<PredictedSatellite> & prediction);
+
+	/**
+	 * @brief      Get the prediction of the last start
+	 */
+	std::vector<PredictedSatellite> lastPrediction() const;
+
+	/**
+	 * @brief      Number of stored almanacs
+	 */
+	std::size_t almanacCount() const;
+
+	/**
+	 * @brief      Set the UTC clock, defaults to the system clock
+	 */
+	void setClock(std::function<GpsUtcTime()> clock);
+
+	/**
+	 * @brief      Almanac dumped by the receiver slot, the stored almanac of a predicted satellite
+	 * is injected when the receiver reports it unavailable
+	 */
+	void onAlmanac(const model::GpsAlmanac & almanac);
+
+	/**
+	 * @brief      Location update slot
+	 */
+	void onLocation(const Location & loc);
+
+	/**
+	 * @brief      Location injected by the platform slot
+	 */
+	int onInjectLocation(double latitude, double longitude, float accuracy);
+
+	/**
+	 * @brief      Navigation start slot, publishes the expected satellite list and dumps the
+	 * receiver almanacs
+	 */
+	int onStart();
+
+	/**
+	 * @brief      Navigation stop slot, saves the store when it changed
+	 */
+	int onStop();
+
+	/**
+	 * Signal emitted to send the almanac injections and the dump request to the device
+	 */
+	Signal<void, const model::Message &> sendMessageRequest;
+
+	/**
+	 * Signal emitted at start with the predicted satellite list
+	 */
+	Signal<void, const std::map<SatIdentifier, SatInfo> &> expectedSatellites;
+};
+
+} // namespace device
+} // namespace stm
+
+#endif // TESEO_HAL_DEVICE_SKY_PREDICTOR_H
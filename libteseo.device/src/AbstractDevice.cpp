@@ -42,7 +42,9 @@ namespace device {
 
 const ByteVector AbstractDevice::nmeaSequenceStart {'G', 'G', 'A'};
 
-AbstractDevice::AbstractDevice()
+AbstractDevice::AbstractDevice() :
+	epochPublished(false),
+	epochReceiving(false)
 { }
 
 void AbstractDevice::init()
@@ -110,20 +112,61 @@ void AbstractDevice::update()
 	if(location->locationValidity())
 		locationUpdate(location);
 
-	// Trigger satellite list update
-	satelliteListUpdate(this->satellites);
+	// Trigger satellite list update, with the expected satellites until the receiver reports some
+	if(!satellites->empty())
+		expectedSatellites.clear();
+
+	if(satellites->empty() && !expectedSatellites.empty())
+		satelliteListUpdate(expectedSatellites);
+	else
+		satelliteListUpdate(this->satellites);
+}
+
+void AbstractDevice::setExpectedSatellites(const std::map<SatIdentifier, SatInfo> & sats)
+{
+	bool publish;
+
+	{
+		std::lock_guard<std::mutex> lock(dataMutex);
+		expectedSatellites = sats;
+		publish = satellites->empty() && !sats.empty();
+	}
+
+	// Publish them now, the first epoch may take a while. Emitted out of the data lock, the
+	// slots may call back into the device.
+	if(publish)
+		satelliteListUpdate(sats);
 }
 
 void AbstractDevice::updateIfStartSentenceId(const ByteVector & sentenceId)
 {
 	if(sentenceId == nmeaSequenceStart)
 	{
-		// Trigger updates
-		update();
+		// Trigger updates, unless the epoch timer already did it
+		if(!epochPublished)
+			update();
 
 		// Clear data before starting new sequence
 		this->clearSatelliteList();
+
+		epochPublished = false;
 	}
+
+	epochReceiving = true;
+}
+
+void AbstractDevice::onEpochDue()
+{
+	std::lock_guard<std::mutex> lock(dataMutex);
+
+	if(epochPublished || !epochReceiving)
+		return;
+
+	update();
+	this->clearSatelliteList();
+
+	epochPublished = true;
+	epochReceiving = false;
 }
 
 int AbstractDevice::start()
@@ -148,6 +191,11 @@ int AbstractDevice::stop()
 	// Stop the navigation
 	stopNavigation();
 
+	{
+		std::lock_guard<std::mutex> lock(dataMutex);
+		expectedSatellites.clear();
+	}
+
 	// Release wakelock and update status
 	utils::Wakelock::release();
 	statusUpdate(GPS_STATUS_SESSION_END);
@@ -0,0 +1,248 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Assistance data injection
+ * @file AssistanceInjector.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/device/AssistanceInjector.h>
+
+#define LOG_TAG "teseo_hal_AssistanceInjector"
+#include <cutils/log.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <teseo/utils/ByteVector.h>
+
+namespace stm {
+namespace device {
+
+using namespace stm::model;
+
+namespace {
+
+/**
+ * @brief      Parse an unsigned decimal field
+ *
+ * @return     False if the field is empty or isn't a number
+ */
+bool parseUnsigned(const std::string & field, unsigned long & value)
+{
+	if(field.empty())
+		return false;
+
+	char * end = nullptr;
+	value = std::strtoul(field.c_str(), &end, 10);
+	return *end == '\0';
+}
+
+/**
+ * @brief      Check an hexadecimal string
+ */
+bool isHex(const std::string & hex)
+{
+	if(hex.size() % 2 != 0)
+		return false;
+
+	for(std::size_t i = 0; i < hex.size(); i += 2)
+	{
+		bool invalid = false;
+		utils::asciiToByte(hex[i], hex[i + 1], invalid);
+
+		if(invalid)
+			return false;
+	}
+
+	return true;
+}
+
+} // namespace
+
+const char * toString(AssistanceKind kind)
+{
+	switch(kind)
+	{
+		case AssistanceKind::Ephemeris: return "ephemeris";
+		case AssistanceKind::Almanac:   return "almanac";
+	}
+
+	return "unknown";
+}
+
+AssistanceInjector::AssistanceInjector() :
+	navigating(false),
+	sendMessageRequest("AssistanceInjector::sendMessageRequest")
+{ }
+
+std::vector<Message> AssistanceInjector::parse(AssistanceKind kind, const std::vector<char> & content)
+{
+	const std::string sentenceId = kind == AssistanceKind::Ephemeris ? "PSTMEPHEM" : "PSTMALMANAC";
+	const MessageId id = kind == AssistanceKind::Ephemeris ?
+		MessageId::Stagps_RealTime_Ephemeris : MessageId::Stagps_RealTime_Almanac;
+
+	std::vector<Message> messages;
+	std::size_t skipped = 0;
+
+	std::istringstream lines(std::string(content.begin(), content.end()));
+	std::string line;
+
+	while(std::getline(lines, line))
+	{
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if(line.empty())
+			continue;
+
+		// $<body>*<checksum>
+		std::size_t star = line.rfind('*');
+
+		if(line[0] != '$' || star == std::string::npos || star + 3 != line.size())
+		{
+			skipped++;
+			continue;
+		}
+
+		uint8_t crc = 0;
+		for(std::size_t i = 1; i < star; i++)
+			crc ^= static_cast<uint8_t>(line[i]);
+
+		bool invalid = false;
+		uint8_t expected = utils::asciiToByte(line[star + 1], line[star + 2], invalid);
+
+		if(invalid || crc != expected)
+		{
+			skipped++;
+			continue;
+		}
+
+		// Sentence id, satellite id, data size, then the data in hexadecimal, in one or several fields
+		std::vector<std::string> fields;
+		std::istringstream body(line.substr(1, star - 1));
+		std::string field;
+
+		while(std::getline(body, field, ','))
+			fields.push_back(field);
+
+		if(fields.size() < 4 || fields[0] != sentenceId)
+		{
+			skipped++;
+			continue;
+		}
+
+		unsigned long satId;
+		unsigned long size;
+		std::string hex;
+
+		for(auto it = fields.begin() + 3; it != fields.end(); ++it)
+			hex += *it;
+
+		if(!parseUnsigned(fields[1], satId) || !parseUnsigned(fields[2], size) ||
+			size == 0 || hex.size() != 2 * size || !isHex(hex))
+		{
+			skipped++;
+			continue;
+		}
+
+		messages.push_back(Message{
+			id,
+			{
+				utils::createFromString(fields[1]),
+				utils::createFromString(fields[2]),
+				utils::createFromString(hex)
+			}
+		});
+	}
+
+	if(skipped > 0)
+		ALOGW("%zu lines of the %s file skipped", skipped, toString(kind));
+
+	return messages;
+}
+
+std::size_t AssistanceInjector::inject(AssistanceKind kind, const std::vector<char> & content)
+{
+	std::vector<Message> messages = parse(kind, content);
+
+	if(messages.empty())
+	{
+		ALOGE("No %s to inject", toString(kind));
+		return 0;
+	}
+
+	bool now;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		now = navigating;
+
+		if(!now)
+			pending[kind] = messages;
+	}
+
+	if(!now)
+	{
+		ALOGI("Keep the %s of %zu satellites until navigation starts", toString(kind), messages.size());
+		return messages.size();
+	}
+
+	ALOGI("Inject the %s of %zu satellites", toString(kind), messages.size());
+
+	for(const auto & message : messages)
+		sendMessageRequest(message);
+
+	return messages.size();
+}
+
+int AssistanceInjector::onStart()
+{
+	std::map<AssistanceKind, std::vector<Message>> injections;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		navigating = true;
+		injections.swap(pending);
+	}
+
+	for(const auto & p : injections)
+	{
+		ALOGI("Inject the %s of %zu satellites", toString(p.first), p.second.size());
+
+		for(const auto & message : p.second)
+			sendMessageRequest(message);
+	}
+
+	return 0;
+}
+
+int AssistanceInjector::onStop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	navigating = false;
+	return 0;
+}
+
+} // namespace device
+} // namespace stm
@@ -0,0 +1,227 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Adaptive constellation selection
+ * @file ConstellationPolicy.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/device/ConstellationPolicy.h>
+
+#define LOG_TAG "teseo_hal_ConstellationPolicy"
+#include <cutils/log.h>
+
+#include <string>
+
+#include <teseo/utils/ByteVector.h>
+
+namespace stm {
+namespace device {
+
+ConstellationThresholds::ConstellationThresholds() :
+	reduceMinUsed(10),
+	reduceMaxPdop(2.),
+	restoreMinUsed(7),
+	restoreMaxPdop(3.),
+	reduceAfter(30),
+	restoreAfter(2),
+	holdoff(300)
+{ }
+
+EpochSummary EpochSummary::from(
+	const std::optional<Location> & loc,
+	const std::map<SatIdentifier, SatInfo> & satellites)
+{
+	EpochSummary epoch;
+
+	epoch.fix = loc && loc->locationValidity();
+	epoch.pdop = (epoch.fix && loc->pdopValidity()) ? loc->pdop() : 0.;
+
+	for(const auto & p : satellites)
+	{
+		Constellation c = p.first.getConstellation();
+
+		if(p.second.isTracked())
+			epoch.tracked[c]++;
+
+		if(p.second.isUsedInFix())
+			epoch.used[c]++;
+	}
+
+	return epoch;
+}
+
+ConstellationPolicy::ConstellationPolicy(
+	const std::set<Constellation> & configured,
+	Constellation primary,
+	const ConstellationThresholds & thresholds) :
+	configured(configured),
+	primary(primary),
+	thresholds(thresholds),
+	reduced(false),
+	goodEpochs(0),
+	degradedEpochs(0),
+	sinceRestore(thresholds.holdoff),
+	sendMessageRequest("ConstellationPolicy::sendMessageRequest")
+{ }
+
+bool ConstellationPolicy::evaluate(const EpochSummary & epoch)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Nothing to save with the primary constellation alone
+	if(configured.size() < 2 || configured.count(primary) == 0)
+		return false;
+
+	auto it = epoch.used.find(primary);
+	unsigned int primaryUsed = (it != epoch.used.end()) ? it->second : 0;
+
+	if(!reduced)
+	{
+		bool good = epoch.fix &&
+		            primaryUsed >= thresholds.reduceMinUsed &&
+		            epoch.pdop > 0. && epoch.pdop <= thresholds.reduceMaxPdop;
+
+		goodEpochs = good ? goodEpochs + 1 : 0;
+
+		if(sinceRestore < thresholds.holdoff)
+			sinceRestore++;
+
+		if(goodEpochs < thresholds.reduceAfter || sinceRestore < thresholds.holdoff)
+			return false;
+
+		ALOGI("Open sky: %u satellites used, PDOP %.1f, reduce constellations", primaryUsed, epoch.pdop);
+
+		reduced = true;
+		goodEpochs = 0;
+		degradedEpochs = 0;
+		return true;
+	}
+
+	bool degraded = !epoch.fix ||
+	                primaryUsed < thresholds.restoreMinUsed ||
+	                epoch.pdop > thresholds.restoreMaxPdop;
+
+	degradedEpochs = degraded ? degradedEpochs + 1 : 0;
+
+	if(degradedEpochs < thresholds.restoreAfter)
+		return false;
+
+	ALOGI("Geometry degraded: %u satellites used, PDOP %.1f, restore constellations", primaryUsed, epoch.pdop);
+
+	reduced = false;
+	degradedEpochs = 0;
+	sinceRestore = 0;
+	return true;
+}
+
+bool ConstellationPolicy::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	bool changed = reduced;
+
+	reduced = false;
+	goodEpochs = 0;
+	degradedEpochs = 0;
+	sinceRestore = thresholds.holdoff;
+	epochLocation = std::nullopt;
+
+	return changed;
+}
+
+std::set<Constellation> ConstellationPolicy::selection() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(reduced)
+		return std::set<Constellation>({primary});
+
+	return configured;
+}
+
+uint32_t ConstellationPolicy::mask() const
+{
+	return toMask(selection());
+}
+
+uint32_t ConstellationPolicy::toMask(const std::set<Constellation> & constellations)
+{
+	uint32_t mask = 0;
+
+	for(auto c : constellations)
+	{
+		switch(c)
+		{
+			case Constellation::Gps:     mask |= 0x01; break;
+			case Constellation::Glonass: mask |= 0x02; break;
+			case Constellation::Qzss:    mask |= 0x04; break;
+			case Constellation::Galileo: mask |= 0x08; break;
+			case Constellation::Beidou:  mask |= 0x80; break;
+			default: break;
+		}
+	}
+
+	return mask;
+}
+
+void ConstellationPolicy::requestSelection()
+{
+	uint32_t m = mask();
+
+	ALOGI("Set constellation mask to 0x%02x", m);
+	sendMessageRequest(model::Message{
+		model::MessageId::SetConstellationMask,
+		{utils::createFromString(std::to_string(m))}
+	});
+}
+
+void ConstellationPolicy::onLocation(const Location & loc)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	epochLocation = loc;
+}
+
+void ConstellationPolicy::onSatelliteList(const std::map<SatIdentifier, SatInfo> & satellites)
+{
+	std::optional<Location> loc;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		loc = epochLocation;
+		epochLocation = std::nullopt;
+	}
+
+	if(evaluate(EpochSummary::from(loc, satellites)))
+		requestSelection();
+}
+
+int ConstellationPolicy::onStart()
+{
+	if(reset())
+		requestSelection();
+
+	return 0;
+}
+
+} // namespace device
+} // namespace stm
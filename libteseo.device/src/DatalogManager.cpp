@@ -0,0 +1,405 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Receiver datalog manager
+ * @file DatalogManager.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/device/DatalogManager.h>
+
+#define LOG_TAG "teseo_hal_DatalogManager"
+#include <cutils/log.h>
+
+#include <string>
+
+#include <teseo/utils/ByteVector.h>
+
+namespace stm {
+namespace device {
+
+using namespace stm::model;
+
+namespace {
+
+/**
+ * Entry type logging position, altitude, speed, course and HDOP
+ */
+constexpr unsigned int entryType = 1;
+
+/**
+ * Query type reading complete entries
+ */
+constexpr unsigned int queryType = 0;
+
+ByteVector param(unsigned int value)
+{
+	return utils::createFromString(std::to_string(value));
+}
+
+/**
+ * A command is in progress, an answer is expected
+ */
+bool waitsAnswer(DatalogState state)
+{
+	return state == DatalogState::Configuring || state == DatalogState::Reading || state == DatalogState::Stopping;
+}
+
+} // namespace
+
+const char * toString(DatalogState state)
+{
+	switch(state)
+	{
+		case DatalogState::Idle:        return "idle";
+		case DatalogState::Configuring: return "configuring";
+		case DatalogState::Logging:     return "logging";
+		case DatalogState::Reading:     return "reading";
+		case DatalogState::Stopping:    return "stopping";
+	}
+
+	return "unknown";
+}
+
+DatalogCriteria::DatalogCriteria() :
+	circular(true),
+	minInterval(1),
+	minSpeed(0),
+	minDistance(0)
+{ }
+
+DatalogManager::DatalogManager(const DatalogCriteria & criteria, std::chrono::milliseconds answerTimeout) :
+	criteria(criteria),
+	answerTimeout(answerTimeout),
+	clock(&Clock::now),
+	state(DatalogState::Idle),
+	nextEntry(0),
+	queryFirst(0),
+	sendMessageRequest("DatalogManager::sendMessageRequest"),
+	linkRequest("DatalogManager::linkRequest"),
+	batchReady("DatalogManager::batchReady"),
+	commandFailed("DatalogManager::commandFailed"),
+	deadlineChanged("DatalogManager::deadlineChanged")
+{ }
+
+Message DatalogManager::command(MessageId id) const
+{
+	switch(id)
+	{
+		case MessageId::Datalog_Create:
+			return Message{id, {
+				param(criteria.circular ? 1 : 0),
+				param(criteria.minInterval),
+				param(criteria.minSpeed),
+				param(criteria.minDistance),
+				param(entryType)
+			}};
+
+		case MessageId::Datalog_Query:
+			// Read every entry from the first one not read yet
+			return Message{id, {param(queryType), param(nextEntry), param(0)}};
+
+		default:
+			return Message{id, {}};
+	}
+}
+
+bool DatalogManager::begin(DatalogState expected, DatalogState next, MessageId id)
+{
+	Actions actions;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(state != expected)
+		{
+			ALOGW("Datalog is %s, expected %s", toString(state), toString(expected));
+			return false;
+		}
+
+		ALOGI("Datalog %s -> %s", toString(state), toString(next));
+		state = next;
+		entries.clear();
+
+		// A new datalog starts empty
+		if(id == MessageId::Datalog_Create)
+			nextEntry = 0;
+
+		queryFirst = nextEntry;
+		deadline = clock() + answerTimeout;
+
+		actions.linkUp = true;
+		actions.messages.push_back(command(id));
+		actions.deadlineChanged = true;
+	}
+
+	perform(actions);
+	return true;
+}
+
+void DatalogManager::perform(Actions & actions)
+{
+	if(actions.linkUp)
+		linkRequest(true);
+
+	for(const auto & message : actions.messages)
+		sendMessageRequest(message);
+
+	if(actions.linkDown)
+		linkRequest(false);
+
+	if(actions.batch)
+		batchReady(actions.entries);
+
+	if(actions.failed)
+		commandFailed(actions.failedState);
+
+	if(actions.deadlineChanged)
+		deadlineChanged();
+}
+
+bool DatalogManager::startLogging()
+{
+	return begin(DatalogState::Idle, DatalogState::Configuring, MessageId::Datalog_Create);
+}
+
+bool DatalogManager::readBatch()
+{
+	return begin(DatalogState::Logging, DatalogState::Reading, MessageId::Datalog_Query);
+}
+
+bool DatalogManager::stopLogging()
+{
+	return begin(DatalogState::Logging, DatalogState::Stopping, MessageId::Datalog_Stop);
+}
+
+DatalogState DatalogManager::getState() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return state;
+}
+
+std::optional<DatalogManager::time_point> DatalogManager::answerDeadline() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(!waitsAnswer(state))
+		return {};
+
+	return deadline;
+}
+
+void DatalogManager::check()
+{
+	Actions actions;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(!waitsAnswer(state) || clock() < deadline)
+			return;
+
+		ALOGE("Datalog %s, no answer from the receiver in %lld ms", toString(state),
+			static_cast<long long>(answerTimeout.count()));
+
+		// The receiver state is unknown, the next session creates the datalog again
+		entries.clear();
+		actions.failed = true;
+		actions.failedState = state;
+		actions.linkDown = true;
+
+		ALOGI("Datalog %s -> %s", toString(state), toString(DatalogState::Idle));
+		state = DatalogState::Idle;
+	}
+
+	perform(actions);
+}
+
+DatalogManager::time_point DatalogManager::now() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return clock();
+}
+
+void DatalogManager::setClock(std::function<time_point()> clock)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->clock = clock;
+}
+
+void DatalogManager::onDatalogAnswer(DatalogAnswer answer)
+{
+	Actions actions;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		DatalogState next = state;
+
+		// The receiver is still answering
+		if(waitsAnswer(state))
+			deadline = clock() + answerTimeout;
+
+		switch(state)
+		{
+			case DatalogState::Configuring:
+				if(answer == DatalogAnswer::CreateOk)
+					actions.messages.push_back(command(MessageId::Datalog_Start));
+				else if(answer == DatalogAnswer::StartOk)
+					next = DatalogState::Logging;
+				else if(answer == DatalogAnswer::CreateError || answer == DatalogAnswer::StartError)
+					next = DatalogState::Idle;
+				break;
+
+			case DatalogState::Reading:
+				if(answer == DatalogAnswer::QueryOk)
+				{
+					actions.batch = true;
+					actions.entries.swap(entries);
+					next = DatalogState::Logging;
+				}
+				else if(answer == DatalogAnswer::QueryError)
+				{
+					// Read these entries again with the next batch
+					ALOGE("Datalog read back failed, %zu entries discarded", entries.size());
+					entries.clear();
+					nextEntry = queryFirst;
+					next = DatalogState::Logging;
+				}
+				break;
+
+			case DatalogState::Stopping:
+				if(answer == DatalogAnswer::StopOk)
+					actions.messages.push_back(command(MessageId::Datalog_Erase));
+				else if(answer == DatalogAnswer::StopError)
+					next = DatalogState::Logging;
+				else if(answer == DatalogAnswer::EraseOk || answer == DatalogAnswer::EraseError)
+				{
+					if(answer == DatalogAnswer::EraseError)
+						ALOGW("Datalog not erased");
+
+					next = DatalogState::Idle;
+				}
+				break;
+
+			default:
+				ALOGW("Unexpected datalog answer while %s", toString(state));
+				break;
+		}
+
+		if(next != state)
+		{
+			ALOGI("Datalog %s -> %s", toString(state), toString(next));
+			state = next;
+			actions.linkDown = true;
+		}
+	}
+
+	perform(actions);
+}
+
+void DatalogManager::onDatalogEntry(unsigned int index, const Location & loc)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(state != DatalogState::Reading)
+		return;
+
+	entries.push_back(loc);
+	deadline = clock() + answerTimeout;
+
+	if(index >= nextEntry)
+		nextEntry = index + 1;
+}
+
+DatalogTimer::DatalogTimer(DatalogManager & manager) :
+	Trackable(),
+	Thread("teseo-datalog-timer"),
+	manager(manager),
+	runTimer(false),
+	changed(false)
+{ }
+
+void DatalogTimer::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	ALOGI("Start datalog timer");
+
+	while(runTimer)
+	{
+		changed = false;
+
+		// The manager signals deadline changes, don't call it with the mutex held
+		lock.unlock();
+		const DatalogManager::time_point now = manager.now();
+		manager.check();
+		std::optional<DatalogManager::time_point> deadline = manager.answerDeadline();
+		lock.lock();
+
+		auto pred = [this] () { return !runTimer || changed; };
+
+		// Deadlines are on the manager clock, only the remaining delay is waited for
+		if(deadline)
+			cond.wait_for(lock, *deadline - now, pred);
+		else
+			cond.wait(lock, pred);
+	}
+
+	ALOGI("Stop datalog timer");
+}
+
+int DatalogTimer::start()
+{
+	// Set before the thread exists, so a stop request can't be overwritten by the thread
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runTimer = true;
+		changed = false;
+	}
+
+	return Thread::start();
+}
+
+int DatalogTimer::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runTimer = false;
+	}
+
+	cond.notify_all();
+	return 0;
+}
+
+void DatalogTimer::onDeadlineChanged()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed = true;
+	}
+
+	cond.notify_all();
+}
+
+} // namespace device
+} // namespace stm
@@ -0,0 +1,294 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Hot-standby receiver failover
+ * @file ReceiverFailover.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/device/ReceiverFailover.h>
+
+#define LOG_TAG "teseo_hal_ReceiverFailover"
+#include <cutils/log.h>
+
+namespace stm {
+namespace device {
+
+using namespace std::chrono;
+
+const char * toString(Receiver receiver)
+{
+	switch(receiver)
+	{
+		case Receiver::Primary: return "primary";
+		case Receiver::Standby: return "standby";
+	}
+
+	return "unknown";
+}
+
+FailoverSettings::FailoverSettings() :
+	epochPeriod(1000),
+	cadenceTimeout(200),
+	fixTimeout(2500),
+	demoteAfter(10000)
+{ }
+
+void ReceiverHealth::onSentence(time_point now, const FailoverSettings & settings)
+{
+	// An epoch starts with the first sentence after the silence between two bursts
+	if(!epochStart || now - *lastSentence > settings.epochPeriod / 2 || now - *epochStart >= settings.epochPeriod)
+		epochStart = now;
+
+	lastSentence = now;
+}
+
+void ReceiverHealth::onValidFix(time_point now)
+{
+	lastValidFix = now;
+}
+
+void ReceiverHealth::reset()
+{
+	lastSentence.reset();
+	epochStart.reset();
+	lastValidFix.reset();
+}
+
+bool ReceiverHealth::stalled(time_point now, const FailoverSettings & settings) const
+{
+	return !epochStart || now - *epochStart > settings.epochPeriod + settings.cadenceTimeout;
+}
+
+bool ReceiverHealth::healthy(time_point now, const FailoverSettings & settings) const
+{
+	if(stalled(now, settings))
+		return false;
+
+	return lastValidFix && now - *lastValidFix <= settings.fixTimeout;
+}
+
+ReceiverFailover::ReceiverFailover(const FailoverSettings & settings) :
+	settings(settings),
+	active(Receiver::Primary),
+	switches(0),
+	locationUpdate("ReceiverFailover::locationUpdate"),
+	satelliteListUpdate("ReceiverFailover::satelliteListUpdate"),
+	activeChanged("ReceiverFailover::activeChanged")
+{ }
+
+void ReceiverFailover::switchTo(Receiver receiver, time_point now, Publication & pub)
+{
+	ALOGW("Switch published receiver from %s to %s", toString(active), toString(receiver));
+
+	active = receiver;
+	switches++;
+	pub.activeChanged = true;
+	pub.active = receiver;
+
+	// The new source fix of the current epoch is published without waiting for the next one
+	State & s = state(receiver);
+
+	if(s.location && now - s.locationTime <= settings.epochPeriod)
+		pub.location = s.location;
+
+	if(s.satellites && now - s.satellitesTime <= settings.epochPeriod)
+		pub.satellites = s.satellites;
+}
+
+void ReceiverFailover::evaluate(time_point now, Publication & pub)
+{
+	bool primaryOk = state(Receiver::Primary).health.healthy(now, settings);
+	bool standbyOk = state(Receiver::Standby).health.healthy(now, settings);
+
+	if(primaryOk)
+	{
+		if(!primaryHealthySince)
+			primaryHealthySince = now;
+	}
+	else
+	{
+		primaryHealthySince.reset();
+	}
+
+	if(active == Receiver::Primary)
+	{
+		if(!primaryOk && standbyOk)
+			switchTo(Receiver::Standby, now, pub);
+	}
+	else
+	{
+		if(primaryOk && (!standbyOk || now - *primaryHealthySince >= settings.demoteAfter))
+			switchTo(Receiver::Primary, now, pub);
+	}
+}
+
+void ReceiverFailover::publish(const Publication & pub)
+{
+	if(pub.activeChanged)
+		activeChanged(pub.active);
+
+	if(pub.location)
+		locationUpdate(*pub.location);
+
+	if(pub.satellites)
+		satelliteListUpdate(*pub.satellites);
+}
+
+void ReceiverFailover::sentence(Receiver receiver, time_point now)
+{
+	std::lock_guard<std::mutex> publishLock(publishMutex);
+	Publication pub;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		state(receiver).health.onSentence(now, settings);
+		evaluate(now, pub);
+	}
+
+	publish(pub);
+}
+
+void ReceiverFailover::location(Receiver receiver, const Location & loc, time_point now)
+{
+	std::lock_guard<std::mutex> publishLock(publishMutex);
+	Publication pub;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		State & s = state(receiver);
+
+		if(loc.locationValidity())
+			s.health.onValidFix(now);
+
+		s.location = loc;
+		s.locationTime = now;
+
+		evaluate(now, pub);
+
+		if(receiver == active && !pub.location)
+			pub.location = loc;
+	}
+
+	publish(pub);
+}
+
+void ReceiverFailover::satelliteList(Receiver receiver, const SatelliteList & satellites, time_point now)
+{
+	std::lock_guard<std::mutex> publishLock(publishMutex);
+	Publication pub;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		State & s = state(receiver);
+
+		s.satellites = satellites;
+		s.satellitesTime = now;
+
+		evaluate(now, pub);
+
+		if(receiver == active && !pub.satellites)
+			pub.satellites = satellites;
+	}
+
+	publish(pub);
+}
+
+void ReceiverFailover::check(time_point now)
+{
+	std::lock_guard<std::mutex> publishLock(publishMutex);
+	Publication pub;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		evaluate(now, pub);
+	}
+
+	publish(pub);
+}
+
+void ReceiverFailover::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(State & s : states)
+	{
+		s.health.reset();
+		s.location.reset();
+		s.satellites.reset();
+	}
+
+	active = Receiver::Primary;
+	primaryHealthySince.reset();
+}
+
+Receiver ReceiverFailover::getActive() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return active;
+}
+
+unsigned int ReceiverFailover::getSwitchCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return switches;
+}
+
+void ReceiverFailover::onPrimaryNmea(GpsUtcTime, const NmeaMessage &)
+{
+	sentence(Receiver::Primary, Clock::now());
+}
+
+void ReceiverFailover::onStandbyNmea(GpsUtcTime, const NmeaMessage &)
+{
+	sentence(Receiver::Standby, Clock::now());
+}
+
+void ReceiverFailover::onPrimaryLocation(const Location & loc)
+{
+	location(Receiver::Primary, loc, Clock::now());
+}
+
+void ReceiverFailover::onStandbyLocation(const Location & loc)
+{
+	location(Receiver::Standby, loc, Clock::now());
+}
+
+void ReceiverFailover::onPrimarySatelliteList(const SatelliteList & satellites)
+{
+	satelliteList(Receiver::Primary, satellites, Clock::now());
+}
+
+void ReceiverFailover::onStandbySatelliteList(const SatelliteList & satellites)
+{
+	satelliteList(Receiver::Standby, satellites, Clock::now());
+}
+
+int ReceiverFailover::onStart()
+{
+	ALOGI("Navigation started, primary receiver active");
+	reset();
+	return 0;
+}
+
+} // namespace device
+} // namespace stm
@@ -0,0 +1,531 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Almanac based sky visibility prediction
+ * @file SkyPredictor.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/device/SkyPredictor.h>
+
+#define LOG_TAG "teseo_hal_SkyPredictor"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+#include <teseo/utils/ByteVector.h>
+#include <teseo/utils/Time.h>
+
+namespace stm {
+namespace device {
+
+namespace {
+
+// IS-GPS-200 constants
+constexpr double gpsPi = 3.1415926535898;
+constexpr double earthGravity = 3.986005e14;
+constexpr double earthRotation = 7.2921151467e-5;
+constexpr double secondsPerWeek = 604800.;
+
+constexpr double speedOfLight = 299792458.;
+constexpr double l1Frequency = 1575.42e6;
+
+// WGS84 ellipsoid
+constexpr double wgs84A = 6378137.;
+constexpr double wgs84E2 = 6.69437999014e-3;
+
+/**
+ * GPS time is ahead of UTC by the leap seconds inserted since 1980
+ */
+constexpr double gpsLeapSeconds = 18.;
+
+constexpr double degrees = 180. / M_PI;
+
+/**
+ * Store layout: magic, version, position flag, latitude, longitude, altitude, refresh time,
+ * almanac count, then the raw almanacs
+ */
+const char storeMagic[4] = {'T', 'S', 'K', 'Y'};
+constexpr uint8_t storeVersion = 1;
+
+int32_t signExtend(uint32_t value, int bits)
+{
+	uint32_t sign = 1u << (bits - 1);
+	return static_cast<int32_t>((value ^ sign) - sign);
+}
+
+double pow2(int exponent)
+{
+	return std::ldexp(1., exponent);
+}
+
+Ecef operator - (const Ecef & a, const Ecef & b)
+{
+	return Ecef{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+} // namespace
+
+Ecef Ecef::fromWgs84(double latitude, double longitude, double altitude)
+{
+	double lat = latitude / degrees;
+	double lon = longitude / degrees;
+	double n = wgs84A / std::sqrt(1. - wgs84E2 * std::sin(lat) * std::sin(lat));
+
+	return Ecef{
+		(n + altitude) * std::cos(lat) * std::cos(lon),
+		(n + altitude) * std::cos(lat) * std::sin(lon),
+		(n * (1. - wgs84E2) + altitude) * std::sin(lat)
+	};
+}
+
+std::optional<AlmanacOrbit> AlmanacOrbit::from(const model::GpsAlmanac & almanac)
+{
+	const model::GpsAlmanacData & d = almanac.d;
+
+	// Health bit set means the satellite shouldn't be used
+	if(!d.available || d.health || d.satid == 0 || d.root_a == 0)
+		return std::nullopt;
+
+	AlmanacOrbit o;
+	o.prn = d.satid;
+	o.week = d.week;
+	o.toa = d.toa * pow2(12);
+	o.eccentricity = d.eccentricity * pow2(-21);
+	o.inclination = (0.3 + signExtend(d.delta_i, 16) * pow2(-19)) * gpsPi;
+	o.rightAscensionRate = signExtend(d.omega_dot, 16) * pow2(-38) * gpsPi;
+	o.sqrtA = d.root_a * pow2(-11);
+	o.rightAscension = signExtend(d.omega_zero, 24) * pow2(-23) * gpsPi;
+	o.perigee = signExtend(d.perigee, 24) * pow2(-23) * gpsPi;
+	o.meanAnomaly = signExtend(d.mean_anomaly, 24) * pow2(-23) * gpsPi;
+
+	return o;
+}
+
+Ecef AlmanacOrbit::position(double gpsTime) const
+{
+	// The almanac week may be truncated to 10 bits, take the closest matching week
+	double fullWeek = week;
+	if(week < 1024)
+		fullWeek += 1024. * std::round((std::floor(gpsTime / secondsPerWeek) - week) / 1024.);
+
+	double tk = gpsTime - (fullWeek * secondsPerWeek + toa);
+
+	double a = sqrtA * sqrtA;
+	double n = std::sqrt(earthGravity / (a * a * a));
+	double m = meanAnomaly + n * tk;
+
+	// Kepler equation, converges in a few iterations for GPS eccentricities
+	double e = m;
+	for(int i = 0; i < 10; i++)
+	{
+		double step = (e - eccentricity * std::sin(e) - m) / (1. - eccentricity * std::cos(e));
+		e -= step;
+
+		if(std::fabs(step) < 1e-12)
+			break;
+	}
+
+	double nu = std::atan2(std::sqrt(1. - eccentricity * eccentricity) * std::sin(e), std::cos(e) - eccentricity);
+	double phi = nu + perigee;
+	double r = a * (1. - eccentricity * std::cos(e));
+	double omega = rightAscension + (rightAscensionRate - earthRotation) * tk - earthRotation * toa;
+
+	double xp = r * std::cos(phi);
+	double yp = r * std::sin(phi);
+
+	return Ecef{
+		xp * std::cos(omega) - yp * std::cos(inclination) * std::sin(omega),
+		xp * std::sin(omega) + yp * std::cos(inclination) * std::cos(omega),
+		yp * std::sin(inclination)
+	};
+}
+
+SkyPredictor::SkyPredictor(
+	const std::string & storePath,
+	float elevationMask,
+	GpsUtcTime refreshPeriod) :
+	storePath(storePath),
+	elevationMask(elevationMask),
+	refreshPeriod(refreshPeriod),
+	refreshedAt(0),
+	dirty(false),
+	dumpRequested(false),
+	seeding(false),
+	clock(&utils::systemNow),
+	sendMessageRequest("SkyPredictor::sendMessageRequest"),
+	expectedSatellites("SkyPredictor::expectedSatellites")
+{ }
+
+bool SkyPredictor::load()
+{
+	if(storePath.empty())
+		return false;
+
+	FILE * file = fopen(storePath.c_str(), "rb");
+
+	if(!file)
+	{
+		ALOGI("No almanac store %s: %s", storePath.c_str(), strerror(errno));
+		return false;
+	}
+
+	char magic[sizeof(storeMagic)];
+	uint8_t version = 0, hasPosition = 0, count = 0;
+	double latitude = 0., longitude = 0., altitude = 0.;
+	uint64_t refreshed = 0;
+
+	bool ok =
+		fread(magic, sizeof(magic), 1, file) == 1 &&
+		std::equal(magic, magic + sizeof(magic), storeMagic) &&
+		fread(&version, sizeof(version), 1, file) == 1 && version == storeVersion &&
+		fread(&hasPosition, sizeof(hasPosition), 1, file) == 1 &&
+		fread(&latitude, sizeof(latitude), 1, file) == 1 &&
+		fread(&longitude, sizeof(longitude), 1, file) == 1 &&
+		fread(&altitude, sizeof(altitude), 1, file) == 1 &&
+		fread(&refreshed, sizeof(refreshed), 1, file) == 1 &&
+		fread(&count, sizeof(count), 1, file) == 1;
+
+	std::map<uint8_t, model::GpsAlmanac> loaded;
+
+	for(unsigned int i = 0; ok && i < count; i++)
+	{
+		model::GpsAlmanac alm;
+		ok = fread(alm.raw, sizeof(alm.raw), 1, file) == 1;
+
+		if(ok)
+			loaded[alm.d.satid] = alm;
+	}
+
+	fclose(file);
+
+	if(!ok)
+	{
+		ALOGW("Invalid almanac store %s, ignored", storePath.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	almanacs = std::move(loaded);
+	refreshedAt = refreshed;
+
+	if(hasPosition)
+	{
+		Location loc;
+		loc.location(latitude, longitude);
+		loc.altitude(altitude);
+		lastPosition = loc;
+	}
+
+	ALOGI("Loaded %zu almanacs from %s", almanacs.size(), storePath.c_str());
+	return true;
+}
+
+void SkyPredictor::save()
+{
+	if(storePath.empty())
+		return;
+
+	std::string tmpPath = storePath + ".tmp";
+	FILE * file = fopen(tmpPath.c_str(), "wb");
+
+	if(!file)
+	{
+		ALOGW("Unable to create almanac store %s: %s", tmpPath.c_str(), strerror(errno));
+		return;
+	}
+
+	uint8_t version = storeVersion;
+	uint8_t hasPosition = lastPosition ? 1 : 0;
+	uint8_t count = static_cast<uint8_t>(almanacs.size());
+	double latitude = lastPosition ? lastPosition->latitude() : 0.;
+	double longitude = lastPosition ? lastPosition->longitude() : 0.;
+	double altitude = lastPosition ? lastPosition->altitude() : 0.;
+	uint64_t refreshed = refreshedAt;
+
+	bool ok =
+		fwrite(storeMagic, sizeof(storeMagic), 1, file) == 1 &&
+		fwrite(&version, sizeof(version), 1, file) == 1 &&
+		fwrite(&hasPosition, sizeof(hasPosition), 1, file) == 1 &&
+		fwrite(&latitude, sizeof(latitude), 1, file) == 1 &&
+		fwrite(&longitude, sizeof(longitude), 1, file) == 1 &&
+		fwrite(&altitude, sizeof(altitude), 1, file) == 1 &&
+		fwrite(&refreshed, sizeof(refreshed), 1, file) == 1 &&
+		fwrite(&count, sizeof(count), 1, file) == 1;
+
+	for(const auto & it : almanacs)
+		ok = ok && fwrite(it.second.raw, sizeof(it.second.raw), 1, file) == 1;
+
+	ok = fclose(file) == 0 && ok;
+
+	if(ok && rename(tmpPath.c_str(), storePath.c_str()) == 0)
+	{
+		dirty = false;
+	}
+	else
+	{
+		ALOGW("Unable to write almanac store %s: %s", storePath.c_str(), strerror(errno));
+		unlink(tmpPath.c_str());
+	}
+}
+
+std::vector<PredictedSatellite> SkyPredictor::predict(
+	const std::map<uint8_t, model::GpsAlmanac> & almanacs,
+	const Location & position,
+	GpsUtcTime utc,
+	float elevationMask)
+{
+	std::vector<PredictedSatellite> visible;
+
+	const double lat = position.latitude() / degrees;
+	const double lon = position.longitude() / degrees;
+	const Ecef observer = Ecef::fromWgs84(position.latitude(), position.longitude(), position.altitude());
+	const double t = utils::utc_timestamp_to_gps_timestamp(utc) / 1000. + gpsLeapSeconds;
+
+	for(const auto & it : almanacs)
+	{
+		auto orbit = AlmanacOrbit::from(it.second);
+
+		if(!orbit)
+			continue;
+
+		Ecef d = orbit->position(t) - observer;
+		double range = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+
+		// Local east, north, up
+		double east = -std::sin(lon) * d.x + std::cos(lon) * d.y;
+		double north = -std::sin(lat) * std::cos(lon) * d.x - std::sin(lat) * std::sin(lon) * d.y + std::cos(lat) * d.z;
+		double up = std::cos(lat) * std::cos(lon) * d.x + std::cos(lat) * std::sin(lon) * d.y + std::sin(lat) * d.z;
+
+		double elevation = std::asin(up / range) * degrees;
+
+		if(elevation < elevationMask)
+			continue;
+
+		double azimuth = std::atan2(east, north) * degrees;
+		if(azimuth < 0.)
+			azimuth += 360.;
+
+		// Range rate from the satellite velocity, the observer is static in the earth frame
+		Ecef v = orbit->position(t + .5) - orbit->position(t - .5);
+		double rangeRate = (v.x * d.x + v.y * d.y + v.z * d.z) / range;
+
+		visible.push_back(PredictedSatellite{
+			orbit->prn,
+			static_cast<float>(elevation),
+			static_cast<float>(azimuth),
+			static_cast<float>(-rangeRate * l1Frequency / speedOfLight)
+		});
+	}
+
+	std::sort(visible.begin(), visible.end(), [] (const PredictedSatellite & a, const PredictedSatellite & b) {
+		return a.elevation > b.elevation;
+	});
+
+	return visible;
+}
+
+std::vector<PredictedSatellite> SkyPredictor::predictNow() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(!lastPosition || almanacs.empty())
+		return std::vector<PredictedSatellite>();
+
+	return predict(almanacs, *lastPosition, clock(), elevationMask);
+}
+
+std::map<SatIdentifier, SatInfo> SkyPredictor::toSatelliteList(const std::vector<PredictedSatellite> & prediction)
+{
+	std::map<SatIdentifier, SatInfo> satellites;
+
+	for(const auto & p : prediction)
+	{
+		SatIdentifier id(p.prn);
+		satellites.emplace(id, SatInfo(id, p.elevation, p.azimuth, 0.f, false, false, true, false));
+	}
+
+	return satellites;
+}
+
+std::vector<PredictedSatellite> SkyPredictor::lastPrediction() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return prediction;
+}
+
+std::size_t SkyPredictor::almanacCount() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return almanacs.size();
+}
+
+void SkyPredictor::setClock(std::function<GpsUtcTime()> clock)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->clock = clock;
+}
+
+void SkyPredictor::onAlmanac(const model::GpsAlmanac & almanac)
+{
+	if(almanac.d.satid == 0)
+		return;
+
+	const uint8_t prn = almanac.d.satid;
+
+	if(almanac.d.available)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		almanacs[prn] = almanac;
+		refreshedAt = clock();
+		dirty = true;
+		return;
+	}
+
+	// The receiver lacks this almanac, the stored one is injected if the satellite is predicted
+	model::GpsAlmanac stored;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = almanacs.find(prn);
+
+		if(!seeding || it == almanacs.end() ||
+			std::none_of(prediction.begin(), prediction.end(), [prn] (const PredictedSatellite & p) { return p.prn == prn; }))
+			return;
+
+		stored = it->second;
+	}
+
+	ALOGI("Receiver lacks the almanac of predicted PRN %u, inject it", prn);
+
+	ByteVector data;
+	data << stored;
+
+	sendMessageRequest(model::Message{
+		model::MessageId::Stagps_RealTime_Almanac,
+		{
+			utils::createFromString(std::to_string(prn)),
+			utils::createFromString(std::to_string(data.size())),
+			utils::to_ascii(data, true)
+		}
+	});
+}
+
+void SkyPredictor::onLocation(const Location & loc)
+{
+	if(!loc.locationValidity())
+		return;
+
+	bool dump = false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		lastPosition = loc;
+		dirty = true;
+
+		if(!dumpRequested && (almanacs.empty() || clock() - refreshedAt > refreshPeriod))
+		{
+			dumpRequested = true;
+			dump = true;
+		}
+	}
+
+	if(dump)
+	{
+		ALOGI("Request the receiver almanacs");
+		sendMessageRequest(model::Message{model::MessageId::DumpAlmanac, {}});
+	}
+}
+
+int SkyPredictor::onInjectLocation(double latitude, double longitude, float accuracy)
+{
+	(void)(accuracy);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// A fix of the receiver is more accurate
+	if(lastPosition && lastPosition->quality() != FixQuality::Invalid)
+		return 0;
+
+	Location loc;
+	loc.location(latitude, longitude);
+	loc.altitude(0.);
+	lastPosition = loc;
+
+	return 0;
+}
+
+int SkyPredictor::onStart()
+{
+	std::vector<PredictedSatellite> predicted = predictNow();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		prediction = predicted;
+
+		// The dump tells which almanacs the receiver lacks and refreshes the others, it replaces
+		// the dump after the first fix
+		seeding = !predicted.empty();
+		dumpRequested = seeding;
+	}
+
+	if(predicted.empty())
+	{
+		ALOGI("No sky prediction, position or almanacs missing");
+		return 0;
+	}
+
+	ALOGI("%zu satellites predicted above %.0f degrees", predicted.size(), elevationMask);
+
+	for(const auto & p : predicted)
+	{
+		ALOGD("Predicted PRN %u: elevation %.1f, azimuth %.1f, Doppler %.0f Hz",
+			p.prn, p.elevation, p.azimuth, p.doppler);
+	}
+
+	expectedSatellites(toSatelliteList(predicted));
+
+	sendMessageRequest(model::Message{model::MessageId::DumpAlmanac, {}});
+
+	return 0;
+}
+
+int SkyPredictor::onStop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	seeding = false;
+
+	if(dirty)
+		save();
+
+	return 0;
+}
+
+} // namespace device
+} // namespace stm
@@ -36,19 +36,22 @@ LOCAL_SHARED_LIBRARIES := \
 	libcutils             \
 	libsysutils           \
 	libhardware           \
+	libteseo.utils        \
 	libteseo.model        \
 	libteseo.vendor
 
 LOCAL_SRC_FILES :=   \
 	src/Geofence.cpp \
 	src/manager.cpp  \
-	src/model.cpp
+	src/model.cpp    \
+	src/schedule.cpp
 
 LOCAL_COPY_HEADERS_TO := teseo/geofencing/
 LOCAL_COPY_HEADERS :=                   \
 	include/teseo/geofencing/Geofence.h \
 	include/teseo/geofencing/manager.h  \
-	include/teseo/geofencing/model.h
+	include/teseo/geofencing/model.h    \
+	include/teseo/geofencing/schedule.h
 	
 
 LOCAL_PRELINK_MODULE := false
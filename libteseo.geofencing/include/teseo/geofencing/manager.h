@@ -26,24 +26,45 @@
 #include <memory>
 #include <algorithm> //std::count_if
 #include <forward_list>
+#include <functional>
+#include <mutex>
 
 #include <teseo/geofencing/model.h>
 #include <teseo/geofencing/Geofence.h>
+#include <teseo/geofencing/schedule.h>
 #include <teseo/utils/Signal.h>
 
 namespace stm {
 namespace geofencing {
 
+/**
+ * @brief Geofencing manager
+ *
+ * @details Geofences are evaluated on the host for every location update. Geofences with a
+ * schedule are only evaluated inside their activity windows and removed when they expire, the
+ * inactive ones cost nothing on location updates.
+ */
 class GeofencingManager:public Trackable {
 private:
 
     std::unordered_map<model::GeofenceId, std::unique_ptr<Geofence>> geofences;
 
+    // Geofences inside their activity windows, the only ones evaluated
+    std::unordered_map<model::GeofenceId, Geofence *> activeGeofences;
+
+    GeofenceScheduler scheduler;
+
+    std::function<model::time_point()> clock;
+
     // Last location
     Location m_lastLocation;
 
+    std::recursive_mutex mutex;
+
 public:
 
+    GeofencingManager();
+
     /**
      * Initialize the geofencing manager
      */
@@ -86,6 +107,32 @@ public:
      */
     void onDeviceStatusUpdate(GpsStatusValue deviceStatus);
 
+    /**
+     * @brief Number of geofences inside their activity windows
+     */
+    std::size_t activeGeofenceCount();
+
+    /**
+     * @brief Apply the schedule edges reached at the given time
+     * @param now Current time
+     */
+    void advanceSchedule(model::time_point now);
+
+    /**
+     * @brief Time of the next schedule edge, empty when no geofence is scheduled
+     */
+    std::optional<model::time_point> nextScheduleEdge();
+
+    /**
+     * @brief Current time of the clock geofences are scheduled from
+     */
+    model::time_point now();
+
+    /**
+     * @brief Set the clock giving the time geofences are scheduled from, the system clock by default
+     */
+    void setClock(std::function<model::time_point()> clock);
+
     Signal<void, model::SystemStatus, const Location &> sendGeofenceStatus;
 
     Signal<void, model::GeofenceId, const Location &, model::Transition, GpsUtcTime> sendGeofenceTransition;
@@ -98,6 +145,16 @@ public:
 
     Signal<void, model::GeofenceId, model::OperationStatus> answerGeofenceResumeRequest;
 
+    /**
+     * The next schedule edge may have changed
+     */
+    Signal<void> scheduleChanged;
+
+    /**
+     * A geofence expired and was removed
+     */
+    Signal<void, model::GeofenceId> geofenceExpired;
+
     ~GeofencingManager();   
     
 };
@@ -23,8 +23,11 @@
 #define TESEO_HAL_GEOFENCING_MODEL_H
 
 #include <chrono>
+#include <vector>
 #include <hardware/gps.h>
 
+#include <teseo/utils/optional.h>
+
 #include <teseo/model/Location.h>
 #include <teseo/model/Coordinate.h>
 
@@ -106,6 +109,30 @@ private:
     std::pair<double, double> to_rad() const;
 };
 
+using Clock = std::chrono::system_clock;
+using time_point = Clock::time_point;
+
+/**
+ * Recurring activity window
+ *
+ * @details The window is open from start to start + duration, then again every period. start is
+ * counted from the UTC epoch, a daily window from 08:00 to 18:00 UTC is {8h, 10h, 24h}. A zero
+ * period opens the window only once.
+ */
+struct ActivityWindow {
+    std::chrono::seconds start;
+    std::chrono::seconds duration;
+    std::chrono::seconds period;
+};
+
+/**
+ * When a geofence is evaluated
+ */
+struct GeofenceSchedule {
+    std::optional<time_point> expiry;   ///< The geofence is removed at this time, never if empty
+    std::vector<ActivityWindow> windows; ///< Active inside any of these windows, always if empty
+};
+
 /**
  * Geofence definition
  */
@@ -117,6 +144,7 @@ struct GeofenceDefinition {
     TransitionFlags monitor_transitions;
     std::chrono::milliseconds notifications_responsiveness;
     std::chrono::milliseconds unknown_time;
+    GeofenceSchedule schedule;
 };
 
 /**
@@ -0,0 +1,184 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Geofence activity schedule
+ * @file schedule.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_GEOFENCING_SCHEDULE_H
+#define TESEO_HAL_GEOFENCING_SCHEDULE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include <teseo/geofencing/model.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/utils/optional.h>
+
+namespace stm {
+namespace geofencing {
+
+class GeofencingManager;
+
+/**
+ * @brief Timer heap activating, deactivating and expiring the scheduled geofences
+ *
+ * @details Only the next edge of each geofence is in the heap, the following one is computed
+ * when it is reached. It doesn't lock, the time is given by the caller so it can be driven by a
+ * virtual clock.
+ */
+class GeofenceScheduler {
+public:
+    enum class Event {
+        Activated,
+        Deactivated,
+        Expired
+    };
+
+    struct Edge {
+        model::GeofenceId id;
+        Event event;
+    };
+
+private:
+    struct Entry {
+        model::time_point when;
+        model::GeofenceId id;
+        uint64_t generation;
+
+        bool operator>(const Entry & other) const { return when > other.when; }
+    };
+
+    struct Scheduled {
+        model::GeofenceSchedule schedule;
+        uint64_t generation;
+        bool active;
+    };
+
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+
+    std::unordered_map<model::GeofenceId, Scheduled> geofences;
+
+    uint64_t generation;
+
+    void push(model::GeofenceId id, Scheduled & s, model::time_point now);
+
+    /**
+     * Remove the entries of removed or rescheduled geofences from the top of the heap
+     */
+    void dropStale();
+
+public:
+    GeofenceScheduler();
+
+    /**
+     * @brief Schedule a geofence
+     * @param id Geofence identifier
+     * @param schedule Expiry and activity windows
+     * @param now Current time
+     * @return True if the geofence is active now
+     */
+    bool add(model::GeofenceId id, const model::GeofenceSchedule & schedule, model::time_point now);
+
+    /**
+     * @brief Stop scheduling a geofence
+     */
+    void remove(model::GeofenceId id);
+
+    /**
+     * @brief Get the edges reached at the given time, oldest first
+     * @details An expired geofence is not scheduled anymore.
+     */
+    std::vector<Edge> advance(model::time_point now);
+
+    /**
+     * @brief Time of the next edge, empty when no edge is scheduled
+     */
+    std::optional<model::time_point> nextEdge();
+
+    /**
+     * @brief Number of edges in the heap, including the stale ones
+     */
+    std::size_t pending() const { return heap.size(); }
+
+    /**
+     * @brief Check if a time is inside the activity windows of a schedule
+     */
+    static bool isActive(const model::GeofenceSchedule & schedule, model::time_point t);
+
+    /**
+     * @brief Time of the next activity change of a schedule after t, expiry excluded
+     */
+    static std::optional<model::time_point> nextChange(const model::GeofenceSchedule & schedule, model::time_point t);
+};
+
+/**
+ * @brief Geofence timer thread
+ *
+ * @details Sleeps until the next edge of the manager schedule and applies it, against the system
+ * clock.
+ */
+class GeofenceTimer :
+    public Trackable,
+    public Thread
+{
+private:
+    GeofencingManager & manager;
+
+    std::mutex mutex;
+
+    std::condition_variable cond;
+
+    bool runTimer;
+
+    bool changed;
+
+protected:
+    virtual void run();
+
+public:
+    GeofenceTimer(GeofencingManager & manager);
+
+    virtual ~GeofenceTimer();
+
+    /**
+     * @brief Start the timer thread
+     */
+    int start();
+
+    /**
+     * @brief Schedule change slot, the next edge is computed again
+     */
+    void onScheduleChanged();
+
+    virtual int stop();
+};
+
+} // namespace geofencing
+} // namespace stm
+
+#endif // TESEO_HAL_GEOFENCING_SCHEDULE_H
@@ -35,14 +35,24 @@ using namespace stm::geofencing::model;
 namespace stm {
 namespace geofencing {
 
+GeofencingManager::GeofencingManager() :
+    clock(&Clock::now),
+    scheduleChanged("GeofencingManager::scheduleChanged"),
+    geofenceExpired("GeofencingManager::geofenceExpired")
+{ }
+
 void GeofencingManager::initialize()
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     ALOGI("GeofencingManager init");
 }
 
 //void GeofencingManager::add(GeofenceDefinition && def)
 void GeofencingManager::add(GeofenceDefinition def)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     GeofenceId id = def.id;
 
     auto it = this->geofences.find(id);
@@ -60,14 +70,24 @@ void GeofencingManager::add(GeofenceDefinition def)
     }
     
     try {
+        const GeofenceSchedule schedule = def.schedule;
+        const bool scheduled = schedule.expiry || !schedule.windows.empty();
+
         auto geofence_ptr = std::make_unique<Geofence>(std::move(def),this);
+        Geofence * geofence = geofence_ptr.get();
         this->geofences.insert(std::make_pair(id, std::move(geofence_ptr)));
 
-        ALOGI("Geofence #%d added, now tracking %d geofences", id, (int)std::count_if(geofences.begin(), geofences.end(), [](auto & p) {
+        if(scheduler.add(id, schedule, clock()))
+            activeGeofences.emplace(id, geofence);
+
+        ALOGI("Geofence #%d added, now tracking %d geofences", id, (int)std::count_if(activeGeofences.begin(), activeGeofences.end(), [](auto & p) {
             return p.second->trackingStatus() == Geofence::TrackingStatus::Tracking;
         }));
 
         this->answerGeofenceAddRequest(id, OperationStatus::Success);
+
+        if(scheduled)
+            scheduleChanged();
     } catch(const std::exception & e) {
         ALOGE("Exception while adding geofence %d: %s", id, e.what());
         this->answerGeofenceAddRequest(id, OperationStatus::Error_Generic);
@@ -76,10 +96,14 @@ void GeofencingManager::add(GeofenceDefinition def)
 
 void GeofencingManager::remove(GeofenceId id)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     auto iterator = this->geofences.find(id);
     if(iterator != this->geofences.end()) {
         // Maybe we don't need the removing tracking status
         iterator->second->setTrackingStatus(Geofence::TrackingStatus::Removing);
+        scheduler.remove(id);
+        activeGeofences.erase(id);
         iterator->second.reset();
         this->geofences.erase(iterator);
         ALOGI("Geofence #%d removed.", id);
@@ -92,6 +116,8 @@ void GeofencingManager::remove(GeofenceId id)
 
 void GeofencingManager::pause(GeofenceId id)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     auto iterator = this->geofences.find(id);
     if(iterator != this->geofences.end()) {
         iterator->second->setTrackingStatus(Geofence::TrackingStatus::Paused);
@@ -105,6 +131,8 @@ void GeofencingManager::pause(GeofenceId id)
 
 void GeofencingManager::resume(GeofenceId id, TransitionFlags monitored_transitions)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     auto iterator = this->geofences.find(id);
     if(iterator != this->geofences.end()) {
         iterator->second->setMonitoredTransition(monitored_transitions);
@@ -119,11 +147,13 @@ void GeofencingManager::resume(GeofenceId id, TransitionFlags monitored_transiti
 
 void GeofencingManager::onLocationUpdate(const Location & loc)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     ALOGI("onLocationUpdate");
 
     m_lastLocation = loc;
 
-    for(auto & pair : geofences)
+    for(auto & pair : activeGeofences)
     {
         auto & geofence_ptr = pair.second;
         geofence_ptr->updateStatusFromLocation(loc);
@@ -132,6 +162,8 @@ void GeofencingManager::onLocationUpdate(const Location & loc)
 
 void GeofencingManager::onDeviceStatusUpdate(GpsStatusValue deviceStatus)
 {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
     /*
      The current HAL doesn't give ENGINE_ON and ENGINE_OFF status which should be used for that purpose
      When they will be available this function should not depend on the SESSION_{BEGIN,END} statuses.
@@ -152,6 +184,73 @@ void GeofencingManager::onDeviceStatusUpdate(GpsStatusValue deviceStatus)
     }
 }
 
+std::size_t GeofencingManager::activeGeofenceCount()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    return activeGeofences.size();
+}
+
+void GeofencingManager::advanceSchedule(time_point now)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    std::vector<GeofenceScheduler::Edge> edges = scheduler.advance(now);
+
+    if(edges.empty())
+        return;
+
+    for(const auto & edge : edges)
+    {
+        auto it = geofences.find(edge.id);
+
+        if(it == geofences.end())
+            continue;
+
+        switch(edge.event)
+        {
+            case GeofenceScheduler::Event::Activated:
+                ALOGI("Geofence #%d activated", edge.id);
+                activeGeofences.emplace(edge.id, it->second.get());
+                break;
+
+            case GeofenceScheduler::Event::Deactivated:
+                ALOGI("Geofence #%d deactivated", edge.id);
+                activeGeofences.erase(edge.id);
+                break;
+
+            case GeofenceScheduler::Event::Expired:
+                ALOGI("Geofence #%d expired, removed", edge.id);
+                activeGeofences.erase(edge.id);
+                it->second->setTrackingStatus(Geofence::TrackingStatus::Removing);
+                geofences.erase(it);
+                geofenceExpired(edge.id);
+                break;
+        }
+    }
+}
+
+std::optional<time_point> GeofencingManager::nextScheduleEdge()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    return scheduler.nextEdge();
+}
+
+time_point GeofencingManager::now()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    return clock();
+}
+
+void GeofencingManager::setClock(std::function<time_point()> clock)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    this->clock = clock;
+}
+
 GeofencingManager::~GeofencingManager(){
 
     //delete m_lastLocation_ptr;
@@ -43,8 +43,8 @@ double degree_to_rad(double d)
 bool transitionFlagsIsValid(TransitionFlags flags)
 {
     constexpr TransitionFlags ALL_FLAGS_INVERTED = ~(
-        static_cast<int32_t>(Transition::Entered) &
-        static_cast<int32_t>(Transition::Exited)  &
+        static_cast<int32_t>(Transition::Entered) |
+        static_cast<int32_t>(Transition::Exited)  |
         static_cast<int32_t>(Transition::Uncertain));
 
     // force all valid values in flags to zero
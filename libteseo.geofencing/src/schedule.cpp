@@ -0,0 +1,302 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Geofence activity schedule
+ * @file schedule.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/geofencing/schedule.h>
+
+#define LOG_TAG "teseo_hal_GeofenceSchedule"
+#include <cutils/log.h>
+
+#include <teseo/geofencing/manager.h>
+
+using namespace stm::geofencing::model;
+
+namespace stm {
+namespace geofencing {
+
+namespace {
+
+Clock::duration floorMod(Clock::duration a, Clock::duration b)
+{
+    auto r = a % b;
+    return r < Clock::duration::zero() ? r + b : r;
+}
+
+} // namespace
+
+GeofenceScheduler::GeofenceScheduler() :
+    generation(0)
+{ }
+
+bool GeofenceScheduler::isActive(const GeofenceSchedule & schedule, time_point t)
+{
+    if(schedule.windows.empty())
+        return true;
+
+    const Clock::duration since = t.time_since_epoch();
+
+    for(const auto & w : schedule.windows)
+    {
+        const Clock::duration start = w.start;
+        const Clock::duration duration = w.duration;
+        const Clock::duration period = w.period;
+
+        if(duration <= Clock::duration::zero())
+            continue;
+
+        // One-shot window
+        if(period <= Clock::duration::zero())
+        {
+            if(since >= start && since < start + duration)
+                return true;
+            continue;
+        }
+
+        if(duration >= period || floorMod(since - start, period) < duration)
+            return true;
+    }
+
+    return false;
+}
+
+std::optional<time_point> GeofenceScheduler::nextChange(const GeofenceSchedule & schedule, time_point t)
+{
+    std::optional<time_point> next;
+    const Clock::duration since = t.time_since_epoch();
+
+    auto keep = [&next] (time_point c) {
+        if(!next || c < *next)
+            next = c;
+    };
+
+    for(const auto & w : schedule.windows)
+    {
+        const Clock::duration start = w.start;
+        const Clock::duration duration = w.duration;
+        const Clock::duration period = w.period;
+
+        // Never or always open
+        if(duration <= Clock::duration::zero())
+            continue;
+
+        if(period <= Clock::duration::zero())
+        {
+            if(since < start)
+                keep(t + (start - since));
+            else if(since < start + duration)
+                keep(t + (start + duration - since));
+            continue;
+        }
+
+        if(duration >= period)
+            continue;
+
+        const Clock::duration phase = floorMod(since - start, period);
+        keep(t + (phase < duration ? duration - phase : period - phase));
+    }
+
+    return next;
+}
+
+void GeofenceScheduler::push(GeofenceId id, Scheduled & s, time_point now)
+{
+    std::optional<time_point> next = nextChange(s.schedule, now);
+
+    if(s.schedule.expiry && (!next || *s.schedule.expiry <= *next))
+        next = s.schedule.expiry;
+
+    if(next)
+        heap.push(Entry{*next, id, s.generation});
+}
+
+bool GeofenceScheduler::add(GeofenceId id, const GeofenceSchedule & schedule, time_point now)
+{
+    remove(id);
+
+    const bool expired = schedule.expiry && *schedule.expiry <= now;
+    const bool active = !expired && isActive(schedule, now);
+
+    // Unscheduled geofences are always active, nothing to track
+    if(!schedule.expiry && schedule.windows.empty())
+        return true;
+
+    Scheduled & s = geofences[id];
+    s.schedule = schedule;
+    s.generation = ++generation;
+    s.active = active;
+
+    // An expired geofence is reported by the next advance
+    if(expired)
+        heap.push(Entry{*schedule.expiry, id, s.generation});
+    else
+        push(id, s, now);
+
+    return active;
+}
+
+void GeofenceScheduler::remove(GeofenceId id)
+{
+    // Its heap entries are dropped when they reach the top
+    geofences.erase(id);
+}
+
+void GeofenceScheduler::dropStale()
+{
+    while(!heap.empty())
+    {
+        auto it = geofences.find(heap.top().id);
+
+        if(it != geofences.end() && it->second.generation == heap.top().generation)
+            break;
+
+        heap.pop();
+    }
+}
+
+std::vector<GeofenceScheduler::Edge> GeofenceScheduler::advance(time_point now)
+{
+    std::vector<Edge> edges;
+
+    while(true)
+    {
+        dropStale();
+
+        if(heap.empty() || heap.top().when > now)
+            break;
+
+        const Entry e = heap.top();
+        heap.pop();
+
+        auto it = geofences.find(e.id);
+        Scheduled & s = it->second;
+
+        if(s.schedule.expiry && *s.schedule.expiry <= e.when)
+        {
+            edges.push_back(Edge{e.id, Event::Expired});
+            geofences.erase(it);
+            continue;
+        }
+
+        // Edges are applied at their own time, so a late call still reports them in order
+        const bool active = isActive(s.schedule, e.when);
+
+        if(active != s.active)
+        {
+            s.active = active;
+            edges.push_back(Edge{e.id, active ? Event::Activated : Event::Deactivated});
+        }
+
+        push(e.id, s, e.when);
+    }
+
+    return edges;
+}
+
+std::optional<time_point> GeofenceScheduler::nextEdge()
+{
+    dropStale();
+
+    if(heap.empty())
+        return {};
+
+    return heap.top().when;
+}
+
+GeofenceTimer::GeofenceTimer(GeofencingManager & manager) :
+    Trackable(),
+    Thread("teseo-geofence-timer"),
+    manager(manager),
+    runTimer(false),
+    changed(false)
+{ }
+
+GeofenceTimer::~GeofenceTimer()
+{ }
+
+void GeofenceTimer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    ALOGI("Start geofence timer");
+
+    while(runTimer)
+    {
+        changed = false;
+
+        // The manager signals schedule changes while locked, don't call it with the mutex held
+        lock.unlock();
+        const time_point now = manager.now();
+        manager.advanceSchedule(now);
+        std::optional<time_point> wakeup = manager.nextScheduleEdge();
+        lock.lock();
+
+        auto pred = [this] () { return !runTimer || changed; };
+
+        // Edges are on the manager clock, only the remaining delay is waited for
+        if(wakeup)
+            cond.wait_for(lock, *wakeup - now, pred);
+        else
+            cond.wait(lock, pred);
+    }
+
+    ALOGI("Stop geofence timer");
+}
+
+int GeofenceTimer::start()
+{
+    // Set before the thread exists, so a stop request can't be overwritten by the thread
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        runTimer = true;
+        changed = false;
+    }
+
+    return Thread::start();
+}
+
+void GeofenceTimer::onScheduleChanged()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed = true;
+    }
+
+    cond.notify_all();
+}
+
+int GeofenceTimer::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        runTimer = false;
+    }
+
+    cond.notify_all();
+    return 0;
+}
+
+} // namespace geofencing
+} // namespace stm
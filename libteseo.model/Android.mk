@@ -55,6 +55,7 @@ LOCAL_COPY_HEADERS :=                          \
 	include/teseo/model/Almanac.h              \
 	include/teseo/model/Constellations.h       \
 	include/teseo/model/Coordinate.h           \
+	include/teseo/model/Datalog.h              \
 	include/teseo/model/Ephemeris.h            \
 	include/teseo/model/FixAndOperatingModes.h \
 	include/teseo/model/FixQuality.h           \
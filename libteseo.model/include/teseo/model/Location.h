@@ -78,6 +78,11 @@ private:
 
 	bool hasAccuracy;
 
+	/** Position dilution of precision of the fix. */
+	float _pdop;
+
+	bool hasPdop;
+
     /** Timestamp for the location fix. */
     GpsUtcTime      _timestamp;
 
@@ -109,6 +114,11 @@ public:
 	 */
 	bool accuracyValidity() const;
 
+	/**
+	 * @brief      Get PDOP validity
+	 */
+	bool pdopValidity() const;
+
 	/**
 	 * @brief      Invalidate all location data
 	 */
@@ -139,6 +149,11 @@ public:
 	 */
 	void invalidateAccuracy();
 
+	/**
+	 * @brief      Invalidate PDOP
+	 */
+	void invalidatePdop();
+
 	/**
 	 * @brief      Get the fix quality
 	 */
@@ -184,6 +199,11 @@ public:
 	 */
 	float accuracy() const;
 
+	/**
+	 * @brief      Get PDOP value
+	 */
+	float pdop() const;
+
 	/**
 	 * @brief      Get timestamp value
 	 */
@@ -224,6 +244,11 @@ public:
 	 */
 	float accuracy(float value);
 
+	/**
+	 * @brief      Set and get PDOP value
+	 */
+	float pdop(float value);
+
 	/**
 	 * @brief      Set and get timestamp value
 	 */
@@ -82,6 +82,53 @@ enum class MessageId {
 	 */
 	Stagps_PGPS7_Seed,
 
+	/**
+	 * Set the constellations used by the receiver
+	 * Parameters:
+	 * - Constellation mask
+	 */
+	SetConstellationMask,
+
+	/**
+	 * Create the receiver datalog
+	 * Parameters:
+	 * - Configuration, bit 0 enables the circular buffer
+	 * - Minimum time between two entries, in seconds
+	 * - Minimum speed, in km/h
+	 * - Minimum distance between two entries, in meters
+	 * - Entry type
+	 */
+	Datalog_Create,
+
+	/**
+	 * Start logging fixes in the receiver datalog
+	 */
+	Datalog_Start,
+
+	/**
+	 * Stop logging fixes in the receiver datalog
+	 */
+	Datalog_Stop,
+
+	/**
+	 * Erase the receiver datalog
+	 */
+	Datalog_Erase,
+
+	/**
+	 * Read entries from the receiver datalog
+	 * Parameters:
+	 * - Query type
+	 * - First entry
+	 * - Number of entries, 0 for all
+	 */
+	Datalog_Query,
+
+	/**
+	 * Request the receiver almanacs, answered with one PSTMALMANAC per satellite
+	 */
+	DumpAlmanac,
+
 };
 
 struct Message {
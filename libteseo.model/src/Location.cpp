@@ -84,6 +84,11 @@ float Location::accuracy() const
 	return _accuracy;
 }
 
+float Location::pdop() const
+{
+	return _pdop;
+}
+
 GpsUtcTime Location::timestamp() const
 {
 	return _timestamp;
@@ -137,6 +142,13 @@ float Location::accuracy(float value)
 	return _accuracy;
 }
 
+float Location::pdop(float value)
+{
+	hasPdop = true;
+	_pdop = value;
+	return _pdop;
+}
+
 GpsUtcTime Location::timestamp(GpsUtcTime value)
 {
 	_timestamp = value;
@@ -196,6 +208,11 @@ bool Location::accuracyValidity() const
 	return hasAccuracy;
 }
 
+bool Location::pdopValidity() const
+{
+	return hasPdop;
+}
+
 void Location::invalidateLocation()
 {
 	hasLatLong = false;
@@ -221,6 +238,11 @@ void Location::invalidateAccuracy()
 	hasAccuracy = false;
 }
 
+void Location::invalidatePdop()
+{
+	hasPdop = false;
+}
+
 void Location::invalidateAll()
 {
 	hasLatLong  = false;
@@ -228,6 +250,7 @@ void Location::invalidateAll()
 	hasSpeed    = false;
 	hasBearing  = false;
 	hasAccuracy = false;
+	hasPdop     = false;
 }
 
 } // namespace stm
\ No newline at end of file
@@ -28,6 +28,8 @@
 #ifndef TESEO_HAL_DECODER_ABSTRACT_DECODER_H
 #define TESEO_HAL_DECODER_ABSTRACT_DECODER_H
 
+#include <mutex>
+
 #include <teseo/utils/ByteVector.h>
 #include <teseo/utils/Thread.h>
 #include <teseo/utils/Channel.h>
@@ -51,6 +53,10 @@ private:
 
 	bool stopDecoder;
 
+	bool decoding; ///< True until the decoding loop has seen the stop request
+
+	std::mutex decoderMutex;
+
 protected:
 	/**
 	 * @brief      Decoding task
@@ -78,6 +84,15 @@ public:
 	 */
 	virtual void onNewBytes(ByteVectorPtr bytes);
 
+	/**
+	 * @brief      Start the decoder thread
+	 *
+	 * @details    A decoder stopped but still waiting for bytes resumes instead of exiting.
+	 *
+	 * @return     0 when resumed, the Thread::start result otherwise
+	 */
+	int start();
+
 	/**
 	 * @brief      Stop the decoder thread
 	 *
@@ -43,6 +43,7 @@ AbstractDecoder::AbstractDecoder() :
 	bytesChannel("AbstractDecoder::bytesChannel")
 {
 	stopDecoder = false;
+	decoding = false;
 }
 
 AbstractDecoder::~AbstractDecoder()
@@ -53,13 +54,20 @@ void AbstractDecoder::run()
 	ByteVector * bytes = nullptr;
 	int errcount = 0;
 
-	stopDecoder = false;
-
 	ALOGI("Start decoder thread");
 	utils::Wakelock::acquire();
 
-	while(!stopDecoder)
+	while(true)
 	{
+		{
+			std::lock_guard<std::mutex> lock(decoderMutex);
+			if(stopDecoder)
+			{
+				decoding = false;
+				break;
+			}
+		}
+
 		try
 		{
 			bytes = bytesChannel.receive();
@@ -74,6 +82,7 @@ void AbstractDecoder::run()
 			if(errcount++ > 10)
 			{
 				ALOGE("Too much channel errors, stop decoding.");
+				std::lock_guard<std::mutex> lock(decoderMutex);
 				stopDecoder = true;
 			}
 		}
@@ -82,6 +91,7 @@ void AbstractDecoder::run()
 			if(errcount++ > 10)
 			{
 				ALOGE("Too much channel errors, stop decoding.");
+				std::lock_guard<std::mutex> lock(decoderMutex);
 				stopDecoder = true;
 			}
 		}
@@ -103,13 +113,41 @@ void AbstractDecoder::onNewBytes(ByteVectorPtr bytes)
 	}
 }
 
+int AbstractDecoder::start()
+{
+	{
+		std::lock_guard<std::mutex> lock(decoderMutex);
+		if(decoding)
+		{
+			ALOGI("Resume decoder thread");
+			stopDecoder = false;
+			return 0;
+		}
+	}
+
+	// The previous decoder is leaving run(), wait for its end
+	join();
+
+	// Set before the thread exists, so a stop request can't be overwritten by the thread
+	{
+		std::lock_guard<std::mutex> lock(decoderMutex);
+		stopDecoder = false;
+		decoding = true;
+	}
+
+	return Thread::start();
+}
+
 int AbstractDecoder::stop()
 {
 	if(isRunning())
 	{
 		ALOGI("Stop decoder thread");
 
-		stopDecoder = true;
+		{
+			std::lock_guard<std::mutex> lock(decoderMutex);
+			stopDecoder = true;
+		}
 
 		bytesChannel.send(nullptr);
 
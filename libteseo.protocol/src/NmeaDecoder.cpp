@@ -222,6 +222,9 @@ void NmeaDecoder::decode(ByteVectorPtr bytesPtr)
 	// 5. Log NMEA message
 	NMEA_DECODER_LOGI("NMEA: '%s'", msg.toCString());
 
+	// The epoch timer may publish the device data from its own thread
+	std::lock_guard<std::mutex> lock(device.dataMutex);
+
 	// 6. Trigger device update before eventually decoding start sequence sentence
 	device.updateIfStartSentenceId(msg.sentenceId);
 
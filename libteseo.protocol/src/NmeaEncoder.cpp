@@ -45,6 +45,20 @@ constexpr const auto stagps_realtime_ephemeris = BA("PSTMEPHEM");
 constexpr const auto stagps_realtime_almanac = BA("PSTMALMANAC");
 
 constexpr const auto stagps_pgps7_seed = BA("PSTMSTAGPSSATSEED");
+
+constexpr const auto set_constellation_mask = BA("PSTMSETCONSTMASK");
+
+constexpr const auto datalog_create = BA("PSTMLOGCREATE");
+
+constexpr const auto datalog_start = BA("PSTMLOGSTART");
+
+constexpr const auto datalog_stop = BA("PSTMLOGSTOP");
+
+constexpr const auto datalog_erase = BA("PSTMLOGERASE");
+
+constexpr const auto datalog_query = BA("PSTMLOGREQQUERY");
+
+constexpr const auto dump_almanac = BA("PSTMDUMPALMANAC");
 } // namespace messages
 
 template<std::size_t N>
@@ -183,6 +197,62 @@ ByteVectorPtr stagps_pgps7_seed(
 	return generic_encoder(messages::stagps_pgps7_seed, 7, parameters);
 }
 
+ByteVectorPtr set_constellation_mask(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode constellation mask message");
+	return generic_encoder(messages::set_constellation_mask, 1, parameters);
+}
+
+ByteVectorPtr datalog_create(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode datalog create message");
+	return generic_encoder(messages::datalog_create, 5, parameters);
+}
+
+ByteVectorPtr datalog_start(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode datalog start message");
+	return generic_encoder(messages::datalog_start, 0, parameters);
+}
+
+ByteVectorPtr datalog_stop(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode datalog stop message");
+	return generic_encoder(messages::datalog_stop, 0, parameters);
+}
+
+ByteVectorPtr datalog_erase(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode datalog erase message");
+	return generic_encoder(messages::datalog_erase, 0, parameters);
+}
+
+ByteVectorPtr datalog_query(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode datalog query message");
+	return generic_encoder(messages::datalog_query, 3, parameters);
+}
+
+ByteVectorPtr dump_almanac(
+	const device::AbstractDevice &,
+	const std::vector<ByteVector> & parameters)
+{
+	ALOGI("Encode almanac dump message");
+	return generic_encoder(messages::dump_almanac, 0, parameters);
+}
+
 
 } // namespace encoders
 
@@ -217,6 +287,34 @@ void NmeaEncoder::encode(
 			encodedBytes(encoders::stagps_pgps7_seed(device, message.parameters));
 			break;
 
+		case MessageId::SetConstellationMask:
+			encodedBytes(encoders::set_constellation_mask(device, message.parameters));
+			break;
+
+		case MessageId::Datalog_Create:
+			encodedBytes(encoders::datalog_create(device, message.parameters));
+			break;
+
+		case MessageId::Datalog_Start:
+			encodedBytes(encoders::datalog_start(device, message.parameters));
+			break;
+
+		case MessageId::Datalog_Stop:
+			encodedBytes(encoders::datalog_stop(device, message.parameters));
+			break;
+
+		case MessageId::Datalog_Erase:
+			encodedBytes(encoders::datalog_erase(device, message.parameters));
+			break;
+
+		case MessageId::Datalog_Query:
+			encodedBytes(encoders::datalog_query(device, message.parameters));
+			break;
+
+		case MessageId::DumpAlmanac:
+			encodedBytes(encoders::dump_almanac(device, message.parameters));
+			break;
+
 		default:
 			ALOGE("Message not supported by encoder.");
 			break;
@@ -59,6 +59,8 @@ using namespace frozen::string_literals;
 	#define MSG_DBG_STAGPS8PASSRTN
 	#define MSG_DBG_STAGPSPASSRTN
 	#define MSG_DBG_STAGPSSATSEEDRESP
+	//#define MSG_DBG_LOGQUERY
+	//#define MSG_DBG_ALMANAC
 #endif
 
 namespace stm {
@@ -79,7 +81,7 @@ constexpr static frozen::unordered_map<frozen::string, MessageDecoder, 4> std =
 	// Do not forget to update number of elements in map declaration
 };
 
-constexpr static frozen::unordered_map<frozen::string, MessageDecoder, 8> stm = {
+constexpr static frozen::unordered_map<frozen::string, MessageDecoder, 22> stm = {
 	{"SBAS"_s, &decoders::sbas},
 	{"VER"_s,  &decoders::pstmver},
 	{"STAGPS8PASSRTN"_s,  &decoders::pstmstagps8passrtn},
@@ -88,6 +90,20 @@ constexpr static frozen::unordered_map<frozen::string, MessageDecoder, 8> stm =
 	{"STAGPSPASSGENERROR"_s, &decoders::pstmstagpspassrtn},
 	{"STAGPSSATSEEDOK"_s, &decoders::pstmstagpssatseedresponse},
 	{"STAGPSSATSEEDERROR"_s, &decoders::pstmstagpssatseedresponse},
+	{"SETCONSTMASKOK"_s, &decoders::pstmsetconstmaskresponse},
+	{"SETCONSTMASKERROR"_s, &decoders::pstmsetconstmaskresponse},
+	{"LOGCREATEOK"_s, &decoders::pstmlogresponse},
+	{"LOGCREATEERROR"_s, &decoders::pstmlogresponse},
+	{"LOGSTARTOK"_s, &decoders::pstmlogresponse},
+	{"LOGSTARTERROR"_s, &decoders::pstmlogresponse},
+	{"LOGSTOPOK"_s, &decoders::pstmlogresponse},
+	{"LOGSTOPERROR"_s, &decoders::pstmlogresponse},
+	{"LOGERASEOK"_s, &decoders::pstmlogresponse},
+	{"LOGERASEERROR"_s, &decoders::pstmlogresponse},
+	{"LOGQUERYOK"_s, &decoders::pstmlogresponse},
+	{"LOGQUERYERROR"_s, &decoders::pstmlogresponse},
+	{"LOGQUERY"_s, &decoders::pstmlogquery},
+	{"ALMANAC"_s, &decoders::pstmalmanac},
 	// Do not forget to update number of elements in map declaration
 };
 
@@ -414,6 +430,17 @@ void decoders::gsa(AbstractDevice & dev, const NmeaMessage & msg)
 
 		++it;
 	}
+
+	// Update PDOP, empty when there is no fix
+	if(it < msg.parameters.end())
+	{
+		if(auto opt = utils::byteVectorParse<float>(*it))
+			loc.pdop(*opt);
+		else
+			loc.invalidatePdop();
+
+		dev.setLocation(loc);
+	}
 }
 
 #ifdef MSG_DBG_SBAS
@@ -567,6 +594,165 @@ void decoders::pstmstagpssatseedresponse(AbstractDevice &, const NmeaMessage & m
 	}
 }
 
+void decoders::pstmsetconstmaskresponse(AbstractDevice &, const NmeaMessage & msg)
+{
+	if(msg.sentenceId == utils::createFromString("SETCONSTMASKERROR"))
+	{
+		ALOGW("Device rejected constellation mask: %s", msg.toCString());
+	}
+	else
+	{
+		ALOGI("Device accepted constellation mask: %s", msg.toCString());
+	}
+}
+
+void decoders::pstmlogresponse(AbstractDevice & dev, const NmeaMessage & msg)
+{
+	static const std::map<std::string, DatalogAnswer> answers = {
+		{"LOGCREATEOK",    DatalogAnswer::CreateOk},
+		{"LOGCREATEERROR", DatalogAnswer::CreateError},
+		{"LOGSTARTOK",     DatalogAnswer::StartOk},
+		{"LOGSTARTERROR",  DatalogAnswer::StartError},
+		{"LOGSTOPOK",      DatalogAnswer::StopOk},
+		{"LOGSTOPERROR",   DatalogAnswer::StopError},
+		{"LOGERASEOK",     DatalogAnswer::EraseOk},
+		{"LOGERASEERROR",  DatalogAnswer::EraseError},
+		{"LOGQUERYOK",     DatalogAnswer::QueryOk},
+		{"LOGQUERYERROR",  DatalogAnswer::QueryError}
+	};
+
+	auto it = answers.find(bytesToString(msg.sentenceId));
+
+	if(it == answers.end())
+		return;
+
+	if(it->first.find("ERROR") != std::string::npos)
+		ALOGW("Device rejected datalog command: %s", msg.toCString());
+
+	dev.onDatalogAnswer(it->second);
+}
+
+#ifdef MSG_DBG_LOGQUERY
+#define LOGQUERY_LOGI(...) ALOGI(__VA_ARGS__)
+#define LOGQUERY_LOGW(...) ALOGW(__VA_ARGS__)
+#else
+#define LOGQUERY_LOGI(...)
+#define LOGQUERY_LOGW(...)
+#endif
+void decoders::pstmlogquery(AbstractDevice & dev, const NmeaMessage & msg)
+{
+	LOGQUERY_LOGI("Decode PSTMLOGQUERY: %s", msg.toCString());
+
+	// Entry fields:
+	// index, date, time, fix quality, latitude, N/S, longitude, E/W, altitude, speed (km/h),
+	// course, HDOP
+	if(msg.parameters.size() < 12)
+	{
+		ALOGW("Datalog entry too short: %s", msg.toCString());
+		return;
+	}
+
+	auto index = utils::byteVectorParse<int>(msg.parameters[0]);
+
+	if(!index || *index < 0)
+	{
+		LOGQUERY_LOGW("Datalog entry without index, entry dropped.");
+		return;
+	}
+
+	auto timestamp = utils::parseTimestamp(msg.parameters[1], msg.parameters[2]);
+
+	if(!timestamp)
+	{
+		LOGQUERY_LOGW("Error while parsing datalog entry timestamp, entry dropped.");
+		return;
+	}
+
+	if(msg.parameters[3].empty() || msg.parameters[5].empty() || msg.parameters[7].empty())
+	{
+		LOGQUERY_LOGW("Datalog entry without position, entry dropped.");
+		return;
+	}
+
+	FixQuality quality = FixQualityFromInt(msg.parameters[3][0] - '0');
+
+	if(quality == FixQuality::Invalid)
+	{
+		LOGQUERY_LOGW("Datalog entry without fix, entry dropped.");
+		return;
+	}
+
+	DegreeMinuteCoordinate lat(msg.parameters[4], msg.parameters[5][0]);
+	DegreeMinuteCoordinate lon(msg.parameters[6], msg.parameters[7][0]);
+
+	Location loc;
+	loc.quality(quality);
+	loc.timestamp(*timestamp);
+	loc.location(lat.asDecimalDegree().value(), lon.asDecimalDegree().value());
+	loc.altitude(utils::byteVectorParse<double>(msg.parameters[8]).value_or(0.));
+	loc.speed(utils::byteVectorParse<double>(msg.parameters[9]).value_or(0.) / 3.6);
+	loc.bearing(utils::byteVectorParse<double>(msg.parameters[10]).value_or(0.));
+	loc.accuracy(utils::byteVectorParse<double>(msg.parameters[11]).value_or(0.));
+
+	dev.onDatalogEntry(static_cast<unsigned int>(*index), loc);
+}
+
+#ifdef MSG_DBG_ALMANAC
+#define ALMANAC_LOGI(...) ALOGI(__VA_ARGS__)
+#define ALMANAC_LOGW(...) ALOGW(__VA_ARGS__)
+#else
+#define ALMANAC_LOGI(...)
+#define ALMANAC_LOGW(...)
+#endif
+void decoders::pstmalmanac(AbstractDevice & dev, const NmeaMessage & msg)
+{
+	ALMANAC_LOGI("Decode PSTMALMANAC: %s", msg.toCString());
+
+	// Fields: satellite id, data size, then the data in hexadecimal, in one or several fields
+	if(msg.parameters.size() < 3)
+	{
+		ALOGW("Almanac too short: %s", msg.toCString());
+		return;
+	}
+
+	auto satid = utils::byteVectorParse<int>(msg.parameters[0]);
+	auto size = utils::byteVectorParse<int>(msg.parameters[1]);
+
+	if(!satid || !size || *size != static_cast<int>(sizeof(GpsAlmanacData)))
+	{
+		ALMANAC_LOGW("Almanac without satellite or with unexpected size, dropped.");
+		return;
+	}
+
+	ByteVector hex;
+	for(auto it = msg.parameters.begin() + 2; it != msg.parameters.end(); ++it)
+		hex.insert(hex.end(), it->begin(), it->end());
+
+	if(hex.size() != 2 * sizeof(GpsAlmanacData))
+	{
+		ALMANAC_LOGW("Almanac data size mismatch, dropped.");
+		return;
+	}
+
+	GpsAlmanac almanac;
+	bool invalid = false;
+
+	for(std::size_t i = 0; i < sizeof(GpsAlmanacData); i++)
+	{
+		bool invalidByte = false;
+		almanac.raw[i] = utils::asciiToByte(hex[2 * i], hex[2 * i + 1], invalidByte);
+		invalid = invalid || invalidByte;
+	}
+
+	if(invalid || almanac.d.satid != *satid)
+	{
+		ALMANAC_LOGW("Invalid almanac data, dropped.");
+		return;
+	}
+
+	dev.onAlmanac(almanac);
+}
+
 } // namespace nmea
 } // namespace decoder
 } // namespace stm
\ No newline at end of file
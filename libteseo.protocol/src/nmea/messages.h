@@ -119,6 +119,42 @@ public:
 	 * @param[in]  msg   PSTMSTAGPSSATSEEDOK/ PSTMSTAGPSSATSEEDERRORMessage to decode
 	 */
 	 static void pstmstagpssatseedresponse(AbstractDevice & dev, const NmeaMessage & msg);
+
+	/**
+	 * @brief      PSTMSETCONSTMASKOK and PSTMSETCONSTMASKERROR decoder
+	 *
+	 * @param      dev   Device to update
+	 * @param[in]  msg   PSTMSETCONSTMASKOK/PSTMSETCONSTMASKERROR Message to decode
+	 */
+	static void pstmsetconstmaskresponse(AbstractDevice & dev, const NmeaMessage & msg);
+
+	/**
+	 * @brief      PSTMLOG*OK and PSTMLOG*ERROR decoder
+	 *
+	 * @param      dev   Device to update
+	 * @param[in]  msg   Datalog command answer to decode
+	 */
+	static void pstmlogresponse(AbstractDevice & dev, const NmeaMessage & msg);
+
+	/**
+	 * @brief      PSTMLOGQUERY decoder
+	 *
+	 * @details    Decode one entry read back from the receiver datalog.
+	 *
+	 * @param      dev   Device to update
+	 * @param[in]  msg   PSTMLOGQUERY Message to decode
+	 */
+	static void pstmlogquery(AbstractDevice & dev, const NmeaMessage & msg);
+
+	/**
+	 * @brief      PSTMALMANAC decoder
+	 *
+	 * @details    Decode one almanac dumped by the receiver.
+	 *
+	 * @param      dev   Device to update
+	 * @param[in]  msg   PSTMALMANAC Message to decode
+	 */
+	static void pstmalmanac(AbstractDevice & dev, const NmeaMessage & msg);
 };
 
 /**
@@ -43,16 +43,40 @@ LOCAL_SHARED_LIBRARIES := \
 	libsysutils           \
 	libhardware           \
 	libcurl               \
-	libteseo.utils
+	libteseo.utils        \
+	libteseo.config       \
+	libteseo.model        \
+	libteseo.device       \
+	libteseo.protocol     \
+	libteseo.geofencing
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
 
-LOCAL_SRC_FILES :=             \
-	src/main.cpp               \
-	src/utils/ByteVector.cpp   \
-	src/utils/Channel.cpp      \
+LOCAL_SRC_FILES :=                         \
+	src/main.cpp                           \
+	src/config/ConfigCache.cpp             \
+	src/device/AssistanceInjector.cpp      \
+	src/device/ConstellationPolicy.cpp     \
+	src/device/DatalogManager.cpp          \
+	src/device/ReceiverFailover.cpp        \
+	src/device/SkyPredictor.cpp            \
+	src/geofencing/GeofenceSchedule.cpp    \
+	src/protocol/AbstractDecoder.cpp       \
+	src/test/FaultInjectingByteStream.cpp  \
+	src/utils/AssistanceScheduler.cpp      \
+	src/utils/ByteStreamReader.cpp         \
+	src/utils/ByteVector.cpp               \
+	src/utils/Channel.cpp                  \
+	src/utils/FaultInjectingByteStream.cpp \
+	src/utils/NmeaCapture.cpp              \
+	src/utils/NmeaStream.cpp               \
+	src/utils/Pps.cpp                      \
 	src/utils/Time.cpp
 
+ifeq ($(TESEO_FIRMWARE_UPDATE_ENABLED),true)
+	LOCAL_SRC_FILES += src/utils/FirmwareUpdater.cpp
+endif
+
 LOCAL_PRELINK_MODULE := false
 
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,323 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Fault injecting byte stream decorator
+ * @file FaultInjectingByteStream.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_TEST_FAULT_INJECTING_BYTE_STREAM_H
+#define TESEO_HAL_TEST_FAULT_INJECTING_BYTE_STREAM_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <teseo/utils/ByteVector.h>
+#include <teseo/utils/IByteStream.h>
+#include <teseo/utils/Signal.h>
+
+namespace stm {
+namespace stream {
+
+enum class FaultType {
+	Drop,       ///< Bytes are lost
+	BitFlip,    ///< One bit of a byte is inverted
+	Truncate,   ///< The end of the current line is lost, the line end is kept
+	Stall,      ///< Nothing is delivered for a while, then the held bytes come at once
+	Disconnect  ///< The stream is closed for a while, what the receiver sends meanwhile is lost
+};
+
+/**
+ * @brief      Returns the fault type name, for reports
+ */
+const char * toString(FaultType type);
+
+/**
+ * @brief      Fault scheduled at a given offset in the received stream
+ */
+struct Fault {
+	FaultType type;
+
+	/**
+	 * Offset of the first byte affected, counted on the bytes received from the wrapped stream
+	 */
+	std::size_t offset;
+
+	/**
+	 * Number of bytes lost, Drop only
+	 */
+	std::size_t length;
+
+	/**
+	 * Stall or Disconnect duration
+	 */
+	std::chrono::milliseconds duration;
+};
+
+/**
+ * @brief      Random fault rates, as probabilities per received byte
+ */
+struct FaultRates {
+	double drop = 0.;
+	double bitFlip = 0.;
+	double truncate = 0.;
+	double stall = 0.;
+	double disconnect = 0.;
+
+	std::size_t dropLength = 16;
+	std::chrono::milliseconds stallDuration{500};
+	std::chrono::milliseconds disconnectDuration{2000};
+};
+
+/**
+ * @brief      Fault actually injected
+ */
+struct FaultRecord {
+	/**
+	 * Injection rank, starting at 0
+	 */
+	unsigned int id;
+
+	Fault fault;
+
+	std::chrono::steady_clock::time_point injectedAt;
+};
+
+/**
+ * @brief      Byte stream decorator injecting faults in the bytes received from another stream
+ *
+ * @details    Faults are taken from a schedule and drawn at random from per byte rates, with a
+ * seeded generator so a run can be reproduced. The receive path of the wrapped stream is
+ * decorated: it must be connected to this stream only, and the HAL connects to newBytes as it
+ * would on the wrapped stream. Writes, start and stop are forwarded unchanged.
+ *
+ * Faults are applied in the reader thread of the wrapped stream, a stall holds that thread.
+ */
+class FaultInjectingByteStream : public IByteStream {
+private:
+	IByteStream & inner;
+
+	std::string streamName;
+
+	mutable std::mutex mutex;
+
+	std::mt19937 generator;
+
+	FaultRates rates;
+
+	std::vector<Fault> scheduled;
+
+	std::size_t nextScheduled;
+
+	std::size_t nextRandom;
+
+	std::size_t offset;
+
+	unsigned int faultCount;
+
+	std::size_t dropRemaining;
+
+	bool truncating;
+
+	bool disconnected;
+
+	std::chrono::steady_clock::time_point reconnectAt;
+
+	/**
+	 * Upstream line being assembled, to report the valid sentences received
+	 */
+	ByteVector line;
+
+	void drawNextRandom();
+
+	Fault drawFault();
+
+	void trackInput(uint8_t byte);
+
+	/**
+	 * @brief      Inject a fault, the output held so far is sent first for a stall
+	 *
+	 * @return     Mask applied to the current byte
+	 */
+	uint8_t inject(const Fault & fault, ByteVector & out, std::unique_lock<std::mutex> & lock);
+
+	void onInnerBytes(const ByteVector & bytes);
+
+protected:
+	virtual void open() noexcept(false);
+
+	virtual void close() noexcept(false);
+
+	virtual void flush() noexcept(false);
+
+	/**
+	 * @brief      Never called, bytes are read by the wrapped stream
+	 */
+	virtual ByteVector perform_read() noexcept(false);
+
+	virtual void perform_write(const ByteVectorPtr bytes) noexcept(false);
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param      inner  Decorated stream
+	 * @param[in]  seed   Random fault generator seed
+	 */
+	FaultInjectingByteStream(IByteStream & inner, uint32_t seed = 0);
+
+	virtual ~FaultInjectingByteStream();
+
+	/**
+	 * @brief      Set the random fault rates, all zero by default
+	 */
+	void setRates(const FaultRates & rates);
+
+	/**
+	 * @brief      Schedule a fault, faults at an offset already received are ignored
+	 */
+	void schedule(const Fault & fault);
+
+	/**
+	 * @brief      Number of bytes received from the wrapped stream
+	 */
+	std::size_t received() const;
+
+	virtual const std::string & name() const;
+
+	/**
+	 * @brief      Status of the wrapped stream, closed during a disconnection
+	 */
+	virtual ByteStreamStatus status() const;
+
+	virtual void write(const ByteVectorPtr bytes);
+
+	virtual int start();
+
+	virtual int stop();
+
+	/**
+	 * Fault injected, emitted before the affected bytes are delivered
+	 */
+	Signal<void, const FaultRecord &> faultInjected;
+
+	/**
+	 * Valid sentence received from the wrapped stream, without line end, emitted before the
+	 * sentence is delivered
+	 */
+	Signal<void, const ByteVector &> inputSentence;
+};
+
+/**
+ * @brief      Fault impact measurement
+ *
+ * @details    Compares the valid sentences entering the fault injecting stream with the sentences
+ * delivered by the NMEA stream. A valid sentence that doesn't come out is lost, and counted
+ * against the last fault injected before it was received. A fault is recovered by the first
+ * valid fix following the delivery of a sentence received after it.
+ */
+class RecoveryMeter : public Trackable {
+public:
+	struct Result {
+		FaultRecord record;
+
+		bool recovered;
+
+		/**
+		 * Time from the injection to the first valid fix after it
+		 */
+		std::chrono::milliseconds recovery;
+
+		/**
+		 * Valid sentences lost because of the fault
+		 */
+		unsigned int lostSentences;
+	};
+
+private:
+	struct Pending {
+		ByteVector sentence;
+		int fault;
+	};
+
+	mutable std::mutex mutex;
+
+	std::vector<Result> faults;
+
+	std::deque<Pending> pending;
+
+	int currentFault;
+
+	int passedFault;
+
+	int firstUnrecovered;
+
+	unsigned int unattributed;
+
+	void lose(const Pending & p);
+
+public:
+	RecoveryMeter();
+
+	/**
+	 * @brief      FaultInjectingByteStream::faultInjected slot
+	 */
+	void onFault(const FaultRecord & record);
+
+	/**
+	 * @brief      FaultInjectingByteStream::inputSentence slot
+	 */
+	void onInputSentence(const ByteVector & sentence);
+
+	/**
+	 * @brief      Delivered sentence slot
+	 *
+	 * @details    To be called in decoding order, once the sentence is decoded, so the fixes it
+	 * leads to come after it.
+	 */
+	void onSentence(ByteVectorPtr sentence);
+
+	/**
+	 * @brief      To be called on each valid fix published by the device
+	 */
+	void onValidFix();
+
+	/**
+	 * @brief      Results, one per fault injected
+	 */
+	std::vector<Result> results() const;
+
+	/**
+	 * @brief      Valid sentences lost before the first fault
+	 */
+	unsigned int unattributedLosses() const;
+};
+
+} // namespace stream
+} // namespace stm
+
+#endif // TESEO_HAL_TEST_FAULT_INJECTING_BYTE_STREAM_H
@@ -0,0 +1,150 @@
+/**
+ * @brief Helpers shared by the test cases
+ * @file helpers.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_TEST_HELPERS_H
+#define TESEO_HAL_TEST_HELPERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+
+namespace stm {
+namespace test {
+
+namespace detail {
+
+struct ThreadStart {
+	void (*start)(void *);
+	void * arg;
+};
+
+inline void * threadTrampoline(void * raw)
+{
+	ThreadStart * ts = static_cast<ThreadStart *>(raw);
+	ts->start(ts->arg);
+	delete ts;
+	return nullptr;
+}
+
+} // namespace detail
+
+/**
+ * @brief      Thread create callback running the HAL threads as plain pthreads
+ *
+ * @details    To be registered with Thread::setCreateThreadCb, the Android framework callback
+ * isn't available in tests.
+ */
+inline pthread_t createThread(const char *, void (*start)(void *), void * arg)
+{
+	pthread_t handle;
+	pthread_create(&handle, nullptr, detail::threadTrampoline, new detail::ThreadStart{start, arg});
+	return handle;
+}
+
+/**
+ * @brief      Build an NMEA sentence
+ *
+ * @param[in]  body  Sentence without the leading '$' and the checksum
+ *
+ * @return     The sentence with its checksum, terminated by CRLF
+ */
+inline std::string sentence(const std::string & body)
+{
+	uint8_t crc = 0;
+	for(char c : body)
+		crc ^= static_cast<uint8_t>(c);
+
+	char tail[8];
+	snprintf(tail, sizeof(tail), "*%02X\r\n", crc);
+	return "$" + body + tail;
+}
+
+/**
+ * @brief      Pseudo-terminal standing for the receiver UART
+ *
+ * @details    The emulated receiver uses the master side, the HAL opens the slave path.
+ */
+class PseudoTerminal {
+private:
+	int masterFd;
+	int slaveFd;
+	std::string slave;
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  holdLine  Keep the slave side open in raw mode, so the line stays up while the
+	 *                       host closes and reopens it, like a real UART
+	 */
+	explicit PseudoTerminal(bool holdLine = false) :
+		slaveFd(-1)
+	{
+		masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+		grantpt(masterFd);
+		unlockpt(masterFd);
+		slave = ptsname(masterFd);
+
+		if(holdLine)
+		{
+			slaveFd = ::open(slave.c_str(), O_RDWR | O_NOCTTY);
+
+			struct termios attr;
+			tcgetattr(slaveFd, &attr);
+			cfmakeraw(&attr);
+			tcsetattr(slaveFd, TCSANOW, &attr);
+		}
+	}
+
+	PseudoTerminal(const PseudoTerminal &) = delete;
+	PseudoTerminal & operator = (const PseudoTerminal &) = delete;
+
+	~PseudoTerminal()
+	{
+		close();
+	}
+
+	/**
+	 * @brief      Master side file descriptor
+	 */
+	int master() const
+	{
+		return masterFd;
+	}
+
+	/**
+	 * @brief      Slave device path, opened by the HAL
+	 */
+	const std::string & slavePath() const
+	{
+		return slave;
+	}
+
+	/**
+	 * @brief      Hang up the line, a host reader blocked on it gets an error
+	 */
+	void close()
+	{
+		if(slaveFd >= 0)
+			::close(slaveFd);
+
+		if(masterFd >= 0)
+			::close(masterFd);
+
+		slaveFd = -1;
+		masterFd = -1;
+	}
+};
+
+} // namespace test
+} // namespace stm
+
+#endif // TESEO_HAL_TEST_HELPERS_H
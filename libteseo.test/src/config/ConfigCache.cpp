@@ -0,0 +1,294 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <teseo/config/cache.h>
+#include <teseo/config/config.h>
+
+using namespace stm;
+using namespace stm::config;
+
+static const char * testConfig = R"toml(
+# Teseo configuration file used by the cache tests
+
+[device]
+# UART device to use for NMEA communication
+tty = "/dev/ttyAMA1"
+speed = 230400
+pps = "/dev/pps0"
+
+[constellations]
+gps = true
+glonass = false
+beidou = true
+galileo = true
+adaptive = true
+
+[agnss]
+enable = true
+
+[agnss.refresh]
+enable = true
+ephemeris_uri = "https://assistance.example.com/ephemeris.nmea"
+ephemeris_validity = 10800
+almanac_uri = "https://assistance.example.com/almanac.nmea"
+almanac_validity = 259200
+path = "/data/gps/assistance"
+prefetch_lead = 3600
+coalesce_window = 1800
+backoff_base = 60
+backoff_max = 7200
+daily_budget = 1048576
+
+[stagps]
+enable = true
+
+[stagps.predictive]
+enable = true
+host = "seed.example.com"
+port = 8080
+base_path = "/stagps/predictive"
+vendor_id = "vendor"
+model_id = "model"
+device_id = "0123456789abcdef"
+seed_type = 7
+
+[stagps.realtime]
+enable = false
+host = "realtime.example.com"
+port = 8081
+base_path = "/stagps/realtime"
+vendor_id = "vendor"
+model_id = "model"
+device_id = "0123456789abcdef"
+)toml";
+
+/**
+ * Temporary directory holding a configuration file and its cache
+ */
+struct ConfigFiles {
+	std::string dir;
+	std::string conf;
+	std::string cache;
+
+	ConfigFiles()
+	{
+#ifdef __ANDROID__
+		std::string base = "/data/local/tmp";
+#else
+		std::string base = "/tmp";
+#endif
+		std::string pattern = base + "/teseo_config_XXXXXX";
+		dir = mkdtemp(&pattern[0]);
+		conf = dir + "/gps.conf";
+		cache = dir + "/gps.conf.cache";
+		write(conf, testConfig);
+	}
+
+	~ConfigFiles()
+	{
+		unlink(conf.c_str());
+		unlink(cache.c_str());
+		rmdir(dir.c_str());
+	}
+
+	static void write(const std::string & path, const std::string & content)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << content;
+	}
+
+	static std::string readAll(const std::string & path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::ostringstream content;
+		content << in.rdbuf();
+		return content.str();
+	}
+
+	cache::SourceKey key() const
+	{
+		std::string content;
+		cache::SourceKey k;
+		REQUIRE(cache::readSource(conf, content, k));
+		return k;
+	}
+};
+
+static void checkTestConfig(const Configuration & cfg)
+{
+	REQUIRE(cfg.device.tty == "/dev/ttyAMA1");
+	REQUIRE(cfg.device.speed == 230400);
+	REQUIRE(cfg.device.pps == "/dev/pps0");
+	REQUIRE(cfg.constellations.gps);
+	REQUIRE_FALSE(cfg.constellations.glonass);
+	REQUIRE(cfg.constellations.adaptive);
+	REQUIRE(cfg.agnss.refresh.ephemeris_uri == "https://assistance.example.com/ephemeris.nmea");
+	REQUIRE(cfg.agnss.refresh.almanac_validity == 259200);
+	REQUIRE(cfg.agnss.refresh.daily_budget == 1048576);
+	REQUIRE(cfg.stagps.predictive.port == 8080);
+	REQUIRE(cfg.stagps.predictive.seed_type == 7);
+	REQUIRE(cfg.stagps.predictive.device_id == "0123456789abcdef");
+	REQUIRE_FALSE(cfg.stagps.realtime.enable);
+	REQUIRE(cfg.stagps.realtime.base_path == "/stagps/realtime");
+}
+
+TEST_CASE( "Configuration cache is built and reused", "[config][ConfigCache]" ) {
+	ConfigFiles files;
+
+	checkTestConfig(read(files.conf, files.cache));
+
+	Configuration cached;
+	REQUIRE(cache::load(files.cache, files.key(), cached));
+	checkTestConfig(cached);
+
+	// Second load comes from the cache and gives the same result
+	checkTestConfig(read(files.conf, files.cache));
+}
+
+TEST_CASE( "Configuration cache is rebuilt when the file changes", "[config][ConfigCache]" ) {
+	ConfigFiles files;
+	read(files.conf, files.cache);
+
+	struct stat before;
+	REQUIRE(stat(files.conf.c_str(), &before) == 0);
+	cache::SourceKey oldKey = files.key();
+
+	// Same size and same modification time, only the content hash tells the difference
+	std::string content = testConfig;
+	content.replace(content.find("230400"), 6, "460800");
+	ConfigFiles::write(files.conf, content);
+
+	struct timespec times[2] = { before.st_atim, before.st_mtim };
+	REQUIRE(utimensat(AT_FDCWD, files.conf.c_str(), times, 0) == 0);
+
+	cache::SourceKey newKey = files.key();
+	REQUIRE(newKey.size == oldKey.size);
+	REQUIRE(newKey.mtimeSec == oldKey.mtimeSec);
+	REQUIRE(newKey.mtimeNsec == oldKey.mtimeNsec);
+	REQUIRE(newKey != oldKey);
+
+	Configuration cached;
+	REQUIRE_FALSE(cache::load(files.cache, newKey, cached));
+
+	REQUIRE(read(files.conf, files.cache).device.speed == 460800);
+	REQUIRE(cache::load(files.cache, newKey, cached));
+	REQUIRE(cached.device.speed == 460800);
+}
+
+TEST_CASE( "Corrupted configuration cache falls back to the file", "[config][ConfigCache]" ) {
+	ConfigFiles files;
+	read(files.conf, files.cache);
+	cache::SourceKey key = files.key();
+
+	std::string good = ConfigFiles::readAll(files.cache);
+	Configuration cached;
+
+	SECTION( "Flipped bit in the payload" ) {
+		std::string bad = good;
+		bad[bad.size() - 3] ^= 0x10;
+		ConfigFiles::write(files.cache, bad);
+		REQUIRE_FALSE(cache::load(files.cache, key, cached));
+	}
+
+	SECTION( "Truncated cache" ) {
+		ConfigFiles::write(files.cache, good.substr(0, good.size() / 2));
+		REQUIRE_FALSE(cache::load(files.cache, key, cached));
+	}
+
+	SECTION( "Empty cache" ) {
+		ConfigFiles::write(files.cache, "");
+		REQUIRE_FALSE(cache::load(files.cache, key, cached));
+	}
+
+	SECTION( "Wrong magic" ) {
+		std::string bad = good;
+		bad[0] = 'X';
+		ConfigFiles::write(files.cache, bad);
+		REQUIRE_FALSE(cache::load(files.cache, key, cached));
+	}
+
+	SECTION( "Other fields or defaults" ) {
+		// Schema hash follows the magic and the version
+		std::string bad = good;
+		bad[8] ^= 0x01;
+		ConfigFiles::write(files.cache, bad);
+		REQUIRE_FALSE(cache::load(files.cache, key, cached));
+	}
+
+	checkTestConfig(read(files.conf, files.cache));
+
+	// The fallback rebuilt a valid cache
+	REQUIRE(cache::load(files.cache, key, cached));
+	checkTestConfig(cached);
+}
+
+TEST_CASE( "Missing cache directory does not prevent the configuration load", "[config][ConfigCache]" ) {
+	ConfigFiles files;
+	std::string cachePath = files.dir + "/missing/gps.conf.cache";
+
+	checkTestConfig(read(files.conf, cachePath));
+	checkTestConfig(read(files.conf, ""));
+}
+
+/**
+ * Drop a file from the page cache, so the next load reads it from the storage when possible
+ */
+static void evict(const std::string & path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd >= 0)
+	{
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+TEST_CASE( "Configuration cache load is faster than TOML parsing", "[config][ConfigCache][benchmark]" ) {
+	using std::chrono::steady_clock;
+	using std::chrono::duration_cast;
+	using std::chrono::nanoseconds;
+
+	ConfigFiles files;
+	read(files.conf, files.cache);
+
+	const int iterations = 200;
+	nanoseconds tomlTime(0), cacheTime(0);
+
+	for(int i = 0; i < iterations; i++)
+	{
+		evict(files.conf);
+		auto start = steady_clock::now();
+		read(files.conf, "");
+		tomlTime += duration_cast<nanoseconds>(steady_clock::now() - start);
+
+		evict(files.conf);
+		evict(files.cache);
+		start = steady_clock::now();
+		read(files.conf, files.cache);
+		cacheTime += duration_cast<nanoseconds>(steady_clock::now() - start);
+	}
+
+	double tomlUs = tomlTime.count() / 1000. / iterations;
+	double cacheUs = cacheTime.count() / 1000. / iterations;
+
+	std::ostringstream report;
+	report << "Configuration load, mean of " << iterations << " cold loads: "
+	       << "TOML " << tomlUs << " us, cache " << cacheUs << " us "
+	       << "(x" << tomlUs / cacheUs << "), cache size "
+	       << ConfigFiles::readAll(files.cache).size() << " bytes";
+	WARN(report.str());
+
+	checkTestConfig(read(files.conf, files.cache));
+	REQUIRE(cacheTime < tomlTime);
+}
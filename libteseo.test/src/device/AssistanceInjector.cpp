@@ -0,0 +1,131 @@
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include <teseo/device/AssistanceInjector.h>
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/protocol/NmeaEncoder.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::device;
+
+namespace {
+
+std::vector<char> file(const std::vector<std::string> & lines)
+{
+	std::string content;
+
+	for(const auto & line : lines)
+		content += line;
+
+	return std::vector<char>(content.begin(), content.end());
+}
+
+/**
+ * Sentence bodies the encoder builds from the messages
+ */
+std::vector<std::string> encode(const std::vector<model::Message> & messages)
+{
+	NmeaDevice device;
+	protocol::NmeaEncoder encoder;
+	std::vector<std::string> bodies;
+
+	encoder.encodedBytes.connect(SlotFactory::create(std::function<void(ByteVectorPtr)>(
+		[&bodies] (ByteVectorPtr bytes) { bodies.push_back(std::string(bytes->begin(), bytes->end())); })));
+
+	for(const auto & m : messages)
+		encoder.encode(device, m);
+
+	return bodies;
+}
+
+struct Recorder : public Trackable {
+	std::vector<model::Message> messages;
+
+	void onMessage(const model::Message & m)
+	{
+		messages.push_back(m);
+	}
+};
+
+} // namespace
+
+TEST_CASE( "Assistance files are parsed into injections", "[device][AssistanceInjector]" ) {
+	const std::vector<std::string> ephemeris = {
+		"PSTMEPHEM,5,4,0A1B2C3D",
+		"PSTMEPHEM,12,6,00112233AABB",
+		"PSTMEPHEM,70,2,FFEE"
+	};
+
+	std::string badChecksum = sentence("PSTMEPHEM,7,2,1234");
+	badChecksum[badChecksum.size() - 3] ^= 1;
+
+	std::vector<char> content = file({
+		sentence(ephemeris[0]),
+		"\r\n",
+		badChecksum,
+		sentence(ephemeris[1]),
+		sentence("PSTMALMANAC,3,2,0102"),
+		sentence("PSTMEPHEM,8,4,0102"),
+		sentence("PSTMEPHEM,9,2,ZZ01"),
+		"PSTMEPHEM,10,2,0102\r\n",
+		sentence(ephemeris[2])
+	});
+
+	auto messages = AssistanceInjector::parse(AssistanceKind::Ephemeris, content);
+
+	REQUIRE(messages.size() == 3);
+
+	for(const auto & m : messages)
+		CHECK(m.id == model::MessageId::Stagps_RealTime_Ephemeris);
+
+	// The encoder sends back the sentences of the file
+	CHECK(encode(messages) == ephemeris);
+
+	auto almanacs = AssistanceInjector::parse(AssistanceKind::Almanac, content);
+	REQUIRE(almanacs.size() == 1);
+	CHECK(almanacs[0].id == model::MessageId::Stagps_RealTime_Almanac);
+	CHECK(encode(almanacs) == std::vector<std::string>({"PSTMALMANAC,3,2,0102"}));
+
+	// Data split in several fields is joined
+	auto split = AssistanceInjector::parse(AssistanceKind::Almanac, file({sentence("PSTMALMANAC,4,4,0011,2233")}));
+	CHECK(encode(split) == std::vector<std::string>({"PSTMALMANAC,4,4,00112233"}));
+
+	CHECK(AssistanceInjector::parse(AssistanceKind::Almanac, file({"garbage\n"})).empty());
+}
+
+TEST_CASE( "Assistance is injected during navigation only", "[device][AssistanceInjector]" ) {
+	AssistanceInjector injector;
+	Recorder recorder;
+
+	injector.sendMessageRequest.connect(SlotFactory::create(recorder, &Recorder::onMessage));
+
+	std::vector<char> ephemeris = file({sentence("PSTMEPHEM,5,2,0A0B"), sentence("PSTMEPHEM,6,2,0C0D")});
+	std::vector<char> newer = file({sentence("PSTMEPHEM,7,2,0E0F")});
+	std::vector<char> almanac = file({sentence("PSTMALMANAC,5,2,0102")});
+
+	// Out of navigation the link is down, the data is kept until the next start
+	REQUIRE(injector.inject(AssistanceKind::Ephemeris, ephemeris) == 2);
+	REQUIRE(injector.inject(AssistanceKind::Almanac, almanac) == 1);
+	CHECK(recorder.messages.empty());
+
+	// Newer data of a kind replaces the data kept
+	REQUIRE(injector.inject(AssistanceKind::Ephemeris, newer) == 1);
+	CHECK(injector.inject(AssistanceKind::Ephemeris, file({"garbage\n"})) == 0);
+
+	injector.onStart();
+	CHECK(encode(recorder.messages) == std::vector<std::string>({"PSTMEPHEM,7,2,0E0F", "PSTMALMANAC,5,2,0102"}));
+
+	// Injected once
+	recorder.messages.clear();
+	injector.onStop();
+	injector.onStart();
+	CHECK(recorder.messages.empty());
+
+	// During navigation the data is injected right away
+	REQUIRE(injector.inject(AssistanceKind::Ephemeris, ephemeris) == 2);
+	CHECK(encode(recorder.messages) == std::vector<std::string>({"PSTMEPHEM,5,2,0A0B", "PSTMEPHEM,6,2,0C0D"}));
+}
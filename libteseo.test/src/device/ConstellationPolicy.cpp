@@ -0,0 +1,447 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <teseo/device/ConstellationPolicy.h>
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::device;
+
+namespace {
+
+struct ConstellationScenario {
+	Constellation constellation;
+	const char * talker;
+	int firstPrn;
+	unsigned int visible;
+	unsigned int used;
+};
+
+/**
+ * One phase of the replayed drive, the first gpsUsed GPS satellites are used in the fix
+ */
+struct Phase {
+	const char * name;
+	unsigned int epochs;
+	unsigned int gpsVisible;
+	unsigned int gpsUsed;
+};
+
+struct ReplayStats {
+	std::size_t gsvBytes = 0;
+	std::size_t gsvSentences = 0;
+	std::size_t gsvSatellites = 0;
+	std::chrono::nanoseconds decodeTime = std::chrono::nanoseconds::zero();
+	double pdopSum = 0.;
+	float pdopMax = 0.;
+	float lastPdop = 0.;
+	unsigned int epochs = 0;
+	unsigned int published = 0;
+	unsigned int reducedEpochs = 0;
+	unsigned int degradedWhileReduced = 0;
+	unsigned int transitions = 0;
+};
+
+struct SkyPosition {
+	int elevation;
+	int azimuth;
+};
+
+/**
+ * Position of the i-th satellite of a constellation, spread over the sky
+ */
+SkyPosition skyPosition(int firstPrn, unsigned int i)
+{
+	return SkyPosition{5 + static_cast<int>(i * 33) % 80, static_cast<int>(i * 167 + firstPrn * 53) % 360};
+}
+
+/**
+ * Dilution of precision of the used satellites, with a single receiver clock
+ */
+struct Dop {
+	float pdop;
+	float hdop;
+	float vdop;
+};
+
+Dop dop(const std::vector<SkyPosition> & used)
+{
+	const double degree = std::acos(-1.) / 180.;
+	double m[4][8] = {};
+
+	// Normal matrix of the line of sight and clock unknowns, next to the identity
+	for(const auto & p : used)
+	{
+		double e = p.elevation * degree;
+		double a = p.azimuth * degree;
+		double g[4] = {-std::cos(e) * std::sin(a), -std::cos(e) * std::cos(a), -std::sin(e), 1.};
+
+		for(int i = 0; i < 4; i++)
+			for(int j = 0; j < 4; j++)
+				m[i][j] += g[i] * g[j];
+	}
+
+	for(int i = 0; i < 4; i++)
+		m[i][4 + i] = 1.;
+
+	// Gauss-Jordan elimination, the normal matrix of a valid fix is positive definite
+	for(int c = 0; c < 4; c++)
+	{
+		double pivot = m[c][c];
+
+		for(int j = 0; j < 8; j++)
+			m[c][j] /= pivot;
+
+		for(int r = 0; r < 4; r++)
+		{
+			if(r == c)
+				continue;
+
+			double f = m[r][c];
+			for(int j = 0; j < 8; j++)
+				m[r][j] -= f * m[c][j];
+		}
+	}
+
+	return Dop{
+		static_cast<float>(std::sqrt(m[0][4] + m[1][5] + m[2][6])),
+		static_cast<float>(std::sqrt(m[0][4] + m[1][5])),
+		static_cast<float>(std::sqrt(m[2][6]))
+	};
+}
+
+/**
+ * Build the GSV sentences the receiver outputs for one constellation
+ */
+std::string gsvSentences(const char * talker, int firstPrn, unsigned int count, std::size_t & sentences)
+{
+	std::string out;
+	unsigned int total = (count + 3) / 4;
+
+	for(unsigned int s = 0; s < total; s++)
+	{
+		std::ostringstream body;
+		body << talker << "GSV," << total << ',' << (s + 1) << ',' << count;
+
+		for(unsigned int i = s * 4; i < std::min(count, s * 4 + 4); i++)
+		{
+			SkyPosition p = skyPosition(firstPrn, i);
+			char sat[32];
+			snprintf(sat, sizeof(sat), ",%02d,%02d,%03d,%02d", firstPrn + i, p.elevation, p.azimuth, 25 + (i * 3) % 20);
+			body << sat;
+		}
+
+		out += test::sentence(body.str());
+		sentences++;
+	}
+
+	return out;
+}
+
+/**
+ * Build the GSA sentence the receiver outputs for the used satellites of one constellation
+ */
+std::string gsaSentence(int firstPrn, unsigned int used, const Dop & d)
+{
+	std::ostringstream body;
+	body << "GNGSA,A,3";
+
+	for(unsigned int i = 0; i < 12; i++)
+	{
+		body << ',';
+		if(i < used)
+			body << (firstPrn + i);
+	}
+
+	char dops[32];
+	snprintf(dops, sizeof(dops), ",%.1f,%.1f,%.1f", d.pdop, d.hdop, d.vdop);
+	body << dops;
+
+	return test::sentence(body.str());
+}
+
+/**
+ * Decoder fed with the replayed output directly, without the stream and the decoder thread
+ */
+class ReplayDecoder : public decoder::NmeaDecoder {
+public:
+	ReplayDecoder(AbstractDevice & device) :
+		decoder::NmeaDecoder(device)
+	{ }
+
+	void feed(const std::string & output)
+	{
+		std::size_t begin = 0;
+
+		// The stream splits the output in lines and strips the line end
+		while(begin < output.size())
+		{
+			std::size_t end = output.find("\r\n", begin);
+			decode(ByteVectorPtr(new ByteVector(output.begin() + begin, output.begin() + end)));
+			begin = end + 2;
+		}
+	}
+};
+
+std::string gga(unsigned int epoch)
+{
+	char body[96];
+	snprintf(body, sizeof(body), "GPGGA,%02u%02u%02u.000,4530.1234,N,00712.5678,E,1,08,0.9,100.0,M,47.0,M,,",
+		(epoch / 3600) % 24, (epoch / 60) % 60, epoch % 60);
+	return test::sentence(body);
+}
+
+/**
+ * Replay a drive through the decoder. The receiver outputs the constellations of the last mask
+ * the policy requested, with the DOP of the satellites it used. The policy and the statistics are
+ * fed by the decoded epochs.
+ */
+ReplayStats replay(const std::vector<Phase> & phases, ConstellationPolicy * policy)
+{
+	std::vector<ConstellationScenario> others = {
+		{Constellation::Glonass, "GL", 65, 9, 7},
+		{Constellation::Galileo, "GA", 301, 8, 6},
+		{Constellation::Beidou,  "GB", 141, 10, 8},
+	};
+
+	ReplayStats stats;
+	ConstellationThresholds thresholds;
+	bool reduced = false;
+
+	// Epochs are published by the device at the start of the next epoch
+	NmeaDevice device;
+	ReplayDecoder decoder(device);
+
+	device.locationUpdate.connect(SlotFactory::create(
+		std::function<void(const Location &)>([&stats] (const Location & loc) {
+			stats.lastPdop = loc.pdopValidity() ? loc.pdop() : 0.;
+			stats.pdopSum += stats.lastPdop;
+			stats.pdopMax = std::max(stats.pdopMax, stats.lastPdop);
+			stats.published++;
+		})
+	));
+
+	device.satelliteListUpdate.connect(SlotFactory::create(
+		std::function<void(const std::map<SatIdentifier, SatInfo> &)>(
+			[&stats, &thresholds] (const std::map<SatIdentifier, SatInfo> & sats) {
+				stats.gsvSatellites += sats.size();
+
+				EpochSummary epoch = EpochSummary::from(std::optional<Location>(), sats);
+				if(epoch.tracked.size() != 1)
+					return;
+
+				stats.reducedEpochs++;
+
+				if(epoch.used[Constellation::Gps] < thresholds.restoreMinUsed || stats.lastPdop > thresholds.restoreMaxPdop)
+					stats.degradedWhileReduced++;
+			})
+	));
+
+	if(policy)
+	{
+		device.locationUpdate.connect(SlotFactory::create(*policy, &ConstellationPolicy::onLocation));
+		device.satelliteListUpdate.connect(SlotFactory::create(*policy, &ConstellationPolicy::onSatelliteList));
+
+		// The receiver applies the mask from its next epoch on
+		policy->sendMessageRequest.connect(SlotFactory::create(
+			std::function<void(const model::Message &)>([&stats, &reduced] (const model::Message & m) {
+				std::string mask(m.parameters.at(0).begin(), m.parameters.at(0).end());
+				reduced = std::stoul(mask) == ConstellationPolicy::toMask({Constellation::Gps});
+				stats.transitions++;
+			})
+		));
+	}
+
+	auto decode = [&decoder, &stats] (const std::string & output) {
+		auto begin = std::chrono::steady_clock::now();
+		decoder.feed(output);
+		stats.decodeTime += std::chrono::steady_clock::now() - begin;
+	};
+
+	for(const auto & phase : phases)
+	{
+		for(unsigned int e = 0; e < phase.epochs; e++)
+		{
+			// Publishes the previous epoch, the policy may change the mask
+			decode(gga(stats.epochs));
+
+			std::vector<SkyPosition> used;
+			for(unsigned int i = 0; i < phase.gpsUsed; i++)
+				used.push_back(skyPosition(1, i));
+
+			if(!reduced)
+			{
+				for(const auto & c : others)
+					for(unsigned int i = 0; i < c.used; i++)
+						used.push_back(skyPosition(c.firstPrn, i));
+			}
+
+			Dop d = dop(used);
+			std::string gsa = gsaSentence(1, phase.gpsUsed, d);
+			std::string gsv = gsvSentences("GP", 1, phase.gpsVisible, stats.gsvSentences);
+
+			if(!reduced)
+			{
+				for(const auto & c : others)
+				{
+					gsa += gsaSentence(c.firstPrn, c.used, d);
+					gsv += gsvSentences(c.talker, c.firstPrn, c.visible, stats.gsvSentences);
+				}
+			}
+
+			decode(gsa + gsv);
+
+			stats.gsvBytes += gsv.size();
+			stats.epochs++;
+		}
+	}
+
+	// Start of the next epoch, publishes the last one
+	decode(gga(stats.epochs));
+
+	return stats;
+}
+
+const std::set<Constellation> allConstellations = {
+	Constellation::Gps, Constellation::Glonass, Constellation::Galileo, Constellation::Beidou
+};
+
+} // namespace
+
+TEST_CASE( "Constellation mask matches Teseo bits", "[device][ConstellationPolicy]" ) {
+	REQUIRE(ConstellationPolicy::toMask({Constellation::Gps}) == 0x01);
+	REQUIRE(ConstellationPolicy::toMask(allConstellations) == 0x8B);
+}
+
+TEST_CASE( "Constellations are reduced under open sky and restored quickly", "[device][ConstellationPolicy]" ) {
+	ConstellationPolicy policy(allConstellations);
+	ConstellationThresholds thresholds;
+
+	EpochSummary openSky;
+	openSky.fix = true;
+	openSky.pdop = 1.2;
+	openSky.used[Constellation::Gps] = 11;
+
+	for(unsigned int i = 0; i < thresholds.reduceAfter - 1; i++)
+		REQUIRE_FALSE(policy.evaluate(openSky));
+
+	REQUIRE(policy.evaluate(openSky));
+	REQUIRE(policy.mask() == 0x01);
+
+	EpochSummary canyon = openSky;
+	canyon.used[Constellation::Gps] = 5;
+	canyon.pdop = 4.5;
+
+	REQUIRE_FALSE(policy.evaluate(canyon));
+	REQUIRE(policy.evaluate(canyon));
+	REQUIRE(policy.mask() == 0x8B);
+
+	// Holdoff prevents an immediate reduction
+	for(unsigned int i = 0; i < thresholds.holdoff - 1; i++)
+		REQUIRE_FALSE(policy.evaluate(openSky));
+
+	REQUIRE(policy.evaluate(openSky));
+}
+
+TEST_CASE( "Constellation policy sends the mask on epoch updates", "[device][ConstellationPolicy]" ) {
+	ConstellationThresholds thresholds;
+	thresholds.reduceAfter = 1;
+	ConstellationPolicy policy(allConstellations, Constellation::Gps, thresholds);
+
+	std::vector<std::string> masks;
+	policy.sendMessageRequest.connect(SlotFactory::create(
+		std::function<void(const model::Message &)>([&masks] (const model::Message & m) {
+			REQUIRE(m.id == model::MessageId::SetConstellationMask);
+			masks.push_back(std::string(m.parameters.at(0).begin(), m.parameters.at(0).end()));
+		})
+	));
+
+	Location loc;
+	loc.location(45., 5.);
+	loc.pdop(1.1);
+
+	std::map<SatIdentifier, SatInfo> sats;
+	for(int prn = 1; prn <= 12; prn++)
+	{
+		SatIdentifier id(Constellation::Gps, prn);
+		sats[id] = SatInfo(id).setUsedInFix(true).setTracked(true);
+	}
+
+	policy.onLocation(loc);
+	policy.onSatelliteList(sats);
+	REQUIRE(masks == std::vector<std::string>({"1"}));
+
+	// No location this epoch: the fix is lost
+	policy.onSatelliteList(sats);
+	policy.onSatelliteList(sats);
+	REQUIRE(masks == std::vector<std::string>({"1", "139"}));
+
+	policy.onLocation(loc);
+	policy.onSatelliteList(sats);
+	REQUIRE(policy.onStart() == 0);
+	REQUIRE(masks == std::vector<std::string>({"1", "139"}));
+}
+
+TEST_CASE( "Constellation policy replay reduces GSV traffic", "[device][ConstellationPolicy]" ) {
+	std::vector<Phase> drive = {
+		{"open sky",  600, 12, 11},
+		{"canyon",     60,  7,  5},
+		{"open sky",  300, 12, 11},
+		{"marginal",  400, 11, 10},
+		{"canyon",     30,  6,  4},
+		{"open sky",  600, 12, 11},
+	};
+
+	ConstellationPolicy policy(allConstellations);
+
+	ReplayStats full = replay(drive, nullptr);
+	ReplayStats adaptive = replay(drive, &policy);
+
+	double byteRatio = static_cast<double>(adaptive.gsvBytes) / full.gsvBytes;
+	double satRatio = static_cast<double>(adaptive.gsvSatellites) / full.gsvSatellites;
+	double timeRatio = static_cast<double>(adaptive.decodeTime.count()) / full.decodeTime.count();
+	double fullPdop = full.pdopSum / full.published;
+	double adaptivePdop = adaptive.pdopSum / adaptive.published;
+
+	std::ostringstream report;
+	report << "GSV bytes: " << full.gsvBytes << " -> " << adaptive.gsvBytes
+	       << " (" << static_cast<int>(100. * (1. - byteRatio)) << "% saved), "
+	       << "GSV sentences: " << full.gsvSentences << " -> " << adaptive.gsvSentences << ", "
+	       << "satellites decoded: " << full.gsvSatellites << " -> " << adaptive.gsvSatellites << ", "
+	       << "decode time: " << std::chrono::duration_cast<std::chrono::microseconds>(full.decodeTime).count()
+	       << "us -> " << std::chrono::duration_cast<std::chrono::microseconds>(adaptive.decodeTime).count()
+	       << "us (" << static_cast<int>(100. * (1. - timeRatio)) << "% saved), "
+	       << "mean PDOP: " << fullPdop << " -> " << adaptivePdop << ", "
+	       << "max PDOP: " << full.pdopMax << " -> " << adaptive.pdopMax << ", "
+	       << "reduced epochs: " << adaptive.reducedEpochs << "/" << adaptive.epochs << ", "
+	       << "transitions: " << adaptive.transitions;
+	WARN(report.str());
+
+	REQUIRE(byteRatio < 0.6);
+	REQUIRE(satRatio < 0.6);
+	REQUIRE(adaptive.gsvSentences < full.gsvSentences);
+
+	// Every satellite of the full output is decoded and published
+	std::size_t visible = 0;
+	for(const auto & phase : drive)
+		visible += phase.epochs * (phase.gpsVisible + 9 + 8 + 10);
+
+	REQUIRE(full.gsvSatellites == visible);
+	REQUIRE(full.published == full.epochs);
+	REQUIRE(adaptive.published == adaptive.epochs);
+
+	// Degraded geometry is left with the primary constellation for at most restoreAfter epochs
+	REQUIRE(adaptive.degradedWhileReduced <= 2 * ConstellationThresholds().restoreAfter);
+	REQUIRE(adaptivePdop - fullPdop < 0.6);
+
+	// Three reductions under open sky, one restoration in each canyon
+	REQUIRE(adaptive.transitions == 5);
+}
@@ -0,0 +1,715 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <pthread.h>
+#include <sstream>
+#include <termios.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/device/DatalogManager.h>
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/protocol/NmeaEncoder.h>
+#include <teseo/utils/NmeaStream.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/utils/UartByteStream.h>
+#include <teseo/utils/Wakelock.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::device;
+using namespace stm::model;
+
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+using std::chrono::steady_clock;
+
+namespace {
+
+/**
+ * Receiver answering the datalog commands synchronously
+ */
+struct FakeReceiver : public Trackable {
+	DatalogManager & manager;
+	std::vector<MessageId> received;
+	std::vector<bool> links;
+	unsigned int logged = 3;
+	bool failQuery = false;
+	std::vector<unsigned int> queries;
+	std::vector<MessageId> unanswered;
+
+	FakeReceiver(DatalogManager & manager) : manager(manager) { }
+
+	void onMessage(const Message & message)
+	{
+		received.push_back(message.id);
+
+		if(std::find(unanswered.begin(), unanswered.end(), message.id) != unanswered.end())
+			return;
+
+		switch(message.id)
+		{
+			case MessageId::Datalog_Create: manager.onDatalogAnswer(DatalogAnswer::CreateOk); break;
+			case MessageId::Datalog_Start:  manager.onDatalogAnswer(DatalogAnswer::StartOk);  break;
+			case MessageId::Datalog_Stop:   manager.onDatalogAnswer(DatalogAnswer::StopOk);   break;
+			case MessageId::Datalog_Erase:  manager.onDatalogAnswer(DatalogAnswer::EraseOk);  break;
+			case MessageId::Datalog_Query:
+				if(failQuery)
+				{
+					manager.onDatalogAnswer(DatalogAnswer::QueryError);
+					break;
+				}
+				queries.push_back(std::stoi(utils::bytesToString(message.parameters[1])));
+				for(unsigned int i = queries.back(); i < logged; i++)
+				{
+					Location loc;
+					loc.quality(FixQuality::GPS);
+					loc.location(45. + i, 7.);
+					manager.onDatalogEntry(i, loc);
+				}
+				manager.onDatalogAnswer(DatalogAnswer::QueryOk);
+				break;
+			default:
+				break;
+		}
+	}
+
+	void onLink(bool up)
+	{
+		links.push_back(up);
+	}
+};
+
+struct BatchRecorder : public Trackable {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<std::vector<Location>> batches;
+
+	void onBatch(const std::vector<Location> & batch)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		batches.push_back(batch);
+		cv.notify_all();
+	}
+
+	bool waitFor(std::size_t count, milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return cv.wait_for(lock, timeout, [&] () { return batches.size() >= count; });
+	}
+};
+
+// ====================== Linux pty emulator =====================
+
+struct LoggedFix {
+	unsigned int second;
+	double latitude;
+	double longitude;
+};
+
+/**
+ * Receiver with an internal datalog on the master side of a pseudo-terminal
+ *
+ * @details One receiver second lasts `second` of wall time. While streaming, a GGA is sent
+ * every receiver second; while logging, a fix is appended to the log instead.
+ */
+class DatalogEmulator {
+private:
+	// Like a real UART, the line stays up while the host closes and reopens it
+	PseudoTerminal pty;
+	milliseconds second;
+	std::atomic<bool> running;
+	std::thread reader;
+	std::thread clock;
+	std::mutex mutex;
+	std::vector<LoggedFix> log;
+	unsigned int now;
+	bool logging;
+
+	void send(const std::string & data)
+	{
+		ssize_t written = ::write(pty.master(), data.data(), data.size());
+		(void)written;
+	}
+
+	static std::string coordinate(double value, int degreeDigits)
+	{
+		double degrees = std::floor(value);
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%0*d%07.4f", degreeDigits, static_cast<int>(degrees), (value - degrees) * 60.);
+		return buf;
+	}
+
+	static std::string time(unsigned int s)
+	{
+		char buf[16];
+		snprintf(buf, sizeof(buf), "%02u%02u%02u.000", (s / 3600) % 24, (s / 60) % 60, s % 60);
+		return buf;
+	}
+
+	LoggedFix fixAt(unsigned int s)
+	{
+		return LoggedFix{s, 45.1 + s * 0.0001, 7.2 + s * 0.0002};
+	}
+
+	void handle(const std::string & line)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(line.find("PSTMLOGCREATE") == 0)
+		{
+			log.clear();
+			send(sentence("PSTMLOGCREATEOK"));
+		}
+		else if(line.find("PSTMLOGSTART") == 0)
+		{
+			logging = true;
+			send(sentence("PSTMLOGSTARTOK"));
+		}
+		else if(line.find("PSTMLOGSTOP") == 0)
+		{
+			logging = false;
+			send(sentence("PSTMLOGSTOPOK"));
+		}
+		else if(line.find("PSTMLOGERASE") == 0)
+		{
+			erased = log.size();
+			log.clear();
+			send(sentence("PSTMLOGERASEOK"));
+		}
+		else if(line.find("PSTMLOGREQQUERY") == 0)
+		{
+			// PSTMLOGREQQUERY,<type>,<first>,<count>
+			std::size_t first = std::stoul(line.substr(line.find(',', line.find(',') + 1) + 1));
+			std::string out;
+
+			for(std::size_t i = first; i < log.size(); i++)
+			{
+				const LoggedFix & f = log[i];
+				std::ostringstream entry;
+				entry << "PSTMLOGQUERY," << i << ",181018," << time(f.second) << ",1,"
+				      << coordinate(f.latitude, 2) << ",N," << coordinate(f.longitude, 3) << ",E,"
+				      << "120.5,3.6,90.0,1.1";
+				out += sentence(entry.str());
+			}
+
+			out += sentence("PSTMLOGQUERYOK");
+			send(out);
+		}
+	}
+
+	void readCommands()
+	{
+		std::string pending;
+
+		while(running)
+		{
+			struct pollfd pfd = {pty.master(), POLLIN, 0};
+			if(poll(&pfd, 1, 20) <= 0)
+				continue;
+
+			char buf[256];
+			ssize_t n = ::read(pty.master(), buf, sizeof(buf));
+			if(n <= 0)
+				continue;
+
+			pending.append(buf, n);
+
+			std::size_t eol;
+			while((eol = pending.find('\n')) != std::string::npos)
+			{
+				std::string line = pending.substr(0, eol);
+				pending.erase(0, eol + 1);
+
+				std::size_t start = line.find('$');
+				std::size_t star = line.find('*');
+				if(start != std::string::npos && star != std::string::npos && star > start)
+					handle(line.substr(start + 1, star - start - 1));
+			}
+		}
+	}
+
+	void tick()
+	{
+		auto next = steady_clock::now();
+
+		while(running)
+		{
+			next += second;
+			std::this_thread::sleep_until(next);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			now++;
+			LoggedFix f = fixAt(now);
+
+			if(logging)
+			{
+				log.push_back(f);
+				logged++;
+			}
+			else if(streaming)
+			{
+				std::ostringstream gga;
+				gga << "GPGGA," << time(f.second) << "," << coordinate(f.latitude, 2) << ",N,"
+				    << coordinate(f.longitude, 3) << ",E,1,08,1.1,120.5,M,47.0,M,,";
+				send(sentence(gga.str()));
+			}
+		}
+	}
+
+public:
+	std::atomic<bool> streaming;
+	std::atomic<unsigned int> logged;
+	std::atomic<unsigned int> erased;
+
+	const std::string & slavePath() const
+	{
+		return pty.slavePath();
+	}
+
+	DatalogEmulator(milliseconds second) :
+		pty(true),
+		second(second),
+		running(true),
+		now(0),
+		logging(false),
+		streaming(false),
+		logged(0),
+		erased(0)
+	{
+		reader = std::thread(&DatalogEmulator::readCommands, this);
+		clock = std::thread(&DatalogEmulator::tick, this);
+	}
+
+	~DatalogEmulator()
+	{
+		hangUp();
+	}
+
+	/**
+	 * @brief Stop the emulator and close the line, a host reader blocked on it gets an error
+	 */
+	void hangUp()
+	{
+		if(!running)
+			return;
+
+		running = false;
+		reader.join();
+		clock.join();
+
+		pty.close();
+	}
+
+	std::size_t logSize()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return log.size();
+	}
+};
+
+/**
+ * Host side: UART, NMEA stream, decoder and device, the link is driven by the datalog manager
+ */
+struct Host : public Trackable {
+	NmeaDevice device;
+	decoder::NmeaDecoder decoder;
+	protocol::NmeaEncoder encoder;
+	stream::NmeaStream nmea;
+	stream::IStream & nmeaStream;
+	stream::UartByteStream * uart;
+
+	Host(const std::string & tty) :
+		decoder(device),
+		nmeaStream(nmea)
+	{
+		uart = new stream::UartByteStream(tty, 115200);
+
+		uart->newBytes.connect(SlotFactory::create(nmeaStream, &stream::IStream::onNewBytes));
+		nmeaStream.newSentence.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::onNewBytes));
+		device.sendMessage.connect(SlotFactory::create(encoder, &protocol::IEncoder::encode));
+		encoder.encodedBytes.connect(SlotFactory::create(nmeaStream, &stream::IStream::write));
+		nmeaStream.newBytesToWrite.connect(SlotFactory::create(*uart, &stream::IByteStream::write));
+	}
+
+	~Host()
+	{
+		link(false);
+		std::this_thread::sleep_for(milliseconds(50));
+		delete uart;
+	}
+
+	void link(bool up)
+	{
+		if(up)
+		{
+			decoder.start();
+			uart->start();
+		}
+		else
+		{
+			decoder.stop();
+			uart->stop();
+		}
+	}
+};
+
+/**
+ * Accumulate the time the wakelock is held
+ */
+struct WakeMeter : public Trackable {
+	std::mutex mutex;
+	int held = 0;
+	steady_clock::time_point since;
+	steady_clock::duration total = steady_clock::duration::zero();
+
+	void acquire()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(held++ == 0)
+			since = steady_clock::now();
+	}
+
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(held > 0 && --held == 0)
+			total += steady_clock::now() - since;
+	}
+
+	milliseconds reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto t = total;
+		if(held > 0)
+			t += steady_clock::now() - since;
+		total = steady_clock::duration::zero();
+		since = steady_clock::now();
+		return duration_cast<milliseconds>(t);
+	}
+};
+
+template <typename Pred>
+bool waitUntil(Pred pred, milliseconds timeout)
+{
+	auto end = steady_clock::now() + timeout;
+
+	while(!pred())
+	{
+		if(steady_clock::now() > end)
+			return false;
+		std::this_thread::sleep_for(milliseconds(5));
+	}
+
+	return true;
+}
+
+} // namespace
+
+TEST_CASE( "Datalog manager runs the command sequences", "[device][DatalogManager]" ) {
+	DatalogManager manager;
+	FakeReceiver receiver(manager);
+	BatchRecorder recorder;
+
+	manager.sendMessageRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onMessage));
+	manager.linkRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onLink));
+	manager.batchReady.connect(SlotFactory::create(recorder, &BatchRecorder::onBatch));
+
+	REQUIRE_FALSE(manager.readBatch());
+	REQUIRE(manager.startLogging());
+	REQUIRE(manager.getState() == DatalogState::Logging);
+	REQUIRE_FALSE(manager.startLogging());
+
+	REQUIRE(manager.readBatch());
+	REQUIRE(manager.getState() == DatalogState::Logging);
+	REQUIRE(recorder.batches.size() == 1);
+	REQUIRE(recorder.batches[0].size() == 3);
+	REQUIRE(recorder.batches[0][2].latitude() == Approx(47.));
+
+	// The next batch only holds the fixes logged since
+	receiver.logged = 5;
+	REQUIRE(manager.readBatch());
+	REQUIRE(recorder.batches.size() == 2);
+	REQUIRE(recorder.batches[1].size() == 2);
+	REQUIRE(recorder.batches[1][0].latitude() == Approx(48.));
+
+	REQUIRE(manager.stopLogging());
+	REQUIRE(manager.getState() == DatalogState::Idle);
+
+	std::vector<MessageId> expected = {
+		MessageId::Datalog_Create, MessageId::Datalog_Start,
+		MessageId::Datalog_Query, MessageId::Datalog_Query,
+		MessageId::Datalog_Stop, MessageId::Datalog_Erase
+	};
+	REQUIRE(receiver.received == expected);
+	REQUIRE(receiver.queries == std::vector<unsigned int>({0, 3}));
+
+	// The link is only requested while a command sequence is in progress
+	std::vector<bool> links = {true, false, true, false, true, false, true, false};
+	REQUIRE(receiver.links == links);
+
+	// A new datalog is read from its first entry
+	REQUIRE(manager.startLogging());
+	REQUIRE(manager.readBatch());
+	REQUIRE(receiver.queries.back() == 0);
+}
+
+TEST_CASE( "Failed datalog read back keeps logging", "[device][DatalogManager]" ) {
+	DatalogManager manager;
+	FakeReceiver receiver(manager);
+	BatchRecorder recorder;
+
+	manager.sendMessageRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onMessage));
+	manager.batchReady.connect(SlotFactory::create(recorder, &BatchRecorder::onBatch));
+
+	manager.startLogging();
+	receiver.failQuery = true;
+	REQUIRE(manager.readBatch());
+
+	REQUIRE(manager.getState() == DatalogState::Logging);
+	REQUIRE(recorder.batches.empty());
+
+	// The next read back starts from the same entry
+	receiver.failQuery = false;
+	REQUIRE(manager.readBatch());
+	REQUIRE(recorder.batches.size() == 1);
+	REQUIRE(recorder.batches[0].size() == 3);
+}
+
+TEST_CASE( "Unanswered datalog commands fail after the answer timeout", "[device][DatalogManager]" ) {
+	DatalogManager manager(DatalogCriteria(), milliseconds(500));
+	FakeReceiver receiver(manager);
+	BatchRecorder recorder;
+	std::vector<DatalogState> failures;
+
+	DatalogManager::time_point now;
+	manager.setClock([&now] () { return now; });
+
+	manager.sendMessageRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onMessage));
+	manager.linkRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onLink));
+	manager.batchReady.connect(SlotFactory::create(recorder, &BatchRecorder::onBatch));
+	manager.commandFailed.connect(SlotFactory::create(
+		std::function<void(DatalogState)>([&failures] (DatalogState state) {
+			failures.push_back(state);
+		})
+	));
+
+	REQUIRE_FALSE(manager.answerDeadline());
+
+	SECTION( "Configuring" ) {
+		// The create is answered, the start isn't: the answer restarted the delay
+		receiver.unanswered = {MessageId::Datalog_Start};
+		REQUIRE(manager.startLogging());
+		REQUIRE(manager.getState() == DatalogState::Configuring);
+		REQUIRE(manager.answerDeadline() == now + milliseconds(500));
+
+		now += milliseconds(499);
+		manager.check();
+		REQUIRE(manager.getState() == DatalogState::Configuring);
+		REQUIRE(receiver.links == std::vector<bool>({true}));
+
+		now += milliseconds(1);
+		manager.check();
+		REQUIRE(manager.getState() == DatalogState::Idle);
+		REQUIRE(receiver.links == std::vector<bool>({true, false}));
+		REQUIRE(failures == std::vector<DatalogState>({DatalogState::Configuring}));
+		REQUIRE_FALSE(manager.answerDeadline());
+
+		// A late answer is ignored, the manager starts again from idle
+		manager.onDatalogAnswer(DatalogAnswer::StartOk);
+		REQUIRE(manager.getState() == DatalogState::Idle);
+
+		receiver.unanswered.clear();
+		REQUIRE(manager.startLogging());
+		REQUIRE(manager.getState() == DatalogState::Logging);
+	}
+
+	SECTION( "Reading" ) {
+		REQUIRE(manager.startLogging());
+
+		// Entries are read back but the query never ends
+		receiver.unanswered = {MessageId::Datalog_Query};
+		REQUIRE(manager.readBatch());
+		for(unsigned int i = 0; i < 3; i++)
+		{
+			now += milliseconds(400);
+			manager.onDatalogEntry(i, Location());
+			manager.check();
+			REQUIRE(manager.getState() == DatalogState::Reading);
+		}
+
+		now += milliseconds(500);
+		manager.check();
+		REQUIRE(manager.getState() == DatalogState::Idle);
+		REQUIRE(failures == std::vector<DatalogState>({DatalogState::Reading}));
+		REQUIRE(recorder.batches.empty());
+		REQUIRE(receiver.links == std::vector<bool>({true, false, true, false}));
+	}
+
+	SECTION( "Stopping" ) {
+		REQUIRE(manager.startLogging());
+
+		receiver.unanswered = {MessageId::Datalog_Erase};
+		REQUIRE(manager.stopLogging());
+		REQUIRE(manager.getState() == DatalogState::Stopping);
+
+		now += milliseconds(500);
+		manager.check();
+		REQUIRE(manager.getState() == DatalogState::Idle);
+		REQUIRE(failures == std::vector<DatalogState>({DatalogState::Stopping}));
+		REQUIRE(receiver.links == std::vector<bool>({true, false, true, false}));
+	}
+
+	SECTION( "Logging" ) {
+		// No command in progress, nothing to fail
+		REQUIRE(manager.startLogging());
+		now += milliseconds(10000);
+		manager.check();
+		REQUIRE(manager.getState() == DatalogState::Logging);
+		REQUIRE(failures.empty());
+	}
+}
+
+TEST_CASE( "Datalog timer releases the link of an unanswered command", "[device][DatalogManager]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	DatalogManager manager(DatalogCriteria(), milliseconds(100));
+	FakeReceiver receiver(manager);
+	DatalogTimer timer(manager);
+	std::atomic<bool> linkUp(false);
+
+	manager.sendMessageRequest.connect(SlotFactory::create(receiver, &FakeReceiver::onMessage));
+	manager.linkRequest.connect(SlotFactory::create(
+		std::function<void(bool)>([&linkUp] (bool up) { linkUp = up; })
+	));
+	manager.deadlineChanged.connect(SlotFactory::create(timer, &DatalogTimer::onDeadlineChanged));
+
+	timer.start();
+
+	// Idle, the timer waits for a command without deadline
+	std::this_thread::sleep_for(milliseconds(50));
+
+	receiver.unanswered = {MessageId::Datalog_Create};
+	auto begin = steady_clock::now();
+	REQUIRE(manager.startLogging());
+	REQUIRE(linkUp);
+
+	REQUIRE(waitUntil([&] () { return manager.getState() == DatalogState::Idle; }, milliseconds(1000)));
+	auto elapsed = duration_cast<milliseconds>(steady_clock::now() - begin);
+	REQUIRE(elapsed >= milliseconds(100));
+	REQUIRE(elapsed < milliseconds(500));
+	REQUIRE_FALSE(linkUp);
+
+	timer.stop();
+	timer.join();
+}
+
+TEST_CASE( "Datalog round trip over a pty", "[device][DatalogManager][pty]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	// One receiver second lasts 20 ms
+	const milliseconds second(20);
+	const milliseconds session(2000);
+
+	WakeMeter meter;
+	utils::Wakelock::acquire.connect(SlotFactory::create(meter, &WakeMeter::acquire));
+	utils::Wakelock::release.connect(SlotFactory::create(meter, &WakeMeter::release));
+
+	DatalogEmulator receiver(second);
+	BatchRecorder recorder;
+	std::vector<Location> streamed;
+	std::mutex streamedMutex;
+
+	{
+		Host host(receiver.slavePath());
+		DatalogManager manager;
+
+		manager.sendMessageRequest.connect(SlotFactory::create(host.device, &AbstractDevice::sendMessageRequest));
+		manager.linkRequest.connect(SlotFactory::create(host, &Host::link));
+		manager.batchReady.connect(SlotFactory::create(recorder, &BatchRecorder::onBatch));
+		host.device.onDatalogAnswer.connect(SlotFactory::create(manager, &DatalogManager::onDatalogAnswer));
+		host.device.onDatalogEntry.connect(SlotFactory::create(manager, &DatalogManager::onDatalogEntry));
+		host.device.locationUpdate.connect(SlotFactory::create(
+			std::function<void(const Location &)>([&] (const Location & loc) {
+				std::lock_guard<std::mutex> lock(streamedMutex);
+				streamed.push_back(loc);
+			})
+		));
+
+		// Streaming reference: the host receives every fix
+		meter.reset();
+		receiver.streaming = true;
+		host.link(true);
+		std::this_thread::sleep_for(session);
+		host.link(false);
+		receiver.streaming = false;
+		REQUIRE(waitUntil([&] () { return !host.decoder.isRunning(); }, milliseconds(1000)));
+		milliseconds streamingWake = meter.reset();
+
+		// Datalog: configure, sleep, read back twice, stop
+		REQUIRE(manager.startLogging());
+		REQUIRE(waitUntil([&] () { return manager.getState() == DatalogState::Logging; }, milliseconds(1000)));
+
+		for(std::size_t n = 1; n <= 2; n++)
+		{
+			std::this_thread::sleep_for(session / 2);
+
+			REQUIRE(manager.readBatch());
+			REQUIRE(recorder.waitFor(n, milliseconds(2000)));
+		}
+
+		REQUIRE(manager.stopLogging());
+		REQUIRE(waitUntil([&] () { return manager.getState() == DatalogState::Idle; }, milliseconds(1000)));
+		REQUIRE(waitUntil([&] () { return !host.decoder.isRunning(); }, milliseconds(1000)));
+		milliseconds datalogWake = meter.reset();
+
+		std::vector<Location> batch = recorder.batches[0];
+		batch.insert(batch.end(), recorder.batches[1].begin(), recorder.batches[1].end());
+
+		// The whole datalog was erased on stop
+		REQUIRE(recorder.batches[0].size() > 0);
+		REQUIRE(recorder.batches[1].size() > 0);
+		REQUIRE(batch.size() <= receiver.logged);
+		REQUIRE(receiver.erased == receiver.logged);
+		REQUIRE(receiver.logSize() == 0);
+
+		// Entries are decoded like the streamed ones, read once and without gap between batches
+		for(std::size_t i = 1; i < batch.size(); i++)
+		{
+			REQUIRE(batch[i].timestamp() - batch[i - 1].timestamp() == 1000);
+			REQUIRE(batch[i].latitude() > batch[i - 1].latitude());
+		}
+		REQUIRE(batch[0].altitude() == Approx(120.5));
+		REQUIRE(batch[0].speed() == Approx(1.).epsilon(0.01));
+		REQUIRE(batch[0].bearing() == Approx(90.));
+
+		double expectedLatitude = 45.1 + (batch[0].timestamp() / 1000 % 86400) * 0.0001;
+		REQUIRE(batch[0].latitude() == Approx(expectedLatitude).epsilon(1e-6));
+
+		std::ostringstream report;
+		report << "Session " << session.count() << " ms: streaming wake " << streamingWake.count()
+		       << " ms (" << streamed.size() << " fixes), datalog wake " << datalogWake.count()
+		       << " ms (" << batch.size() << " fixes in 2 batches), "
+		       << static_cast<int>(100. * (1. - static_cast<double>(datalogWake.count()) / streamingWake.count()))
+		       << "% less host wake time";
+		WARN(report.str());
+
+		REQUIRE(datalogWake * 4 < streamingWake);
+		REQUIRE(streamed.size() > 0);
+
+		receiver.hangUp();
+	}
+}
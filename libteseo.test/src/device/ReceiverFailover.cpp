@@ -0,0 +1,487 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <mutex>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/device/ReceiverFailover.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/protocol/NmeaEncoder.h>
+#include <teseo/utils/NmeaStream.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/utils/UartByteStream.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::device;
+
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+namespace {
+
+using time_point = ReceiverFailover::time_point;
+
+const double primaryLatitude = 45.;
+const double standbyLatitude = 46.;
+
+struct Publication {
+	time_point time;
+	Receiver source;
+};
+
+/**
+ * Record the published locations, the source is recognized from the latitude
+ */
+struct Recorder : public Trackable {
+	std::mutex mutex;
+	std::vector<Publication> publications;
+	std::function<time_point()> now;
+
+	Recorder(std::function<time_point()> now) : now(now) { }
+
+	void onLocation(const Location & loc)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Receiver source = std::fabs(loc.latitude() - standbyLatitude) < 0.5 ? Receiver::Standby : Receiver::Primary;
+		publications.push_back(Publication{now(), source});
+	}
+
+	/**
+	 * Longest time between two publications after `from`
+	 */
+	milliseconds longestGap(time_point from)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		milliseconds gap(0);
+
+		for(std::size_t i = 1; i < publications.size(); i++)
+		{
+			if(publications[i].time < from)
+				continue;
+
+			gap = std::max(gap, duration_cast<milliseconds>(publications[i].time - publications[i - 1].time));
+		}
+
+		return gap;
+	}
+
+	/**
+	 * Time of the first publication of `source` after `from`
+	 */
+	std::optional<time_point> first(Receiver source, time_point from)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		for(const auto & p : publications)
+			if(p.time >= from && p.source == source)
+				return p.time;
+
+		return {};
+	}
+
+	std::size_t count(Receiver source, time_point from)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::size_t n = 0;
+
+		for(const auto & p : publications)
+			if(p.time >= from && p.source == source)
+				n++;
+
+		return n;
+	}
+
+	Receiver last()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return publications.back().source;
+	}
+};
+
+Location fix(double latitude)
+{
+	Location loc;
+	loc.quality(FixQuality::GPS);
+	loc.location(latitude, 7.);
+	return loc;
+}
+
+/**
+ * Virtual clock simulation of two receivers, the standby is standbyLag late on the primary
+ */
+struct Simulation {
+	FailoverSettings settings;
+	ReceiverFailover failover;
+	time_point start;
+	time_point now;
+	Recorder recorder;
+
+	bool primaryTalks = true;
+	bool primaryFixes = true;
+	bool standbyTalks = true;
+
+	milliseconds standbyLag = milliseconds(300);
+
+	Simulation() :
+		failover(settings),
+		start(time_point() + std::chrono::hours(1)),
+		now(start),
+		recorder([this] () { return now; })
+	{
+		failover.locationUpdate.connect(SlotFactory::create(recorder, &Recorder::onLocation));
+	}
+
+	void epoch(Receiver receiver, bool withFix, double latitude)
+	{
+		// The location of the previous epoch is published on the first sentence
+		for(int i = 0; i < 4; i++)
+		{
+			time_point t = now + milliseconds(20 * i);
+			failover.sentence(receiver, t);
+
+			if(i == 0 && withFix)
+				failover.location(receiver, fix(latitude), t);
+		}
+	}
+
+	/**
+	 * Run the receivers for `duration`, in 100 ms steps
+	 */
+	void run(milliseconds duration)
+	{
+		time_point end = now + duration;
+
+		while(now < end)
+		{
+			auto phase = duration_cast<milliseconds>(now - start).count() % 1000;
+
+			if(phase == 0 && primaryTalks)
+				epoch(Receiver::Primary, primaryFixes, primaryLatitude);
+
+			if(phase == standbyLag.count() && standbyTalks)
+				epoch(Receiver::Standby, true, standbyLatitude);
+
+			now += milliseconds(100);
+		}
+	}
+};
+
+TEST_CASE( "Publications of both decoder threads are serialized", "[device][ReceiverFailover]" ) {
+	FailoverSettings settings;
+	settings.cadenceTimeout = milliseconds(50);
+	settings.fixTimeout = milliseconds(20);
+	settings.demoteAfter = milliseconds(60000);
+
+	ReceiverFailover failover(settings);
+
+	std::mutex mutex;
+	std::atomic<int> inSlot(0);
+	std::atomic<bool> overlapped(false);
+	std::atomic<bool> primaryAfterSwitch(false);
+	bool switched = false;
+
+	auto enter = [&] () {
+		if(inSlot++ != 0)
+			overlapped = true;
+
+		// Widen the window of a concurrent publication
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	};
+
+	failover.activeChanged.connect(SlotFactory::create(std::function<void(Receiver)>(
+		[&] (Receiver r) {
+			enter();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				switched = (r == Receiver::Standby);
+			}
+			inSlot--;
+		})));
+
+	failover.locationUpdate.connect(SlotFactory::create(std::function<void(const Location &)>(
+		[&] (const Location & loc) {
+			enter();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if(switched && std::fabs(loc.latitude() - primaryLatitude) < 0.5)
+					primaryAfterSwitch = true;
+			}
+			inSlot--;
+		})));
+
+	// The primary loses its fix midway, while both threads keep publishing
+	auto receiver = [&failover] (Receiver r, double latitude, bool losesFix) {
+		for(int i = 0; i < 400; i++)
+		{
+			auto now = ReceiverFailover::Clock::now();
+			Location loc = (losesFix && i >= 100) ? Location() : fix(latitude);
+
+			failover.sentence(r, now);
+			failover.location(r, loc, now);
+
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	};
+
+	std::thread primary(receiver, Receiver::Primary, primaryLatitude, true);
+	std::thread standby(receiver, Receiver::Standby, standbyLatitude, false);
+
+	primary.join();
+	standby.join();
+
+	REQUIRE(failover.getActive() == Receiver::Standby);
+	REQUIRE_FALSE(overlapped);
+	REQUIRE_FALSE(primaryAfterSwitch);
+}
+
+// ====================== Linux pty stand-ins =====================
+
+/**
+ * Receiver replaying one epoch every period on the master side of a pseudo-terminal, with the
+ * HAL receive pipeline on the slave side
+ */
+class PtyReceiver {
+private:
+	PseudoTerminal pty;
+	std::thread emitter;
+	std::atomic<bool> running;
+	milliseconds period;
+	int latitudeDegrees;
+
+	void emit()
+	{
+		unsigned int n = 0;
+		auto next = std::chrono::steady_clock::now();
+
+		while(running)
+		{
+			if(talking)
+			{
+				unsigned int seconds = n++;
+				char time[16];
+				snprintf(time, sizeof(time), "%02u%02u%02u.00", (seconds / 3600) % 24, (seconds / 60) % 60, seconds % 60);
+
+				std::ostringstream gga;
+				gga << "GPGGA," << time << "," << latitudeDegrees << "00.0000,N,00700.0000,E,1,08,0.9,100.0,M,47.0,M,,";
+
+				std::string epoch =
+					sentence(gga.str()) +
+					sentence("GPGSA,A,3,01,02,03,04,05,06,07,08,,,,,1.5,0.9,1.2") +
+					sentence("GPGSV,2,1,08,01,40,083,46,02,17,308,41,03,07,344,39,04,22,228,45") +
+					sentence("GPGSV,2,2,08,05,40,083,46,06,17,308,41,07,07,344,39,08,22,228,45");
+
+				ssize_t written = ::write(pty.master(), epoch.data(), epoch.size());
+				(void)written;
+			}
+
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+public:
+	std::atomic<bool> talking;
+	NmeaDevice device;
+	decoder::NmeaDecoder decoder;
+	protocol::NmeaEncoder encoder;
+	stream::NmeaStream nmea;
+	stream::IStream & nmeaStream;
+	stream::UartByteStream * uart;
+
+	PtyReceiver(milliseconds period, int latitudeDegrees) :
+		running(true),
+		period(period),
+		latitudeDegrees(latitudeDegrees),
+		talking(true),
+		decoder(device),
+		nmeaStream(nmea)
+	{
+		uart = new stream::UartByteStream(pty.slavePath(), 115200);
+
+		uart->newBytes.connect(SlotFactory::create(nmeaStream, &stream::IStream::onNewBytes));
+		nmeaStream.newSentence.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::onNewBytes));
+		device.sendMessage.connect(SlotFactory::create(encoder, &protocol::IEncoder::encode));
+		encoder.encodedBytes.connect(SlotFactory::create(nmeaStream, &stream::IStream::write));
+		nmeaStream.newBytesToWrite.connect(SlotFactory::create(*uart, &stream::IByteStream::write));
+		device.startNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::start));
+		device.startNavigation.connect(SlotFactory::create(*uart, &stream::IByteStream::start));
+		device.stopNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::stop));
+		device.stopNavigation.connect(SlotFactory::create(*uart, &stream::IByteStream::stop));
+	}
+
+	void start(milliseconds phase)
+	{
+		device.start();
+
+		for(int i = 0; i < 100 && uart->status() != stream::ByteStreamStatus::OPENED; i++)
+			std::this_thread::sleep_for(milliseconds(5));
+
+		std::this_thread::sleep_for(phase);
+		emitter = std::thread(&PtyReceiver::emit, this);
+	}
+
+	~PtyReceiver()
+	{
+		running = false;
+		if(emitter.joinable())
+			emitter.join();
+
+		device.stop();
+		decoder.join();
+
+		// Hang up the line to unblock the reader
+		pty.close();
+		std::this_thread::sleep_for(milliseconds(50));
+
+		delete uart;
+	}
+};
+
+} // namespace
+
+TEST_CASE( "Stalled primary fails over within one epoch", "[device][ReceiverFailover]" ) {
+	Simulation sim;
+
+	sim.run(milliseconds(10000));
+	REQUIRE(sim.failover.getActive() == Receiver::Primary);
+	REQUIRE(sim.recorder.count(Receiver::Standby, sim.start) == 0);
+
+	time_point stall = sim.now;
+	sim.primaryTalks = false;
+	sim.run(milliseconds(5000));
+
+	REQUIRE(sim.failover.getActive() == Receiver::Standby);
+	REQUIRE(sim.recorder.last() == Receiver::Standby);
+
+	// The first primary epoch missed is at `stall`, the standby fix of that epoch is published
+	auto failover = sim.recorder.first(Receiver::Standby, stall);
+	REQUIRE(failover);
+	REQUIRE(*failover - stall < sim.settings.epochPeriod);
+	REQUIRE(sim.recorder.longestGap(stall) <= sim.settings.epochPeriod + sim.standbyLag);
+}
+
+TEST_CASE( "Primary without fix fails over to the standby", "[device][ReceiverFailover]" ) {
+	Simulation sim;
+
+	sim.run(milliseconds(10000));
+	time_point loss = sim.now;
+	sim.primaryFixes = false;
+	sim.run(milliseconds(5000));
+
+	REQUIRE(sim.failover.getActive() == Receiver::Standby);
+	REQUIRE(sim.recorder.count(Receiver::Standby, loss) >= 2);
+	REQUIRE(sim.recorder.longestGap(loss) <= sim.settings.fixTimeout + sim.settings.epochPeriod);
+}
+
+TEST_CASE( "Standby is demoted once the primary recovered", "[device][ReceiverFailover]" ) {
+	Simulation sim;
+
+	sim.run(milliseconds(5000));
+	sim.primaryTalks = false;
+	sim.run(milliseconds(5000));
+	REQUIRE(sim.failover.getActive() == Receiver::Standby);
+
+	time_point recovery = sim.now;
+	sim.primaryTalks = true;
+	sim.run(sim.settings.demoteAfter - milliseconds(1000));
+	REQUIRE(sim.failover.getActive() == Receiver::Standby);
+
+	sim.run(milliseconds(3000));
+	REQUIRE(sim.failover.getActive() == Receiver::Primary);
+	REQUIRE(sim.recorder.last() == Receiver::Primary);
+	REQUIRE(sim.failover.getSwitchCount() == 2);
+	REQUIRE(sim.recorder.longestGap(recovery) <= sim.settings.epochPeriod);
+}
+
+TEST_CASE( "Failed standby is not selected", "[device][ReceiverFailover]" ) {
+	Simulation sim;
+
+	sim.run(milliseconds(5000));
+	sim.standbyTalks = false;
+	sim.run(milliseconds(5000));
+	sim.primaryTalks = false;
+	sim.run(milliseconds(5000));
+
+	REQUIRE(sim.failover.getActive() == Receiver::Primary);
+	REQUIRE(sim.failover.getSwitchCount() == 0);
+
+	// Standby back while the primary is still silent
+	sim.standbyTalks = true;
+	sim.run(milliseconds(2000));
+	REQUIRE(sim.failover.getActive() == Receiver::Standby);
+}
+
+TEST_CASE( "Failover between two pty receivers", "[device][ReceiverFailover][pty]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	const milliseconds period(200);
+	const milliseconds standbyLag(70);
+
+	FailoverSettings settings;
+	settings.epochPeriod = period;
+	settings.cadenceTimeout = milliseconds(50);
+	settings.fixTimeout = milliseconds(500);
+	settings.demoteAfter = milliseconds(1000);
+
+	ReceiverFailover failover(settings);
+	Recorder recorder([] () { return ReceiverFailover::Clock::now(); });
+	failover.locationUpdate.connect(SlotFactory::create(recorder, &Recorder::onLocation));
+
+	PtyReceiver primary(period, 45);
+	PtyReceiver standby(period, 46);
+
+	primary.device.onNmea.connect(SlotFactory::create(failover, &ReceiverFailover::onPrimaryNmea));
+	primary.device.locationUpdate.connect(SlotFactory::create(failover, &ReceiverFailover::onPrimaryLocation));
+	primary.device.satelliteListUpdate.connect(SlotFactory::create(failover, &ReceiverFailover::onPrimarySatelliteList));
+	standby.device.onNmea.connect(SlotFactory::create(failover, &ReceiverFailover::onStandbyNmea));
+	standby.device.locationUpdate.connect(SlotFactory::create(failover, &ReceiverFailover::onStandbyLocation));
+	standby.device.satelliteListUpdate.connect(SlotFactory::create(failover, &ReceiverFailover::onStandbySatelliteList));
+
+	primary.start(milliseconds(0));
+	standby.start(standbyLag);
+
+	std::this_thread::sleep_for(milliseconds(1500));
+	REQUIRE(failover.getActive() == Receiver::Primary);
+
+	// Primary UART stalls
+	auto stall = ReceiverFailover::Clock::now();
+	primary.talking = false;
+	std::this_thread::sleep_for(milliseconds(1000));
+
+	REQUIRE(failover.getActive() == Receiver::Standby);
+	milliseconds failoverGap = recorder.longestGap(stall);
+
+	// Primary comes back
+	auto recovery = ReceiverFailover::Clock::now();
+	primary.talking = true;
+	std::this_thread::sleep_for(milliseconds(2000));
+
+	REQUIRE(failover.getActive() == Receiver::Primary);
+	REQUIRE(recorder.last() == Receiver::Primary);
+	milliseconds demotionGap = recorder.longestGap(recovery);
+
+	std::ostringstream report;
+	report << "Epoch period " << period.count() << " ms, "
+	       << "failover gap " << failoverGap.count() << " ms, "
+	       << "demotion gap " << demotionGap.count() << " ms, "
+	       << "switches " << failover.getSwitchCount();
+	WARN(report.str());
+
+	// No epoch is missed on either switch, with some scheduling slack
+	REQUIRE(failoverGap < period + standbyLag + milliseconds(50));
+	REQUIRE(demotionGap < period + milliseconds(50));
+	REQUIRE(failover.getSwitchCount() == 2);
+}
@@ -0,0 +1,984 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/device/SkyPredictor.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/protocol/NmeaEncoder.h>
+#include <teseo/utils/NmeaCapture.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::device;
+
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// Reference model constants, the orbits are integrated independently of the almanac equations
+constexpr double gpsPi = 3.1415926535898;
+constexpr double mu = 3.986005e14;
+constexpr double earthRotation = 7.2921151467e-5;
+constexpr double secondsPerWeek = 604800.;
+constexpr double l1Wavelength = 299792458. / 1575.42e6;
+constexpr double degrees = 180. / M_PI;
+
+constexpr unsigned int referenceWeek = 2023;
+constexpr double referenceToa = 405504.;
+
+using Vector = std::array<double, 3>;
+
+Vector operator + (const Vector & a, const Vector & b) { return {{a[0] + b[0], a[1] + b[1], a[2] + b[2]}}; }
+Vector operator - (const Vector & a, const Vector & b) { return {{a[0] - b[0], a[1] - b[1], a[2] - b[2]}}; }
+Vector operator * (double k, const Vector & a) { return {{k * a[0], k * a[1], k * a[2]}}; }
+double dot(const Vector & a, const Vector & b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+double norm(const Vector & a) { return std::sqrt(dot(a, a)); }
+
+/**
+ * Physical orbital elements of a satellite
+ */
+struct Elements {
+	uint8_t prn;
+	double eccentricity;
+	double inclination;
+	double rightAscensionRate;
+	double sqrtA;
+	double rightAscension;
+	double perigee;
+	double meanAnomaly;
+};
+
+/**
+ * Constellation of 31 satellites on 6 planes, close to the GPS one
+ */
+std::vector<Elements> constellation()
+{
+	std::vector<Elements> sats;
+	const unsigned int perPlane[6] = {6, 5, 5, 5, 5, 5};
+	uint8_t prn = 1;
+
+	for(unsigned int plane = 0; plane < 6; plane++)
+	{
+		for(unsigned int slot = 0; slot < perPlane[plane]; slot++, prn++)
+		{
+			sats.push_back(Elements{
+				prn,
+				0.002 + 0.003 * ((prn * 7) % 6),
+				(55. + 0.6 * ((prn * 3) % 5) - 1.2) / degrees,
+				-8.0e-9 - 0.1e-9 * (prn % 4),
+				5153.6 + 0.05 * ((prn * 5) % 9),
+				(-180. + 60. * plane + 3. * slot) / degrees,
+				(-170. + 23. * ((prn * 11) % 15)) / degrees,
+				std::remainder(360. / perPlane[plane] * slot + 17. * plane + 1., 360.) / degrees
+			});
+		}
+	}
+
+	return sats;
+}
+
+uint32_t fixedPoint(double value, int exponent, int bits)
+{
+	return static_cast<uint32_t>(std::lround(std::ldexp(value, -exponent))) & ((1u << bits) - 1);
+}
+
+/**
+ * Almanac of the elements, IS-GPS-200 scale factors
+ */
+model::GpsAlmanac encode(const Elements & el, unsigned int week = referenceWeek, double toa = referenceToa)
+{
+	model::GpsAlmanac alm;
+	alm.d.satid = el.prn;
+	alm.d.week = week;
+	alm.d.toa = static_cast<uint32_t>(toa / 4096.);
+	alm.d.eccentricity = fixedPoint(el.eccentricity, -21, 16);
+	alm.d.delta_i = fixedPoint(el.inclination / gpsPi - 0.3, -19, 16);
+	alm.d.omega_dot = fixedPoint(el.rightAscensionRate / gpsPi, -38, 16);
+	alm.d.root_a = fixedPoint(el.sqrtA, -11, 24);
+	alm.d.omega_zero = fixedPoint(el.rightAscension / gpsPi, -23, 24);
+	alm.d.perigee = fixedPoint(el.perigee / gpsPi, -23, 24);
+	alm.d.mean_anomaly = fixedPoint(el.meanAnomaly / gpsPi, -23, 24);
+	alm.d.available = 1;
+	alm.d.health = 0;
+	return alm;
+}
+
+std::map<uint8_t, model::GpsAlmanac> almanacs(const std::vector<Elements> & sats)
+{
+	std::map<uint8_t, model::GpsAlmanac> result;
+
+	for(const auto & el : sats)
+		result[el.prn] = encode(el);
+
+	return result;
+}
+
+double gpsTime(unsigned int week, double tow)
+{
+	return week * secondsPerWeek + tow;
+}
+
+GpsUtcTime toUtc(double gpsSeconds)
+{
+	return static_cast<GpsUtcTime>(std::llround((gpsSeconds - 18.) * 1000.)) + 315964800000ull;
+}
+
+/**
+ * Satellite state in an inertial frame aligned with the earth frame at the almanac reference time
+ */
+struct State {
+	Vector position;
+	Vector velocity;
+};
+
+State keplerState(const Elements & el)
+{
+	double a = el.sqrtA * el.sqrtA;
+	double n = std::sqrt(mu / (a * a * a));
+	double e = el.eccentricity;
+
+	double ea = el.meanAnomaly;
+	for(int i = 0; i < 50; i++)
+		ea = el.meanAnomaly + e * std::sin(ea);
+
+	double b = a * std::sqrt(1. - e * e);
+	double rate = n / (1. - e * std::cos(ea));
+
+	Vector p = {{a * (std::cos(ea) - e), b * std::sin(ea), 0.}};
+	Vector v = {{-a * std::sin(ea) * rate, b * std::cos(ea) * rate, 0.}};
+
+	// Perifocal to inertial: node at its value at the reference time, seen from the earth frame
+	double node = el.rightAscension - earthRotation * referenceToa;
+	double cO = std::cos(node), sO = std::sin(node);
+	double cI = std::cos(el.inclination), sI = std::sin(el.inclination);
+	double cW = std::cos(el.perigee), sW = std::sin(el.perigee);
+
+	auto rotate = [&] (const Vector & u) {
+		double x = cW * u[0] - sW * u[1];
+		double y = sW * u[0] + cW * u[1];
+		return Vector{{cO * x - sO * cI * y, sO * x + cO * cI * y, sI * y}};
+	};
+
+	return State{rotate(p), rotate(v)};
+}
+
+State derivative(const State & s)
+{
+	double r = norm(s.position);
+	return State{s.velocity, (-mu / (r * r * r)) * s.position};
+}
+
+/**
+ * Two body RK4 integration from the almanac reference time, then rotation to the earth frame with
+ * the node regression
+ */
+State referenceState(const Elements & el, double dt)
+{
+	State s = keplerState(el);
+	const double step = 30.;
+	double done = 0.;
+
+	while(std::fabs(dt - done) > 1e-9)
+	{
+		double h = std::copysign(std::min(step, std::fabs(dt - done)), dt);
+
+		State k1 = derivative(s);
+		State k2 = derivative(State{s.position + (h / 2) * k1.position, s.velocity + (h / 2) * k1.velocity});
+		State k3 = derivative(State{s.position + (h / 2) * k2.position, s.velocity + (h / 2) * k2.velocity});
+		State k4 = derivative(State{s.position + h * k3.position, s.velocity + h * k3.velocity});
+
+		s.position = s.position + (h / 6) * (k1.position + 2. * k2.position + 2. * k3.position + k4.position);
+		s.velocity = s.velocity + (h / 6) * (k1.velocity + 2. * k2.velocity + 2. * k3.velocity + k4.velocity);
+		done += h;
+	}
+
+	double rate = el.rightAscensionRate - earthRotation;
+	double theta = rate * dt;
+	double c = std::cos(theta), sn = std::sin(theta);
+
+	Vector p = {{c * s.position[0] - sn * s.position[1], sn * s.position[0] + c * s.position[1], s.position[2]}};
+	Vector v = {{c * s.velocity[0] - sn * s.velocity[1], sn * s.velocity[0] + c * s.velocity[1], s.velocity[2]}};
+
+	return State{p, v + rate * Vector{{-p[1], p[0], 0.}}};
+}
+
+struct Site {
+	const char * name;
+	double latitude;
+	double longitude;
+	double altitude;
+};
+
+const std::vector<Site> sites = {
+	{"Grenoble", 45.188, 5.724, 212.},
+	{"Sydney", -33.868, 151.209, 58.},
+	{"Tromso", 69.649, 18.956, 10.},
+	{"Quito", -0.180, -78.467, 2850.},
+};
+
+/**
+ * Satellite seen from a site by the reference model
+ */
+struct Observation {
+	uint8_t prn;
+	double elevation;
+	double azimuth;
+	double doppler;
+};
+
+std::vector<Observation> observe(const std::vector<State> & states, const std::vector<Elements> & sats, const Site & site)
+{
+	double lat = site.latitude / degrees, lon = site.longitude / degrees;
+	double n = 6378137. / std::sqrt(1. - 6.69437999014e-3 * std::sin(lat) * std::sin(lat));
+
+	Vector up = {{std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat)}};
+	Vector east = {{-std::sin(lon), std::cos(lon), 0.}};
+	Vector north = {{-std::sin(lat) * std::cos(lon), -std::sin(lat) * std::sin(lon), std::cos(lat)}};
+	Vector observer = {{
+		(n + site.altitude) * up[0],
+		(n + site.altitude) * up[1],
+		(n * (1. - 6.69437999014e-3) + site.altitude) * up[2]
+	}};
+
+	std::vector<Observation> seen;
+
+	for(std::size_t i = 0; i < states.size(); i++)
+	{
+		Vector los = states[i].position - observer;
+		double range = norm(los);
+		double elevation = std::asin(dot(los, up) / range) * degrees;
+
+		if(elevation < 0.)
+			continue;
+
+		double azimuth = std::atan2(dot(los, east), dot(los, north)) * degrees;
+		if(azimuth < 0.)
+			azimuth += 360.;
+
+		seen.push_back(Observation{
+			sats[i].prn,
+			elevation,
+			azimuth,
+			-dot(states[i].velocity, los) / range / l1Wavelength
+		});
+	}
+
+	return seen;
+}
+
+std::string gga(GpsUtcTime utc, double latitude, double longitude, double altitude)
+{
+	std::time_t seconds = static_cast<std::time_t>(utc / 1000);
+	std::tm tm;
+	gmtime_r(&seconds, &tm);
+
+	char body[128];
+	snprintf(body, sizeof(body), "GPGGA,%02d%02d%02d.00,%02d%07.4f,%c,%03d%07.4f,%c,1,08,1.0,%.1f,M,0.0,M,,",
+		tm.tm_hour, tm.tm_min, tm.tm_sec,
+		static_cast<int>(std::fabs(latitude)), std::fmod(std::fabs(latitude), 1.) * 60., latitude < 0 ? 'S' : 'N',
+		static_cast<int>(std::fabs(longitude)), std::fmod(std::fabs(longitude), 1.) * 60., longitude < 0 ? 'W' : 'E',
+		altitude);
+
+	return sentence(body);
+}
+
+/**
+ * GSV sentences of the observations, elevation and azimuth rounded to the degree as the receiver
+ * outputs them
+ */
+std::vector<std::string> gsv(std::vector<Observation> seen)
+{
+	std::sort(seen.begin(), seen.end(), [] (const Observation & a, const Observation & b) {
+		return a.prn < b.prn;
+	});
+
+	std::vector<std::string> out;
+	std::size_t total = (seen.size() + 3) / 4;
+
+	for(std::size_t s = 0; s < total; s++)
+	{
+		std::ostringstream body;
+		body << "GPGSV," << total << ',' << (s + 1) << ',' << seen.size();
+
+		for(std::size_t i = s * 4; i < std::min(seen.size(), s * 4 + 4); i++)
+		{
+			char sat[32];
+			snprintf(sat, sizeof(sat), ",%02u,%02ld,%03ld,40",
+				seen[i].prn, std::lround(seen[i].elevation), std::lround(seen[i].azimuth) % 360);
+			body << sat;
+		}
+
+		out.push_back(sentence(body.str()));
+	}
+
+	return out;
+}
+
+/**
+ * Decoder fed with sentences directly, without the stream and the decoder thread
+ */
+class TestDecoder : public decoder::NmeaDecoder {
+public:
+	TestDecoder(device::AbstractDevice & device) :
+		decoder::NmeaDecoder(device)
+	{ }
+
+	void feed(std::string s)
+	{
+		// The stream strips the line end
+		while(!s.empty() && (s.back() == '\r' || s.back() == '\n'))
+			s.pop_back();
+
+		decode(ByteVectorPtr(new ByteVector(s.begin(), s.end())));
+	}
+};
+
+/**
+ * Epoch published by the device
+ */
+struct Epoch {
+	Location location;
+	std::map<SatIdentifier, SatInfo> satellites;
+};
+
+void record(AbstractDevice & device, std::vector<Epoch> & epochs)
+{
+	device.locationUpdate.connect(SlotFactory::create(std::function<void(const Location &)>(
+		[&epochs] (const Location & loc) {
+			epochs.push_back(Epoch{loc, {}});
+		})));
+
+	device.satelliteListUpdate.connect(SlotFactory::create(std::function<void(const std::map<SatIdentifier, SatInfo> &)>(
+		[&epochs] (const std::map<SatIdentifier, SatInfo> & sats) {
+			if(!epochs.empty())
+				epochs.back().satellites = sats;
+		})));
+}
+
+struct Comparison {
+	unsigned int epochs = 0;
+	unsigned int compared = 0;
+	unsigned int missed = 0;
+	unsigned int extra = 0;
+	double elevationError = 0.;
+	double azimuthError = 0.;
+	double elevationErrorSum = 0.;
+	std::ostringstream mismatches;
+};
+
+/**
+ * Compare a prediction with the GPS satellites reported in GSV, the GSV elevations are rounded to
+ * the degree, so a margin is left around the mask
+ */
+void compare(
+	const std::vector<PredictedSatellite> & predicted,
+	const std::map<SatIdentifier, SatInfo> & reported,
+	const std::map<uint8_t, model::GpsAlmanac> & known,
+	float mask,
+	Comparison & result)
+{
+	const double margin = 1.;
+	std::map<uint8_t, SatInfo> gps;
+
+	for(const auto & it : reported)
+	{
+		if(it.first.getConstellation() == Constellation::Gps && it.first.getPrn() >= 1 && it.first.getPrn() <= 32)
+			gps.emplace(static_cast<uint8_t>(it.first.getPrn()), it.second);
+	}
+
+	result.epochs++;
+
+	for(const auto & it : gps)
+	{
+		bool isPredicted = std::any_of(predicted.begin(), predicted.end(), [&] (const PredictedSatellite & p) {
+			return p.prn == it.first;
+		});
+
+		if(!isPredicted && known.count(it.first) && it.second.getElevation() >= mask + margin)
+		{
+			result.mismatches << "missed PRN " << int(it.first) << " at elevation " << it.second.getElevation() << "; ";
+			result.missed++;
+		}
+	}
+
+	for(const auto & p : predicted)
+	{
+		auto it = gps.find(p.prn);
+
+		if(it == gps.end() || it->second.getElevation() < mask - margin)
+		{
+			result.mismatches << "extra PRN " << int(p.prn) << " predicted at elevation " << p.elevation << "; ";
+			result.extra++;
+			continue;
+		}
+
+		double elevationError = std::fabs(p.elevation - it->second.getElevation());
+		result.elevationError = std::max(result.elevationError, elevationError);
+		result.elevationErrorSum += elevationError;
+		result.compared++;
+
+		// Azimuth is poorly defined close to the zenith
+		if(p.elevation < 80.)
+		{
+			double azimuthError = std::fabs(std::remainder(p.azimuth - it->second.getAzimuth(), 360.));
+			result.azimuthError = std::max(result.azimuthError, azimuthError);
+		}
+	}
+}
+
+ByteVector readCapture(const char * path)
+{
+	std::ifstream file(path, std::ios::binary);
+	ByteVector raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if(raw.size() >= 4 && std::equal(raw.begin(), raw.begin() + 4, "NMZ1"))
+	{
+		ByteVector decoded;
+		capture::NmeaCaptureDecoder::decode(raw, decoded);
+		raw.swap(decoded);
+	}
+
+	return raw;
+}
+
+/**
+ * Midnight of a ddmmyy date, in UTC
+ */
+GpsUtcTime dateToUtc(const std::string & date)
+{
+	std::tm tm = {};
+	tm.tm_mday = std::stoi(date.substr(0, 2));
+	tm.tm_mon = std::stoi(date.substr(2, 2)) - 1;
+	tm.tm_year = 100 + std::stoi(date.substr(4, 2));
+	return static_cast<GpsUtcTime>(timegm(&tm)) * 1000;
+}
+
+} // namespace
+
+TEST_CASE( "Almanac orbits follow the integrated reference", "[device][SkyPredictor]" ) {
+	auto sats = constellation();
+
+	SECTION( "Fields are decoded with the IS-GPS-200 scale factors" ) {
+		for(const auto & el : sats)
+		{
+			auto orbit = AlmanacOrbit::from(encode(el));
+			REQUIRE(orbit);
+			CHECK(orbit->prn == el.prn);
+			CHECK(orbit->week == referenceWeek);
+			CHECK(orbit->toa == referenceToa);
+			CHECK(orbit->eccentricity == Approx(el.eccentricity).margin(1e-6));
+			CHECK(orbit->inclination == Approx(el.inclination).margin(1e-5));
+			CHECK(orbit->rightAscensionRate == Approx(el.rightAscensionRate).margin(1e-11));
+			CHECK(orbit->sqrtA == Approx(el.sqrtA).margin(1e-3));
+			CHECK(orbit->rightAscension == Approx(el.rightAscension).margin(1e-6));
+			CHECK(orbit->perigee == Approx(el.perigee).margin(1e-6));
+			CHECK(orbit->meanAnomaly == Approx(el.meanAnomaly).margin(1e-6));
+		}
+	}
+
+	SECTION( "Unhealthy or unavailable satellites are ignored" ) {
+		model::GpsAlmanac unhealthy = encode(sats[0]);
+		unhealthy.d.health = 1;
+		CHECK_FALSE(AlmanacOrbit::from(unhealthy));
+
+		model::GpsAlmanac unavailable = encode(sats[0]);
+		unavailable.d.available = 0;
+		CHECK_FALSE(AlmanacOrbit::from(unavailable));
+	}
+
+	SECTION( "Truncated weeks resolve to the closest week" ) {
+		auto full = AlmanacOrbit::from(encode(sats[3]));
+		auto truncated = AlmanacOrbit::from(encode(sats[3], referenceWeek % 1024));
+
+		for(double dt : {-3 * 86400., 0., 5 * 86400.})
+		{
+			Ecef a = full->position(gpsTime(referenceWeek, referenceToa) + dt);
+			Ecef b = truncated->position(gpsTime(referenceWeek, referenceToa) + dt);
+			CHECK(a.x == Approx(b.x).margin(1e-3));
+			CHECK(a.y == Approx(b.y).margin(1e-3));
+			CHECK(a.z == Approx(b.z).margin(1e-3));
+		}
+	}
+
+	SECTION( "Positions match the two body integration over a week" ) {
+		for(const auto & el : sats)
+		{
+			auto orbit = AlmanacOrbit::from(encode(el));
+
+			for(double dt : {-3 * 86400., -3600., 0., 7200., 3 * 86400.})
+			{
+				State ref = referenceState(el, dt);
+				Ecef p = orbit->position(gpsTime(referenceWeek, referenceToa) + dt);
+
+				// The quantized semi-major axis drifts along the track, a few hundred meters in 3 days
+				INFO("PRN " << int(el.prn) << " dt " << dt);
+				CHECK(norm(Vector{{p.x, p.y, p.z}} - ref.position) < 500.);
+			}
+		}
+	}
+}
+
+TEST_CASE( "Sky prediction injects the almanacs the receiver lacks at start", "[device][SkyPredictor]" ) {
+	auto sats = constellation();
+	GpsUtcTime now = toUtc(gpsTime(referenceWeek, referenceToa) + 7200.);
+	const Site & site = sites[0];
+
+	// Almanacs dumped by the receiver
+	NmeaDevice receiver;
+	TestDecoder dumpDecoder(receiver);
+	SkyPredictor predictor("");
+	predictor.setClock([&now] () { return now; });
+	receiver.onAlmanac.connect(SlotFactory::create(predictor, &SkyPredictor::onAlmanac));
+
+	for(const auto & el : sats)
+	{
+		ByteVector data;
+		data << encode(el);
+		ByteVector hex = utils::to_ascii(data, true);
+
+		std::ostringstream body;
+		body << "PSTMALMANAC," << int(el.prn) << ',' << data.size() << ',' << std::string(hex.begin(), hex.end());
+		dumpDecoder.feed(sentence(body.str()));
+	}
+
+	REQUIRE(predictor.almanacCount() == sats.size());
+
+	// Corrupted dumps are dropped
+	dumpDecoder.feed(sentence("PSTMALMANAC,33,40,ZZ"));
+	CHECK(predictor.almanacCount() == sats.size());
+
+	std::vector<model::Message> messages;
+	predictor.sendMessageRequest.connect(SlotFactory::create(std::function<void(const model::Message &)>(
+		[&messages] (const model::Message & m) { messages.push_back(m); })));
+
+	std::map<SatIdentifier, SatInfo> expected;
+	predictor.expectedSatellites.connect(SlotFactory::create(std::function<void(const std::map<SatIdentifier, SatInfo> &)>(
+		[&expected] (const std::map<SatIdentifier, SatInfo> & s) { expected = s; })));
+
+	SECTION( "Nothing is injected without position" ) {
+		predictor.onStart();
+		CHECK(messages.empty());
+		CHECK(expected.empty());
+	}
+
+	SECTION( "A platform location is used until the receiver has a fix" ) {
+		predictor.onInjectLocation(site.latitude, site.longitude, 1000.f);
+		predictor.onStart();
+		CHECK_FALSE(expected.empty());
+
+		Location fix;
+		fix.quality(FixQuality::GPS);
+		fix.location(-33.868, 151.209);
+		fix.altitude(0.);
+		predictor.onLocation(fix);
+		predictor.onInjectLocation(site.latitude, site.longitude, 1000.f);
+
+		auto fromFix = SkyPredictor::predict(almanacs(sats), fix, now, 5.f);
+		auto prediction = predictor.predictNow();
+		REQUIRE(prediction.size() == fromFix.size());
+		CHECK(prediction.front().prn == fromFix.front().prn);
+	}
+
+	SECTION( "Predicted almanacs the receiver lacks are injected and round trip through NMEA" ) {
+		Location fix;
+		fix.quality(FixQuality::GPS);
+		fix.location(site.latitude, site.longitude);
+		fix.altitude(site.altitude);
+		predictor.onLocation(fix);
+
+		// Almanacs are fresh, no dump requested
+		CHECK(messages.empty());
+
+		predictor.onStart();
+		auto prediction = predictor.lastPrediction();
+
+		REQUIRE(prediction.size() >= 6);
+		CHECK(expected.size() == prediction.size());
+		REQUIRE(messages.size() == 1);
+		CHECK(messages[0].id == model::MessageId::DumpAlmanac);
+		messages.clear();
+
+		for(std::size_t i = 1; i < prediction.size(); i++)
+			CHECK(prediction[i - 1].elevation >= prediction[i].elevation);
+
+		// Receiver without almanac after a backup power loss, the highest satellite excepted
+		for(const auto & el : sats)
+		{
+			model::GpsAlmanac missing;
+			missing.d.satid = el.prn;
+			predictor.onAlmanac(el.prn == prediction.front().prn ? encode(el) : missing);
+		}
+
+		REQUIRE(messages.size() == prediction.size() - 1);
+		CHECK(predictor.almanacCount() == sats.size());
+
+		// Once stopped, nothing more is injected
+		predictor.onStop();
+		model::GpsAlmanac missing;
+		missing.d.satid = prediction.back().prn;
+		predictor.onAlmanac(missing);
+		REQUIRE(messages.size() == prediction.size() - 1);
+
+		NmeaDevice target;
+		TestDecoder injectDecoder(target);
+		protocol::NmeaEncoder encoder;
+		std::vector<model::GpsAlmanac> injected;
+
+		target.onAlmanac.connect(SlotFactory::create(std::function<void(const model::GpsAlmanac &)>(
+			[&injected] (const model::GpsAlmanac & a) { injected.push_back(a); })));
+		encoder.encodedBytes.connect(SlotFactory::create(std::function<void(ByteVectorPtr)>(
+			[&injectDecoder] (ByteVectorPtr bytes) { injectDecoder.feed(sentence(std::string(bytes->begin(), bytes->end()))); })));
+
+		for(const auto & m : messages)
+		{
+			CHECK(m.id == model::MessageId::Stagps_RealTime_Almanac);
+			encoder.encode(target, m);
+		}
+
+		REQUIRE(injected.size() == messages.size());
+
+		for(const auto & a : injected)
+		{
+			CHECK(a.d.satid != prediction.front().prn);
+			CHECK(expected.count(SatIdentifier(a.d.satid)));
+
+			model::GpsAlmanac original = encode(sats[a.d.satid - 1]);
+			CHECK(std::equal(a.raw, a.raw + sizeof(a.raw), original.raw));
+		}
+	}
+}
+
+TEST_CASE( "Sky prediction store and almanac refresh", "[device][SkyPredictor]" ) {
+	auto sats = constellation();
+	GpsUtcTime now = toUtc(gpsTime(referenceWeek, referenceToa));
+
+	char path[] = "/tmp/sky-store-XXXXXX";
+	int fd = mkstemp(path);
+	REQUIRE(fd >= 0);
+	close(fd);
+	unlink(path);
+
+	Location fix;
+	fix.quality(FixQuality::GPS);
+	fix.location(sites[1].latitude, sites[1].longitude);
+	fix.altitude(sites[1].altitude);
+
+	unsigned int dumps = 0;
+	auto countDumps = [&dumps] (const model::Message & m) {
+		if(m.id == model::MessageId::DumpAlmanac)
+			dumps++;
+	};
+
+	{
+		SkyPredictor predictor(path, 5.f, 3600 * 1000);
+		predictor.setClock([&now] () { return now; });
+		predictor.sendMessageRequest.connect(SlotFactory::create(std::function<void(const model::Message &)>(countDumps)));
+
+		CHECK_FALSE(predictor.load());
+
+		// Empty store, one dump per session
+		predictor.onLocation(fix);
+		predictor.onLocation(fix);
+		CHECK(dumps == 1);
+
+		for(const auto & el : sats)
+			predictor.onAlmanac(encode(el));
+
+		// With a prediction, the dump is requested at start instead
+		predictor.onStop();
+		predictor.onStart();
+		predictor.onLocation(fix);
+		CHECK(dumps == 2);
+	}
+
+	SkyPredictor reloaded(path, 5.f, 3600 * 1000);
+	reloaded.setClock([&now] () { return now; });
+	REQUIRE(reloaded.load());
+	CHECK(reloaded.almanacCount() == sats.size());
+
+	auto expected = SkyPredictor::predict(almanacs(sats), fix, now, 5.f);
+	auto prediction = reloaded.predictNow();
+
+	REQUIRE(prediction.size() == expected.size());
+	for(std::size_t i = 0; i < prediction.size(); i++)
+	{
+		CHECK(prediction[i].prn == expected[i].prn);
+		CHECK(prediction[i].elevation == Approx(expected[i].elevation).margin(1e-3));
+	}
+
+	unlink(path);
+}
+
+TEST_CASE( "Without prediction at start, stale almanacs are refreshed after the first fix", "[device][SkyPredictor]" ) {
+	auto sats = constellation();
+	GpsUtcTime now = toUtc(gpsTime(referenceWeek, referenceToa));
+
+	Location fix;
+	fix.quality(FixQuality::GPS);
+	fix.location(sites[1].latitude, sites[1].longitude);
+	fix.altitude(sites[1].altitude);
+
+	unsigned int dumps = 0;
+	SkyPredictor predictor("", 5.f, 3600 * 1000);
+	predictor.setClock([&now] () { return now; });
+	predictor.sendMessageRequest.connect(SlotFactory::create(std::function<void(const model::Message &)>(
+		[&dumps] (const model::Message & m) {
+			if(m.id == model::MessageId::DumpAlmanac)
+				dumps++;
+		})));
+
+	for(const auto & el : sats)
+		predictor.onAlmanac(encode(el));
+
+	// No position, nothing predicted
+	predictor.onStart();
+	CHECK(dumps == 0);
+
+	SECTION( "Fresh almanacs" ) {
+		now += 1800 * 1000;
+		predictor.onLocation(fix);
+		CHECK(dumps == 0);
+	}
+
+	SECTION( "Stale almanacs" ) {
+		now += 2 * 3600 * 1000;
+		predictor.onLocation(fix);
+		predictor.onLocation(fix);
+		CHECK(dumps == 1);
+	}
+}
+
+TEST_CASE( "Expected satellites are published until the first GSV", "[device][SkyPredictor]" ) {
+	NmeaDevice device;
+	TestDecoder decoder(device);
+	std::vector<Epoch> epochs;
+	std::vector<std::size_t> published;
+
+	record(device, epochs);
+	device.satelliteListUpdate.connect(SlotFactory::create(std::function<void(const std::map<SatIdentifier, SatInfo> &)>(
+		[&published] (const std::map<SatIdentifier, SatInfo> & sats) { published.push_back(sats.size()); })));
+
+	auto sats = constellation();
+	Location position;
+	position.location(sites[0].latitude, sites[0].longitude);
+	position.altitude(sites[0].altitude);
+
+	GpsUtcTime now = toUtc(gpsTime(referenceWeek, referenceToa));
+	auto prediction = SkyPredictor::predict(almanacs(sats), position, now, 5.f);
+	REQUIRE_FALSE(prediction.empty());
+
+	device.setExpectedSatellites(SkyPredictor::toSatelliteList(prediction));
+	REQUIRE(published.size() == 1);
+	CHECK(published[0] == prediction.size());
+
+	// Epoch without satellites
+	decoder.feed(gga(now, sites[0].latitude, sites[0].longitude, sites[0].altitude));
+	decoder.feed(gga(now + 1000, sites[0].latitude, sites[0].longitude, sites[0].altitude));
+	REQUIRE(epochs.size() == 1);
+	CHECK(epochs[0].satellites.size() == prediction.size());
+	CHECK_FALSE(epochs[0].satellites.begin()->second.isTracked());
+
+	// First epoch reported by the receiver
+	decoder.feed(sentence("GPGSV,1,1,02,07,45,120,40,09,20,300,35"));
+	decoder.feed(gga(now + 2000, sites[0].latitude, sites[0].longitude, sites[0].altitude));
+	REQUIRE(epochs.size() == 2);
+	CHECK(epochs[1].satellites.size() == 2);
+
+	// The expected list isn't used anymore
+	decoder.feed(gga(now + 3000, sites[0].latitude, sites[0].longitude, sites[0].altitude));
+	REQUIRE(epochs.size() == 3);
+	CHECK(epochs[2].satellites.empty());
+}
+
+TEST_CASE( "Sky prediction matches the reported satellites", "[device][SkyPredictor]" ) {
+	const float mask = 5.f;
+	Comparison result;
+
+	const char * almanacPath = std::getenv("SKY_ALMANAC");
+	const char * capturePath = std::getenv("SKY_CAPTURE");
+	const char * date = std::getenv("SKY_DATE");
+
+	std::map<uint8_t, model::GpsAlmanac> known;
+	std::vector<std::vector<PredictedSatellite>> predictions;
+	std::vector<Epoch> epochs;
+	NmeaDevice device;
+	TestDecoder decoder(device);
+	record(device, epochs);
+
+	if(almanacPath && capturePath && date)
+	{
+		// Recorded session, with the almanac store of the same receiver
+		SkyPredictor predictor(almanacPath, mask);
+		REQUIRE(predictor.load());
+
+		ByteVector capture = readCapture(capturePath);
+		std::istringstream lines(std::string(capture.begin(), capture.end()));
+		std::string line;
+
+		while(std::getline(lines, line))
+		{
+			while(!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+				line.pop_back();
+
+			if(!line.empty() && line[0] == '$')
+				decoder.feed(line);
+		}
+
+		GpsUtcTime midnight = dateToUtc(date);
+
+		for(const auto & epoch : epochs)
+		{
+			GpsUtcTime utc = midnight + epoch.location.timestamp() % (24 * 3600 * 1000);
+			predictor.setClock([utc] () { return utc; });
+			predictor.onLocation(epoch.location);
+			predictions.push_back(predictor.predictNow());
+		}
+
+		// Satellites without almanac can't be predicted
+		for(unsigned int prn = 1; prn <= 32; prn++)
+		{
+			bool present = std::any_of(predictions.begin(), predictions.end(), [prn] (const std::vector<PredictedSatellite> & p) {
+				return std::any_of(p.begin(), p.end(), [prn] (const PredictedSatellite & s) { return s.prn == prn; });
+			});
+
+			if(present)
+				known[prn] = model::GpsAlmanac();
+		}
+	}
+	else
+	{
+		// Synthetic session, the GSV comes from the integrated reference orbits
+		auto sats = constellation();
+		known = almanacs(sats);
+
+		double maxDopplerError = 0.;
+
+		for(double dt : {-3 * 86400., -36 * 3600., -6 * 3600., 0., 5400., 20 * 3600., 3 * 86400.})
+		{
+			std::vector<State> states;
+			for(const auto & el : sats)
+				states.push_back(referenceState(el, dt));
+
+			GpsUtcTime utc = toUtc(gpsTime(referenceWeek, referenceToa) + dt);
+
+			for(const auto & site : sites)
+			{
+				auto seen = observe(states, sats, site);
+
+				decoder.feed(gga(utc, site.latitude, site.longitude, site.altitude));
+				for(const auto & s : gsv(seen))
+					decoder.feed(s);
+
+				Location position;
+				position.location(site.latitude, site.longitude);
+				position.altitude(site.altitude);
+				predictions.push_back(SkyPredictor::predict(known, position, utc, mask));
+
+				for(const auto & p : predictions.back())
+				{
+					for(const auto & o : seen)
+					{
+						if(o.prn == p.prn)
+							maxDopplerError = std::max(maxDopplerError, std::fabs(o.doppler - p.doppler));
+					}
+				}
+			}
+		}
+
+		// Publish the last epoch
+		decoder.feed(gga(toUtc(gpsTime(referenceWeek, referenceToa)), 0., 0., 0.));
+
+		INFO("Doppler error: " << maxDopplerError << " Hz");
+		CHECK(maxDopplerError < 10.);
+	}
+
+	REQUIRE(epochs.size() >= predictions.size());
+	REQUIRE_FALSE(predictions.empty());
+
+	for(std::size_t i = 0; i < predictions.size(); i++)
+		compare(predictions[i], epochs[i].satellites, known, mask, result);
+
+	std::ostringstream report;
+	report << "Sky prediction over " << result.epochs << " epochs: "
+	       << result.compared << " satellites compared, "
+	       << result.missed << " missed, " << result.extra << " extra, "
+	       << "elevation error " << (result.compared ? result.elevationErrorSum / result.compared : 0.)
+	       << " mean / " << result.elevationError << " max, "
+	       << "azimuth error " << result.azimuthError << " max (degrees)";
+	WARN(report.str());
+
+	INFO(result.mismatches.str());
+	CHECK(result.compared > 0);
+	CHECK(result.missed == 0);
+	CHECK(result.extra == 0);
+	CHECK(result.elevationError <= 1.);
+	CHECK(result.azimuthError <= 1.5);
+}
+
+TEST_CASE( "Sky prediction compute cost per start", "[device][SkyPredictor]" ) {
+	auto sats = constellation();
+	GpsUtcTime now = toUtc(gpsTime(referenceWeek, referenceToa));
+
+	SkyPredictor predictor("");
+	predictor.setClock([&now] () { return now; });
+
+	for(const auto & el : sats)
+		predictor.onAlmanac(encode(el));
+
+	Location fix;
+	fix.quality(FixQuality::GPS);
+	fix.location(sites[0].latitude, sites[0].longitude);
+	fix.altitude(sites[0].altitude);
+	predictor.onLocation(fix);
+
+	// The start includes the encoding of the almanac dump request
+	NmeaDevice device;
+	protocol::NmeaEncoder encoder;
+	std::size_t bytes = 0;
+	encoder.encodedBytes.connect(SlotFactory::create(std::function<void(ByteVectorPtr)>(
+		[&bytes] (ByteVectorPtr b) { bytes += b->size(); })));
+	predictor.sendMessageRequest.connect(SlotFactory::create(std::function<void(const model::Message &)>(
+		[&encoder, &device] (const model::Message & m) { encoder.encode(device, m); })));
+
+	const unsigned int starts = 1000;
+	nanoseconds predictTime(0), startTime(0);
+
+	for(unsigned int i = 0; i < starts; i++)
+	{
+		now += 60 * 1000;
+
+		auto start = steady_clock::now();
+		auto prediction = predictor.predictNow();
+		predictTime += duration_cast<nanoseconds>(steady_clock::now() - start);
+
+		REQUIRE_FALSE(prediction.empty());
+
+		start = steady_clock::now();
+		predictor.onStart();
+		startTime += duration_cast<nanoseconds>(steady_clock::now() - start);
+	}
+
+	std::ostringstream report;
+	report << "Sky prediction of " << sats.size() << " almanacs: "
+	       << predictTime.count() / starts / 1000. << " us per prediction, "
+	       << startTime.count() / starts / 1000. << " us per start including the encoding of "
+	       << bytes / starts << " bytes";
+	WARN(report.str());
+}
@@ -0,0 +1,415 @@
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+#include <teseo/geofencing/manager.h>
+#include <teseo/geofencing/schedule.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::geofencing;
+using namespace stm::geofencing::model;
+
+using std::chrono::hours;
+using std::chrono::milliseconds;
+using std::chrono::minutes;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+using Event = GeofenceScheduler::Event;
+
+namespace {
+
+// Midnight UTC
+const time_point day = time_point(hours(24 * 17000));
+
+constexpr TransitionFlags allTransitions =
+	GPS_GEOFENCE_ENTERED | GPS_GEOFENCE_EXITED | GPS_GEOFENCE_UNCERTAIN;
+
+GeofenceDefinition fence(GeofenceId id, double latitude, double longitude, double radius, GeofenceSchedule schedule = {})
+{
+	GeofenceDefinition def;
+	def.id = id;
+	def.origin.latitude = DecimalDegreeCoordinate(latitude);
+	def.origin.longitude = DecimalDegreeCoordinate(longitude);
+	def.radius = radius;
+	def.last_transition = Transition::Exited;
+	def.monitor_transitions = allTransitions;
+	def.notifications_responsiveness = milliseconds(1000);
+	def.unknown_time = milliseconds(10000);
+	def.schedule = schedule;
+	return def;
+}
+
+Location fix(double latitude, double longitude)
+{
+	Location loc;
+	loc.quality(stm::FixQuality::GPS);
+	loc.location(latitude, longitude);
+	loc.accuracy(1.);
+	return loc;
+}
+
+GeofenceSchedule daily(hours start, hours duration)
+{
+	GeofenceSchedule s;
+	s.windows.push_back(ActivityWindow{start, duration, hours(24)});
+	return s;
+}
+
+std::vector<Event> events(const std::vector<GeofenceScheduler::Edge> & edges)
+{
+	std::vector<Event> v;
+	for(const auto & e : edges)
+		v.push_back(e.event);
+	return v;
+}
+
+struct Recorder : public Trackable {
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<std::pair<GeofenceId, Transition>> transitions;
+	std::vector<GeofenceId> expired;
+
+	void onTransition(GeofenceId id, const Location &, Transition t, GpsUtcTime)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		transitions.emplace_back(id, t);
+	}
+
+	void onExpired(GeofenceId id)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			expired.push_back(id);
+		}
+		cond.notify_all();
+	}
+
+	bool waitExpired(GeofenceId id, milliseconds timeout)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		return cond.wait_for(lock, timeout, [&] () {
+			return std::find(expired.begin(), expired.end(), id) != expired.end();
+		});
+	}
+};
+
+/**
+ * Manager driven by a virtual clock
+ */
+struct Fixture : public Trackable {
+	GeofencingManager manager;
+	Recorder recorder;
+	time_point now;
+
+	Fixture() :
+		now(day)
+	{
+		manager.setClock([this] () { return now; });
+		manager.sendGeofenceTransition.connect(SlotFactory::create(recorder, &Recorder::onTransition));
+		manager.geofenceExpired.connect(SlotFactory::create(recorder, &Recorder::onExpired));
+	}
+
+	void advance(time_point t)
+	{
+		now = t;
+		manager.advanceSchedule(t);
+	}
+};
+
+} // namespace
+
+TEST_CASE( "Geofence activity windows", "[geofencing][GeofenceScheduler]" ) {
+	SECTION( "Daily window" ) {
+		const GeofenceSchedule s = daily(hours(8), hours(10));
+
+		REQUIRE_FALSE(GeofenceScheduler::isActive(s, day + hours(7)));
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(8)));
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(17) + minutes(59)));
+		REQUIRE_FALSE(GeofenceScheduler::isActive(s, day + hours(18)));
+		REQUIRE(GeofenceScheduler::isActive(s, day - hours(24) + hours(9)));
+
+		REQUIRE(*GeofenceScheduler::nextChange(s, day) == day + hours(8));
+		REQUIRE(*GeofenceScheduler::nextChange(s, day + hours(8)) == day + hours(18));
+		REQUIRE(*GeofenceScheduler::nextChange(s, day + hours(20)) == day + hours(32));
+	}
+
+	SECTION( "Window open before the epoch" ) {
+		GeofenceSchedule s;
+		s.windows.push_back(ActivityWindow{hours(-2), hours(4), hours(24)});
+
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(1)));
+		REQUIRE_FALSE(GeofenceScheduler::isActive(s, day + hours(2)));
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(23)));
+	}
+
+	SECTION( "One-shot window" ) {
+		GeofenceSchedule s;
+		s.windows.push_back(ActivityWindow{
+			std::chrono::duration_cast<seconds>((day + hours(3)).time_since_epoch()), hours(1), seconds(0)});
+
+		REQUIRE_FALSE(GeofenceScheduler::isActive(s, day));
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(3)));
+		REQUIRE(*GeofenceScheduler::nextChange(s, day) == day + hours(3));
+		REQUIRE(*GeofenceScheduler::nextChange(s, day + hours(3)) == day + hours(4));
+		REQUIRE_FALSE(GeofenceScheduler::nextChange(s, day + hours(4)));
+	}
+
+	SECTION( "Unscheduled and always open" ) {
+		GeofenceSchedule s;
+		REQUIRE(GeofenceScheduler::isActive(s, day));
+		REQUIRE_FALSE(GeofenceScheduler::nextChange(s, day));
+
+		s.windows.push_back(ActivityWindow{hours(0), hours(24), hours(24)});
+		REQUIRE(GeofenceScheduler::isActive(s, day + hours(5)));
+		REQUIRE_FALSE(GeofenceScheduler::nextChange(s, day));
+	}
+}
+
+TEST_CASE( "Geofence scheduler edges", "[geofencing][GeofenceScheduler]" ) {
+	GeofenceScheduler scheduler;
+
+	SECTION( "Activation and deactivation" ) {
+		REQUIRE_FALSE(scheduler.add(1, daily(hours(8), hours(10)), day + hours(6)));
+		REQUIRE(*scheduler.nextEdge() == day + hours(8));
+		REQUIRE(scheduler.advance(day + hours(7)).empty());
+
+		auto edges = scheduler.advance(day + hours(8));
+		REQUIRE(edges.size() == 1);
+		REQUIRE(edges[0].id == 1);
+		REQUIRE(edges[0].event == Event::Activated);
+		REQUIRE(*scheduler.nextEdge() == day + hours(18));
+
+		REQUIRE(events(scheduler.advance(day + hours(18))) == std::vector<Event>({Event::Deactivated}));
+
+		// A late call reports every edge in order
+		REQUIRE(events(scheduler.advance(day + hours(24 * 2 + 12))) == std::vector<Event>({
+			Event::Activated, Event::Deactivated, Event::Activated
+		}));
+		REQUIRE(*scheduler.nextEdge() == day + hours(24 * 2 + 18));
+	}
+
+	SECTION( "Overlapping windows" ) {
+		GeofenceSchedule s = daily(hours(8), hours(4));
+		s.windows.push_back(ActivityWindow{hours(10), hours(4), hours(24)});
+
+		REQUIRE_FALSE(scheduler.add(1, s, day));
+		REQUIRE(events(scheduler.advance(day + hours(13))) == std::vector<Event>({Event::Activated}));
+		REQUIRE(*scheduler.nextEdge() == day + hours(14));
+		REQUIRE(events(scheduler.advance(day + hours(15))) == std::vector<Event>({Event::Deactivated}));
+	}
+
+	SECTION( "Expiry" ) {
+		GeofenceSchedule s = daily(hours(8), hours(10));
+		s.expiry = day + hours(12);
+
+		REQUIRE(scheduler.add(1, s, day + hours(9)));
+		REQUIRE(*scheduler.nextEdge() == day + hours(12));
+
+		auto edges = scheduler.advance(day + hours(30));
+		REQUIRE(edges.size() == 1);
+		REQUIRE(edges[0].event == Event::Expired);
+		REQUIRE_FALSE(scheduler.nextEdge());
+		REQUIRE(scheduler.pending() == 0);
+	}
+
+	SECTION( "Already expired" ) {
+		GeofenceSchedule s;
+		s.expiry = day;
+
+		REQUIRE_FALSE(scheduler.add(1, s, day + hours(1)));
+		REQUIRE(events(scheduler.advance(day + hours(1))) == std::vector<Event>({Event::Expired}));
+	}
+
+	SECTION( "Removed and rescheduled geofences" ) {
+		scheduler.add(1, daily(hours(8), hours(10)), day);
+		scheduler.add(2, daily(hours(9), hours(1)), day);
+		scheduler.add(1, daily(hours(10), hours(1)), day);
+		scheduler.remove(2);
+
+		REQUIRE(*scheduler.nextEdge() == day + hours(10));
+
+		auto edges = scheduler.advance(day + hours(10));
+		REQUIRE(edges.size() == 1);
+		REQUIRE(edges[0].id == 1);
+		REQUIRE(scheduler.pending() == 1);
+	}
+}
+
+TEST_CASE( "Geofence transition flags", "[geofencing][GeofencingManager]" ) {
+	REQUIRE(transitionFlagsIsValid(0));
+	REQUIRE(transitionFlagsIsValid(GPS_GEOFENCE_ENTERED));
+	REQUIRE(transitionFlagsIsValid(GPS_GEOFENCE_ENTERED | GPS_GEOFENCE_EXITED));
+	REQUIRE(transitionFlagsIsValid(allTransitions));
+	REQUIRE_FALSE(transitionFlagsIsValid(allTransitions | 0x10));
+
+	Fixture f;
+	f.manager.add(fence(1, 45., 7., 100.));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+
+	GeofenceDefinition invalid = fence(2, 45., 7., 100.);
+	invalid.monitor_transitions = 0x10;
+	f.manager.add(invalid);
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+}
+
+TEST_CASE( "Scheduled geofences are only evaluated when active","[geofencing][GeofencingManager][GeofenceScheduler]" ) {
+	Fixture f;
+
+	f.now = day + hours(6);
+	f.manager.add(fence(1, 45., 7., 100., daily(hours(8), hours(10))));
+	f.manager.add(fence(2, 45., 7., 100.));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+	REQUIRE(*f.manager.nextScheduleEdge() == day + hours(8));
+
+	// Only the unscheduled geofence is evaluated
+	f.manager.onLocationUpdate(fix(45., 7.));
+	REQUIRE(f.recorder.transitions.size() == 1);
+	REQUIRE(f.recorder.transitions[0].first == 2);
+
+	f.advance(day + hours(8));
+	REQUIRE(f.manager.activeGeofenceCount() == 2);
+	f.manager.onLocationUpdate(fix(45., 7.));
+	REQUIRE(f.recorder.transitions.size() == 2);
+	REQUIRE(f.recorder.transitions[1].first == 1);
+	REQUIRE(f.recorder.transitions[1].second == Transition::Entered);
+
+	// Nothing reported while inactive
+	f.advance(day + hours(18));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+	f.manager.onLocationUpdate(fix(46., 7.));
+	REQUIRE(f.recorder.transitions.size() == 3);
+	REQUIRE(f.recorder.transitions[2].first == 2);
+
+	// A removed geofence is not scheduled anymore
+	f.manager.remove(1);
+	f.advance(day + hours(32));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+	REQUIRE_FALSE(f.manager.nextScheduleEdge());
+}
+
+TEST_CASE( "Expired geofences are removed", "[geofencing][GeofencingManager][GeofenceScheduler]" ) {
+	Fixture f;
+
+	GeofenceSchedule s;
+	s.expiry = day + minutes(30);
+	f.manager.add(fence(1, 45., 7., 100., s));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+
+	f.advance(day + minutes(29));
+	REQUIRE(f.recorder.expired.empty());
+
+	f.advance(day + minutes(31));
+	REQUIRE(f.recorder.expired == std::vector<GeofenceId>({1}));
+	REQUIRE(f.manager.activeGeofenceCount() == 0);
+
+	f.manager.onLocationUpdate(fix(45., 7.));
+	REQUIRE(f.recorder.transitions.empty());
+
+	// The identifier can be used again
+	f.manager.add(fence(1, 45., 7., 100.));
+	REQUIRE(f.manager.activeGeofenceCount() == 1);
+}
+
+TEST_CASE( "Geofence timer expires geofences on time", "[geofencing][GeofenceTimer]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	GeofencingManager manager;
+	Recorder recorder;
+	GeofenceTimer timer(manager);
+
+	manager.geofenceExpired.connect(SlotFactory::create(recorder, &Recorder::onExpired));
+	manager.scheduleChanged.connect(SlotFactory::create(timer, &GeofenceTimer::onScheduleChanged));
+	timer.start();
+
+	// Added after the timer went to sleep without any edge
+	std::this_thread::sleep_for(milliseconds(20));
+
+	const auto start = steady_clock::now();
+	GeofenceSchedule s;
+	s.expiry = Clock::now() + milliseconds(100);
+	manager.add(fence(1, 45., 7., 100., s));
+
+	REQUIRE(recorder.waitExpired(1, milliseconds(2000)));
+	REQUIRE(steady_clock::now() - start >= milliseconds(90));
+	REQUIRE(manager.activeGeofenceCount() == 0);
+
+	timer.stop();
+	timer.join();
+}
+
+TEST_CASE( "Geofence timer follows the manager clock", "[geofencing][GeofenceTimer]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	GeofencingManager manager;
+	Recorder recorder;
+	GeofenceTimer timer(manager);
+
+	// A month ahead of the system clock, like a clock set from the receiver time
+	const auto offset = hours(24 * 30);
+	manager.setClock([offset] () { return Clock::now() + offset; });
+	manager.geofenceExpired.connect(SlotFactory::create(recorder, &Recorder::onExpired));
+	manager.scheduleChanged.connect(SlotFactory::create(timer, &GeofenceTimer::onScheduleChanged));
+
+	SECTION( "Edges are reached on the manager clock" ) {
+		timer.start();
+
+		GeofenceSchedule s;
+		s.expiry = manager.now() + milliseconds(100);
+		manager.add(fence(1, 45., 7., 100., s));
+
+		REQUIRE(recorder.waitExpired(1, milliseconds(2000)));
+		REQUIRE(manager.activeGeofenceCount() == 0);
+	}
+
+	SECTION( "Stop right after start" ) {
+		timer.start();
+	}
+
+	timer.stop();
+	timer.join();
+	REQUIRE_FALSE(timer.isRunning());
+}
+
+TEST_CASE( "Geofence evaluation cost depends on the active geofences", "[geofencing][GeofencingManager][benchmark]" ) {
+	constexpr int total = 2000;
+	constexpr int active = 20;
+	constexpr int fixes = 200;
+
+	auto measure = [&] (bool scheduled) {
+		Fixture f;
+		f.now = day + hours(6);
+
+		for(int i = 0; i < total; i++)
+		{
+			// Spread around the fixes, far enough to never be entered
+			GeofenceSchedule s = scheduled && i >= active ? daily(hours(8), hours(10)) : GeofenceSchedule{};
+			f.manager.add(fence(i, 45. + (i % 50) * 0.01, 7. + (i / 50) * 0.01, 10., s));
+		}
+
+		REQUIRE(f.manager.activeGeofenceCount() == static_cast<std::size_t>(scheduled ? active : total));
+
+		const auto start = steady_clock::now();
+		for(int i = 0; i < fixes; i++)
+			f.manager.onLocationUpdate(fix(44.5, 6.5 + i * 1e-5));
+
+		return std::chrono::duration<double, std::micro>(steady_clock::now() - start).count() / fixes;
+	};
+
+	const double all = measure(false);
+	const double scheduled = measure(true);
+
+	WARN("Per fix, " << total << " geofences: " << all << " us, " << active << " active of "
+		<< total << ": " << scheduled << " us");
+
+	REQUIRE(scheduled < all);
+}
@@ -0,0 +1,96 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <teseo/protocol/AbstractDecoder.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::decoder;
+
+namespace {
+
+/**
+ * Decoder recording the decoded bytes
+ */
+class RecordingDecoder : public AbstractDecoder {
+private:
+	std::mutex mutex;
+	std::string decoded;
+
+protected:
+	void decode(ByteVectorPtr bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.append(bytes->begin(), bytes->end());
+	}
+
+public:
+	std::string get()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return decoded;
+	}
+
+	void feed(const std::string & s)
+	{
+		onNewBytes(ByteVectorPtr(new ByteVector(s.begin(), s.end())));
+	}
+};
+
+bool waitFor(std::function<bool()> condition)
+{
+	for(int i = 0; i < 1000 && !condition(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	return condition();
+}
+
+} // namespace
+
+TEST_CASE( "Decoder restarts after a stop", "[protocol][AbstractDecoder]" ) {
+	Thread::setCreateThreadCb(&test::createThread);
+
+	RecordingDecoder decoder;
+
+	SECTION( "Stop right after start" ) {
+		// The stop request must not be lost if the thread isn't running yet
+		decoder.start();
+		REQUIRE(decoder.stop() == 0);
+		decoder.join();
+
+		REQUIRE_FALSE(decoder.isRunning());
+	}
+
+	SECTION( "Restart while waiting for bytes" ) {
+		decoder.start();
+		decoder.feed("a");
+		REQUIRE(waitFor([&] { return decoder.get() == "a"; }));
+
+		decoder.stop();
+		decoder.start();
+
+		decoder.feed("b");
+		REQUIRE(waitFor([&] { return decoder.get() == "ab"; }));
+		REQUIRE(decoder.isRunning());
+	}
+
+	SECTION( "Restart once stopped" ) {
+		decoder.start();
+		decoder.stop();
+		REQUIRE(waitFor([&] { return !decoder.isRunning(); }));
+
+		decoder.start();
+		decoder.feed("c");
+		REQUIRE(waitFor([&] { return decoder.get() == "c"; }));
+	}
+
+	decoder.stop();
+	decoder.join();
+
+	REQUIRE_FALSE(decoder.isRunning());
+}
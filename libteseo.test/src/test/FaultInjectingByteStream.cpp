@@ -0,0 +1,422 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Fault injecting byte stream decorator
+ * @file FaultInjectingByteStream.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/test/FaultInjectingByteStream.h>
+
+#define LOG_TAG "teseo_hal_FaultInjectingByteStream"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace stm {
+namespace stream {
+
+using std::chrono::steady_clock;
+
+namespace {
+
+/**
+ * Upstream lines longer than this aren't NMEA sentences
+ */
+constexpr std::size_t maxLineSize = 255;
+
+constexpr std::size_t never = std::numeric_limits<std::size_t>::max();
+
+int hexValue(uint8_t c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+/**
+ * Check a sentence is "$...*HH" with a matching checksum
+ */
+bool isValidSentence(const ByteVector & s)
+{
+	std::size_t n = s.size();
+
+	if(n < 4 || s[0] != '$' || s[n - 3] != '*')
+		return false;
+
+	int high = hexValue(s[n - 2]);
+	int low = hexValue(s[n - 1]);
+
+	if(high < 0 || low < 0)
+		return false;
+
+	uint8_t crc = 0;
+	for(std::size_t i = 1; i < n - 3; i++)
+		crc ^= s[i];
+
+	return crc == ((high << 4) | low);
+}
+
+} // namespace
+
+const char * toString(FaultType type)
+{
+	switch(type)
+	{
+		case FaultType::Drop:       return "drop";
+		case FaultType::BitFlip:    return "bit flip";
+		case FaultType::Truncate:   return "truncate";
+		case FaultType::Stall:      return "stall";
+		case FaultType::Disconnect: return "disconnect";
+	}
+
+	return "unknown";
+}
+
+FaultInjectingByteStream::FaultInjectingByteStream(IByteStream & inner, uint32_t seed) :
+	inner(inner),
+	streamName("faulty:" + inner.name()),
+	generator(seed),
+	nextScheduled(0),
+	nextRandom(never),
+	offset(0),
+	faultCount(0),
+	dropRemaining(0),
+	truncating(false),
+	disconnected(false),
+	faultInjected("FaultInjectingByteStream::faultInjected"),
+	inputSentence("FaultInjectingByteStream::inputSentence")
+{
+	line.reserve(maxLineSize);
+
+	inner.newBytes.connect(SlotFactory::create(*this, &FaultInjectingByteStream::onInnerBytes));
+}
+
+FaultInjectingByteStream::~FaultInjectingByteStream()
+{ }
+
+void FaultInjectingByteStream::setRates(const FaultRates & rates)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->rates = rates;
+	drawNextRandom();
+}
+
+void FaultInjectingByteStream::schedule(const Fault & fault)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(fault.offset < offset)
+	{
+		ALOGW("Fault scheduled at offset %zu ignored, %zu bytes already received", fault.offset, offset);
+		return;
+	}
+
+	auto it = std::upper_bound(scheduled.begin() + nextScheduled, scheduled.end(), fault,
+		[] (const Fault & a, const Fault & b) { return a.offset < b.offset; });
+
+	scheduled.insert(it, fault);
+}
+
+std::size_t FaultInjectingByteStream::received() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return offset;
+}
+
+void FaultInjectingByteStream::drawNextRandom()
+{
+	double total = rates.drop + rates.bitFlip + rates.truncate + rates.stall + rates.disconnect;
+
+	if(total <= 0.)
+	{
+		nextRandom = never;
+		return;
+	}
+
+	std::geometric_distribution<std::size_t> gap(std::min(total, 1.));
+	nextRandom = offset + 1 + gap(generator);
+}
+
+Fault FaultInjectingByteStream::drawFault()
+{
+	std::discrete_distribution<int> pick({rates.drop, rates.bitFlip, rates.truncate, rates.stall, rates.disconnect});
+
+	Fault fault;
+	fault.type = static_cast<FaultType>(pick(generator));
+	fault.offset = offset;
+	fault.length = fault.type == FaultType::Drop ? rates.dropLength : 0;
+	fault.duration = fault.type == FaultType::Stall ? rates.stallDuration :
+		fault.type == FaultType::Disconnect ? rates.disconnectDuration : std::chrono::milliseconds(0);
+
+	return fault;
+}
+
+void FaultInjectingByteStream::trackInput(uint8_t byte)
+{
+	if(byte == '$')
+		line.clear();
+
+	if(byte == '\r' || byte == '\n')
+	{
+		if(isValidSentence(line))
+			inputSentence(line);
+
+		line.clear();
+		return;
+	}
+
+	if(line.size() < maxLineSize)
+		line.push_back(byte);
+	else
+		line.clear();
+}
+
+uint8_t FaultInjectingByteStream::inject(const Fault & fault, ByteVector & out, std::unique_lock<std::mutex> & lock)
+{
+	FaultRecord record{faultCount++, fault, steady_clock::now()};
+	record.fault.offset = offset;
+
+	ALOGI("Inject %s at offset %zu", toString(fault.type), offset);
+	faultInjected(record);
+
+	switch(fault.type)
+	{
+		case FaultType::Drop:
+			dropRemaining = std::max(dropRemaining, fault.length);
+			break;
+
+		case FaultType::BitFlip:
+			return static_cast<uint8_t>(1 << std::uniform_int_distribution<int>(0, 7)(generator));
+
+		case FaultType::Truncate:
+			truncating = true;
+			break;
+
+		case FaultType::Stall:
+			// Deliver what precedes the fault, then hold the reader
+			lock.unlock();
+			if(!out.empty())
+				newBytes(out);
+			std::this_thread::sleep_for(fault.duration);
+			lock.lock();
+			out.clear();
+			break;
+
+		case FaultType::Disconnect:
+			disconnected = true;
+			reconnectAt = record.injectedAt + fault.duration;
+			break;
+	}
+
+	return 0;
+}
+
+void FaultInjectingByteStream::onInnerBytes(const ByteVector & bytes)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	ByteVector out;
+	out.reserve(bytes.size());
+
+	if(disconnected && steady_clock::now() >= reconnectAt)
+	{
+		ALOGI("Reconnected after %zu bytes", offset);
+		disconnected = false;
+	}
+
+	for(uint8_t byte : bytes)
+	{
+		trackInput(byte);
+
+		uint8_t mask = 0;
+
+		while(nextScheduled < scheduled.size() && scheduled[nextScheduled].offset <= offset)
+			mask ^= inject(scheduled[nextScheduled++], out, lock);
+
+		if(nextRandom <= offset)
+		{
+			mask ^= inject(drawFault(), out, lock);
+			drawNextRandom();
+		}
+
+		byte ^= mask;
+		offset++;
+
+		if(disconnected)
+			continue;
+
+		if(dropRemaining > 0)
+		{
+			dropRemaining--;
+			continue;
+		}
+
+		if(truncating)
+		{
+			if(byte != '\r' && byte != '\n')
+				continue;
+
+			truncating = false;
+		}
+
+		out.push_back(byte);
+	}
+
+	lock.unlock();
+
+	if(!out.empty())
+		newBytes(out);
+}
+
+void FaultInjectingByteStream::open() noexcept(false)
+{ }
+
+void FaultInjectingByteStream::close() noexcept(false)
+{ }
+
+void FaultInjectingByteStream::flush() noexcept(false)
+{ }
+
+ByteVector FaultInjectingByteStream::perform_read() noexcept(false)
+{
+	throw StreamNotOpenedException();
+}
+
+void FaultInjectingByteStream::perform_write(const ByteVectorPtr bytes) noexcept(false)
+{
+	inner.write(bytes);
+}
+
+const std::string & FaultInjectingByteStream::name() const
+{
+	return streamName;
+}
+
+ByteStreamStatus FaultInjectingByteStream::status() const
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(disconnected && steady_clock::now() < reconnectAt)
+			return ByteStreamStatus::CLOSED;
+	}
+
+	return inner.status();
+}
+
+void FaultInjectingByteStream::write(const ByteVectorPtr bytes)
+{
+	inner.write(bytes);
+}
+
+int FaultInjectingByteStream::start()
+{
+	return inner.start();
+}
+
+int FaultInjectingByteStream::stop()
+{
+	return inner.stop();
+}
+
+RecoveryMeter::RecoveryMeter() :
+	currentFault(-1),
+	passedFault(-1),
+	firstUnrecovered(0),
+	unattributed(0)
+{ }
+
+void RecoveryMeter::lose(const Pending & p)
+{
+	if(p.fault < 0)
+		unattributed++;
+	else
+		faults[p.fault].lostSentences++;
+}
+
+void RecoveryMeter::onFault(const FaultRecord & record)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	faults.push_back(Result{record, false, std::chrono::milliseconds(0), 0});
+	currentFault = static_cast<int>(faults.size()) - 1;
+}
+
+void RecoveryMeter::onInputSentence(const ByteVector & sentence)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.push_back(Pending{sentence, currentFault});
+}
+
+void RecoveryMeter::onSentence(ByteVectorPtr sentence)
+{
+	if(!isValidSentence(*sentence))
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = std::find_if(pending.begin(), pending.end(),
+		[&sentence] (const Pending & p) { return p.sentence == *sentence; });
+
+	// A corruption keeping the checksum valid
+	if(it == pending.end())
+		return;
+
+	for(auto lost = pending.begin(); lost != it; ++lost)
+		lose(*lost);
+
+	passedFault = std::max(passedFault, it->fault);
+	pending.erase(pending.begin(), it + 1);
+}
+
+void RecoveryMeter::onValidFix()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto now = steady_clock::now();
+
+	for(; firstUnrecovered <= passedFault; firstUnrecovered++)
+	{
+		Result & r = faults[firstUnrecovered];
+		r.recovered = true;
+		r.recovery = std::chrono::duration_cast<std::chrono::milliseconds>(now - r.record.injectedAt);
+	}
+}
+
+std::vector<RecoveryMeter::Result> RecoveryMeter::results() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return faults;
+}
+
+unsigned int RecoveryMeter::unattributedLosses() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return unattributed;
+}
+
+} // namespace stream
+} // namespace stm
@@ -0,0 +1,521 @@
+#include <catch.hpp>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <chrono>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/utils/AssistanceScheduler.h>
+#include <teseo/utils/http.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::assistance;
+
+using std::chrono::hours;
+using std::chrono::minutes;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+using std::chrono::steady_clock;
+
+/**
+ * Fake fetcher standing for the HTTP server, driven by a virtual clock
+ */
+class FakeFetcher : public IAssistanceFetcher {
+public:
+	time_point & now;
+	hours validity;
+	std::size_t size;
+	unsigned int failuresLeft;
+	std::map<std::string, unsigned int> downloads;
+
+	FakeFetcher(time_point & now, hours validity, std::size_t size) :
+		now(now),
+		validity(validity),
+		size(size),
+		failuresLeft(0)
+	{ }
+
+	FetchResult fetch(const std::string & id)
+	{
+		downloads[id]++;
+
+		if(failuresLeft > 0)
+		{
+			failuresLeft--;
+			return FetchResult{false, 0, time_point()};
+		}
+
+		return FetchResult{true, size, now + validity};
+	}
+};
+
+static SchedulerPolicy testPolicy()
+{
+	SchedulerPolicy policy;
+	policy.prefetchLead = minutes(30);
+	policy.coalesceWindow = minutes(90);
+	policy.backoffBase = seconds(60);
+	policy.backoffMax = seconds(600);
+	policy.backoffJitter = 0.;
+	policy.dailyBudget = 0;
+	return policy;
+}
+
+/**
+ * Run the scheduler against the virtual clock until `end`, always jumping to the next wakeup
+ */
+static void simulate(AssistanceScheduler & scheduler, FakeFetcher & fetcher, time_point & now, time_point end)
+{
+	while(true)
+	{
+		for(const auto & id : scheduler.poll(now))
+			scheduler.report(id, fetcher.fetch(id), now);
+
+		auto wakeup = scheduler.nextWakeup(now);
+		if(!wakeup || *wakeup > end)
+			break;
+
+		now = *wakeup > now ? *wakeup : now + seconds(1);
+	}
+
+	now = end;
+}
+
+TEST_CASE( "Assistance is refreshed before it expires", "[utils][AssistanceScheduler]" ) {
+	time_point now = time_point(hours(1000));
+	FakeFetcher fetcher(now, hours(6), 1000);
+	AssistanceScheduler scheduler(testPolicy());
+
+	scheduler.track("ephemeris", now + hours(2), 1000);
+
+	REQUIRE(scheduler.poll(now).empty());
+	REQUIRE(*scheduler.nextWakeup(now) == now + minutes(90));
+
+	simulate(scheduler, fetcher, now, now + minutes(90));
+	REQUIRE(fetcher.downloads["ephemeris"] == 1);
+	REQUIRE(*scheduler.validUntil("ephemeris") == now + hours(6));
+
+	// 24 hours of 6 hours validity: one refresh every 5h30
+	simulate(scheduler, fetcher, now, now + hours(24));
+	REQUIRE(fetcher.downloads["ephemeris"] == 5);
+}
+
+TEST_CASE( "Assistance refreshes are coalesced", "[utils][AssistanceScheduler]" ) {
+	time_point now = time_point(hours(1000));
+	FakeFetcher fetcher(now, hours(6), 1000);
+	AssistanceScheduler scheduler(testPolicy());
+
+	scheduler.track("gps", now + hours(1), 1000);
+	scheduler.track("glonass", now + hours(2), 1000);
+	scheduler.track("almanac", now + hours(12), 1000);
+
+	SECTION( "Items due soon are refreshed with the due one" ) {
+		auto ids = scheduler.poll(now + minutes(30));
+		REQUIRE(ids.size() == 2);
+		REQUIRE(ids[0] == "gps");
+		REQUIRE(ids[1] == "glonass");
+	}
+
+	SECTION( "A wakeup refreshes items due soon" ) {
+		REQUIRE(scheduler.poll(now, false).empty());
+
+		auto ids = scheduler.poll(now, true);
+		REQUIRE(ids.size() == 2);
+		REQUIRE(ids[0] == "gps");
+		REQUIRE(ids[1] == "glonass");
+	}
+
+	SECTION( "In flight items are not returned twice" ) {
+		REQUIRE(scheduler.poll(now + minutes(30)).size() == 2);
+		REQUIRE(scheduler.poll(now + minutes(31)).empty());
+	}
+}
+
+TEST_CASE( "Failed refreshes back off exponentially", "[utils][AssistanceScheduler]" ) {
+	time_point now = time_point(hours(1000));
+	FakeFetcher fetcher(now, hours(6), 1000);
+	AssistanceScheduler scheduler(testPolicy());
+
+	scheduler.track("ephemeris", now + minutes(30), 1000);
+	fetcher.failuresLeft = 6;
+
+	std::vector<seconds> delays;
+
+	for(int i = 0; i < 6; i++)
+	{
+		auto ids = scheduler.poll(now);
+		REQUIRE(ids.size() == 1);
+		scheduler.report(ids[0], fetcher.fetch(ids[0]), now);
+
+		time_point next = *scheduler.nextWakeup(now);
+		delays.push_back(duration_cast<seconds>(next - now));
+		REQUIRE(scheduler.poll(next - seconds(1)).empty());
+		now = next;
+	}
+
+	REQUIRE(delays == std::vector<seconds>({
+		seconds(60), seconds(120), seconds(240), seconds(480), seconds(600), seconds(600)
+	}));
+
+	auto ids = scheduler.poll(now);
+	REQUIRE(ids.size() == 1);
+	scheduler.report(ids[0], fetcher.fetch(ids[0]), now);
+	REQUIRE(*scheduler.validUntil("ephemeris") == now + hours(6));
+}
+
+TEST_CASE( "Backoff jitter stays within bounds", "[utils][AssistanceScheduler]" ) {
+	SchedulerPolicy policy = testPolicy();
+	policy.backoffJitter = .25;
+
+	time_point now = time_point(hours(1000));
+	AssistanceScheduler scheduler(policy, 42);
+
+	scheduler.track("ephemeris", now, 1000);
+
+	for(int i = 0; i < 50; i++)
+	{
+		scheduler.track("ephemeris", now, 1000);
+		REQUIRE(scheduler.poll(now).size() == 1);
+		scheduler.report("ephemeris", FetchResult{false, 0, time_point()}, now);
+
+		seconds delay = duration_cast<seconds>(*scheduler.nextWakeup(now) - now);
+		REQUIRE(delay >= seconds(45));
+		REQUIRE(delay <= seconds(75));
+	}
+}
+
+TEST_CASE( "Assistance refreshes respect the daily budget", "[utils][AssistanceScheduler]" ) {
+	SchedulerPolicy policy = testPolicy();
+	policy.dailyBudget = 3000;
+
+	time_point now = time_point(hours(1000));
+	time_point start = now;
+	FakeFetcher fetcher(now, hours(2), 1000);
+	AssistanceScheduler scheduler(policy);
+
+	scheduler.track("ephemeris", now + hours(2), 1000);
+
+	// Unbounded, the item would be refreshed every 1h30
+	simulate(scheduler, fetcher, now, start + hours(24));
+	REQUIRE(fetcher.downloads["ephemeris"] == 3);
+	REQUIRE(scheduler.budgetUsed(now) == 3000);
+
+	// Budget is released 24 hours after the first download
+	time_point wakeup = *scheduler.nextWakeup(now);
+	REQUIRE(wakeup == start + hours(1) + minutes(30) + hours(24));
+
+	simulate(scheduler, fetcher, now, wakeup);
+	REQUIRE(fetcher.downloads["ephemeris"] == 4);
+	REQUIRE(scheduler.budgetUsed(now) == 3000);
+}
+
+TEST_CASE( "Assistance download size is learned for the budget", "[utils][AssistanceScheduler]" ) {
+	SchedulerPolicy policy = testPolicy();
+	policy.dailyBudget = 3000;
+
+	time_point now = time_point(hours(1000));
+	time_point start = now;
+	FakeFetcher fetcher(now, hours(2), 1000);
+	AssistanceScheduler scheduler(policy);
+
+	// No stored file, its size is unknown
+	scheduler.track("ephemeris", now, 0);
+
+	simulate(scheduler, fetcher, now, start + hours(23));
+
+	// Only the first download was done without knowing its size
+	REQUIRE(fetcher.downloads["ephemeris"] == 3);
+	REQUIRE(scheduler.budgetUsed(now) == 3000);
+}
+
+/**
+ * HTTP server on the loopback interface, one connection at a time
+ *
+ * @details Each path is answered with its own status and body. A path without answer is
+ * accepted and never answered, like a stalled server.
+ */
+class LoopbackHttpServer {
+private:
+	struct Route {
+		int status;
+		std::string body;
+	};
+
+	int listenFd;
+	uint16_t serverPort;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::mutex mutex;
+	std::map<std::string, Route> routes;
+	std::map<std::string, unsigned int> hits;
+
+	static const char * reason(int status)
+	{
+		return status == 200 ? "OK" : status == 404 ? "Not Found" : "Error";
+	}
+
+	void serve(int fd)
+	{
+		std::string request;
+		char buffer[1024];
+
+		// Read the request line and the headers
+		while(running && request.find("\r\n\r\n") == std::string::npos)
+		{
+			struct pollfd pfd = {fd, POLLIN, 0};
+			if(poll(&pfd, 1, 20) <= 0)
+				continue;
+
+			ssize_t n = ::read(fd, buffer, sizeof(buffer));
+			if(n <= 0)
+				return;
+
+			request.append(buffer, n);
+		}
+
+		// GET <path> HTTP/1.1
+		std::size_t start = request.find(' ') + 1;
+		std::string path = request.substr(start, request.find(' ', start) - start);
+		Route route;
+		bool answer;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			hits[path]++;
+			auto it = routes.find(path);
+			answer = it != routes.end();
+			if(answer)
+				route = it->second;
+		}
+
+		if(!answer)
+		{
+			while(running)
+				std::this_thread::sleep_for(milliseconds(10));
+			return;
+		}
+
+		std::string response = "HTTP/1.1 " + std::to_string(route.status) + " " + reason(route.status) +
+			"\r\nContent-Length: " + std::to_string(route.body.size()) +
+			"\r\nConnection: close\r\n\r\n" + route.body;
+
+		ssize_t written = ::write(fd, response.data(), response.size());
+		(void)written;
+	}
+
+	void run()
+	{
+		while(running)
+		{
+			struct pollfd pfd = {listenFd, POLLIN, 0};
+			if(poll(&pfd, 1, 20) <= 0)
+				continue;
+
+			int fd = ::accept(listenFd, nullptr, nullptr);
+			if(fd < 0)
+				continue;
+
+			serve(fd);
+			::close(fd);
+		}
+	}
+
+public:
+	LoopbackHttpServer() :
+		running(true)
+	{
+		listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+		struct sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+
+		socklen_t len = sizeof(addr);
+		::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+		::listen(listenFd, 4);
+		::getsockname(listenFd, reinterpret_cast<struct sockaddr *>(&addr), &len);
+		serverPort = ntohs(addr.sin_port);
+
+		thread = std::thread(&LoopbackHttpServer::run, this);
+	}
+
+	~LoopbackHttpServer()
+	{
+		running = false;
+		thread.join();
+		::close(listenFd);
+	}
+
+	void route(const std::string & path, int status, const std::string & body)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		routes[path] = Route{status, body};
+	}
+
+	unsigned int hitCount(const std::string & path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return hits[path];
+	}
+
+	std::string uri(const std::string & path) const
+	{
+		return "http://127.0.0.1:" + std::to_string(serverPort) + path;
+	}
+};
+
+TEST_CASE( "HTTP assistance fetcher downloads from a loopback server", "[utils][AssistanceScheduler][http]" ) {
+	Thread::setCreateThreadCb(test::createThread);
+	utils::http_init();
+
+	const std::string body = "$PSTMEPHEM,5,2,0A0B*00\r\n";
+	const GpsUtcTime validity = 1500000000000;
+
+	LoopbackHttpServer server;
+	server.route("/ephemeris", 200, body);
+	server.route("/missing", 404, "not found");
+
+	HttpAssistanceFetcher fetcher(milliseconds(300));
+	std::vector<std::string> downloads;
+	GpsUtcTime injected = validity;
+
+	fetcher.downloaded.connect(SlotFactory::create(
+		std::function<GpsUtcTime(const std::string &, const std::vector<char> &)>(
+			[&] (const std::string & id, const std::vector<char> & payload) {
+				downloads.push_back(id + ":" + std::string(payload.begin(), payload.end()));
+				return injected;
+			})
+		)
+	);
+
+	SECTION( "Downloaded data is handed over for injection" ) {
+		fetcher.setUri("ephemeris", server.uri("/ephemeris"));
+		FetchResult result = fetcher.fetch("ephemeris");
+
+		REQUIRE(result.success);
+		REQUIRE(result.bytes == body.size());
+		REQUIRE(result.validUntil == time_point(milliseconds(validity)));
+		REQUIRE(downloads == std::vector<std::string>({"ephemeris:" + body}));
+	}
+
+	SECTION( "Data the injection rejects is a failure" ) {
+		injected = 0;
+		fetcher.setUri("ephemeris", server.uri("/ephemeris"));
+		FetchResult result = fetcher.fetch("ephemeris");
+
+		REQUIRE_FALSE(result.success);
+		REQUIRE(result.bytes == body.size());
+		REQUIRE(downloads.size() == 1);
+	}
+
+	SECTION( "Not found is a failure, its bytes count for the budget" ) {
+		fetcher.setUri("almanac", server.uri("/missing"));
+		FetchResult result = fetcher.fetch("almanac");
+
+		REQUIRE_FALSE(result.success);
+		REQUIRE(result.bytes == std::string("not found").size());
+		REQUIRE(downloads.empty());
+		REQUIRE(server.hitCount("/missing") == 1);
+	}
+
+	SECTION( "A stalled server times out" ) {
+		fetcher.setUri("almanac", server.uri("/stalled"));
+
+		auto begin = steady_clock::now();
+		FetchResult result = fetcher.fetch("almanac");
+		auto elapsed = duration_cast<milliseconds>(steady_clock::now() - begin);
+
+		REQUIRE_FALSE(result.success);
+		REQUIRE(downloads.empty());
+		REQUIRE(server.hitCount("/stalled") == 1);
+		REQUIRE(elapsed >= milliseconds(300));
+		REQUIRE(elapsed < milliseconds(2000));
+	}
+
+	SECTION( "An item without URI is a failure" ) {
+		REQUIRE_FALSE(fetcher.fetch("almanac").success);
+		REQUIRE(downloads.empty());
+	}
+
+	utils::http_cleanup();
+}
+
+TEST_CASE( "Assistance refresher runs against a loopback server", "[utils][AssistanceScheduler][http]" ) {
+	Thread::setCreateThreadCb(test::createThread);
+	utils::http_init();
+
+	LoopbackHttpServer server;
+	server.route("/ephemeris", 200, "$PSTMEPHEM,5,2,0A0B*00\r\n");
+
+	HttpAssistanceFetcher fetcher(milliseconds(300));
+	fetcher.setUri("ephemeris", server.uri("/ephemeris"));
+	fetcher.downloaded.connect(SlotFactory::create(
+		std::function<GpsUtcTime(const std::string &, const std::vector<char> &)>(
+			[] (const std::string &, const std::vector<char> &) {
+				return duration_cast<milliseconds>((Clock::now() + hours(4)).time_since_epoch()).count();
+			})
+		)
+	);
+
+	AssistanceRefresher refresher(testPolicy(), fetcher);
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<FetchResult> results;
+
+	refresher.refreshed.connect(SlotFactory::create(
+		std::function<void(const std::string &, const FetchResult &)>(
+			[&] (const std::string &, const FetchResult & result) {
+				std::lock_guard<std::mutex> lock(mutex);
+				results.push_back(result);
+				cv.notify_all();
+			})
+		)
+	);
+
+	SECTION( "A stop right after the start ends the thread" ) {
+		refresher.track("ephemeris", Clock::now() + hours(4), 0);
+
+		refresher.start();
+		refresher.stop();
+		refresher.join();
+
+		REQUIRE_FALSE(refresher.isRunning());
+	}
+
+	SECTION( "A due item is downloaded, then the refresher waits for its next refresh" ) {
+		refresher.track("ephemeris", Clock::now(), 0);
+		refresher.start();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			REQUIRE(cv.wait_for(lock, milliseconds(2000), [&] () { return !results.empty(); }));
+		}
+
+		// Valid for 4 hours, nothing more to do for now
+		std::this_thread::sleep_for(milliseconds(200));
+		REQUIRE(results.size() == 1);
+		REQUIRE(results[0].success);
+		REQUIRE(server.hitCount("/ephemeris") == 1);
+
+		auto begin = steady_clock::now();
+		refresher.stop();
+		refresher.join();
+
+		REQUIRE_FALSE(refresher.isRunning());
+		REQUIRE(steady_clock::now() - begin < milliseconds(500));
+	}
+
+	utils::http_cleanup();
+}
@@ -0,0 +1,202 @@
+#include <catch.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <teseo/utils/IByteStream.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::stream;
+
+namespace {
+
+/**
+ * Byte stream returning the pushed chunks, reads block until a chunk is available
+ */
+class QueueByteStream : public IByteStream {
+private:
+	std::string streamName;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<ByteVector> chunks;
+	int openCount;
+	unsigned int opens;
+
+protected:
+	void open()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		openCount++;
+		opens++;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		openCount--;
+		cond.notify_all();
+	}
+
+	void flush() { }
+
+	ByteVector perform_read()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cond.wait(lock, [this] { return !chunks.empty() || openCount == 0; });
+
+		if(chunks.empty())
+			throw StreamReadException();
+
+		ByteVector chunk = chunks.front();
+		chunks.pop_front();
+		return chunk;
+	}
+
+	void perform_write(const ByteVectorPtr) { }
+
+public:
+	QueueByteStream() :
+		streamName("queue"),
+		openCount(0),
+		opens(0)
+	{ }
+
+	const std::string & name() const { return streamName; }
+
+	ByteStreamStatus status() const
+	{
+		return openCount > 0 ? ByteStreamStatus::OPENED : ByteStreamStatus::CLOSED;
+	}
+
+	void write(const ByteVectorPtr) { }
+
+	int start() { return 0; }
+
+	int stop() { return 0; }
+
+	void push(const std::string & s)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		chunks.push_back(ByteVector(s.begin(), s.end()));
+		cond.notify_all();
+	}
+
+	int openedCount()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return openCount;
+	}
+
+	unsigned int openCalls()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return opens;
+	}
+};
+
+/**
+ * Bytes received from the reader thread
+ */
+struct Received : public Trackable {
+	std::mutex mutex;
+	std::string bytes;
+
+	void onNewBytes(const ByteVector & bv)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bytes.append(bv.begin(), bv.end());
+	}
+
+	std::string get()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return bytes;
+	}
+};
+
+bool waitFor(std::function<bool()> condition)
+{
+	for(int i = 0; i < 1000 && !condition(); i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	return condition();
+}
+
+} // namespace
+
+TEST_CASE( "Byte stream openers are reference counted", "[utils][ByteStreamReader]" ) {
+	QueueByteStream stream;
+
+	{
+		ByteStreamOpener<false> reader(stream);
+
+		{
+			ByteStreamOpener<false> writer(stream);
+			REQUIRE(stream.openedCount() == 2);
+		}
+
+		// The writer leaving doesn't close the stream under the reader
+		REQUIRE(stream.openedCount() == 1);
+		REQUIRE(static_cast<bool>(reader));
+	}
+
+	REQUIRE(stream.openedCount() == 0);
+}
+
+TEST_CASE( "Byte stream reader restarts after a stop", "[utils][ByteStreamReader]" ) {
+	Thread::setCreateThreadCb(&test::createThread);
+
+	QueueByteStream stream;
+	ByteStreamReader reader(stream);
+	Received received;
+
+	stream.newBytes.connect(SlotFactory::create(received, &Received::onNewBytes));
+
+	reader.start();
+	stream.push("a");
+	REQUIRE(waitFor([&] { return received.get() == "a"; }));
+
+	SECTION( "Restarted while blocked in read" ) {
+		// The blocked reader resumes, the stream isn't reopened
+		reader.stop();
+		REQUIRE(reader.start() == 0);
+
+		stream.push("b");
+		REQUIRE(waitFor([&] { return received.get() == "ab"; }));
+		REQUIRE(stream.openCalls() == 1);
+	}
+
+	SECTION( "Restarted once the previous reader exited" ) {
+		reader.stop();
+		stream.push("b");
+		REQUIRE(waitFor([&] { return stream.openedCount() == 0; }));
+
+		reader.start();
+		stream.push("c");
+		REQUIRE(waitFor([&] { return received.get() == "abc"; }));
+		REQUIRE(stream.openCalls() == 2);
+	}
+
+	SECTION( "Restarted while the previous reader is exiting" ) {
+		reader.stop();
+		stream.push("b");
+		reader.start();
+
+		stream.push("c");
+		REQUIRE(waitFor([&] { return received.get() == "abc"; }));
+		REQUIRE(stream.openedCount() == 1);
+	}
+
+	reader.stop();
+	stream.push("");
+	reader.join();
+
+	REQUIRE_FALSE(reader.isRunning());
+	REQUIRE(stream.openedCount() == 0);
+}
@@ -0,0 +1,528 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/protocol/NmeaEncoder.h>
+#include <teseo/utils/NmeaCapture.h>
+#include <teseo/utils/NmeaStream.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/utils/UartByteStream.h>
+#include <teseo/test/FaultInjectingByteStream.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::stream;
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+std::string epoch(unsigned int seconds)
+{
+	char time[16];
+	snprintf(time, sizeof(time), "%02u%02u%02u.00", (seconds / 3600) % 24, (seconds / 60) % 60, seconds % 60);
+
+	std::ostringstream gga, rmc;
+	gga << "GPGGA," << time << ",4530." << 1000 + seconds << ",N,00712.5678,E,1,08,0.9,100.0,M,47.0,M,,";
+	rmc << "GPRMC," << time << ",A,4530." << 1000 + seconds << ",N,00712.5678,E,0.5,54.7,191018,,,A";
+
+	return
+		sentence(gga.str()) +
+		sentence(rmc.str()) +
+		sentence("GPGSA,A,3,01,02,03,04,05,06,07,08,,,,,1.5,0.9,1.2") +
+		sentence("GPGSV,2,1,08,01,40,083,46,02,17,308,41,03,07,344,39,04,22,228,45") +
+		sentence("GPGSV,2,2,08,05,40,083,46,06,17,308,41,07,07,344,39,08,22,228,45");
+}
+
+/**
+ * Byte stream fed by the test
+ */
+class FakeByteStream : public IByteStream {
+private:
+	std::string streamName = "fake";
+
+protected:
+	virtual void open() { }
+	virtual void close() { }
+	virtual void flush() { }
+	virtual ByteVector perform_read() { return ByteVector(); }
+	virtual void perform_write(const ByteVectorPtr) { }
+
+public:
+	virtual const std::string & name() const { return streamName; }
+	virtual ByteStreamStatus status() const { return ByteStreamStatus::OPENED; }
+	virtual void write(const ByteVectorPtr) { }
+	virtual int start() { return 0; }
+	virtual int stop() { return 0; }
+
+	void feed(const std::string & bytes)
+	{
+		newBytes(ByteVector(bytes.begin(), bytes.end()));
+	}
+};
+
+/**
+ * Record what comes out of the decorator
+ */
+struct Output : public Trackable {
+	std::mutex mutex;
+	std::string bytes;
+	std::vector<FaultRecord> faults;
+
+	explicit Output(FaultInjectingByteStream & stream)
+	{
+		stream.newBytes.connect(SlotFactory::create(std::function<void(const ByteVector &)>([this] (const ByteVector & b) {
+			std::lock_guard<std::mutex> lock(mutex);
+			bytes.append(b.begin(), b.end());
+		})));
+
+		stream.faultInjected.connect(SlotFactory::create(std::function<void(const FaultRecord &)>([this] (const FaultRecord & r) {
+			std::lock_guard<std::mutex> lock(mutex);
+			faults.push_back(r);
+		})));
+	}
+};
+
+Fault fault(FaultType type, std::size_t offset, std::size_t length = 0, milliseconds duration = milliseconds(0))
+{
+	return Fault{type, offset, length, duration};
+}
+
+// ====================== Linux pty stand-ins =====================
+
+/**
+ * Capture replayed by the pty receiver, from NMEA_REPLAY when set, raw or compressed
+ */
+std::vector<std::string> replayEpochs(int synthetic)
+{
+	std::vector<std::string> epochs;
+	const char * path = std::getenv("NMEA_REPLAY");
+
+	if(!path)
+	{
+		for(int i = 0; i < synthetic; i++)
+			epochs.push_back(epoch(i));
+
+		return epochs;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	ByteVector raw((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if(raw.size() >= 4 && std::equal(raw.begin(), raw.begin() + 4, "NMZ1"))
+	{
+		ByteVector decoded;
+		capture::NmeaCaptureDecoder::decode(raw, decoded);
+		raw.swap(decoded);
+	}
+
+	// One epoch per GGA sentence
+	std::string text(raw.begin(), raw.end());
+	std::size_t start = 0;
+
+	while(start < text.size())
+	{
+		std::size_t next = text.find("GGA,", start + 1);
+		next = next == std::string::npos ? text.size() : text.rfind('$', next);
+
+		if(next <= start)
+			next = text.size();
+
+		epochs.push_back(text.substr(start, next - start));
+		start = next;
+	}
+
+	return epochs;
+}
+
+/**
+ * Decoder reporting the sentences to the meter once decoded, so a fix follows the sentences it
+ * comes from
+ */
+class MeteredDecoder : public decoder::NmeaDecoder {
+private:
+	RecoveryMeter & meter;
+
+protected:
+	virtual void decode(ByteVectorPtr bytes)
+	{
+		// The decoder strips the sentence in place
+		ByteVectorPtr received(new ByteVector(*bytes));
+		decoder::NmeaDecoder::decode(bytes);
+		meter.onSentence(received);
+	}
+
+public:
+	MeteredDecoder(device::AbstractDevice & device, RecoveryMeter & meter) :
+		decoder::NmeaDecoder(device),
+		meter(meter)
+	{ }
+};
+
+/**
+ * Capture replayed at an accelerated pace on the master side of a pseudo-terminal, the HAL receive
+ * pipeline with the fault injecting stream runs on the slave side
+ */
+class Replay {
+private:
+	PseudoTerminal pty;
+	std::thread emitter;
+	milliseconds period;
+	std::vector<std::string> epochs;
+
+	void emit()
+	{
+		auto next = steady_clock::now();
+
+		for(const std::string & e : epochs)
+		{
+			ssize_t written = ::write(pty.master(), e.data(), e.size());
+			(void)written;
+
+			next += period;
+			std::this_thread::sleep_until(next);
+		}
+
+		done = true;
+	}
+
+public:
+	std::atomic<bool> done;
+	RecoveryMeter meter;
+	device::NmeaDevice device;
+	MeteredDecoder decoder;
+	protocol::NmeaEncoder encoder;
+	NmeaStream nmea;
+	IStream & nmeaStream;
+	UartByteStream * uart;
+	FaultInjectingByteStream * faulty;
+	std::size_t size;
+
+	Replay(const std::vector<std::string> & epochs, milliseconds period, uint32_t seed) :
+		period(period),
+		epochs(epochs),
+		done(false),
+		decoder(device, meter),
+		nmeaStream(nmea),
+		size(0)
+	{
+		for(const std::string & e : epochs)
+			size += e.size();
+
+		uart = new UartByteStream(pty.slavePath(), 115200);
+		faulty = new FaultInjectingByteStream(*uart, seed);
+
+		faulty->newBytes.connect(SlotFactory::create(nmeaStream, &IStream::onNewBytes));
+		faulty->faultInjected.connect(SlotFactory::create(meter, &RecoveryMeter::onFault));
+		faulty->inputSentence.connect(SlotFactory::create(meter, &RecoveryMeter::onInputSentence));
+		nmeaStream.newSentence.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::onNewBytes));
+		device.locationUpdate.connect(SlotFactory::create(std::function<void(const Location &)>([this] (const Location &) {
+			meter.onValidFix();
+		})));
+		device.sendMessage.connect(SlotFactory::create(encoder, &protocol::IEncoder::encode));
+		encoder.encodedBytes.connect(SlotFactory::create(nmeaStream, &IStream::write));
+		nmeaStream.newBytesToWrite.connect(SlotFactory::create(*faulty, &IByteStream::write));
+		device.startNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::start));
+		device.startNavigation.connect(SlotFactory::create(*faulty, &IByteStream::start));
+		device.stopNavigation.connect(SlotFactory::create(decoder, &decoder::AbstractDecoder::stop));
+		device.stopNavigation.connect(SlotFactory::create(*faulty, &IByteStream::stop));
+	}
+
+	void run()
+	{
+		device.start();
+
+		for(int i = 0; i < 100 && uart->status() != ByteStreamStatus::OPENED; i++)
+			std::this_thread::sleep_for(milliseconds(5));
+
+		emitter = std::thread(&Replay::emit, this);
+		emitter.join();
+
+		// Let the last epochs through the pipeline
+		std::this_thread::sleep_for(milliseconds(200));
+	}
+
+	~Replay()
+	{
+		if(emitter.joinable())
+			emitter.join();
+
+		device.stop();
+		decoder.join();
+
+		// Hang up the line to unblock the reader
+		pty.close();
+		std::this_thread::sleep_for(milliseconds(50));
+
+		delete faulty;
+		delete uart;
+	}
+};
+
+void report(const std::vector<RecoveryMeter::Result> & results)
+{
+	for(const auto & r : results)
+	{
+		std::ostringstream line;
+		line << toString(r.record.fault.type) << " at " << r.record.fault.offset << ": ";
+
+		if(r.recovered)
+			line << "next valid fix after " << r.recovery.count() << " ms";
+		else
+			line << "no valid fix";
+
+		line << ", " << r.lostSentences << " sentences lost";
+		WARN(line.str());
+	}
+}
+
+} // namespace
+
+TEST_CASE( "Scheduled faults alter the received bytes", "[utils][FaultInjectingByteStream]" ) {
+	FakeByteStream inner;
+	FaultInjectingByteStream faulty(inner, 1);
+	Output output(faulty);
+
+	const std::string line = sentence("GPGSA,A,3,01,02,03,04,05,06,07,08,,,,,1.5,0.9,1.2");
+
+	SECTION( "Drop" ) {
+		faulty.schedule(fault(FaultType::Drop, 10, 5));
+		inner.feed(line);
+
+		REQUIRE( output.bytes == line.substr(0, 10) + line.substr(15) );
+		REQUIRE( output.faults.size() == 1 );
+		REQUIRE( output.faults[0].fault.offset == 10 );
+	}
+
+	SECTION( "Bit flip" ) {
+		faulty.schedule(fault(FaultType::BitFlip, 7));
+		inner.feed(line);
+
+		REQUIRE( output.bytes.size() == line.size() );
+		REQUIRE( output.bytes.substr(0, 7) == line.substr(0, 7) );
+		REQUIRE( output.bytes.substr(8) == line.substr(8) );
+
+		uint8_t diff = output.bytes[7] ^ line[7];
+		REQUIRE( diff != 0 );
+		REQUIRE( (diff & (diff - 1)) == 0 );
+	}
+
+	SECTION( "Truncate keeps the line end" ) {
+		faulty.schedule(fault(FaultType::Truncate, 20));
+		inner.feed(line + line);
+
+		REQUIRE( output.bytes == line.substr(0, 20) + "\r\n" + line );
+	}
+
+	SECTION( "Faults are counted on the received bytes, across reads" ) {
+		faulty.schedule(fault(FaultType::Drop, line.size() + 1, 2));
+		faulty.schedule(fault(FaultType::Drop, 1, 2));
+		inner.feed(line.substr(0, 2));
+		inner.feed(line.substr(2) + line);
+
+		REQUIRE( faulty.received() == 2 * line.size() );
+		REQUIRE( output.bytes == line.substr(0, 1) + line.substr(3) + "$" + line.substr(3) );
+		REQUIRE( output.faults.size() == 2 );
+		REQUIRE( output.faults[1].id == 1 );
+
+		// Too late to apply
+		faulty.schedule(fault(FaultType::Drop, 0, 2));
+		inner.feed(line);
+		REQUIRE( output.faults.size() == 2 );
+	}
+
+	SECTION( "Stall delays the following bytes" ) {
+		faulty.schedule(fault(FaultType::Stall, 10, 0, milliseconds(100)));
+		auto start = steady_clock::now();
+		inner.feed(line);
+
+		REQUIRE( steady_clock::now() - start >= milliseconds(100) );
+		REQUIRE( output.bytes == line );
+	}
+
+	SECTION( "Disconnect loses the bytes received meanwhile" ) {
+		faulty.schedule(fault(FaultType::Disconnect, 10, 0, milliseconds(100)));
+		inner.feed(line);
+
+		REQUIRE( faulty.status() == ByteStreamStatus::CLOSED );
+		inner.feed(line);
+		REQUIRE( output.bytes == line.substr(0, 10) );
+
+		std::this_thread::sleep_for(milliseconds(110));
+		REQUIRE( faulty.status() == ByteStreamStatus::OPENED );
+		inner.feed(line);
+		REQUIRE( output.bytes == line.substr(0, 10) + line );
+	}
+}
+
+TEST_CASE( "Random faults are reproducible from the seed", "[utils][FaultInjectingByteStream]" ) {
+	std::string capture;
+	for(int i = 0; i < 200; i++)
+		capture += epoch(i);
+
+	FaultRates rates;
+	rates.drop = 1e-3;
+	rates.bitFlip = 1e-3;
+	rates.truncate = 1e-3;
+	rates.stall = 1e-5;
+	rates.stallDuration = milliseconds(1);
+	rates.disconnect = 1e-5;
+	rates.disconnectDuration = milliseconds(0);
+
+	auto run = [&] (uint32_t seed) {
+		FakeByteStream inner;
+		FaultInjectingByteStream faulty(inner, seed);
+		Output output(faulty);
+		faulty.setRates(rates);
+
+		for(std::size_t i = 0; i < capture.size(); i += 100)
+			inner.feed(capture.substr(i, 100));
+
+		return std::make_pair(output.bytes, output.faults);
+	};
+
+	auto a = run(7);
+	auto b = run(7);
+	auto c = run(8);
+
+	REQUIRE( a.second.size() > 100 );
+	REQUIRE( a.first == b.first );
+	REQUIRE( a.second.size() == b.second.size() );
+	REQUIRE( a.first != c.first );
+
+	std::map<FaultType, int> types;
+	for(std::size_t i = 0; i < a.second.size(); i++)
+	{
+		REQUIRE( a.second[i].fault.type == b.second[i].fault.type );
+		REQUIRE( a.second[i].fault.offset == b.second[i].fault.offset );
+		types[a.second[i].fault.type]++;
+	}
+
+	// Rates are per byte, around capture.size() / 1000 faults of each frequent type
+	const int expected = capture.size() / 1000;
+	for(FaultType type : {FaultType::Drop, FaultType::BitFlip, FaultType::Truncate})
+	{
+		REQUIRE( types[type] > expected / 2 );
+		REQUIRE( types[type] < expected * 2 );
+	}
+}
+
+TEST_CASE( "Recovery meter attributes lost sentences to faults", "[utils][FaultInjectingByteStream]" ) {
+	FakeByteStream inner;
+	FaultInjectingByteStream faulty(inner);
+	NmeaStream nmea;
+	IStream & nmeaStream = nmea;
+	RecoveryMeter meter;
+
+	faulty.newBytes.connect(SlotFactory::create(nmeaStream, &IStream::onNewBytes));
+	faulty.faultInjected.connect(SlotFactory::create(meter, &RecoveryMeter::onFault));
+	faulty.inputSentence.connect(SlotFactory::create(meter, &RecoveryMeter::onInputSentence));
+	nmeaStream.newSentence.connect(SlotFactory::create(meter, &RecoveryMeter::onSentence));
+
+	const std::string e0 = epoch(0), e1 = epoch(1), e2 = epoch(2);
+	const std::size_t rmc = e1.find("$GPRMC");
+
+	// Lose the GGA and RMC of the second epoch
+	faulty.schedule(fault(FaultType::Drop, e0.size() + 10, rmc));
+	// A bit flip in the GSA of the third one
+	faulty.schedule(fault(FaultType::BitFlip, e0.size() + e1.size() + e2.find("$GPGSA") + 8));
+
+	inner.feed(e0);
+	meter.onValidFix();
+	inner.feed(e1);
+	inner.feed(e2);
+
+	auto results = meter.results();
+	REQUIRE( results.size() == 2 );
+	REQUIRE( meter.unattributedLosses() == 0 );
+	REQUIRE( results[0].lostSentences == 2 );
+	REQUIRE( results[1].lostSentences == 1 );
+
+	// The sentences after the faults came through before this fix
+	REQUIRE_FALSE( results[0].recovered );
+	meter.onValidFix();
+	results = meter.results();
+	REQUIRE( results[0].recovered );
+	REQUIRE( results[1].recovered );
+}
+
+TEST_CASE( "Fault recovery over a replayed capture", "[utils][FaultInjectingByteStream][pty]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	const milliseconds period(30);
+	std::vector<std::string> epochs = replayEpochs(80);
+
+	SECTION( "One fault of each type" ) {
+		Replay replay(epochs, period, 0);
+		const std::size_t step = replay.size / 6;
+
+		replay.faulty->schedule(fault(FaultType::Drop, step, 16));
+		replay.faulty->schedule(fault(FaultType::BitFlip, 2 * step));
+		replay.faulty->schedule(fault(FaultType::Truncate, 3 * step));
+		replay.faulty->schedule(fault(FaultType::Stall, 4 * step, 0, milliseconds(200)));
+		replay.faulty->schedule(fault(FaultType::Disconnect, 5 * step, 0, milliseconds(300)));
+
+		replay.run();
+
+		auto results = replay.meter.results();
+		report(results);
+
+		REQUIRE( results.size() == 5 );
+		REQUIRE( replay.meter.unattributedLosses() == 0 );
+
+		for(const auto & r : results)
+			REQUIRE( r.recovered );
+
+		// A stall delays the sentences without losing them, a disconnection lasts at least its duration
+		REQUIRE( results[3].lostSentences == 0 );
+		REQUIRE( results[3].recovery >= milliseconds(200) );
+		REQUIRE( results[4].lostSentences > 0 );
+		REQUIRE( results[4].recovery >= milliseconds(300) );
+	}
+
+	SECTION( "Random faults" ) {
+		Replay replay(epochs, period, 1234);
+
+		FaultRates rates;
+		rates.drop = 2e-4;
+		rates.bitFlip = 2e-4;
+		rates.truncate = 2e-4;
+		rates.stall = 2e-5;
+		rates.stallDuration = milliseconds(100);
+		rates.disconnect = 2e-5;
+		rates.disconnectDuration = milliseconds(200);
+		replay.faulty->setRates(rates);
+
+		replay.run();
+
+		auto results = replay.meter.results();
+		report(results);
+
+		REQUIRE( results.size() > 0 );
+
+		// Faults within the last epochs may see no fix before the end of the replay
+		for(const auto & r : results)
+		{
+			if(r.record.fault.offset + 3 * replay.size / epochs.size() < replay.size)
+				REQUIRE( r.recovered );
+		}
+	}
+}
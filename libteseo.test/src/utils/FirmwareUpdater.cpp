@@ -0,0 +1,368 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+#include <teseo/utils/FirmwareUpdater.h>
+#include <teseo/utils/Thread.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::firmware;
+using namespace stm::test;
+
+namespace {
+
+/**
+ * Bootloader flash content, kept across sessions to allow resume
+ */
+struct Flash {
+	uint32_t imageSize = 0;
+	uint32_t imageCrc = 0;
+	uint16_t blockSize = 0;
+	uint32_t nextBlock = 0;
+	ByteVector content;
+	bool flashed = false;
+};
+
+/**
+ * Bootloader emulator on the master side of a pseudo-terminal
+ */
+class BootloaderEmulator {
+private:
+	int master;
+	Flash & flash;
+	std::thread thread;
+	std::atomic<bool> running;
+	FrameParser parser;
+	bool nakSent;
+	unsigned int sessionBlocks;
+
+	void reply(FrameType type, uint32_t sequence, ByteVector payload = ByteVector())
+	{
+		ByteVector bytes = Frame{type, sequence, payload}.encode();
+		ssize_t ret = ::write(master, bytes.data(), bytes.size());
+		(void)(ret);
+	}
+
+	static uint32_t get32(const ByteVector & p, std::size_t i)
+	{
+		return p[i] | (p[i + 1] << 8) | (p[i + 2] << 16) | (static_cast<uint32_t>(p[i + 3]) << 24);
+	}
+
+	void process(const Frame & f)
+	{
+		switch(f.type)
+		{
+			case FrameType::Hello:
+			{
+				uint32_t size = get32(f.payload, 0);
+				uint32_t crc = get32(f.payload, 4);
+				uint16_t blockSize = f.payload[8] | (f.payload[9] << 8);
+				baudRequested = get32(f.payload, 10);
+
+				if(size != flash.imageSize || crc != flash.imageCrc || blockSize != flash.blockSize)
+				{
+					flash = Flash();
+					flash.imageSize = size;
+					flash.imageCrc = crc;
+					flash.blockSize = blockSize;
+					flash.content.resize(size);
+				}
+
+				ByteVector payload;
+				for(int i = 0; i < 4; i++)
+					payload.push_back((baudRequested >> (8 * i)) & 0xFF);
+
+				reply(FrameType::Status, flash.nextBlock, payload);
+				break;
+			}
+
+			case FrameType::Data:
+				if(silentAfter && sessionBlocks >= *silentAfter)
+					return;
+
+				if(f.sequence == flash.nextBlock)
+				{
+					// Line corruption: the block CRC fails and the block is rejected
+					if(corrupt.erase(f.sequence))
+					{
+						reply(FrameType::Nak, flash.nextBlock);
+						nakSent = true;
+						return;
+					}
+
+					std::copy(f.payload.begin(), f.payload.end(),
+						flash.content.begin() + static_cast<std::size_t>(f.sequence) * flash.blockSize);
+					flash.nextBlock++;
+					sessionBlocks++;
+					nakSent = false;
+					reply(FrameType::Ack, flash.nextBlock);
+				}
+				else if(f.sequence < flash.nextBlock)
+				{
+					reply(FrameType::Ack, flash.nextBlock);
+				}
+				else if(!nakSent)
+				{
+					reply(FrameType::Nak, flash.nextBlock);
+					nakSent = true;
+				}
+				break;
+
+			case FrameType::Commit:
+			{
+				uint32_t total = (flash.imageSize + flash.blockSize - 1) / flash.blockSize;
+				bool ok = flash.nextBlock == total &&
+				          crc32(flash.content.data(), flash.content.size()) == flash.imageCrc;
+
+				flash.flashed = ok;
+				reply(FrameType::Done, 0, ByteVector({static_cast<uint8_t>(ok ? 0 : 1)}));
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	void run()
+	{
+		while(running)
+		{
+			struct pollfd pfd = {master, POLLIN, 0};
+
+			if(poll(&pfd, 1, 20) <= 0 || !(pfd.revents & POLLIN))
+				continue;
+
+			uint8_t buffer[4096];
+			ssize_t n = ::read(master, buffer, sizeof(buffer));
+
+			if(n <= 0)
+				continue;
+
+			for(const Frame & f : parser.push(ByteVector(buffer, buffer + n)))
+				process(f);
+		}
+	}
+
+public:
+	std::set<uint32_t> corrupt;
+	std::optional<unsigned int> silentAfter;
+	uint32_t baudRequested;
+
+	BootloaderEmulator(int master, Flash & flash) :
+		master(master),
+		flash(flash),
+		running(false),
+		nakSent(false),
+		sessionBlocks(0),
+		baudRequested(0)
+	{ }
+
+	~BootloaderEmulator()
+	{
+		stop();
+	}
+
+	void start()
+	{
+		running = true;
+		thread = std::thread(&BootloaderEmulator::run, this);
+	}
+
+	void stop()
+	{
+		running = false;
+
+		if(thread.joinable())
+			thread.join();
+	}
+};
+
+/**
+ * Pseudo-terminal with an UART byte stream opened on the slave side
+ */
+class PtyLink {
+private:
+	PseudoTerminal pty;
+
+public:
+	int master;
+	stream::UartByteStream * uart;
+
+	PtyLink() :
+		master(pty.master()),
+		uart(nullptr)
+	{
+		Thread::setCreateThreadCb(createThread);
+
+		uart = new stream::UartByteStream(pty.slavePath(), 115200);
+		uart->start();
+
+		// Wait for the reader and the writer to open the device
+		for(int i = 0; i < 100 && uart->status() != stream::ByteStreamStatus::OPENED; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	~PtyLink()
+	{
+		uart->stop();
+
+		// Hang up the line to unblock the reader
+		pty.close();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		delete uart;
+	}
+};
+
+ByteVector makeImage(std::size_t size)
+{
+	ByteVector image(size);
+	uint32_t x = 0x12345678;
+
+	for(auto & b : image)
+	{
+		x = x * 1103515245 + 12345;
+		b = static_cast<uint8_t>(x >> 16);
+	}
+
+	return image;
+}
+
+UpdateSettings testSettings()
+{
+	UpdateSettings settings;
+	settings.blockSize = 512;
+	settings.window = 8;
+	settings.ackTimeout = std::chrono::milliseconds(100);
+	settings.maxRetries = 3;
+	return settings;
+}
+
+} // namespace
+
+TEST_CASE( "Firmware frames are parsed and resynchronized", "[utils][FirmwareUpdater]" ) {
+	Frame a{FrameType::Data, 7, ByteVector({1, 2, 3, 4, 5})};
+	Frame b{FrameType::Ack, 8, ByteVector()};
+
+	ByteVector corrupted = a.encode();
+	corrupted[10] ^= 0x10;
+
+	ByteVector bytes = {0x00, 0x42};
+	for(const ByteVector & part : {corrupted, a.encode(), b.encode()})
+		bytes.insert(bytes.end(), part.begin(), part.end());
+
+	FrameParser parser;
+	std::deque<Frame> frames;
+
+	// Feed the stream byte per byte
+	for(uint8_t byte : bytes)
+		for(const Frame & f : parser.push(ByteVector({byte})))
+			frames.push_back(f);
+
+	REQUIRE(frames.size() == 2);
+	REQUIRE(frames[0].type == FrameType::Data);
+	REQUIRE(frames[0].sequence == 7);
+	REQUIRE(frames[0].payload == a.payload);
+	REQUIRE(frames[1].type == FrameType::Ack);
+	REQUIRE(frames[1].sequence == 8);
+	REQUIRE(parser.droppedFrames() >= 1);
+
+	const char * check = "123456789";
+	REQUIRE(crc32(reinterpret_cast<const uint8_t *>(check), 9) == 0xCBF43926);
+}
+
+TEST_CASE( "Firmware update over a pseudo-terminal", "[utils][FirmwareUpdater]" ) {
+	ByteVector image = makeImage(150 * 1024 + 100);
+	uint32_t totalBlocks = (image.size() + 511) / 512;
+	Flash flash;
+	PtyLink link;
+
+	REQUIRE(link.uart->status() == stream::ByteStreamStatus::OPENED);
+
+	FirmwareUpdater updater(*link.uart, testSettings());
+
+	std::vector<uint32_t> acked;
+	updater.progress.connect(SlotFactory::create(
+		std::function<void(const UpdateProgress &)>([&acked] (const UpdateProgress & p) {
+			acked.push_back(p.ackedBlocks);
+		})
+	));
+
+	SECTION( "Clean transfer at the maximum baud rate" ) {
+		BootloaderEmulator bootloader(link.master, flash);
+		bootloader.start();
+
+		REQUIRE(updater.update(image) == UpdateResult::Success);
+		REQUIRE(flash.flashed);
+		REQUIRE(flash.content == image);
+		REQUIRE(bootloader.baudRequested == stream::UartByteStream::maxSpeed());
+
+		// Baud rate is restored after the update
+		REQUIRE(link.uart->speed() == 115200);
+
+		UpdateProgress p = updater.getProgress();
+		REQUIRE(p.ackedBlocks == totalBlocks);
+		REQUIRE(p.totalBlocks == totalBlocks);
+		REQUIRE(p.retransmissions == 0);
+		REQUIRE(p.throughput > 0.);
+		REQUIRE(std::is_sorted(acked.begin(), acked.end()));
+		REQUIRE(acked.back() == totalBlocks);
+
+		std::ostringstream report;
+		report << image.size() << " bytes in " << totalBlocks << " blocks, "
+		       << static_cast<int>(p.throughput / 1024) << " KiB/s over pty";
+		WARN(report.str());
+	}
+
+	SECTION( "Corrupted blocks are sent again" ) {
+		BootloaderEmulator bootloader(link.master, flash);
+		bootloader.corrupt = {0, 17, 18, 150, totalBlocks - 1};
+		bootloader.start();
+
+		REQUIRE(updater.update(image) == UpdateResult::Success);
+		REQUIRE(flash.content == image);
+
+		UpdateProgress p = updater.getProgress();
+		REQUIRE(p.retransmissions >= 5);
+		REQUIRE(p.retransmissions <= 5 * testSettings().window + testSettings().window);
+	}
+
+	SECTION( "Interrupted transfer is resumed" ) {
+		{
+			BootloaderEmulator bootloader(link.master, flash);
+			bootloader.silentAfter = 120;
+			bootloader.start();
+
+			REQUIRE(updater.update(image) == UpdateResult::Interrupted);
+			REQUIRE(updater.getProgress().ackedBlocks == 120);
+			REQUIRE(link.uart->speed() == 115200);
+		}
+
+		REQUIRE_FALSE(flash.flashed);
+		REQUIRE(flash.nextBlock == 120);
+
+		BootloaderEmulator bootloader(link.master, flash);
+		bootloader.start();
+
+		REQUIRE(updater.update(image) == UpdateResult::Success);
+		REQUIRE(flash.flashed);
+		REQUIRE(flash.content == image);
+
+		UpdateProgress p = updater.getProgress();
+		REQUIRE(p.resumedBlocks == 120);
+		REQUIRE(p.ackedBlocks == totalBlocks);
+	}
+
+	SECTION( "Silent bootloader interrupts the update" ) {
+		REQUIRE(updater.update(image) == UpdateResult::Interrupted);
+		REQUIRE(updater.getProgress().ackedBlocks == 0);
+	}
+}
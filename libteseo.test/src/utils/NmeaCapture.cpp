@@ -0,0 +1,339 @@
+#include <catch.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <teseo/utils/NmeaCapture.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::test;
+using namespace stm::capture;
+
+namespace {
+
+/**
+ * Stream shaped like a Teseo one: GPS and GLONASS, 1 Hz, slowly moving receiver
+ */
+std::string recording(int epochs, unsigned int seed = 42)
+{
+	std::mt19937 rng(seed);
+	std::normal_distribution<double> noise(0., 1.);
+
+	struct Sat { int prn; int elevation; int azimuth; int snr; };
+	std::vector<Sat> gps, glonass;
+	for(int i = 0; i < 10; i++)
+		gps.push_back(Sat{2 + i * 3, 10 + i * 8, i * 36, 30 + i % 15});
+	for(int i = 0; i < 7; i++)
+		glonass.push_back(Sat{65 + i * 2, 15 + i * 10, 20 + i * 50, 28 + i % 12});
+
+	double latitude = 4530.1234, longitude = 712.5678, altitude = 240.0, speed = 12.;
+	std::string out;
+	char buf[256];
+
+	auto gsv = [&] (const char * talker, std::vector<Sat> & sats) {
+		const int messages = (sats.size() + 3) / 4;
+		for(int m = 0; m < messages; m++)
+		{
+			std::string body = std::string(talker) + "GSV," + std::to_string(messages) + "," + std::to_string(m + 1) + "," + std::to_string(sats.size());
+			for(std::size_t i = m * 4; i < std::min(sats.size(), std::size_t(m * 4 + 4)); i++)
+			{
+				snprintf(buf, sizeof(buf), ",%02d,%02d,%03d,%02d", sats[i].prn, sats[i].elevation, sats[i].azimuth, sats[i].snr);
+				body += buf;
+			}
+			out += sentence(body);
+		}
+	};
+
+	for(int e = 0; e < epochs; e++)
+	{
+		const int t = 36000 + e;
+		const int hh = t / 3600 % 24, mm = t / 60 % 60, ss = t % 60;
+
+		latitude += 0.0003 + noise(rng) * 0.00005;
+		longitude += 0.0002 + noise(rng) * 0.00005;
+		altitude += noise(rng) * 0.1;
+		speed = std::max(0., speed + noise(rng) * 0.2);
+
+		snprintf(buf, sizeof(buf), "GPGGA,%02d%02d%02d.000,%09.4f,N,%09.4f,E,1,%02d,0.8,%.1f,M,47.3,M,,",
+			hh, mm, ss, latitude, longitude, 17, altitude);
+		out += sentence(buf);
+		snprintf(buf, sizeof(buf), "GPRMC,%02d%02d%02d.000,A,%09.4f,N,%09.4f,E,%.1f,%.1f,191018,,,A",
+			hh, mm, ss, latitude, longitude, speed, 54.3 + noise(rng));
+		out += sentence(buf);
+		snprintf(buf, sizeof(buf), "GPVTG,%.1f,T,,M,%.1f,N,%.1f,K,A", 54.3 + noise(rng), speed, speed * 1.852);
+		out += sentence(buf);
+		out += sentence("GNGSA,A,3,02,05,08,11,14,17,20,23,26,29,,,1.4,0.8,1.1");
+		out += sentence("GNGSA,A,3,65,67,69,71,73,75,77,,,,,,1.4,0.8,1.1");
+
+		for(auto * sats : {&gps, &glonass})
+		{
+			for(auto & s : *sats)
+			{
+				s.snr = std::min(50, std::max(20, s.snr + static_cast<int>(std::lround(noise(rng)))));
+				if(e % 60 == 0)
+					s.azimuth = (s.azimuth + 1) % 360;
+			}
+		}
+		gsv("GP", gps);
+		gsv("GL", glonass);
+
+		snprintf(buf, sizeof(buf), "PSTMTG,1018,%d.000,18,0,0x0000,%08d,1,0,0,0", 36000 + e, 1234567 + e * 1000);
+		out += sentence(buf);
+		snprintf(buf, sizeof(buf), "GPGST,%02d%02d%02d.000,1.7,,,,1.2,1.0,2.3", hh, mm, ss);
+		out += sentence(buf);
+	}
+
+	return out;
+}
+
+ByteVector bytes(const std::string & s)
+{
+	return ByteVector(s.begin(), s.end());
+}
+
+/**
+ * Encode in random slices, the chunks are collected separately
+ */
+struct Capture : public Trackable {
+	NmeaCaptureEncoder encoder;
+	std::vector<ByteVector> chunks;
+
+	Capture(std::size_t chunkSize) :
+		encoder(chunkSize)
+	{
+		encoder.newChunk.connect(SlotFactory::create(*this, &Capture::onChunk));
+	}
+
+	void onChunk(const ByteVector & chunk)
+	{
+		chunks.push_back(chunk);
+	}
+
+	void encode(const ByteVector & raw, unsigned int seed = 1)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<std::size_t> slice(1, 300);
+
+		for(std::size_t pos = 0; pos < raw.size(); )
+		{
+			std::size_t n = std::min(slice(rng), raw.size() - pos);
+			encoder.append(raw.data() + pos, n);
+			pos += n;
+		}
+
+		encoder.flush();
+	}
+
+	ByteVector all() const
+	{
+		ByteVector out;
+		for(const auto & c : chunks)
+			out.insert(out.end(), c.begin(), c.end());
+		return out;
+	}
+};
+
+ByteVector roundTrip(const ByteVector & raw, std::size_t chunkSize = 65536)
+{
+	Capture capture(chunkSize);
+	capture.encode(raw);
+
+	ByteVector out;
+	REQUIRE(NmeaCaptureDecoder::decode(capture.all(), out) == 0);
+	return out;
+}
+
+} // namespace
+
+TEST_CASE( "NMEA capture is lossless", "[utils][NmeaCapture]" ) {
+	SECTION( "Receiver stream" ) {
+		const ByteVector raw = bytes(recording(600));
+		REQUIRE(roundTrip(raw) == raw);
+		REQUIRE(roundTrip(raw, 1000) == raw);
+	}
+
+	SECTION( "Unusual content" ) {
+		std::string s;
+		s += sentence("GPGGA,120000.000,4530.1234,N,00712.5678,E,1,08,0.9,100.0,M,47.0,M,,");
+		s += sentence("GPGGA,120001.000,4530.1240,N,00712.5670,E,1,08,0.9,-0.5,M,47.0,M,,");
+		s += sentence("GPGGA,120002.000,4530.1240,S,00712.5670,W,1,8,.9,-0.0,M,-47,M,00,");
+		s += sentence("GPGGA,120003.00,4530.124,N,712.5670,E,1,08,1.,1234567890123456789,M,47.0,M,,");
+		s += sentence("GPGGA");
+		s += sentence("GPGGA,");
+		s += sentence("GPGGA,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,");
+		s += sentence(",empty,type");
+		s += "$GPRMC,120000.000,A,4530.1234,N,00712.5678,E,0.0,0.0,191018,,,A*00\r\n";
+		s += "$GPTXT,lower case checksum*4f\r\n";
+		s += "$GPTXT,no CR*11\n";
+		s += "\r\n\n\n";
+		s += "PSTMVER,no dollar*55\r\n";
+		s += std::string("\0\x01\xFF\x80 binary\r\n", 14);
+		s += sentence("PSTMGEOFENCE,120000.000,191018,0,1,45.000000,N,7.000000,E,5.0");
+		s += std::string(10000, 'x') + "\r\n";
+		for(int i = 0; i < 300; i++)
+			s += sentence("PT" + std::to_string(i) + ",1,2,3");
+		s += "$GPGGA,partial";
+
+		const ByteVector raw = bytes(s);
+		REQUIRE(roundTrip(raw) == raw);
+		REQUIRE(roundTrip(raw, 100) == raw);
+	}
+
+	SECTION( "Empty stream" ) {
+		Capture capture(1000);
+		capture.encoder.flush();
+		REQUIRE(capture.chunks.empty());
+	}
+}
+
+TEST_CASE( "NMEA capture chunks are independent", "[utils][NmeaCapture]" ) {
+	const ByteVector raw = bytes(recording(300));
+	Capture capture(16 * 1024);
+	capture.encode(raw);
+
+	REQUIRE(capture.chunks.size() > 4);
+
+	SECTION( "Each chunk decodes alone" ) {
+		ByteVector out;
+		for(const auto & chunk : capture.chunks)
+		{
+			std::size_t consumed = 0;
+			REQUIRE(NmeaCaptureDecoder::decodeChunk(chunk.data(), chunk.size(), consumed, out) == NmeaCaptureDecoder::Status::Ok);
+			REQUIRE(consumed == chunk.size());
+		}
+		REQUIRE(out == raw);
+	}
+
+	SECTION( "Corrupted chunk is skipped" ) {
+		ByteVector damaged = capture.chunks[2];
+		damaged[damaged.size() / 2] ^= 0x5A;
+		damaged.resize(damaged.size() - 3);
+
+		ByteVector stream;
+		std::size_t before = 0, after = 0;
+		for(std::size_t i = 0; i < capture.chunks.size(); i++)
+		{
+			const ByteVector & c = i == 2 ? damaged : capture.chunks[i];
+			stream.insert(stream.end(), c.begin(), c.end());
+		}
+
+		ByteVector out;
+		REQUIRE(NmeaCaptureDecoder::decode(stream, out) == 1);
+
+		ByteVector expected;
+		for(std::size_t i = 0; i < capture.chunks.size(); i++)
+		{
+			if(i == 2)
+			{
+				before = expected.size();
+				continue;
+			}
+
+			std::size_t consumed;
+			NmeaCaptureDecoder::decodeChunk(capture.chunks[i].data(), capture.chunks[i].size(), consumed, expected);
+			after = expected.size();
+		}
+
+		REQUIRE(before > 0);
+		REQUIRE(after > before);
+		REQUIRE(out == expected);
+	}
+
+	SECTION( "Truncated capture" ) {
+		ByteVector stream = capture.all();
+		stream.resize(stream.size() - 10);
+
+		ByteVector out;
+		REQUIRE(NmeaCaptureDecoder::decode(stream, out) == 1);
+		REQUIRE(out.size() < raw.size());
+		REQUIRE(std::equal(out.begin(), out.end(), raw.begin()));
+	}
+}
+
+TEST_CASE( "NMEA capture writer", "[utils][NmeaCapture]" ) {
+	Thread::setCreateThreadCb(createThread);
+
+	char path[] = "/tmp/nmea-capture-XXXXXX";
+	int fd = mkstemp(path);
+	REQUIRE(fd >= 0);
+	close(fd);
+
+	const ByteVector raw = bytes(recording(120));
+
+	// Two sessions appended to the same file
+	for(int session = 0; session < 2; session++)
+	{
+		NmeaCaptureWriter writer(path, 8 * 1024);
+		writer.start();
+
+		for(std::size_t pos = 0; pos < raw.size(); pos += 512)
+			writer.onNewBytes(ByteVector(raw.begin() + pos, raw.begin() + std::min(raw.size(), pos + 512)));
+
+		REQUIRE(writer.stop() == 0);
+		writer.join();
+		REQUIRE(writer.stop() == -1);
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	ByteVector stored((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	unlink(path);
+
+	ByteVector expected = raw;
+	expected.insert(expected.end(), raw.begin(), raw.end());
+
+	ByteVector out;
+	REQUIRE(NmeaCaptureDecoder::decode(stored, out) == 0);
+	REQUIRE(out == expected);
+}
+
+TEST_CASE( "NMEA capture compression benchmark", "[utils][NmeaCapture][benchmark]" ) {
+	// A recorded capture can be given through NMEA_CAPTURE, a synthetic one is used otherwise
+	ByteVector raw;
+	const char * recorded = std::getenv("NMEA_CAPTURE");
+
+	if(recorded)
+	{
+		std::ifstream file(recorded, std::ios::binary);
+		raw.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	if(raw.empty())
+		raw = bytes(recording(3600));
+
+	Capture capture(65536);
+
+	std::clock_t start = std::clock();
+	capture.encoder.append(raw);
+	capture.encoder.flush();
+	const double encodeCpu = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+	const ByteVector compressed = capture.all();
+
+	ByteVector out;
+	start = std::clock();
+	REQUIRE(NmeaCaptureDecoder::decode(compressed, out) == 0);
+	const double decodeCpu = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+	REQUIRE(out == raw);
+
+	const double megabytes = raw.size() / (1024. * 1024.);
+	const double ratio = double(raw.size()) / compressed.size();
+
+	WARN((recorded ? recorded : "Synthetic capture") << ": " << raw.size() << " bytes to "
+		<< compressed.size() << " in " << capture.chunks.size() << " chunks, ratio " << ratio
+		<< ", encode " << encodeCpu * 1000 / megabytes << " ms CPU/MB, decode "
+		<< decodeCpu * 1000 / megabytes << " ms CPU/MB");
+
+	if(!recorded)
+		REQUIRE(ratio > 3.);
+}
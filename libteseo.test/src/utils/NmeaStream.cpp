@@ -0,0 +1,61 @@
+#include <catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include <teseo/utils/NmeaStream.h>
+
+using namespace stm;
+using namespace stm::stream;
+
+namespace {
+
+struct Sentences : public Trackable {
+	std::vector<std::string> list;
+
+	void onSentence(ByteVectorPtr bytes)
+	{
+		list.push_back(std::string(bytes->begin(), bytes->end()));
+	}
+};
+
+void feed(NmeaStream & stream, const std::string & s)
+{
+	stream.onNewBytes(ByteVector(s.begin(), s.end()));
+}
+
+} // namespace
+
+TEST_CASE( "NMEA stream splits sentences on line ends", "[utils][NmeaStream]" ) {
+	NmeaStream stream;
+	Sentences sentences;
+
+	stream.newSentence.connect(SlotFactory::create(sentences, &Sentences::onSentence));
+
+	SECTION( "Lone sentence is dispatched on its line end" ) {
+		feed(stream, "$PSTMLOGSTARTOK*00\r\n");
+		REQUIRE(sentences.list == std::vector<std::string>({"$PSTMLOGSTARTOK*00"}));
+	}
+
+	SECTION( "Sentences split across reads" ) {
+		feed(stream, "$GPGGA,1");
+		feed(stream, "23*00\r");
+		REQUIRE(sentences.list.empty());
+
+		feed(stream, "\n$GPRMC,4");
+		REQUIRE(sentences.list == std::vector<std::string>({"$GPGGA,123*00"}));
+
+		feed(stream, "56*00\r\n$GPGSV");
+		REQUIRE(sentences.list == std::vector<std::string>({"$GPGGA,123*00", "$GPRMC,456*00"}));
+	}
+
+	SECTION( "Sentences without line end are split on the next dollar" ) {
+		feed(stream, "$GPGGA,1*00$GPRMC,2*00$");
+		REQUIRE(sentences.list == std::vector<std::string>({"$GPGGA,1*00", "$GPRMC,2*00"}));
+	}
+
+	SECTION( "Empty lines are ignored" ) {
+		feed(stream, "\r\n\r\n$GPGGA,1*00\r\n\n\r\n");
+		REQUIRE(sentences.list == std::vector<std::string>({"$GPGGA,1*00"}));
+	}
+}
@@ -0,0 +1,361 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <thread>
+
+#include <teseo/utils/Pps.h>
+#include <teseo/utils/IByteStream.h>
+#include <teseo/device/NmeaDevice.h>
+#include <teseo/protocol/NmeaDecoder.h>
+#include <teseo/test/helpers.h>
+
+using namespace stm;
+using namespace stm::pps;
+
+using namespace std::chrono;
+
+/**
+ * Fake PPS source replaying pulses with known deviations from the nominal period
+ */
+class FakePpsSource : public IPpsSource {
+private:
+	std::string fakeName;
+	std::deque<nanoseconds> deviations;
+	nanoseconds nominalTime;
+	uint32_t sequence;
+
+public:
+	FakePpsSource(std::initializer_list<nanoseconds> devs) :
+		fakeName("fake-pps"),
+		deviations(devs),
+		nominalTime(seconds(1000)),
+		sequence(0)
+	{ }
+
+	const std::string & name() const { return fakeName; }
+
+	void open() { }
+
+	void close() { }
+
+	std::optional<PpsEvent> fetch(milliseconds)
+	{
+		if(deviations.empty())
+			return {};
+
+		nanoseconds t = nominalTime + deviations.front();
+		deviations.pop_front();
+		nominalTime += seconds(1);
+		sequence++;
+
+		return PpsEvent { t, t, sequence };
+	}
+
+	void skip()
+	{
+		nominalTime += seconds(1);
+	}
+};
+
+TEST_CASE( "PPS estimator computes interval and jitter", "[utils][Pps]" ) {
+
+	FakePpsSource source({
+		microseconds(0), microseconds(50), microseconds(-50),
+		microseconds(50), microseconds(-50), microseconds(0)
+	});
+
+	PpsEpochEstimator estimator;
+
+	while(auto event = source.fetch(milliseconds(1500)))
+		estimator.onPulse(*event);
+
+	PpsStatistics stats = estimator.statistics();
+
+	REQUIRE(stats.pulses == 6);
+	REQUIRE(stats.missed == 0);
+	REQUIRE(stats.meanInterval == seconds(1));
+	REQUIRE(stats.maxDeviation == microseconds(100));
+
+	// Intervals deviations: +50, -100, +100, -100, +50 us
+	REQUIRE(stats.jitter > microseconds(83));
+	REQUIRE(stats.jitter < microseconds(84));
+}
+
+TEST_CASE( "PPS estimator detects missing pulses", "[utils][Pps]" ) {
+
+	FakePpsSource source({ microseconds(0), microseconds(0), microseconds(0) });
+	PpsEpochEstimator estimator;
+
+	estimator.onPulse(*source.fetch(milliseconds(1500)));
+	source.skip();
+	source.skip();
+	estimator.onPulse(*source.fetch(milliseconds(1500)));
+	estimator.onPulse(*source.fetch(milliseconds(1500)));
+
+	PpsStatistics stats = estimator.statistics();
+
+	REQUIRE(stats.pulses == 3);
+	REQUIRE(stats.missed == 2);
+	REQUIRE(stats.meanInterval == seconds(1));
+}
+
+TEST_CASE( "PPS estimator learns the epoch deadline", "[utils][Pps]" ) {
+
+	FakePpsSource source({
+		microseconds(0), microseconds(0), microseconds(0), microseconds(0), microseconds(0)
+	});
+
+	PpsEpochEstimator estimator(16, milliseconds(20));
+
+	// Sentences of each epoch are received between 100 and 250 ms after the pulse
+	for(int i = 0; i < 3; i++)
+	{
+		auto event = source.fetch(milliseconds(1500));
+		estimator.onPulse(*event);
+
+		REQUIRE(!estimator.epochDeadline());
+
+		estimator.onSentence(event->monotonicTime + milliseconds(100));
+		estimator.onSentence(event->monotonicTime + milliseconds(200 + i * 25));
+	}
+
+	auto event = source.fetch(milliseconds(1500));
+	estimator.onPulse(*event);
+
+	auto deadline = estimator.epochDeadline();
+
+	REQUIRE(static_cast<bool>(deadline));
+	REQUIRE(*deadline == event->monotonicTime + milliseconds(250 + 20));
+	REQUIRE(estimator.statistics().sentenceLatency == milliseconds(250));
+
+	// Sentences received before the pulse are ignored
+	estimator.onSentence(event->monotonicTime - milliseconds(10));
+	estimator.onPulse(*source.fetch(milliseconds(1500)));
+
+	REQUIRE(estimator.statistics().sentenceLatency == milliseconds(250));
+}
+
+TEST_CASE( "PPS estimator anchors GNSS time to the monotonic clock", "[utils][Pps]" ) {
+
+	FakePpsSource source({ microseconds(0) });
+	PpsEpochEstimator estimator;
+
+	REQUIRE(!estimator.gnssTimeAt(seconds(0)));
+
+	auto event = source.fetch(milliseconds(1500));
+	estimator.onPulse(*event);
+	estimator.anchor(1500000000000);
+
+	REQUIRE(*estimator.gnssTimeAt(event->monotonicTime) == 1500000000000);
+	REQUIRE(*estimator.gnssTimeAt(event->monotonicTime + milliseconds(1234)) == 1500000001234);
+}
+
+/**
+ * Fake PPS source pulsing in real time, with a short period to keep the tests fast
+ */
+class LivePpsSource : public IPpsSource {
+private:
+	std::string fakeName;
+	nanoseconds period;
+	nanoseconds nextPulse;
+	uint32_t sequence;
+
+public:
+	std::atomic<unsigned int> opened;
+	std::atomic<unsigned int> closed;
+
+	LivePpsSource(nanoseconds period = milliseconds(100)) :
+		fakeName("live-pps"),
+		period(period),
+		nextPulse(nanoseconds::zero()),
+		sequence(0),
+		opened(0),
+		closed(0)
+	{ }
+
+	const std::string & name() const { return fakeName; }
+
+	void open()
+	{
+		nextPulse = monotonicNow() + period;
+		opened++;
+	}
+
+	void close() { closed++; }
+
+	std::optional<PpsEvent> fetch(milliseconds timeout)
+	{
+		nanoseconds now = monotonicNow();
+
+		if(nextPulse - now > timeout)
+		{
+			std::this_thread::sleep_for(timeout);
+			return {};
+		}
+
+		std::this_thread::sleep_for(nextPulse - now);
+
+		PpsEvent event { nextPulse, nextPulse, ++sequence };
+		nextPulse += period;
+
+		return event;
+	}
+};
+
+TEST_CASE( "Kernel PPS source reports open and read errors", "[utils][Pps]" ) {
+
+	SECTION( "Nonexistent device" ) {
+		KernelPpsSource source("/dev/nonexistent-pps");
+		REQUIRE_THROWS_AS(source.open(), const stream::StreamOpenException &);
+	}
+
+	SECTION( "Device without PPS capabilities" ) {
+		KernelPpsSource source("/dev/null");
+		REQUIRE_THROWS_AS(source.open(), const stream::StreamOpenException &);
+		REQUIRE_THROWS_AS(source.fetch(milliseconds(10)), const stream::StreamNotOpenedException &);
+	}
+
+	SECTION( "Fetch before open" ) {
+		KernelPpsSource source("/dev/null");
+		REQUIRE_THROWS_AS(source.fetch(milliseconds(10)), const stream::StreamNotOpenedException &);
+	}
+}
+
+TEST_CASE( "PPS epoch timer signals the epoch deadline", "[utils][Pps]" ) {
+
+	Thread::setCreateThreadCb(&test::createThread);
+
+	LivePpsSource source;
+	PpsEpochTimer timer(source);
+
+	std::atomic<unsigned int> pulses(0);
+	std::atomic<unsigned int> due(0);
+
+	// Sentences follow each pulse
+	timer.pulse.connect(SlotFactory::create(std::function<void(const PpsEvent &)>(
+		[&] (const PpsEvent &) {
+			pulses++;
+			timer.onSentence();
+		})));
+
+	timer.epochDue.connect(SlotFactory::create(std::function<void()>(
+		[&] () {
+			due++;
+		})));
+
+	timer.start();
+	std::this_thread::sleep_for(milliseconds(850));
+	timer.stop();
+
+	unsigned int received = pulses;
+
+	REQUIRE(received >= 6);
+	REQUIRE(timer.statistics().pulses == received);
+
+	// Deadlines are only known once enough epochs were learned
+	REQUIRE(due > 0);
+	REQUIRE(due <= received - PpsEpochEstimator::minimalLearnedEpochs);
+
+	REQUIRE(source.opened == 1);
+	REQUIRE(source.closed == 1);
+}
+
+TEST_CASE( "PPS epoch timer start and stop", "[utils][Pps]" ) {
+
+	Thread::setCreateThreadCb(&test::createThread);
+
+	LivePpsSource source;
+	PpsEpochTimer timer(source);
+
+	SECTION( "Stop without start" ) {
+		REQUIRE(timer.stop() == 0);
+		REQUIRE(source.opened == 0);
+	}
+
+	SECTION( "Stop right after start" ) {
+		// The stop request must not be lost if the thread isn't running yet
+		timer.start();
+		timer.stop();
+
+		REQUIRE(source.opened == source.closed);
+		REQUIRE(timer.statistics().pulses <= 1);
+	}
+
+	SECTION( "Restart" ) {
+		timer.start();
+		std::this_thread::sleep_for(milliseconds(250));
+		timer.stop();
+
+		REQUIRE(timer.statistics().pulses > 0);
+
+		// A quick restart gets a fresh estimator and a running thread
+		REQUIRE(timer.start() != 0);
+		std::this_thread::sleep_for(milliseconds(250));
+		timer.stop();
+
+		REQUIRE(source.opened == 2);
+		REQUIRE(source.closed == 2);
+		REQUIRE(timer.statistics().pulses > 0);
+		REQUIRE(timer.statistics().pulses <= 3);
+	}
+}
+
+/**
+ * Decoder fed with sentences directly, without the stream and the decoder thread
+ */
+class PpsTestDecoder : public decoder::NmeaDecoder {
+public:
+	PpsTestDecoder(device::AbstractDevice & device) :
+		decoder::NmeaDecoder(device)
+	{ }
+
+	void feed(const std::string & body)
+	{
+		std::string s = test::sentence(body);
+
+		// The stream strips the line end
+		s.resize(s.size() - 2);
+
+		decode(ByteVectorPtr(new ByteVector(s.begin(), s.end())));
+	}
+};
+
+TEST_CASE( "Epoch due publishes the current epoch once", "[utils][Pps]" ) {
+
+	device::NmeaDevice device;
+	PpsTestDecoder decoder(device);
+
+	unsigned int updates = 0;
+
+	device.locationUpdate.connect(SlotFactory::create(std::function<void(const Location &)>(
+		[&] (const Location &) {
+			updates++;
+		})));
+
+	SECTION( "Nothing received" ) {
+		device.onEpochDue();
+		REQUIRE(updates == 0);
+	}
+
+	SECTION( "Epoch published before the next one starts" ) {
+		decoder.feed("GPGGA,120000.000,4530.1234,N,00712.5678,E,1,08,0.9,100.0,M,47.0,M,,");
+		REQUIRE(updates == 0);
+
+		device.onEpochDue();
+		REQUIRE(updates == 1);
+
+		// Once per epoch
+		device.onEpochDue();
+		REQUIRE(updates == 1);
+
+		// The start of the next epoch doesn't publish it again
+		decoder.feed("GPGGA,120001.000,4530.1240,N,00712.5670,E,1,08,0.9,100.0,M,47.0,M,,");
+		REQUIRE(updates == 1);
+
+		// Without the timer, the epoch is published by the start of the next one
+		decoder.feed("GPGGA,120002.000,4530.1246,N,00712.5662,E,1,08,0.9,100.0,M,47.0,M,,");
+		REQUIRE(updates == 2);
+	}
+}
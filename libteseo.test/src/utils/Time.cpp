@@ -27,3 +27,32 @@ TEST_CASE( "NMEA Time parser works correctly", "[utils][Time]" ) {
 
 	REQUIRE(static_cast<bool>(opt_empty) == false);
 }
+
+TEST_CASE( "NMEA Time parser rejects truncated input", "[utils][Time]" ) {
+
+	ByteVector no_msec = { '1', '3', '3', '7', '4', '2' };
+	ByteVector short_msec = { '1', '3', '3', '7', '4', '2', '.', '0' };
+
+	REQUIRE_FALSE(static_cast<bool>(parseTimestamp(no_msec)));
+	REQUIRE_FALSE(static_cast<bool>(parseTimestamp(short_msec)));
+}
+
+TEST_CASE( "NMEA date and time parser works correctly", "[utils][Time]" ) {
+
+	ByteVector date = { '1', '9', '1', '0', '1', '8' };
+	ByteVector time_str = { '1', '2', '0', '0', '0', '0', '.', '0', '0', '0' };
+
+	std::optional<GpsUtcTime> opt_time = parseTimestamp(date, time_str);
+
+	REQUIRE(static_cast<bool>(opt_time) == true);
+	REQUIRE(*opt_time == 1539950400000);
+
+	ByteVector leap_day = { '2', '9', '0', '2', '2', '0' };
+	REQUIRE(*parseTimestamp(leap_day, time_str) == 1582977600000);
+
+	ByteVector bad_month = { '1', '9', '1', '3', '1', '8' };
+	ByteVector short_date = { '1', '9', '1', '0', '1' };
+
+	REQUIRE_FALSE(static_cast<bool>(parseTimestamp(bad_month, time_str)));
+	REQUIRE_FALSE(static_cast<bool>(parseTimestamp(short_date, time_str)));
+}
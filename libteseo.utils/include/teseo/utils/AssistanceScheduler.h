@@ -0,0 +1,304 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Predictive assistance data refresh scheduler
+ * @file AssistanceScheduler.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_UTILS_ASSISTANCE_SCHEDULER_H
+#define TESEO_HAL_UTILS_ASSISTANCE_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <hardware/gps.h>
+
+#include "optional.h"
+#include "Signal.h"
+#include "Thread.h"
+
+namespace stm {
+namespace assistance {
+
+using Clock = std::chrono::system_clock;
+using time_point = Clock::time_point;
+using seconds = std::chrono::seconds;
+
+/**
+ * @brief      Scheduler policy
+ */
+struct SchedulerPolicy {
+	/**
+	 * Items are refreshed this long before they expire
+	 */
+	seconds prefetchLead;
+
+	/**
+	 * When a refresh happens anyway, items expiring within this window after their prefetch time
+	 * are refreshed with it
+	 */
+	seconds coalesceWindow;
+
+	/**
+	 * First retry delay after a failure, doubled on each consecutive failure
+	 */
+	seconds backoffBase;
+
+	/**
+	 * Maximum retry delay
+	 */
+	seconds backoffMax;
+
+	/**
+	 * Relative jitter applied to the retry delay, in [0, 1[
+	 */
+	double backoffJitter;
+
+	/**
+	 * Maximum number of bytes downloaded in any 24 hours window, 0 for unlimited
+	 */
+	std::size_t dailyBudget;
+
+	SchedulerPolicy();
+};
+
+/**
+ * @brief      Result of an assistance download
+ */
+struct FetchResult {
+	bool success;            ///< Download succeeded and the receiver got the data, or gets it at the next start
+	std::size_t bytes;       ///< Number of bytes downloaded, even on failure
+	time_point validUntil;   ///< New validity end of the item, on success
+};
+
+/**
+ * @brief      Predictive assistance refresh scheduler
+ *
+ * @details    The scheduler tracks the validity window of every injected assistance item and
+ * decides when each of them must be refreshed. It doesn't perform any I/O nor lock, the time is
+ * given by the caller so it can be driven by a virtual clock.
+ */
+class AssistanceScheduler {
+private:
+	struct Item {
+		time_point validUntil;
+		std::size_t expectedBytes;
+		unsigned int failures;
+		time_point nextAttempt;
+		bool inFlight;
+	};
+
+	SchedulerPolicy policy;
+
+	std::map<std::string, Item> items;
+
+	std::deque<std::pair<time_point, std::size_t>> usage;
+
+	std::mt19937 rng;
+
+	void expireUsage(time_point now);
+
+	bool fitsBudget(std::size_t bytes) const;
+
+	time_point prefetchTime(const Item & item) const;
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  policy  The scheduling policy
+	 * @param[in]  seed    Seed of the backoff jitter generator
+	 */
+	AssistanceScheduler(const SchedulerPolicy & policy, uint32_t seed = std::mt19937::default_seed);
+
+	/**
+	 * @brief      Track an assistance item
+	 *
+	 * @param[in]  id             Item identifier
+	 * @param[in]  validUntil     End of the item validity
+	 * @param[in]  expectedBytes  Expected download size, used for the budget
+	 */
+	void track(const std::string & id, time_point validUntil, std::size_t expectedBytes);
+
+	/**
+	 * @brief      Stop tracking an assistance item
+	 */
+	void untrack(const std::string & id);
+
+	/**
+	 * @brief      Get the items to refresh now
+	 *
+	 * @details    The returned items are marked as in flight until their result is reported.
+	 *
+	 * @param[in]  now     Current time
+	 * @param[in]  awake   Set to true when the system is awake anyway, so refreshes due soon are
+	 * coalesced with this wakeup.
+	 *
+	 * @return     Identifiers of the items to refresh
+	 */
+	std::vector<std::string> poll(time_point now, bool awake = false);
+
+	/**
+	 * @brief      Report the result of a refresh
+	 */
+	void report(const std::string & id, const FetchResult & result, time_point now);
+
+	/**
+	 * @brief      Get the time at which the scheduler must be polled again
+	 *
+	 * @return     The next wakeup time, or an empty value if nothing is tracked
+	 */
+	std::optional<time_point> nextWakeup(time_point now);
+
+	/**
+	 * @brief      Get the number of bytes downloaded in the last 24 hours
+	 */
+	std::size_t budgetUsed(time_point now);
+
+	/**
+	 * @brief      Get the validity end of an item
+	 */
+	std::optional<time_point> validUntil(const std::string & id) const;
+};
+
+/**
+ * @brief      Assistance fetcher interface
+ */
+class IAssistanceFetcher {
+public:
+	virtual ~IAssistanceFetcher() { }
+
+	/**
+	 * @brief      Download and inject an assistance item
+	 *
+	 * @details    Called from the refresher thread, the call is blocking.
+	 *
+	 * @param[in]  id    Identifier of the item
+	 *
+	 * @return     The download result
+	 */
+	virtual FetchResult fetch(const std::string & id) = 0;
+};
+
+/**
+ * @brief      HTTP assistance fetcher
+ *
+ * @details    Each item is downloaded from its own URI using HttpRequest. The downloaded content is
+ * forwarded through the `downloaded` signal, its slot injects the data into the receiver and
+ * returns the new validity end of the item, or 0 if the data couldn't be injected.
+ */
+class HttpAssistanceFetcher : public IAssistanceFetcher {
+private:
+	std::map<std::string, std::string> uris;
+
+	std::chrono::milliseconds timeout;
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  timeout  A download taking longer fails, so a stalled server can't block the
+	 * refresher thread
+	 */
+	HttpAssistanceFetcher(std::chrono::milliseconds timeout = std::chrono::minutes(1));
+
+	/**
+	 * @brief      Set the URI of an item
+	 */
+	void setUri(const std::string & id, const std::string & uri);
+
+	virtual FetchResult fetch(const std::string & id);
+
+	Signal<GpsUtcTime, const std::string &, const std::vector<char> &> downloaded;
+};
+
+/**
+ * @brief      Assistance refresher thread
+ *
+ * @details    Runs the scheduler against the system clock and performs the refreshes with the
+ * fetcher.
+ */
+class AssistanceRefresher :
+	public Trackable,
+	public Thread
+{
+private:
+	AssistanceScheduler scheduler;
+
+	IAssistanceFetcher & fetcher;
+
+	std::mutex mutex;
+
+	std::condition_variable cond;
+
+	bool runRefresher;
+
+	bool awake;
+
+	bool changed;
+
+protected:
+	virtual void run();
+
+public:
+	AssistanceRefresher(const SchedulerPolicy & policy, IAssistanceFetcher & fetcher);
+
+	virtual ~AssistanceRefresher();
+
+	/**
+	 * @brief      Start the refresher thread
+	 */
+	int start();
+
+	/**
+	 * @brief      Track an assistance item, see AssistanceScheduler::track
+	 */
+	void track(const std::string & id, time_point validUntil, std::size_t expectedBytes);
+
+	/**
+	 * @brief      Wakeup slot
+	 *
+	 * @details    Called when the system is awake for another reason (navigation start, network
+	 * connection...), refreshes due soon are performed now.
+	 */
+	void onWakeup();
+
+	virtual int stop();
+
+	/**
+	 * Signal emitted after each refresh attempt
+	 */
+	Signal<void, const std::string &, const FetchResult &> refreshed;
+};
+
+} // namespace assistance
+} // namespace stm
+
+#endif // TESEO_HAL_UTILS_ASSISTANCE_SCHEDULER_H
@@ -0,0 +1,229 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Resumable receiver firmware update over the UART byte stream
+ * @file FirmwareUpdater.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_UTILS_FIRMWARE_UPDATER_H
+#define TESEO_HAL_UTILS_FIRMWARE_UPDATER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include "ByteVector.h"
+#include "optional.h"
+#include "Signal.h"
+#include "UartByteStream.h"
+
+namespace stm {
+namespace firmware {
+
+using milliseconds = std::chrono::milliseconds;
+
+/**
+ * @brief      Compute the CRC-32 (IEEE 802.3) of a buffer
+ */
+uint32_t crc32(const uint8_t * data, std::size_t size, uint32_t crc = 0);
+
+/**
+ * @brief      Update protocol frame types
+ */
+enum class FrameType : uint8_t {
+	// Host to bootloader
+	Hello  = 0x01, ///< Start or resume an update, payload: size, CRC, block size, baud rate
+	Data   = 0x02, ///< One image block, sequence is the block index
+	Commit = 0x03, ///< All blocks sent, verify and flash the image
+	Abort  = 0x04, ///< Stop the update, the received blocks are kept for a resume
+
+	// Bootloader to host
+	Status = 0x81, ///< Hello answer, sequence is the first block to send, payload: baud rate
+	Ack    = 0x82, ///< Cumulative acknowledge, sequence is the next expected block
+	Nak    = 0x83, ///< Block rejected, sequence is the block to send again
+	Done   = 0x84  ///< Commit answer, payload: 0 on success
+};
+
+/**
+ * @brief      Update protocol frame
+ *
+ * @details    On the wire a frame is: 0xA5, type, sequence (u32 LE), payload length (u16 LE),
+ * payload, CRC-32 (u32 LE) of type, sequence, length and payload.
+ */
+struct Frame {
+	FrameType type;
+	uint32_t sequence;
+	ByteVector payload;
+
+	static constexpr uint8_t startOfFrame = 0xA5;
+
+	static constexpr std::size_t headerSize = 8;
+
+	static constexpr std::size_t maxPayloadSize = 8192;
+
+	/**
+	 * @brief      Serialize the frame
+	 */
+	ByteVector encode() const;
+};
+
+/**
+ * @brief      Incremental frame parser
+ *
+ * @details    Bytes are accumulated until a complete frame is available. Corrupted frames are
+ * dropped and the parser resynchronizes on the next start of frame.
+ */
+class FrameParser {
+private:
+	ByteVector buffer;
+
+	unsigned int dropped;
+
+public:
+	FrameParser();
+
+	/**
+	 * @brief      Push received bytes
+	 *
+	 * @return     The complete frames found
+	 */
+	std::deque<Frame> push(const ByteVector & bytes);
+
+	/**
+	 * @brief      Number of corrupted frames dropped
+	 */
+	unsigned int droppedFrames() const;
+
+	void reset();
+};
+
+/**
+ * @brief      Firmware update settings
+ */
+struct UpdateSettings {
+	std::size_t blockSize;     ///< Image block size
+	unsigned int window;       ///< Maximum number of unacknowledged blocks
+	milliseconds ackTimeout;   ///< Delay without acknowledge before sending the window again
+	unsigned int maxRetries;   ///< Consecutive timeouts before the update is interrupted
+	unsigned int baudRate;     ///< Baud rate used during the transfer, 0 for the maximum supported
+
+	UpdateSettings();
+};
+
+/**
+ * @brief      Firmware update progress
+ */
+struct UpdateProgress {
+	uint32_t ackedBlocks;      ///< Blocks acknowledged by the bootloader
+	uint32_t totalBlocks;      ///< Number of blocks of the image
+	uint32_t resumedBlocks;    ///< Blocks already present on the bootloader when the update started
+	uint32_t retransmissions;  ///< Blocks sent more than once
+	double throughput;         ///< Acknowledged bytes per second since the update started
+};
+
+/**
+ * @brief      Firmware update result
+ */
+enum class UpdateResult {
+	Success,      ///< Image flashed
+	Interrupted,  ///< Bootloader stopped answering, the update can be resumed
+	Rejected,     ///< Bootloader refused the image
+	StreamError   ///< Byte stream error
+};
+
+const char * toString(UpdateResult result);
+
+/**
+ * @brief      Windowed firmware update engine
+ *
+ * @details    The image is sent through the byte stream writer with a sliding window of
+ * unacknowledged blocks, each block is protected by the frame CRC. The bootloader acknowledges the
+ * blocks cumulatively and rejects a corrupted block with a NAK, the window is then sent again from
+ * this block. The bootloader keeps the acknowledged blocks, when an interrupted update is started
+ * again with the same image it resumes from the first missing block.
+ *
+ * The byte stream must be started and the navigation stopped during the update.
+ *
+ * The framing is not validated against the receiver bootloader yet, the updater is only built
+ * with TESEO_FIRMWARE_UPDATE_ENABLED.
+ */
+class FirmwareUpdater :
+	public Trackable
+{
+private:
+	stream::UartByteStream & stream;
+
+	UpdateSettings settings;
+
+	FrameParser parser;
+
+	std::mutex mutex;
+
+	std::condition_variable cond;
+
+	std::deque<Frame> frames;
+
+	UpdateProgress currentProgress;
+
+	void send(const Frame & frame);
+
+	std::optional<Frame> receive(milliseconds timeout);
+
+	UpdateResult transfer(const ByteVector & image, uint32_t first, uint32_t totalBlocks);
+
+public:
+	FirmwareUpdater(stream::UartByteStream & stream, const UpdateSettings & settings = UpdateSettings());
+
+	/**
+	 * @brief      Update the receiver firmware
+	 *
+	 * @details    The call is blocking, progress is reported through the `progress` signal.
+	 *
+	 * @param[in]  image  Firmware image
+	 *
+	 * @return     The update result
+	 */
+	UpdateResult update(const ByteVector & image);
+
+	/**
+	 * @brief      Get the progress of the current or last update
+	 */
+	UpdateProgress getProgress();
+
+	/**
+	 * @brief      Received bytes slot, connected to the byte stream
+	 */
+	void onNewBytes(const ByteVector & bytes);
+
+	/**
+	 * Signal emitted each time blocks are acknowledged
+	 */
+	Signal<void, const UpdateProgress &> progress;
+};
+
+} // namespace firmware
+} // namespace stm
+
+#endif // TESEO_HAL_UTILS_FIRMWARE_UPDATER_H
@@ -22,6 +22,7 @@
 #ifndef TESEO_HAL_UTILS_IBYTESTREAM_H
 #define TESEO_HAL_UTILS_IBYTESTREAM_H
 
+#include <mutex>
 #include <stdexcept>
 #include "Signal.h"
 #include "ByteVector.h"
@@ -124,6 +125,8 @@ protected:
 
 	/**
 	 * @brief Open device for reading and writing
+	 *
+	 * @details Calls are reference counted, the device is closed by the last matching close().
 	 */
 	virtual void open() noexcept(false) = 0;
 
@@ -197,33 +200,29 @@ private:
 
 public:
 	ByteStreamOpener(IByteStream & s) :
-		stream(s)
+		stream(s),
+		closeOnDestroy(false)
 	{
-		if(stream.status() != ByteStreamStatus::OPENED)
+		// Opening is reference counted: the stream stays open until every opener is destroyed,
+		// the reader and the writer may stop in any order.
+		if(CatchException)
 		{
-			if(CatchException)
-			{
-				try
-				{
-					stream.open();
-					closeOnDestroy = true;
-				}
-				catch(const StreamException & ex)
-				{
-					__private_ByteStreamOpenerLog::loge("Error while opening stream '%s': %s",
-						stream.name(),
-						ex.what());
-				}
-			}
-			else
+			try
 			{
 				stream.open();
 				closeOnDestroy = true;
 			}
+			catch(const StreamException & ex)
+			{
+				__private_ByteStreamOpenerLog::loge("Error while opening stream '%s': %s",
+					stream.name(),
+					ex.what());
+			}
 		}
 		else
 		{
-			closeOnDestroy = false;
+			stream.open();
+			closeOnDestroy = true;
 		}
 	}
 
@@ -265,9 +264,21 @@ protected:
 
 	bool runReader;
 
+	bool reading; ///< True until the read loop has seen the stop request
+
+	std::mutex readerMutex;
+
 public:
 	ByteStreamReader(IByteStream & bs);
 
+	/**
+	 * @brief Start the reader
+	 *
+	 * @details A reader stopped while blocked in read() resumes instead of exiting, the
+	 * stream can be stopped and started again while no bytes are received.
+	 */
+	int start();
+
 	int stop();
 };
 
@@ -0,0 +1,197 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Compressed NMEA stream capture
+ * @file NmeaCapture.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_UTILS_NMEA_CAPTURE_H
+#define TESEO_HAL_UTILS_NMEA_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ByteVector.h"
+#include "Channel.h"
+#include "Signal.h"
+#include "Thread.h"
+
+namespace stm {
+namespace capture {
+
+namespace priv {
+class Model;
+} // namespace priv
+
+/**
+ * @brief      Streaming NMEA capture encoder
+ *
+ * @details    The raw stream is cut in lines. Well formed sentences are encoded field by field
+ * against the previous sentence of the same type: repeated fields take one byte, numeric fields
+ * keeping their format are delta coded and the other values are taken from a small per field
+ * dictionary. Anything else, including partial lines and bad checksums, is kept as a literal so
+ * the stream is reproduced byte for byte.
+ *
+ * The output is made of chunks covering at least chunkSize raw bytes, each one starting with a
+ * fresh model so it can be decoded on its own:
+ *
+ *     "NMZ1" | varint rawSize | varint payloadSize | CRC-32 of payload, little endian | payload
+ */
+class NmeaCaptureEncoder {
+private:
+	std::size_t chunkSize;
+
+	std::unique_ptr<priv::Model> model;
+
+	ByteVector line;
+
+	ByteVector payload;
+
+	std::size_t rawSize;
+
+	void encodeLine(const uint8_t * data, std::size_t size);
+
+	void closeChunk();
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  chunkSize  Raw bytes covered by a chunk before it is closed
+	 */
+	explicit NmeaCaptureEncoder(std::size_t chunkSize = 65536);
+
+	~NmeaCaptureEncoder();
+
+	/**
+	 * @brief      Append raw stream bytes, complete chunks are sent through newChunk
+	 */
+	void append(const uint8_t * data, std::size_t size);
+
+	void append(const ByteVector & bytes);
+
+	/**
+	 * @brief      Close the current chunk, including the pending partial line
+	 */
+	void flush();
+
+	/**
+	 * Chunk ready to be stored
+	 */
+	Signal<void, const ByteVector &> newChunk;
+};
+
+/**
+ * @brief      NMEA capture decoder
+ */
+class NmeaCaptureDecoder {
+public:
+	enum class Status {
+		Ok,         ///< Chunk decoded
+		Incomplete, ///< More bytes are needed
+		Corrupted   ///< Not a valid chunk
+	};
+
+	/**
+	 * @brief      Decode one chunk
+	 *
+	 * @param[in]  data      Capture bytes, starting with a chunk
+	 * @param[in]  size      Number of bytes available
+	 * @param[out] consumed  Size of the chunk, on success
+	 * @param      out       Raw bytes are appended to it, on success
+	 *
+	 * @return     Decoding status
+	 */
+	static Status decodeChunk(const uint8_t * data, std::size_t size, std::size_t & consumed, ByteVector & out);
+
+	/**
+	 * @brief      Decode a whole capture
+	 *
+	 * @details    A corrupted chunk is skipped up to the next chunk header.
+	 *
+	 * @param[in]  capture  Capture bytes
+	 * @param      out      Raw bytes are appended to it
+	 *
+	 * @return     Number of chunks skipped
+	 */
+	static std::size_t decode(const ByteVector & capture, ByteVector & out);
+};
+
+/**
+ * @brief      Compressed NMEA capture file writer
+ *
+ * @details    The received bytes are only copied in the caller thread, they are encoded and
+ * written to the file by the writer thread. Chunks are appended to the file so several sessions
+ * can be stored in the same capture.
+ */
+class NmeaCaptureWriter :
+	public Trackable,
+	public Thread
+{
+private:
+	std::string path;
+
+	NmeaCaptureEncoder encoder;
+
+	FILE * file;
+
+	std::mutex mutex;
+
+	bool capturing;
+
+	thread::Channel<ByteVector *> bytesChannel;
+
+	void onChunk(const ByteVector & chunk);
+
+protected:
+	virtual void run();
+
+public:
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  path       Capture file path
+	 * @param[in]  chunkSize  Raw bytes covered by a chunk
+	 */
+	NmeaCaptureWriter(const std::string & path, std::size_t chunkSize = 65536);
+
+	virtual ~NmeaCaptureWriter();
+
+	/**
+	 * @brief      Received bytes slot
+	 */
+	void onNewBytes(const ByteVector & bytes);
+
+	/**
+	 * @brief      Stop the writer once the queued bytes are written
+	 */
+	virtual int stop();
+};
+
+} // namespace capture
+} // namespace stm
+
+#endif // TESEO_HAL_UTILS_NMEA_CAPTURE_H
@@ -0,0 +1,320 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Kernel PPS based epoch timing
+ * @file Pps.h
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#ifndef TESEO_HAL_UTILS_PPS_H
+#define TESEO_HAL_UTILS_PPS_H
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <cstdint>
+
+#include <hardware/gps.h>
+
+#include "optional.h"
+#include "Signal.h"
+#include "Thread.h"
+
+namespace stm {
+namespace pps {
+
+using nanoseconds = std::chrono::nanoseconds;
+using milliseconds = std::chrono::milliseconds;
+
+/**
+ * @brief      One pulse captured on the receiver 1PPS line
+ */
+struct PpsEvent {
+	/**
+	 * Pulse assert time as timestamped by the kernel (CLOCK_REALTIME)
+	 */
+	nanoseconds assertTime;
+
+	/**
+	 * Pulse assert time converted to the monotonic clock (CLOCK_MONOTONIC)
+	 */
+	nanoseconds monotonicTime;
+
+	/**
+	 * Kernel assert sequence number
+	 */
+	uint32_t sequence;
+};
+
+/**
+ * @brief      Pulse per second source interface
+ *
+ * @details    The interface is implemented by KernelPpsSource for the Linux PPS API, it can also be
+ * implemented by fake sources to drive the epoch timing from a test.
+ */
+class IPpsSource {
+public:
+	virtual ~IPpsSource() { }
+
+	/**
+	 * @brief      Get the source name
+	 */
+	virtual const std::string & name() const = 0;
+
+	/**
+	 * @brief      Open the source
+	 */
+	virtual void open() noexcept(false) = 0;
+
+	/**
+	 * @brief      Close the source
+	 */
+	virtual void close() = 0;
+
+	/**
+	 * @brief      Wait for the next pulse
+	 *
+	 * @param[in]  timeout  Maximum time to wait for the pulse
+	 *
+	 * @return     The pulse, or an empty value on timeout
+	 */
+	virtual std::optional<PpsEvent> fetch(milliseconds timeout) noexcept(false) = 0;
+};
+
+/**
+ * @brief      Linux kernel PPS source (/dev/ppsN)
+ */
+class KernelPpsSource : public IPpsSource {
+private:
+	std::string device;
+
+	int fd;
+
+	uint32_t lastSequence;
+
+public:
+	explicit KernelPpsSource(const std::string & device);
+
+	virtual ~KernelPpsSource();
+
+	virtual const std::string & name() const;
+
+	virtual void open() noexcept(false);
+
+	virtual void close();
+
+	virtual std::optional<PpsEvent> fetch(milliseconds timeout) noexcept(false);
+};
+
+/**
+ * @brief      PPS timing statistics
+ */
+struct PpsStatistics {
+	unsigned int pulses;        ///< Number of pulses received
+	unsigned int missed;        ///< Number of pulses detected as missing
+	nanoseconds meanInterval;   ///< Mean interval between two consecutive pulses
+	nanoseconds jitter;         ///< Standard deviation of the pulse interval
+	nanoseconds maxDeviation;   ///< Maximum deviation of the pulse interval from one second
+	nanoseconds sentenceLatency; ///< Learned delay between pulse and last sentence of the epoch
+};
+
+/**
+ * @brief      PPS epoch estimator
+ *
+ * @details    The estimator is fed with the pulses and with the arrival time of each sentence. It
+ * learns how long after the pulse the receiver has finished sending the epoch's sentences, so the
+ * epoch can be published as soon as they are all received instead of waiting for the first
+ * sentence of the next epoch. It also anchors the GNSS time to the monotonic clock.
+ *
+ * The estimator doesn't lock, the owner is responsible of synchronization.
+ */
+class PpsEpochEstimator {
+private:
+	std::size_t window;
+
+	nanoseconds margin;
+
+	std::optional<PpsEvent> lastPulse;
+
+	std::deque<nanoseconds> intervals;
+
+	std::deque<nanoseconds> latencies;
+
+	std::optional<nanoseconds> epochLatency;
+
+	unsigned int pulses;
+
+	unsigned int missed;
+
+	std::optional<GpsUtcTime> anchorUtc;
+
+	nanoseconds anchorMonotonic;
+
+public:
+	/**
+	 * Nominal interval between two pulses
+	 */
+	static constexpr nanoseconds nominalInterval = std::chrono::seconds(1);
+
+	/**
+	 * Minimal number of learned epochs before giving an epoch deadline
+	 */
+	static constexpr std::size_t minimalLearnedEpochs = 3;
+
+	/**
+	 * @brief      Constructor
+	 *
+	 * @param[in]  window  Number of epochs used to compute statistics and sentence latency
+	 * @param[in]  margin  Margin added to the learned sentence latency
+	 */
+	PpsEpochEstimator(std::size_t window = 16, nanoseconds margin = milliseconds(20));
+
+	/**
+	 * @brief      Process a new pulse
+	 */
+	void onPulse(const PpsEvent & event);
+
+	/**
+	 * @brief      Record a sentence arrival
+	 *
+	 * @param[in]  monotonicTime  Sentence arrival time on the monotonic clock
+	 */
+	void onSentence(nanoseconds monotonicTime);
+
+	/**
+	 * @brief      Anchor the GNSS time on the last pulse
+	 *
+	 * @param[in]  utc   UTC time of the current epoch as reported by the receiver
+	 */
+	void anchor(GpsUtcTime utc);
+
+	/**
+	 * @brief      Get the monotonic time at which the current epoch's sentences are due
+	 *
+	 * @return     The deadline, or an empty value while the latency isn't learned yet
+	 */
+	std::optional<nanoseconds> epochDeadline() const;
+
+	/**
+	 * @brief      Convert a monotonic time to GNSS UTC time using the last anchor
+	 *
+	 * @return     The UTC time in milliseconds, or an empty value if not anchored yet
+	 */
+	std::optional<GpsUtcTime> gnssTimeAt(nanoseconds monotonicTime) const;
+
+	/**
+	 * @brief      Get the timing statistics
+	 */
+	PpsStatistics statistics() const;
+
+	/**
+	 * @brief      Forget everything learned
+	 */
+	void reset();
+};
+
+/**
+ * @brief      PPS epoch timer
+ *
+ * @details    The timer thread waits for pulses from the source, feeds the estimator and emits
+ * `epochDue` when all the sentences of the current epoch should have been received.
+ */
+class PpsEpochTimer :
+	public Trackable,
+	public Thread
+{
+private:
+	IPpsSource & source;
+
+	PpsEpochEstimator estimator;
+
+	mutable std::mutex mutex;
+
+	std::condition_variable cond;
+
+	bool runTimer;
+
+protected:
+	virtual void run();
+
+public:
+	PpsEpochTimer(IPpsSource & source);
+
+	virtual ~PpsEpochTimer();
+
+	/**
+	 * @brief      Sentence received slot
+	 */
+	void onSentence();
+
+	/**
+	 * @brief      GNSS time decoded slot
+	 *
+	 * @param[in]  utc   UTC time of the epoch
+	 */
+	void onGnssTime(GpsUtcTime utc);
+
+	/**
+	 * @brief      Get the current GNSS UTC time using the monotonic clock
+	 */
+	std::optional<GpsUtcTime> gnssNow() const;
+
+	/**
+	 * @brief      Get the timing statistics
+	 */
+	PpsStatistics statistics() const;
+
+	/**
+	 * @brief      Start the timer thread, with a fresh estimator
+	 */
+	int start();
+
+	/**
+	 * @brief      Stop the timer thread and wait for its end
+	 *
+	 * @details    The thread ends once the pending pulse fetch returns, so this may block up to
+	 * the fetch timeout.
+	 */
+	virtual int stop();
+
+	/**
+	 * Signal emitted on each pulse
+	 */
+	Signal<void, const PpsEvent &> pulse;
+
+	/**
+	 * Signal emitted when the current epoch's sentences are all received
+	 */
+	Signal<void> epochDue;
+};
+
+/**
+ * @brief      Get the monotonic clock current time
+ */
+nanoseconds monotonicNow();
+
+} // namespace pps
+} // namespace stm
+
+#endif // TESEO_HAL_UTILS_PPS_H
@@ -50,6 +50,8 @@ private:
 
 	bool running; ///< Flag that indicates if the thread is running
 
+	bool joinable; ///< Flag that indicates if a started thread wasn't joined yet
+
 	/**
 	 * Thread create callback type
 	 */
@@ -98,6 +100,9 @@ public:
 
 	/**
 	 * @brief      Pause until the thread ends
+	 *
+	 * @details    Does nothing if the thread wasn't started, was already joined, or if it is
+	 * called from the thread itself.
 	 */
 	void join();
 
@@ -65,6 +65,19 @@ std::optional<GpsUtcTime> parseTimestamp(
  */
 std::optional<GpsUtcTime> parseTimestamp(const ByteVector & vec);
 
+/**
+ * @brief      Convert a date and a time to a timestamp
+ *
+ * @details    The date format is 'ddmmyy' (years 2000 to 2099) and the time format is
+ * 'hhmmss.msec'. Unlike the time only version, the result doesn't depend on the injected date.
+ *
+ * @param[in]  date   Date to parse
+ * @param[in]  time   Time to parse
+ *
+ * @return     The parsed timestamp
+ */
+std::optional<GpsUtcTime> parseTimestamp(const ByteVector & date, const ByteVector & time);
+
 /**
  * @brief      Save the UTC time into the HAL memory
  *
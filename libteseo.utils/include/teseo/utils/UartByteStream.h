@@ -95,6 +95,25 @@ public:
 	virtual const std::string& name() const;
 
 	virtual ByteStreamStatus status() const;
+
+	/**
+	 * @brief Change the device baud rate
+	 *
+	 * @details Output already written is sent at the previous baud rate before the change.
+	 *
+	 * @return False if the baud rate isn't supported or can't be applied
+	 */
+	bool setSpeed(unsigned int speed);
+
+	/**
+	 * @brief Get the device baud rate
+	 */
+	unsigned int speed() const;
+
+	/**
+	 * @brief Get the maximum supported baud rate
+	 */
+	static unsigned int maxSpeed();
 };
 
 } // namespace stream
@@ -22,6 +22,7 @@
 #ifndef TESEO_HAL_UTILS_HTTP_H
 #define TESEO_HAL_UTILS_HTTP_H
 
+#include <chrono>
 #include <vector>
 #include <unordered_map>
 #include <functional>
@@ -88,6 +89,11 @@ public:
 
 	HttpRequest & setContent(const std::string & content);
 
+	/**
+	 * @brief      Abort the request when it takes longer, 0 (the default) waits forever
+	 */
+	HttpRequest & setTimeout(std::chrono::milliseconds timeout);
+
 	const HttpResponse & getResponse() const;
 
 	virtual int stop();
@@ -105,6 +111,7 @@ private:
 	std::vector<Header> headers;
 	std::string userAgent;
 	std::string content;
+	std::chrono::milliseconds timeout;
 	bool stopped;
 	HttpResponse response;
 };
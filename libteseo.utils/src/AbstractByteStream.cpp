@@ -34,13 +34,40 @@ void ByteStreamReader::run()
 	if(!bsOpener)
 	{
 		ALOGE("Unable to open byte stream, ByteStreamReader will exit early.");
+		std::lock_guard<std::mutex> lock(readerMutex);
+		reading = false;
 		return;
 	}
 
-	runReader = true;
-	while(runReader)
+	while(true)
 	{
-		auto bv = byteStream.perform_read();
+		{
+			std::lock_guard<std::mutex> lock(readerMutex);
+			if(!runReader)
+			{
+				reading = false;
+				break;
+			}
+		}
+
+		ByteVector bv;
+
+		try
+		{
+			bv = byteStream.perform_read();
+		}
+		catch(const StreamException & ex)
+		{
+			std::lock_guard<std::mutex> lock(readerMutex);
+			reading = false;
+
+			// The device may be closed by the writer while the reader is stopping
+			if(!runReader)
+				break;
+
+			throw;
+		}
+
 		byteStream.newBytes(bv);
 	}
 }
@@ -48,11 +75,38 @@ void ByteStreamReader::run()
 ByteStreamReader::ByteStreamReader(IByteStream & bs) :
 	Thread("ByteStreamReader"),
 	byteStream(bs),
-	runReader(true)
+	runReader(true),
+	reading(false)
 { }
 
+int ByteStreamReader::start()
+{
+	{
+		std::lock_guard<std::mutex> lock(readerMutex);
+		if(reading)
+		{
+			ALOGV("Resume byte stream reader");
+			runReader = true;
+			return 0;
+		}
+	}
+
+	// The previous reader is leaving run(), wait for its end
+	join();
+
+	// Set before the thread exists, so a stop request can't be overwritten by the thread
+	{
+		std::lock_guard<std::mutex> lock(readerMutex);
+		runReader = true;
+		reading = true;
+	}
+
+	return Thread::start();
+}
+
 int ByteStreamReader::stop()
 {
+	std::lock_guard<std::mutex> lock(readerMutex);
 	runReader = false;
 	return 0;
 }
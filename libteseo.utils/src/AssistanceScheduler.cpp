@@ -0,0 +1,413 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Predictive assistance data refresh scheduler
+ * @file AssistanceScheduler.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/utils/AssistanceScheduler.h>
+
+#define LOG_TAG "teseo_hal_AssistanceScheduler"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <teseo/utils/http.h>
+
+namespace stm {
+namespace assistance {
+
+using namespace std::chrono;
+
+static const hours budgetWindow(24);
+
+SchedulerPolicy::SchedulerPolicy() :
+	prefetchLead(hours(2)),
+	coalesceWindow(hours(1)),
+	backoffBase(seconds(30)),
+	backoffMax(hours(1)),
+	backoffJitter(.2),
+	dailyBudget(0)
+{ }
+
+AssistanceScheduler::AssistanceScheduler(const SchedulerPolicy & policy, uint32_t seed) :
+	policy(policy),
+	rng(seed)
+{ }
+
+void AssistanceScheduler::expireUsage(time_point now)
+{
+	while(!usage.empty() && usage.front().first + budgetWindow <= now)
+		usage.pop_front();
+}
+
+bool AssistanceScheduler::fitsBudget(std::size_t bytes) const
+{
+	if(policy.dailyBudget == 0)
+		return true;
+
+	std::size_t used = 0;
+	for(const auto & u : usage)
+		used += u.second;
+
+	return used + bytes <= policy.dailyBudget;
+}
+
+time_point AssistanceScheduler::prefetchTime(const Item & item) const
+{
+	return item.validUntil - policy.prefetchLead;
+}
+
+void AssistanceScheduler::track(const std::string & id, time_point validUntil, std::size_t expectedBytes)
+{
+	auto it = items.find(id);
+
+	if(it == items.end())
+	{
+		items[id] = Item{validUntil, expectedBytes, 0, time_point(), false};
+		return;
+	}
+
+	it->second.validUntil = validUntil;
+	it->second.expectedBytes = expectedBytes;
+	it->second.failures = 0;
+	it->second.nextAttempt = time_point();
+}
+
+void AssistanceScheduler::untrack(const std::string & id)
+{
+	items.erase(id);
+}
+
+std::vector<std::string> AssistanceScheduler::poll(time_point now, bool awake)
+{
+	std::vector<std::pair<time_point, std::string>> candidates;
+	bool strictlyDue = false;
+
+	expireUsage(now);
+
+	for(const auto & p : items)
+	{
+		const Item & item = p.second;
+
+		if(item.inFlight || now < item.nextAttempt)
+			continue;
+
+		if(now >= prefetchTime(item))
+			strictlyDue = true;
+
+		candidates.push_back(std::make_pair(prefetchTime(item), p.first));
+	}
+
+	// Coalesce the refreshes due soon with the one due now, or with an external wakeup
+	time_point horizon = (strictlyDue || awake) ? now + policy.coalesceWindow : now;
+
+	std::sort(candidates.begin(), candidates.end());
+
+	std::vector<std::string> selected;
+	std::size_t reserved = 0;
+
+	for(const auto & c : candidates)
+	{
+		if(c.first > horizon)
+			break;
+
+		Item & item = items[c.second];
+
+		if(!fitsBudget(reserved + item.expectedBytes))
+		{
+			ALOGW("Daily budget exhausted, refresh of '%s' deferred", c.second.c_str());
+			continue;
+		}
+
+		reserved += item.expectedBytes;
+		item.inFlight = true;
+		selected.push_back(c.second);
+	}
+
+	return selected;
+}
+
+void AssistanceScheduler::report(const std::string & id, const FetchResult & result, time_point now)
+{
+	if(result.bytes > 0)
+		usage.push_back(std::make_pair(now, result.bytes));
+
+	auto it = items.find(id);
+	if(it == items.end())
+		return;
+
+	Item & item = it->second;
+	item.inFlight = false;
+
+	if(result.success)
+	{
+		// The size of the last download is the best guess of the next one
+		if(result.bytes > 0)
+			item.expectedBytes = result.bytes;
+
+		item.validUntil = result.validUntil;
+		item.failures = 0;
+		item.nextAttempt = time_point();
+		return;
+	}
+
+	item.failures++;
+
+	duration<double> delay = policy.backoffBase * std::pow(2., std::min(item.failures - 1, 30u));
+	delay = std::min<duration<double>>(delay, policy.backoffMax);
+
+	std::uniform_real_distribution<double> jitter(-policy.backoffJitter, policy.backoffJitter);
+	delay *= 1. + jitter(rng);
+
+	item.nextAttempt = now + duration_cast<Clock::duration>(delay);
+
+	ALOGW("Refresh of '%s' failed %u time(s), retry in %llds", id.c_str(), item.failures,
+		static_cast<long long>(duration_cast<seconds>(delay).count()));
+}
+
+std::optional<time_point> AssistanceScheduler::nextWakeup(time_point now)
+{
+	std::optional<time_point> wakeup;
+
+	expireUsage(now);
+
+	std::size_t used = 0;
+	for(const auto & u : usage)
+		used += u.second;
+
+	for(const auto & p : items)
+	{
+		const Item & item = p.second;
+
+		if(item.inFlight)
+			continue;
+
+		if(policy.dailyBudget != 0 && item.expectedBytes > policy.dailyBudget)
+			continue;
+
+		time_point t = std::max(prefetchTime(item), item.nextAttempt);
+
+		// Wait for enough of the budget to be released
+		if(policy.dailyBudget != 0 && used + item.expectedBytes > policy.dailyBudget)
+		{
+			std::size_t remaining = used;
+
+			for(const auto & u : usage)
+			{
+				remaining -= u.second;
+				if(remaining + item.expectedBytes <= policy.dailyBudget)
+				{
+					t = std::max(t, u.first + budgetWindow);
+					break;
+				}
+			}
+		}
+
+		if(!wakeup || t < *wakeup)
+			wakeup = t;
+	}
+
+	if(wakeup && *wakeup < now)
+		wakeup = now;
+
+	return wakeup;
+}
+
+std::size_t AssistanceScheduler::budgetUsed(time_point now)
+{
+	expireUsage(now);
+
+	std::size_t used = 0;
+	for(const auto & u : usage)
+		used += u.second;
+
+	return used;
+}
+
+std::optional<time_point> AssistanceScheduler::validUntil(const std::string & id) const
+{
+	auto it = items.find(id);
+
+	if(it == items.end())
+		return std::nullopt;
+
+	return it->second.validUntil;
+}
+
+HttpAssistanceFetcher::HttpAssistanceFetcher(milliseconds timeout) :
+	timeout(timeout),
+	downloaded("HttpAssistanceFetcher::downloaded")
+{ }
+
+void HttpAssistanceFetcher::setUri(const std::string & id, const std::string & uri)
+{
+	uris[id] = uri;
+}
+
+FetchResult HttpAssistanceFetcher::fetch(const std::string & id)
+{
+	auto it = uris.find(id);
+
+	if(it == uris.end())
+	{
+		ALOGE("No URI for assistance item '%s'", id.c_str());
+		return FetchResult{false, 0, time_point()};
+	}
+
+	utils::HttpRequest request;
+
+	request.setVerb(utils::HttpRequest::GET)
+		.setUri(it->second)
+		.setUserAgent(USER_AGENT)
+		.setTimeout(timeout);
+
+	request.start();
+	request.join();
+
+	const utils::HttpResponse & response = request.getResponse();
+	FetchResult result{false, response.buffer.size(), time_point()};
+
+	if(response.statusCode != utils::HttpStatusCode::Success)
+	{
+		ALOGW("Download of '%s' failed: %d %s", id.c_str(),
+			static_cast<int>(response.statusCode), response.statusMessage.c_str());
+		return result;
+	}
+
+	GpsUtcTime validity = downloaded(id, response.buffer);
+
+	if(validity > 0)
+	{
+		result.success = true;
+		result.validUntil = time_point(milliseconds(validity));
+	}
+
+	return result;
+}
+
+AssistanceRefresher::AssistanceRefresher(const SchedulerPolicy & policy, IAssistanceFetcher & fetcher) :
+	Trackable(),
+	Thread("teseo-agnss-refresh"),
+	scheduler(policy, static_cast<uint32_t>(Clock::now().time_since_epoch().count())),
+	fetcher(fetcher),
+	runRefresher(false),
+	awake(false),
+	changed(false),
+	refreshed("AssistanceRefresher::refreshed")
+{ }
+
+AssistanceRefresher::~AssistanceRefresher()
+{ }
+
+void AssistanceRefresher::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	ALOGI("Start assistance refresher");
+
+	while(runRefresher)
+	{
+		std::vector<std::string> ids = scheduler.poll(Clock::now(), awake);
+		awake = false;
+
+		if(ids.empty())
+		{
+			std::optional<time_point> wakeup = scheduler.nextWakeup(Clock::now());
+			auto pred = [this] () { return !runRefresher || awake || changed; };
+
+			changed = false;
+
+			if(wakeup)
+				cond.wait_until(lock, *wakeup, pred);
+			else
+				cond.wait(lock, pred);
+
+			continue;
+		}
+
+		for(const auto & id : ids)
+		{
+			ALOGI("Refresh assistance item '%s'", id.c_str());
+
+			lock.unlock();
+			FetchResult result = fetcher.fetch(id);
+			lock.lock();
+
+			scheduler.report(id, result, Clock::now());
+
+			lock.unlock();
+			refreshed(id, result);
+			lock.lock();
+		}
+	}
+
+	ALOGI("Stop assistance refresher");
+}
+
+int AssistanceRefresher::start()
+{
+	// Set before the thread exists, so a stop request can't be overwritten by the thread
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runRefresher = true;
+	}
+
+	return Thread::start();
+}
+
+void AssistanceRefresher::track(const std::string & id, time_point validUntil, std::size_t expectedBytes)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		scheduler.track(id, validUntil, expectedBytes);
+		changed = true;
+	}
+
+	cond.notify_all();
+}
+
+void AssistanceRefresher::onWakeup()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		awake = true;
+	}
+
+	cond.notify_all();
+}
+
+int AssistanceRefresher::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runRefresher = false;
+	}
+
+	cond.notify_all();
+	return 0;
+}
+
+} // namespace assistance
+} // namespace stm
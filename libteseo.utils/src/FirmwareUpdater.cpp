@@ -0,0 +1,409 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Resumable receiver firmware update over the UART byte stream
+ * @file FirmwareUpdater.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/utils/FirmwareUpdater.h>
+
+#define LOG_TAG "teseo_hal_FirmwareUpdater"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <array>
+
+namespace stm {
+namespace firmware {
+
+using namespace std::chrono;
+
+constexpr uint8_t Frame::startOfFrame;
+constexpr std::size_t Frame::headerSize;
+constexpr std::size_t Frame::maxPayloadSize;
+
+static std::array<uint32_t, 256> makeCrc32Table()
+{
+	std::array<uint32_t, 256> table;
+
+	for(uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t c = i;
+
+		for(int k = 0; k < 8; k++)
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+
+		table[i] = c;
+	}
+
+	return table;
+}
+
+uint32_t crc32(const uint8_t * data, std::size_t size, uint32_t crc)
+{
+	static const std::array<uint32_t, 256> table = makeCrc32Table();
+
+	crc = ~crc;
+
+	for(std::size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static void put16(ByteVector & out, uint16_t value)
+{
+	out.push_back(value & 0xFF);
+	out.push_back((value >> 8) & 0xFF);
+}
+
+static void put32(ByteVector & out, uint32_t value)
+{
+	for(int i = 0; i < 4; i++)
+		out.push_back((value >> (8 * i)) & 0xFF);
+}
+
+static uint32_t get32(const uint8_t * in)
+{
+	return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+ByteVector Frame::encode() const
+{
+	ByteVector out;
+	out.reserve(headerSize + payload.size() + 4);
+
+	out.push_back(startOfFrame);
+	out.push_back(static_cast<uint8_t>(type));
+	put32(out, sequence);
+	put16(out, static_cast<uint16_t>(payload.size()));
+	out.insert(out.end(), payload.begin(), payload.end());
+	put32(out, crc32(out.data() + 1, out.size() - 1));
+
+	return out;
+}
+
+FrameParser::FrameParser() :
+	dropped(0)
+{ }
+
+std::deque<Frame> FrameParser::push(const ByteVector & bytes)
+{
+	std::deque<Frame> frames;
+
+	buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+
+	while(true)
+	{
+		auto sof = std::find(buffer.begin(), buffer.end(), Frame::startOfFrame);
+		buffer.erase(buffer.begin(), sof);
+
+		if(buffer.size() < Frame::headerSize)
+			break;
+
+		std::size_t length = buffer[6] | (buffer[7] << 8);
+
+		if(length > Frame::maxPayloadSize)
+		{
+			buffer.erase(buffer.begin());
+			dropped++;
+			continue;
+		}
+
+		if(buffer.size() < Frame::headerSize + length + 4)
+			break;
+
+		uint32_t crc = get32(&buffer[Frame::headerSize + length]);
+
+		if(crc != crc32(&buffer[1], Frame::headerSize - 1 + length))
+		{
+			buffer.erase(buffer.begin());
+			dropped++;
+			continue;
+		}
+
+		Frame f;
+		f.type = static_cast<FrameType>(buffer[1]);
+		f.sequence = get32(&buffer[2]);
+		f.payload.assign(buffer.begin() + Frame::headerSize, buffer.begin() + Frame::headerSize + length);
+		frames.push_back(f);
+
+		buffer.erase(buffer.begin(), buffer.begin() + Frame::headerSize + length + 4);
+	}
+
+	return frames;
+}
+
+unsigned int FrameParser::droppedFrames() const
+{
+	return dropped;
+}
+
+void FrameParser::reset()
+{
+	buffer.clear();
+	dropped = 0;
+}
+
+UpdateSettings::UpdateSettings() :
+	blockSize(1024),
+	window(8),
+	ackTimeout(500),
+	maxRetries(5),
+	baudRate(0)
+{ }
+
+const char * toString(UpdateResult result)
+{
+	switch(result)
+	{
+		case UpdateResult::Success:     return "success";
+		case UpdateResult::Interrupted: return "interrupted";
+		case UpdateResult::Rejected:    return "rejected";
+		case UpdateResult::StreamError: return "stream error";
+	}
+
+	return "unknown";
+}
+
+FirmwareUpdater::FirmwareUpdater(stream::UartByteStream & stream, const UpdateSettings & settings) :
+	Trackable(),
+	stream(stream),
+	settings(settings),
+	currentProgress({0, 0, 0, 0, 0.}),
+	progress("FirmwareUpdater::progress")
+{
+	stream.newBytes.connect(SlotFactory::create(*this, &FirmwareUpdater::onNewBytes));
+}
+
+void FirmwareUpdater::onNewBytes(const ByteVector & bytes)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	std::deque<Frame> received = parser.push(bytes);
+
+	if(received.empty())
+		return;
+
+	frames.insert(frames.end(), received.begin(), received.end());
+	lock.unlock();
+
+	cond.notify_all();
+}
+
+void FirmwareUpdater::send(const Frame & frame)
+{
+	stream.write(std::make_shared<ByteVector>(frame.encode()));
+}
+
+std::optional<Frame> FirmwareUpdater::receive(milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	if(!cond.wait_for(lock, timeout, [this] () { return !frames.empty(); }))
+		return std::nullopt;
+
+	Frame f = frames.front();
+	frames.pop_front();
+	return f;
+}
+
+UpdateProgress FirmwareUpdater::getProgress()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return currentProgress;
+}
+
+UpdateResult FirmwareUpdater::transfer(const ByteVector & image, uint32_t first, uint32_t totalBlocks)
+{
+	auto start = steady_clock::now();
+	uint32_t base = first, next = first;
+	uint32_t highestSent = first;
+	unsigned int retries = 0;
+
+	while(base < totalBlocks)
+	{
+		// Fill the window
+		while(next < totalBlocks && next - base < settings.window)
+		{
+			std::size_t offset = static_cast<std::size_t>(next) * settings.blockSize;
+			std::size_t size = std::min(settings.blockSize, image.size() - offset);
+
+			send(Frame{FrameType::Data, next,
+				ByteVector(image.begin() + offset, image.begin() + offset + size)});
+
+			if(next < highestSent)
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				currentProgress.retransmissions++;
+			}
+
+			next++;
+			highestSent = std::max(highestSent, next);
+		}
+
+		auto frame = receive(settings.ackTimeout);
+
+		if(!frame)
+		{
+			if(++retries > settings.maxRetries)
+			{
+				ALOGE("No acknowledge from bootloader, update interrupted at block %u", base);
+				return UpdateResult::Interrupted;
+			}
+
+			ALOGW("Acknowledge timeout, send again from block %u", base);
+			next = base;
+			continue;
+		}
+
+		if(frame->type == FrameType::Ack && frame->sequence > base && frame->sequence <= next)
+		{
+			base = frame->sequence;
+			retries = 0;
+
+			UpdateProgress p;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				double elapsed = duration<double>(steady_clock::now() - start).count();
+				double bytes = std::min<double>(
+					static_cast<double>(base - first) * settings.blockSize, image.size());
+
+				currentProgress.ackedBlocks = base;
+				currentProgress.throughput = elapsed > 0. ? bytes / elapsed : 0.;
+				p = currentProgress;
+			}
+
+			progress(p);
+		}
+		else if(frame->type == FrameType::Nak && frame->sequence >= base && frame->sequence < next)
+		{
+			ALOGW("Block %u rejected by bootloader", frame->sequence);
+
+			if(++retries > settings.maxRetries)
+			{
+				ALOGE("Block %u rejected too many times", frame->sequence);
+				return UpdateResult::Interrupted;
+			}
+
+			base = frame->sequence;
+			next = frame->sequence;
+		}
+	}
+
+	return UpdateResult::Success;
+}
+
+UpdateResult FirmwareUpdater::update(const ByteVector & image)
+{
+	uint32_t totalBlocks = (image.size() + settings.blockSize - 1) / settings.blockSize;
+	uint32_t imageCrc = crc32(image.data(), image.size());
+	unsigned int originalSpeed = stream.speed();
+	unsigned int speed = settings.baudRate ? settings.baudRate : stream::UartByteStream::maxSpeed();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		parser.reset();
+		frames.clear();
+		currentProgress = UpdateProgress{0, totalBlocks, 0, 0, 0.};
+	}
+
+	ALOGI("Start firmware update: %zu bytes, %u blocks of %zu bytes, crc 0x%08x",
+		image.size(), totalBlocks, settings.blockSize, imageCrc);
+
+	// Announce the image, the bootloader answers with the first missing block
+	Frame hello{FrameType::Hello, 0, ByteVector()};
+	put32(hello.payload, image.size());
+	put32(hello.payload, imageCrc);
+	put16(hello.payload, settings.blockSize);
+	put32(hello.payload, speed);
+
+	std::optional<Frame> status;
+	for(unsigned int i = 0; i <= settings.maxRetries && !status; i++)
+	{
+		send(hello);
+
+		while((status = receive(settings.ackTimeout)) && status->type != FrameType::Status)
+			;
+	}
+
+	if(!status || status->payload.size() < 4 || status->sequence > totalBlocks)
+	{
+		ALOGE("No answer from bootloader");
+		return UpdateResult::Interrupted;
+	}
+
+	uint32_t first = status->sequence;
+	unsigned int acceptedSpeed = get32(status->payload.data());
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		currentProgress.ackedBlocks = first;
+		currentProgress.resumedBlocks = first;
+	}
+
+	if(first > 0)
+		ALOGI("Resume firmware update from block %u", first);
+
+	if(acceptedSpeed != 0 && acceptedSpeed != originalSpeed && !stream.setSpeed(acceptedSpeed))
+	{
+		send(Frame{FrameType::Abort, 0, ByteVector()});
+		return UpdateResult::StreamError;
+	}
+
+	UpdateResult result = transfer(image, first, totalBlocks);
+
+	if(result == UpdateResult::Success)
+	{
+		// Commit the image, flashing may take longer than a block acknowledge
+		std::optional<Frame> done;
+		for(unsigned int i = 0; i <= settings.maxRetries && !done; i++)
+		{
+			send(Frame{FrameType::Commit, totalBlocks, ByteVector()});
+
+			while((done = receive(settings.ackTimeout * 4)) && done->type != FrameType::Done)
+				;
+		}
+
+		if(!done)
+			result = UpdateResult::Interrupted;
+		else if(done->payload.empty() || done->payload[0] != 0)
+			result = UpdateResult::Rejected;
+	}
+	else
+	{
+		send(Frame{FrameType::Abort, 0, ByteVector()});
+	}
+
+	if(stream.speed() != originalSpeed)
+		stream.setSpeed(originalSpeed);
+
+	UpdateProgress p = getProgress();
+	ALOGI("Firmware update %s: %u/%u blocks, %u retransmitted, %.0f B/s",
+		toString(result), p.ackedBlocks, p.totalBlocks, p.retransmissions, p.throughput);
+
+	return result;
+}
+
+} // namespace firmware
+} // namespace stm
@@ -0,0 +1,1009 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Compressed NMEA stream capture
+ * @file NmeaCapture.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/utils/NmeaCapture.h>
+
+#define LOG_TAG "teseo_hal_NmeaCapture"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace stm {
+namespace capture {
+
+namespace {
+
+const uint8_t magic[4] = {'N', 'M', 'Z', '1'};
+
+/**
+ * Lines longer than this are stored as literals without waiting for their end
+ */
+constexpr std::size_t maxLineSize = 4096;
+
+/**
+ * Chunks announcing more than this are considered corrupted
+ */
+constexpr uint64_t maxChunkSize = 64 * 1024 * 1024;
+
+/**
+ * Record kinds, the other values are type indexes
+ */
+enum Record : uint8_t {
+	LITERAL_LINE = 0,
+	NEW_TYPE     = 255
+};
+
+constexpr std::size_t maxTypes = NEW_TYPE - 1;
+
+/**
+ * Field operations, in the 3 low bits of the field byte. The 5 high bits hold a small argument,
+ * followed by a varint when it doesn't fit.
+ */
+enum Op : uint8_t {
+	SAME    = 0, ///< Same as in the reference sentence, argument is the number of extra fields
+	EMPTY   = 1, ///< Empty field
+	DICT    = 2, ///< Dictionary entry, argument is the index
+	DELTA   = 3, ///< Same number format, argument is the zigzag value difference
+	NUMBER  = 4, ///< Number, argument is the integer digits count
+	LITERAL = 5, ///< Raw value, argument is its size
+	DELTA2  = 6  ///< Same number format, argument is the zigzag difference with the previous delta
+};
+
+constexpr uint8_t smallArgMax = 31;
+
+uint32_t crc32(const uint8_t * data, std::size_t size)
+{
+	static const std::array<uint32_t, 256> table = [] () {
+		std::array<uint32_t, 256> t;
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for(int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	uint32_t crc = 0xFFFFFFFF;
+	for(std::size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+void putVarint(ByteVector & out, uint64_t v)
+{
+	while(v >= 0x80)
+	{
+		out.push_back(static_cast<uint8_t>(v | 0x80));
+		v >>= 7;
+	}
+
+	out.push_back(static_cast<uint8_t>(v));
+}
+
+bool getVarint(const uint8_t * & p, const uint8_t * end, uint64_t & v)
+{
+	v = 0;
+
+	for(unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		if(p == end)
+			return false;
+
+		uint8_t b = *p++;
+		v |= static_cast<uint64_t>(b & 0x7F) << shift;
+
+		if(!(b & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+uint64_t zigzag(int64_t v)
+{
+	return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v)
+{
+	return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+void putOp(ByteVector & out, Op op, uint64_t arg)
+{
+	if(arg < smallArgMax)
+	{
+		out.push_back(static_cast<uint8_t>(op | (arg << 3)));
+	}
+	else
+	{
+		out.push_back(static_cast<uint8_t>(op | (smallArgMax << 3)));
+		putVarint(out, arg - smallArgMax);
+	}
+}
+
+bool getOp(const uint8_t * & p, const uint8_t * end, Op & op, uint64_t & arg)
+{
+	if(p == end)
+		return false;
+
+	uint8_t b = *p++;
+	op = static_cast<Op>(b & 0x07);
+	arg = b >> 3;
+
+	if(arg < smallArgMax)
+		return true;
+
+	uint64_t extra;
+	if(!getVarint(p, end, extra))
+		return false;
+
+	arg += extra;
+	return true;
+}
+
+/**
+ * Decimal number keeping its exact text format
+ */
+struct Number {
+	int64_t value;
+	uint8_t intDigits;
+	uint8_t fracDigits;
+	bool dot;
+
+	bool sameFormat(const Number & other) const
+	{
+		return intDigits == other.intDigits && fracDigits == other.fracDigits && dot == other.dot;
+	}
+};
+
+bool parseNumber(const std::string & text, Number & n)
+{
+	std::size_t i = 0;
+	bool negative = false;
+
+	if(!text.empty() && text[0] == '-')
+	{
+		negative = true;
+		i = 1;
+	}
+
+	uint64_t value = 0;
+	unsigned int intDigits = 0;
+	unsigned int fracDigits = 0;
+	bool dot = false;
+
+	for(; i < text.size(); i++)
+	{
+		char c = text[i];
+
+		if(c == '.' && !dot)
+		{
+			dot = true;
+			continue;
+		}
+
+		if(c < '0' || c > '9')
+			return false;
+
+		value = value * 10 + (c - '0');
+		(dot ? fracDigits : intDigits)++;
+
+		// Keeps the value and its differences in an int64_t
+		if(intDigits + fracDigits > 18)
+			return false;
+	}
+
+	// "-0" can't be told apart from "0"
+	if(intDigits + fracDigits == 0 || (negative && value == 0))
+		return false;
+
+	n.value = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+	n.intDigits = static_cast<uint8_t>(intDigits);
+	n.fracDigits = static_cast<uint8_t>(fracDigits);
+	n.dot = dot;
+	return true;
+}
+
+bool formatNumber(const Number & n, std::string & text)
+{
+	const unsigned int width = n.intDigits + n.fracDigits;
+
+	if(width == 0 || width > 18 || (n.fracDigits && !n.dot))
+		return false;
+
+	const bool negative = n.value < 0;
+	uint64_t value = negative ? -static_cast<uint64_t>(n.value) : static_cast<uint64_t>(n.value);
+
+	if(negative && value == 0)
+		return false;
+
+	char digits[20];
+	for(int i = width - 1; i >= 0; i--)
+	{
+		digits[i] = '0' + value % 10;
+		value /= 10;
+	}
+
+	// The value doesn't fit in its format
+	if(value != 0)
+		return false;
+
+	text.clear();
+	if(negative)
+		text.push_back('-');
+	text.append(digits, n.intDigits);
+	if(n.dot)
+		text.push_back('.');
+	text.append(digits + n.intDigits, n.fracDigits);
+	return true;
+}
+
+/**
+ * Last values seen in a field, oldest replaced first
+ */
+class Dictionary {
+private:
+	static constexpr std::size_t capacity = 16;
+
+	std::array<std::string, capacity> entries;
+	std::size_t count = 0;
+	std::size_t next = 0;
+
+public:
+	int find(const std::string & text) const
+	{
+		for(std::size_t i = 0; i < count; i++)
+		{
+			if(entries[i] == text)
+				return static_cast<int>(i);
+		}
+
+		return -1;
+	}
+
+	const std::string * at(uint64_t index) const
+	{
+		return index < count ? &entries[index] : nullptr;
+	}
+
+	void add(const std::string & text)
+	{
+		entries[next] = text;
+		next = (next + 1) % capacity;
+		if(count < capacity)
+			count++;
+	}
+};
+
+struct Field {
+	std::string text;
+	bool numeric = false;
+	Number number;
+	int64_t delta = 0; ///< Difference with the reference field, when it has the same format
+};
+
+using Fields = std::vector<Field>;
+
+int64_t wrappingSub(int64_t a, int64_t b)
+{
+	return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));
+}
+
+int64_t wrappingAdd(int64_t a, int64_t b)
+{
+	return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));
+}
+
+} // namespace
+
+namespace priv {
+
+/**
+ * Encoding state shared by the encoder and the decoder, reset on each chunk
+ */
+class Model {
+public:
+	struct Type {
+		/**
+		 * Sentences cycling through several contents, like the GSV pages, are coded against the
+		 * most similar of the last ones
+		 */
+		static constexpr std::size_t depth = 4;
+
+		std::array<Fields, depth> history;
+		std::size_t head = 0;
+		std::size_t count = 0;
+
+		std::vector<Dictionary> dictionaries;
+
+		/**
+		 * Sentence r positions back, 0 is the last one
+		 */
+		const Fields * reference(std::size_t r) const
+		{
+			return r < count ? &history[(head + depth - r) % depth] : nullptr;
+		}
+
+		void push(Fields && fields)
+		{
+			head = (head + 1) % depth;
+			history[head] = std::move(fields);
+			count = std::min(count + 1, depth);
+		}
+
+		Dictionary & dictionary(std::size_t index)
+		{
+			if(index >= dictionaries.size())
+				dictionaries.resize(index + 1);
+
+			return dictionaries[index];
+		}
+	};
+
+	std::vector<std::string> names;
+
+	std::unordered_map<std::string, std::size_t> indexes;
+
+	std::vector<Type> types;
+
+	void reset()
+	{
+		names.clear();
+		indexes.clear();
+		types.clear();
+	}
+
+	std::size_t addType(const std::string & name)
+	{
+		indexes.emplace(name, names.size());
+		names.push_back(name);
+		types.emplace_back();
+		return names.size() - 1;
+	}
+};
+
+} // namespace priv
+
+namespace {
+
+using Type = priv::Model::Type;
+
+const char hexDigits[] = "0123456789ABCDEF";
+
+/**
+ * Check that a line is "$body*HH\r\n" with a valid upper case checksum
+ */
+bool isSentence(const uint8_t * data, std::size_t size)
+{
+	if(size < 6 || data[0] != '$' || data[size - 2] != '\r' || data[size - 1] != '\n' || data[size - 5] != '*')
+		return false;
+
+	uint8_t crc = 0;
+	for(std::size_t i = 1; i < size - 5; i++)
+		crc ^= data[i];
+
+	return data[size - 4] == hexDigits[crc >> 4] && data[size - 3] == hexDigits[crc & 0x0F];
+}
+
+const Field * referenceField(const Fields * reference, std::size_t index)
+{
+	return reference && index < reference->size() ? &(*reference)[index] : nullptr;
+}
+
+/**
+ * Compute the numeric value of a field from its text
+ */
+void analyze(Field & field, const Field * previous)
+{
+	field.numeric = parseNumber(field.text, field.number);
+	field.delta = 0;
+
+	if(field.numeric && previous && previous->numeric && previous->number.sameFormat(field.number))
+		field.delta = wrappingSub(field.number.value, previous->number.value);
+}
+
+/**
+ * Encode the fields following the sentence type
+ */
+void encodeFields(ByteVector & out, Type & type, Fields && fields)
+{
+	std::size_t ref = 0;
+	std::size_t best = 0;
+
+	for(std::size_t r = 0; r < type.count; r++)
+	{
+		const Fields & candidate = *type.reference(r);
+		std::size_t same = 0;
+
+		for(std::size_t i = 0; i < std::min(candidate.size(), fields.size()); i++)
+			same += candidate[i].text == fields[i].text;
+
+		if(r == 0 || same > best)
+		{
+			ref = r;
+			best = same;
+		}
+	}
+
+	const Fields * reference = type.reference(ref);
+	putVarint(out, fields.size() << 2 | ref);
+
+	for(std::size_t i = 0; i < fields.size(); )
+	{
+		Field & field = fields[i];
+		const Field * previous = referenceField(reference, i);
+
+		if(previous && previous->text == field.text)
+		{
+			std::size_t run = 0;
+
+			while(i + run < fields.size())
+			{
+				const Field * p = referenceField(reference, i + run);
+				if(!p || p->text != fields[i + run].text)
+					break;
+
+				analyze(fields[i + run], p);
+				run++;
+			}
+
+			putOp(out, SAME, run - 1);
+			i += run;
+			continue;
+		}
+
+		analyze(field, previous);
+
+		if(field.text.empty())
+		{
+			putOp(out, EMPTY, 0);
+		}
+		else if(field.numeric)
+		{
+			if(previous && previous->numeric && previous->number.sameFormat(field.number))
+			{
+				// Steady rates, like the time, cost nothing on the second order
+				const uint64_t first = zigzag(field.delta);
+				const uint64_t second = zigzag(wrappingSub(field.delta, previous->delta));
+
+				if(second < first)
+					putOp(out, DELTA2, second);
+				else
+					putOp(out, DELTA, first);
+			}
+			else
+			{
+				putOp(out, NUMBER, field.number.intDigits);
+				out.push_back(static_cast<uint8_t>(field.number.fracDigits | (field.number.dot ? 0x80 : 0)));
+				putVarint(out, zigzag(field.number.value));
+			}
+		}
+		else
+		{
+			Dictionary & dictionary = type.dictionary(i);
+			int entry = dictionary.find(field.text);
+
+			if(entry >= 0)
+			{
+				putOp(out, DICT, entry);
+			}
+			else
+			{
+				putOp(out, LITERAL, field.text.size());
+				out.insert(out.end(), field.text.begin(), field.text.end());
+				dictionary.add(field.text);
+			}
+		}
+
+		i++;
+	}
+
+	type.push(std::move(fields));
+}
+
+bool decodeFields(const uint8_t * & p, const uint8_t * end, Type & type, ByteVector & raw)
+{
+	uint64_t header;
+	if(!getVarint(p, end, header))
+		return false;
+
+	const uint64_t count = header >> 2;
+	const std::size_t ref = header & 0x03;
+
+	// Sentences are cut like any line
+	if(count > maxLineSize || (ref > 0 && ref >= type.count))
+		return false;
+
+	const Fields * reference = type.reference(ref);
+	Fields fields(count);
+
+	for(std::size_t i = 0; i < count; )
+	{
+		Op op;
+		uint64_t arg;
+
+		if(!getOp(p, end, op, arg))
+			return false;
+
+		Field & field = fields[i];
+		const Field * previous = referenceField(reference, i);
+
+		switch(op)
+		{
+			case SAME:
+				if(arg >= count - i)
+					return false;
+
+				for(std::size_t k = 0; k <= arg; k++)
+				{
+					const Field * q = referenceField(reference, i + k);
+					if(!q)
+						return false;
+
+					fields[i + k].text = q->text;
+					analyze(fields[i + k], q);
+				}
+
+				i += arg + 1;
+				continue;
+
+			case EMPTY:
+				break;
+
+			case DICT:
+			{
+				const std::string * entry = type.dictionary(i).at(arg);
+				if(!entry)
+					return false;
+				field.text = *entry;
+				break;
+			}
+
+			case DELTA:
+			case DELTA2:
+			{
+				if(!previous || !previous->numeric)
+					return false;
+
+				int64_t delta = unzigzag(arg);
+				if(op == DELTA2)
+					delta = wrappingAdd(delta, previous->delta);
+
+				Number number = previous->number;
+				number.value = wrappingAdd(previous->number.value, delta);
+				if(!formatNumber(number, field.text))
+					return false;
+				break;
+			}
+
+			case NUMBER:
+			{
+				uint64_t value;
+				if(arg > 18 || p == end)
+					return false;
+
+				uint8_t format = *p++;
+				if(!getVarint(p, end, value))
+					return false;
+
+				Number number;
+				number.value = unzigzag(value);
+				number.intDigits = static_cast<uint8_t>(arg);
+				number.fracDigits = format & 0x7F;
+				number.dot = (format & 0x80) != 0;
+				if(!formatNumber(number, field.text))
+					return false;
+				break;
+			}
+
+			case LITERAL:
+				if(arg > static_cast<uint64_t>(end - p))
+					return false;
+
+				field.text.assign(reinterpret_cast<const char *>(p), arg);
+				p += arg;
+				type.dictionary(i).add(field.text);
+				break;
+
+			default:
+				return false;
+		}
+
+		analyze(field, previous);
+		i++;
+	}
+
+	for(const Field & field : fields)
+	{
+		raw.push_back(',');
+		raw.insert(raw.end(), field.text.begin(), field.text.end());
+	}
+
+	type.push(std::move(fields));
+	return true;
+}
+
+} // namespace
+
+NmeaCaptureEncoder::NmeaCaptureEncoder(std::size_t chunkSize) :
+	chunkSize(chunkSize),
+	model(new priv::Model()),
+	rawSize(0),
+	newChunk("NmeaCaptureEncoder::newChunk")
+{ }
+
+NmeaCaptureEncoder::~NmeaCaptureEncoder()
+{ }
+
+void NmeaCaptureEncoder::encodeLine(const uint8_t * data, std::size_t size)
+{
+	rawSize += size;
+
+	if(isSentence(data, size))
+	{
+		const uint8_t * body = data + 1;
+		const uint8_t * bodyEnd = data + size - 5;
+		const uint8_t * comma = std::find(body, bodyEnd, ',');
+
+		std::string name(reinterpret_cast<const char *>(body), comma - body);
+		auto it = model->indexes.find(name);
+
+		if(it != model->indexes.end() || model->names.size() < maxTypes)
+		{
+			std::size_t index;
+
+			if(it != model->indexes.end())
+			{
+				index = it->second;
+				payload.push_back(static_cast<uint8_t>(index + 1));
+			}
+			else
+			{
+				index = model->addType(name);
+				payload.push_back(NEW_TYPE);
+				putVarint(payload, name.size());
+				payload.insert(payload.end(), body, comma);
+			}
+
+			Fields fields(std::count(comma, bodyEnd, ','));
+
+			const uint8_t * begin = comma;
+			for(Field & field : fields)
+			{
+				begin++;
+				const uint8_t * end = std::find(begin, bodyEnd, ',');
+				field.text.assign(reinterpret_cast<const char *>(begin), end - begin);
+				begin = end;
+			}
+
+			encodeFields(payload, model->types[index], std::move(fields));
+			return;
+		}
+	}
+
+	payload.push_back(LITERAL_LINE);
+	putVarint(payload, size);
+	payload.insert(payload.end(), data, data + size);
+}
+
+void NmeaCaptureEncoder::closeChunk()
+{
+	if(rawSize == 0)
+		return;
+
+	ByteVector chunk(magic, magic + sizeof(magic));
+	putVarint(chunk, rawSize);
+	putVarint(chunk, payload.size());
+
+	const uint32_t crc = crc32(payload.data(), payload.size());
+	for(int i = 0; i < 4; i++)
+		chunk.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+
+	chunk.insert(chunk.end(), payload.begin(), payload.end());
+
+	payload.clear();
+	rawSize = 0;
+	model->reset();
+
+	newChunk(chunk);
+}
+
+void NmeaCaptureEncoder::append(const uint8_t * data, std::size_t size)
+{
+	const uint8_t * end = data + size;
+
+	while(data != end)
+	{
+		const uint8_t * eol = static_cast<const uint8_t *>(std::memchr(data, '\n', end - data));
+		const uint8_t * stop = eol ? eol + 1 : end;
+
+		if(line.empty() && eol)
+		{
+			// Whole line available, no copy
+			encodeLine(data, stop - data);
+		}
+		else
+		{
+			line.insert(line.end(), data, stop);
+
+			if(eol || line.size() >= maxLineSize)
+			{
+				encodeLine(line.data(), line.size());
+				line.clear();
+			}
+		}
+
+		data = stop;
+
+		if(rawSize >= chunkSize)
+			closeChunk();
+	}
+}
+
+void NmeaCaptureEncoder::append(const ByteVector & bytes)
+{
+	append(bytes.data(), bytes.size());
+}
+
+void NmeaCaptureEncoder::flush()
+{
+	if(!line.empty())
+	{
+		encodeLine(line.data(), line.size());
+		line.clear();
+	}
+
+	closeChunk();
+}
+
+NmeaCaptureDecoder::Status NmeaCaptureDecoder::decodeChunk(
+	const uint8_t * data,
+	std::size_t size,
+	std::size_t & consumed,
+	ByteVector & out)
+{
+	const uint8_t * p = data;
+	const uint8_t * end = data + size;
+
+	if(std::memcmp(data, magic, std::min(size, sizeof(magic))) != 0)
+		return Status::Corrupted;
+
+	if(size < sizeof(magic))
+		return Status::Incomplete;
+
+	p += sizeof(magic);
+
+	uint64_t rawSize, payloadSize;
+	if(!getVarint(p, end, rawSize) || !getVarint(p, end, payloadSize))
+		return end - p < 10 ? Status::Incomplete : Status::Corrupted;
+
+	if(rawSize > maxChunkSize || payloadSize > maxChunkSize)
+		return Status::Corrupted;
+
+	if(payloadSize + 4 > static_cast<uint64_t>(end - p))
+		return Status::Incomplete;
+
+	uint32_t crc = 0;
+	for(int i = 0; i < 4; i++)
+		crc |= static_cast<uint32_t>(*p++) << (8 * i);
+
+	end = p + payloadSize;
+
+	if(crc32(p, payloadSize) != crc)
+		return Status::Corrupted;
+
+	priv::Model model;
+	ByteVector raw;
+	raw.reserve(rawSize);
+	std::string text;
+
+	while(p != end)
+	{
+		uint8_t record = *p++;
+
+		if(record == LITERAL_LINE)
+		{
+			uint64_t length;
+			if(!getVarint(p, end, length) || length > static_cast<uint64_t>(end - p))
+				return Status::Corrupted;
+
+			raw.insert(raw.end(), p, p + length);
+			p += length;
+			continue;
+		}
+
+		std::size_t index;
+
+		if(record == NEW_TYPE)
+		{
+			uint64_t length;
+			if(!getVarint(p, end, length) || length > static_cast<uint64_t>(end - p) || model.names.size() >= maxTypes)
+				return Status::Corrupted;
+
+			index = model.addType(std::string(reinterpret_cast<const char *>(p), length));
+			p += length;
+		}
+		else
+		{
+			index = record - 1;
+			if(index >= model.names.size())
+				return Status::Corrupted;
+		}
+
+		const std::size_t start = raw.size();
+		const std::string & name = model.names[index];
+
+		raw.push_back('$');
+		raw.insert(raw.end(), name.begin(), name.end());
+
+		if(!decodeFields(p, end, model.types[index], raw))
+			return Status::Corrupted;
+
+		uint8_t crc = 0;
+		for(std::size_t i = start + 1; i < raw.size(); i++)
+			crc ^= raw[i];
+
+		raw.push_back('*');
+		raw.push_back(hexDigits[crc >> 4]);
+		raw.push_back(hexDigits[crc & 0x0F]);
+		raw.push_back('\r');
+		raw.push_back('\n');
+	}
+
+	if(raw.size() != rawSize)
+		return Status::Corrupted;
+
+	out.insert(out.end(), raw.begin(), raw.end());
+	consumed = end - data;
+	return Status::Ok;
+}
+
+std::size_t NmeaCaptureDecoder::decode(const ByteVector & capture, ByteVector & out)
+{
+	std::size_t skipped = 0;
+	std::size_t pos = 0;
+
+	while(pos < capture.size())
+	{
+		std::size_t consumed = 0;
+		Status status = decodeChunk(capture.data() + pos, capture.size() - pos, consumed, out);
+
+		if(status == Status::Ok)
+		{
+			pos += consumed;
+			continue;
+		}
+
+		skipped++;
+
+		if(status == Status::Incomplete)
+		{
+			ALOGW("Truncated capture chunk at offset %zu", pos);
+			break;
+		}
+
+		ALOGW("Corrupted capture chunk at offset %zu", pos);
+
+		auto next = std::search(capture.begin() + pos + 1, capture.end(), magic, magic + sizeof(magic));
+		pos = next - capture.begin();
+	}
+
+	return skipped;
+}
+
+NmeaCaptureWriter::NmeaCaptureWriter(const std::string & path, std::size_t chunkSize) :
+	Trackable(),
+	Thread("teseo-nmea-capture"),
+	path(path),
+	encoder(chunkSize),
+	file(nullptr),
+	capturing(true),
+	bytesChannel("NmeaCaptureWriter::bytesChannel")
+{
+	encoder.newChunk.connect(SlotFactory::create(*this, &NmeaCaptureWriter::onChunk));
+}
+
+NmeaCaptureWriter::~NmeaCaptureWriter()
+{ }
+
+void NmeaCaptureWriter::run()
+{
+	file = fopen(path.c_str(), "ab");
+
+	if(!file)
+	{
+		ALOGE("Unable to open NMEA capture %s: %s", path.c_str(), strerror(errno));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		capturing = false;
+
+		while(bytesChannel.size() > 0)
+			delete bytesChannel.receive();
+
+		return;
+	}
+
+	ALOGI("Start NMEA capture to %s", path.c_str());
+
+	while(true)
+	{
+		ByteVector * bytes = bytesChannel.receive();
+
+		if(bytes == nullptr)
+			break;
+
+		encoder.append(*bytes);
+		delete bytes;
+	}
+
+	encoder.flush();
+	fclose(file);
+	file = nullptr;
+
+	ALOGI("End of NMEA capture");
+}
+
+void NmeaCaptureWriter::onChunk(const ByteVector & chunk)
+{
+	if(fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size() || fflush(file) != 0)
+		ALOGE("Unable to write NMEA capture %s: %s", path.c_str(), strerror(errno));
+}
+
+void NmeaCaptureWriter::onNewBytes(const ByteVector & bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(capturing)
+		bytesChannel.send(new ByteVector(bytes));
+}
+
+int NmeaCaptureWriter::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(!capturing)
+			return -1;
+
+		capturing = false;
+	}
+
+	bytesChannel.send(nullptr);
+	return 0;
+}
+
+} // namespace capture
+} // namespace stm
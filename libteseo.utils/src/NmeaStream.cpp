@@ -70,7 +70,7 @@ void NmeaStream::onNewBytes(const ByteVector & bytes)
 		auto bytesEnd = bytes.end();
 
 		/*
-			* This for loop is responsible of splitting the stream at each $.
+			* This for loop is responsible of splitting the stream at each $ and at each line end.
 			* 
 			* When a $ is found its position is store in end, then we remove any trailing '\r' or
 			* '\n'.
@@ -81,6 +81,9 @@ void NmeaStream::onNewBytes(const ByteVector & bytes)
 			* The buffer is sent for processing, then cleared.
 			* 
 			* The new frame start is set at dollar position.
+			* 
+			* A '\n' also ends the frame, so the last sentence of a burst is not held back until
+			* the next one arrives.
 			*/
 		for(auto it = start; it != bytesEnd; ++it)
 		{
@@ -89,10 +92,10 @@ void NmeaStream::onNewBytes(const ByteVector & bytes)
 				auto end = it;
 
 				// Remove any \n or \r just before the dollar
-				if(*(end - 1) == '\r' || *(end - 1) == '\n')
+				if(end > start && (*(end - 1) == '\r' || *(end - 1) == '\n'))
 					end--;
 
-				if(*(end - 1) == '\r' || *(end - 1) == '\n')
+				if(end > start && (*(end - 1) == '\r' || *(end - 1) == '\n'))
 					end--;
 
 				// Append data to buffer
@@ -100,12 +103,33 @@ void NmeaStream::onNewBytes(const ByteVector & bytes)
 					buffer.insert(buffer.end(), start, end);
 				
 				// Send and clear buffer
-				newSentence(ByteVectorPtr(new ByteVector(buffer.begin(), buffer.end())));
+				if(!buffer.empty())
+					newSentence(ByteVectorPtr(new ByteVector(buffer.begin(), buffer.end())));
 				buffer.clear();
 
 				// Set start to dollar position
 				start = it;
 			}
+			else if(*it == '\n')
+			{
+				auto end = it;
+
+				// Remove the \r just before the \n
+				if(end > start && *(end - 1) == '\r')
+					end--;
+
+				if(start < end)
+					buffer.insert(buffer.end(), start, end);
+
+				if(!buffer.empty() && buffer.back() == '\r')
+					buffer.pop_back();
+
+				if(!buffer.empty())
+					newSentence(ByteVectorPtr(new ByteVector(buffer.begin(), buffer.end())));
+				buffer.clear();
+
+				start = it + 1;
+			}
 		}
 
 		// Append the rest of the readed bytes to the buffer
@@ -0,0 +1,418 @@
+/*
+* This file is part of Teseo Android HAL
+*
+* Copyright (c) 2016-2017, STMicroelectronics - All Rights Reserved
+* Author(s): Baudouin Feildel <baudouin.feildel@st.com> for STMicroelectronics.
+*
+* License terms: Apache 2.0.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+/**
+ * @brief Kernel PPS based epoch timing
+ * @file Pps.cpp
+ * @copyright 2018, STMicroelectronics, All rights reserved.
+ */
+
+#include <teseo/utils/Pps.h>
+
+#define LOG_TAG "teseo_hal_Pps"
+#include <cutils/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/pps.h>
+
+#include <teseo/utils/errors.h>
+#include <teseo/utils/IByteStream.h>
+
+namespace stm {
+namespace pps {
+
+using namespace std::chrono;
+
+constexpr nanoseconds PpsEpochEstimator::nominalInterval;
+constexpr std::size_t PpsEpochEstimator::minimalLearnedEpochs;
+
+nanoseconds monotonicNow()
+{
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch());
+}
+
+static nanoseconds realtimeNow()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec);
+}
+
+KernelPpsSource::KernelPpsSource(const std::string & device) :
+	device(device),
+	fd(-1),
+	lastSequence(0)
+{ }
+
+KernelPpsSource::~KernelPpsSource()
+{
+	close();
+}
+
+const std::string & KernelPpsSource::name() const
+{
+	return device;
+}
+
+void KernelPpsSource::open() noexcept(false)
+{
+	if(fd >= 0)
+		return;
+
+	fd = ::open(device.c_str(), O_RDWR);
+	CHECK_ERROR(fd, errors::open, "PPS source %s opened successfully.", device.c_str());
+
+	if(fd == -1)
+		throw stream::StreamOpenException();
+
+	int caps = 0;
+	if(ioctl(fd, PPS_GETCAP, &caps) == -1 || !(caps & PPS_CAPTUREASSERT))
+	{
+		ALOGE("PPS source %s can't capture assert events", device.c_str());
+		close();
+		throw stream::StreamOpenException();
+	}
+
+	// Enabling assert capture requires CAP_SYS_TIME, it is usually already enabled by the
+	// kernel client so a failure here isn't fatal.
+	struct pps_kparams params;
+	if(ioctl(fd, PPS_GETPARAMS, &params) == 0 && !(params.mode & PPS_CAPTUREASSERT))
+	{
+		params.mode |= PPS_CAPTUREASSERT;
+		if(ioctl(fd, PPS_SETPARAMS, &params) == -1)
+			ALOGW("Unable to enable assert capture on %s: %s", device.c_str(), strerror(errno));
+	}
+}
+
+void KernelPpsSource::close()
+{
+	if(fd >= 0)
+	{
+		auto ret = ::close(fd);
+		CHECK_ERROR(ret, errors::close, "PPS source %s closed successfully.", device.c_str());
+		fd = -1;
+	}
+}
+
+std::optional<PpsEvent> KernelPpsSource::fetch(milliseconds timeout) noexcept(false)
+{
+	if(fd < 0)
+		throw stream::StreamNotOpenedException();
+
+	struct pps_fdata fdata;
+	memset(&fdata, 0, sizeof(fdata));
+	fdata.timeout.sec = duration_cast<seconds>(timeout).count();
+	fdata.timeout.nsec = duration_cast<nanoseconds>(timeout % seconds(1)).count();
+	fdata.timeout.flags = 0;
+
+	if(ioctl(fd, PPS_FETCH, &fdata) == -1)
+	{
+		if(errno == ETIMEDOUT || errno == EINTR)
+			return {};
+
+		errors::read(errno);
+		throw stream::StreamReadException();
+	}
+
+	if(fdata.info.assert_sequence == lastSequence)
+		return {};
+
+	lastSequence = fdata.info.assert_sequence;
+
+	// The kernel timestamps the pulse with the realtime clock, move it to the monotonic clock
+	// which doesn't jump when the system time is injected.
+	nanoseconds assertTime = seconds(fdata.info.assert_tu.sec) + nanoseconds(fdata.info.assert_tu.nsec);
+	nanoseconds offset = monotonicNow() - realtimeNow();
+
+	return PpsEvent { assertTime, assertTime + offset, fdata.info.assert_sequence };
+}
+
+PpsEpochEstimator::PpsEpochEstimator(std::size_t window, nanoseconds margin) :
+	window(window),
+	margin(margin)
+{
+	reset();
+}
+
+void PpsEpochEstimator::reset()
+{
+	lastPulse.reset();
+	intervals.clear();
+	latencies.clear();
+	epochLatency.reset();
+	pulses = 0;
+	missed = 0;
+	anchorUtc.reset();
+	anchorMonotonic = nanoseconds::zero();
+}
+
+template<typename T>
+static void push_bounded(std::deque<T> & d, const T & value, std::size_t size)
+{
+	d.push_back(value);
+
+	while(d.size() > size)
+		d.pop_front();
+}
+
+void PpsEpochEstimator::onPulse(const PpsEvent & event)
+{
+	pulses++;
+
+	if(lastPulse)
+	{
+		nanoseconds interval = event.monotonicTime - lastPulse->monotonicTime;
+		auto periods = static_cast<long>(std::lround(
+			static_cast<double>(interval.count()) / nominalInterval.count()));
+
+		if(periods > 1)
+			missed += periods - 1;
+		else if(periods == 1)
+			push_bounded(intervals, interval, window);
+
+		// Close the previous epoch
+		if(epochLatency)
+			push_bounded(latencies, *epochLatency, window);
+	}
+
+	epochLatency.reset();
+	lastPulse = event;
+}
+
+void PpsEpochEstimator::onSentence(nanoseconds monotonicTime)
+{
+	if(!lastPulse)
+		return;
+
+	nanoseconds offset = monotonicTime - lastPulse->monotonicTime;
+
+	// Ignore sentences that can't belong to the current epoch
+	if(offset < nanoseconds::zero() || offset >= nominalInterval)
+		return;
+
+	epochLatency = std::max(epochLatency.value_or(nanoseconds::zero()), offset);
+}
+
+void PpsEpochEstimator::anchor(GpsUtcTime utc)
+{
+	if(!lastPulse)
+		return;
+
+	// The pulse marks the start of the UTC second of the epoch
+	anchorUtc = utc - (utc % 1000);
+	anchorMonotonic = lastPulse->monotonicTime;
+}
+
+std::optional<nanoseconds> PpsEpochEstimator::epochDeadline() const
+{
+	if(!lastPulse || latencies.size() < minimalLearnedEpochs)
+		return {};
+
+	nanoseconds latency = *std::max_element(latencies.begin(), latencies.end()) + margin;
+
+	// Sentences are still in flight when the next pulse arrives, early publication is useless
+	if(latency >= nominalInterval)
+		return {};
+
+	return lastPulse->monotonicTime + latency;
+}
+
+std::optional<GpsUtcTime> PpsEpochEstimator::gnssTimeAt(nanoseconds monotonicTime) const
+{
+	if(!anchorUtc)
+		return {};
+
+	return *anchorUtc + duration_cast<milliseconds>(monotonicTime - anchorMonotonic).count();
+}
+
+PpsStatistics PpsEpochEstimator::statistics() const
+{
+	PpsStatistics stats;
+
+	stats.pulses = pulses;
+	stats.missed = missed;
+	stats.meanInterval = nanoseconds::zero();
+	stats.jitter = nanoseconds::zero();
+	stats.maxDeviation = nanoseconds::zero();
+	stats.sentenceLatency = latencies.empty() ?
+		nanoseconds::zero() : *std::max_element(latencies.begin(), latencies.end());
+
+	if(intervals.empty())
+		return stats;
+
+	double sum = 0;
+	for(auto i : intervals)
+	{
+		sum += i.count();
+		stats.maxDeviation = std::max(stats.maxDeviation,
+			i > nominalInterval ? i - nominalInterval : nominalInterval - i);
+	}
+
+	double mean = sum / intervals.size();
+
+	double variance = 0;
+	for(auto i : intervals)
+		variance += (i.count() - mean) * (i.count() - mean);
+
+	variance /= intervals.size();
+
+	stats.meanInterval = nanoseconds(static_cast<nanoseconds::rep>(std::llround(mean)));
+	stats.jitter = nanoseconds(static_cast<nanoseconds::rep>(std::llround(std::sqrt(variance))));
+
+	return stats;
+}
+
+PpsEpochTimer::PpsEpochTimer(IPpsSource & source) :
+	Trackable(),
+	Thread("teseo-pps"),
+	source(source),
+	runTimer(false),
+	pulse("PpsEpochTimer::pulse"),
+	epochDue("PpsEpochTimer::epochDue")
+{ }
+
+PpsEpochTimer::~PpsEpochTimer()
+{ }
+
+void PpsEpochTimer::run()
+{
+	try
+	{
+		source.open();
+	}
+	catch(const stream::StreamException & ex)
+	{
+		ALOGE("Unable to open PPS source '%s': %s", source.name().c_str(), ex.what());
+		return;
+	}
+
+	ALOGI("Start PPS epoch timer on %s", source.name().c_str());
+
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if(!runTimer)
+				break;
+		}
+
+		std::optional<PpsEvent> event;
+
+		try
+		{
+			event = source.fetch(milliseconds(1500));
+		}
+		catch(const stream::StreamException & ex)
+		{
+			ALOGE("Error while fetching PPS event: %s", ex.what());
+			break;
+		}
+
+		if(!event)
+		{
+			ALOGW("No pulse received from %s", source.name().c_str());
+			continue;
+		}
+
+		std::optional<nanoseconds> deadline;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			estimator.onPulse(*event);
+			deadline = estimator.epochDeadline();
+		}
+
+		pulse(*event);
+
+		if(deadline)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			steady_clock::time_point tp(duration_cast<steady_clock::duration>(*deadline));
+
+			if(cond.wait_until(lock, tp, [this] { return !runTimer; }))
+				break;
+
+			lock.unlock();
+			epochDue();
+		}
+	}
+
+	source.close();
+
+	ALOGI("End of PPS epoch timer");
+}
+
+void PpsEpochTimer::onSentence()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	estimator.onSentence(monotonicNow());
+}
+
+void PpsEpochTimer::onGnssTime(GpsUtcTime utc)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	estimator.anchor(utc);
+}
+
+std::optional<GpsUtcTime> PpsEpochTimer::gnssNow() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return estimator.gnssTimeAt(monotonicNow());
+}
+
+PpsStatistics PpsEpochTimer::statistics() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return estimator.statistics();
+}
+
+int PpsEpochTimer::start()
+{
+	// Set before the thread exists, so a stop request can't be overwritten by the thread
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runTimer = true;
+		estimator.reset();
+	}
+
+	return Thread::start();
+}
+
+int PpsEpochTimer::stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		runTimer = false;
+	}
+
+	cond.notify_all();
+	join();
+	return 0;
+}
+
+} // namespace pps
+} // namespace stm
@@ -54,13 +54,24 @@ void Thread::runWrapper()
 
 void Thread::join()
 {
+	if(!joinable)
+		return;
+
+	if(pthread_equal(handle, pthread_self()))
+	{
+		ALOGW("Thread %s can't join itself.", name.c_str());
+		return;
+	}
+
 	pthread_join(handle, NULL);
+	joinable = false;
 }
 
 Thread::Thread(const char * name) :
 	name(name)
 {
 	running = false;
+	joinable = false;
 }
 
 Thread::~Thread()
@@ -76,7 +87,18 @@ int Thread::start()
 {
 	if(!running)
 	{
+		// Release the previous run of the thread
+		join();
+
+		// Running from now on, a second start can't create another thread
+		running = true;
+
 		handle = createThread(name.c_str(), &priv::threadStart, this);
+		joinable = handle != 0;
+
+		if(!joinable)
+			running = false;
+
 		return handle != 0;
 	}
 	else
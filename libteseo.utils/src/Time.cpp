@@ -105,12 +105,18 @@ constexpr int PARSER_MIN_SIZE  = 2, PARSER_MIN_OFFSET  = 2;
 constexpr int PARSER_SEC_SIZE  = 2, PARSER_SEC_OFFSET  = 4;
 constexpr int PARSER_MSEC_SIZE = 3, PARSER_MSEC_OFFSET = 7;
 
-std::optional<GpsUtcTime> parseTimestamp(
+/**
+ * Milliseconds since midnight of a 'hhmmss.msec' time
+ */
+static std::optional<GpsUtcTime> parseTimeOfDay(
 	const ByteVector::const_iterator & begin,
 	const ByteVector::const_iterator & end)
 {
 	std::optional<int> hour, min, sec, msec;
 
+	if(end - begin < PARSER_MSEC_OFFSET + PARSER_MSEC_SIZE)
+		return {};
+
 	hour = byteVectorParse<int>(
 		begin + PARSER_HOUR_OFFSET,
 		begin + PARSER_HOUR_OFFSET + PARSER_HOUR_SIZE);
@@ -131,11 +137,44 @@ std::optional<GpsUtcTime> parseTimestamp(
 		ALOGW("Trailing data after timestamp: '%s'", bytesToString(begin, end).c_str());
 
 	if(hour && min && sec && msec)
-		return *msec + *sec * 1000 + *min * 60000 + *hour * 3600000 +
-			duration_cast<milliseconds>(utcTodayOffset.time_since_epoch()).count();
+		return *msec + *sec * 1000 + *min * 60000 + *hour * 3600000;
+	else
+		return {};
+}
+
+std::optional<GpsUtcTime> parseTimestamp(
+	const ByteVector::const_iterator & begin,
+	const ByteVector::const_iterator & end)
+{
+	if(auto timeOfDay = parseTimeOfDay(begin, end))
+		return *timeOfDay + duration_cast<milliseconds>(utcTodayOffset.time_since_epoch()).count();
 	else
 		return {};
 }
 
+std::optional<GpsUtcTime> parseTimestamp(const ByteVector & date, const ByteVector & time)
+{
+	if(date.size() != 6 || time.size() < PARSER_MSEC_OFFSET + PARSER_MSEC_SIZE)
+		return {};
+
+	std::optional<int> day   = byteVectorParse<int>(date.cbegin(),     date.cbegin() + 2);
+	std::optional<int> month = byteVectorParse<int>(date.cbegin() + 2, date.cbegin() + 4);
+	std::optional<int> year  = byteVectorParse<int>(date.cbegin() + 4, date.cbegin() + 6);
+	std::optional<GpsUtcTime> timeOfDay = parseTimeOfDay(time.cbegin(), time.cend());
+
+	if(!day || !month || !year || !timeOfDay || *month < 1 || *month > 12 || *day < 1 || *day > 31)
+		return {};
+
+	// Days since 1970-01-01 in the proleptic Gregorian calendar
+	int y = 2000 + *year - (*month <= 2 ? 1 : 0);
+	int era = y / 400;
+	int yoe = y - era * 400;
+	int doy = (153 * (*month + (*month > 2 ? -3 : 9)) + 2) / 5 + *day - 1;
+	int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	int64_t days = static_cast<int64_t>(era) * 146097 + doe - 719468;
+
+	return days * 86400000 + *timeOfDay;
+}
+
 } // namespace utils
 } // namespace stm
\ No newline at end of file
@@ -33,6 +33,7 @@
 
 #include <teseo/config/config.h>
 #include <teseo/utils/errors.h>
+#include <algorithm>
 #include <unordered_map>
 
 #define UART_BYTE_STREAM_BUFFER_SIZE 255
@@ -97,8 +98,7 @@ void UartByteStream::open() noexcept(false)
 
 	if(streamStatus == ByteStreamStatus::OPENED)
 	{
-		ALOGW("UART %s already opened.", ttyDevice.c_str());
-		ALOGV("Increment UART open count");
+		ALOGV("UART %s already opened, increment open count", ttyDevice.c_str());
 		openCount++;
 		return;
 	}
@@ -193,6 +193,53 @@ void UartByteStream::close() noexcept(false)
 	}
 }
 
+bool UartByteStream::setSpeed(unsigned int speed)
+{
+	std::unique_lock<std::mutex> lock(openMutex);
+
+	auto it = mDeviceSpeed.find(speed);
+	if(it == mDeviceSpeed.end())
+	{
+		ALOGE("Error: unsupported UART baud rate %u", speed);
+		return false;
+	}
+
+	if(streamStatus == ByteStreamStatus::OPENED)
+	{
+		struct termios attr;
+		tcgetattr(fd, &attr);
+
+		cfsetispeed(&attr, it->second);
+		cfsetospeed(&attr, it->second);
+
+		// Wait for pending output to be sent at the previous baud rate
+		if(tcsetattr(fd, TCSADRAIN, &attr) == -1)
+		{
+			ALOGE("Unable to set UART %s baud rate to %u", ttyDevice.c_str(), speed);
+			return false;
+		}
+	}
+
+	ALOGI("UART %s baud rate set to %u", ttyDevice.c_str(), speed);
+	speedDevice = speed;
+	return true;
+}
+
+unsigned int UartByteStream::speed() const
+{
+	return speedDevice;
+}
+
+unsigned int UartByteStream::maxSpeed()
+{
+	unsigned int max = 0;
+
+	for(const auto & s : mDeviceSpeed)
+		max = std::max(max, s.first);
+
+	return max;
+}
+
 ByteVector UartByteStream::perform_read() noexcept(false)
 {
 	if(streamStatus == ByteStreamStatus::OPENED)
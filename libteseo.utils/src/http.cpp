@@ -114,6 +114,7 @@ size_t curl_write_response_cb(char *ptr, size_t size, size_t nmemb, void *data)
 HttpRequest::HttpRequest() :
 	Thread("http-request"),
 	verb(Verb::GET),
+	timeout(0),
 	stopped(false)
 { }
 
@@ -187,6 +188,20 @@ HttpRequest & HttpRequest::setContent(const std::string & c)
 	return *this;
 }
 
+HttpRequest & HttpRequest::setTimeout(std::chrono::milliseconds t)
+{
+	if(!isRunning())
+	{
+		timeout = t;
+	}
+	else
+	{
+		ALOGW("Trying to change HTTP request timeout while executing request.");
+	}
+
+	return *this;
+}
+
 const HttpResponse & HttpRequest::getResponse() const
 {
 	return response;
@@ -247,6 +262,9 @@ void HttpRequest::run()
 	// System options
 	curl_easy_setopt(curlHandle, CURLOPT_NOSIGNAL, 1); // Avoid signals to be raised by cURL
 
+	if(timeout.count() > 0)
+		curl_easy_setopt(curlHandle, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+
 	// Register the write function and the write destination
 	if(verb == HttpRequest::POST)
 	{